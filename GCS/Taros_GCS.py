@@ -4,8 +4,13 @@
 from struct import *
 import random
 
+import taros_framing
+import taros_decoder
+import taros_templates
+import taros_commands
+
 import PySide6
-from PySide6.QtCore import Qt
+from PySide6.QtCore import Qt, QTimer
 from PySide6 import QtWidgets
 from PySide6.QtSerialPort import *
 from PySide6.QtGui import QColor
@@ -14,6 +19,45 @@ from PySide6.QtWidgets import ( QApplication, QWidget, QTabWidget,
     QPushButton, QLabel, QGridLayout, QHBoxLayout, QVBoxLayout )
 
 
+# the binary layout of the telemetry data messages (little-endian)
+# hash, time [ms] and the value(s), keyed by the low byte of the message type
+TM_DATA_FORMATS = {
+    0x90: '<HIh',       # MSG_TYPE_DATA_INT16
+    0x98: '<HIf',       # MSG_TYPE_DATA_FLOAT
+    0x99: '<HId',       # MSG_TYPE_DATA_DOUBLE
+    0xA0: '<HIddf',     # MSG_TYPE_DATA_GPS
+}
+
+def message_size(buffer):
+    """
+    The number of bytes the message at the start of the buffer takes.
+    Data messages have a fixed size, all others carry the number of bytes following the header.
+    Returns 0 if the buffer does not hold a complete message.
+    """
+    if len(buffer) < 3 or buffer[0] != 0xCC:
+        return 0
+    if buffer[1] in TM_DATA_FORMATS:
+        size = 2+calcsize(TM_DATA_FORMATS[buffer[1]])
+    else:
+        size = 3+buffer[2]
+    if size > len(buffer):
+        return 0
+    return size
+
+def split_messages(payload):
+    """
+    Split the payload of a frame into the messages packed into it.
+    """
+    messages = []
+    pos = 0
+    while pos < len(payload):
+        size = message_size(payload[pos:])
+        if size == 0:
+            break
+        messages.append(payload[pos:pos+size])
+        pos += size
+    return messages
+
 def format_time(t):
     h = t//(1000*60*60)
     ms = t-h*(1000*60*60)
@@ -34,8 +78,17 @@ class CommunicationsView(QWidget):
         # port for listening
         self.port_available = False
         self.port = None
-        # receive buffer for the messages
-        self.receive_buffer = bytearray(b'')
+        # decoder for the received frames
+        # the modem appends one RSSI byte after every packet
+        # the compiled decoder is used if available
+        try:
+            self.fast_decoder = taros_decoder.StreamDecoder(trailer_bytes=1)
+        except OSError:
+            self.fast_decoder = None
+        self.decoder = taros_framing.FrameDecoder(1)
+        # the dictionary of telemetry variables hash : (sender, name, units)
+        # it is filled from the variable declarations sent by the flight controller
+        self.tm_variables = {}
         # the left side - message table
         self.table = QTableWidget()
         self.table.setRowCount(0)
@@ -104,37 +157,28 @@ class CommunicationsView(QWidget):
         """
         Called when the application gets data from the connected device.
         """
-        msg = bytes(self.serial.readAll())
-        self.receive_buffer.extend(msg)
-        # line = ""
-        # for c in msg:
-        #     line += (" %0.2X" % c)
-        # print(line)
-        
-        found = False
-        empty = len(self.receive_buffer) < 3
-        while not (found or empty):
-            msb, lsb, n_bytes = unpack('BBB', self.receive_buffer[:3])
-            # if it ihas a message header
-            if msb == 204:
-                # if it is a system message or a ping response
-                if lsb == 129 or lsb == 136:
-                    if len(self.receive_buffer) >= n_bytes+3:
-                        found = True
-                    else:
-                        empty = True
-            if not (found or empty):
-                self.receive_buffer.pop(0)
-                empty = len(self.receive_buffer) < 3
-                
-        if found:
-            msg = self.receive_buffer[0:n_bytes+4]
-            del self.receive_buffer[0:n_bytes+4]
+        data = bytes(self.serial.readAll())
+        # the compiled decoder returns the messages split from the frames
+        if self.fast_decoder is not None:
+            for msg, rssi in self.fast_decoder.push(data):
+                self.process_message(msg, rssi)
+            return
+        # only frames with a valid CRC are returned
+        for payload, trailer in self.decoder.push(data):
+            # a frame may hold several messages
+            for msg in split_messages(payload):
+                self.process_message(msg, trailer[0])
+
+    def process_message(self, msg, rsi):
+        """
+        Display one message received in a frame.
+        """
+        if len(msg) >= 3:
             msb, lsb, n_bytes = unpack('BBB', msg[:3])
             # if it ihas a message header
             if msb == 204:
-                # if it is a system message
-                if lsb == 129:
+                # if it is a system message (plain text or template)
+                if lsb == 129 or lsb == 138:
                     sender = msg[3:11].decode(encoding='utf-8')
                     self.next_index = self.table.rowCount()
                     self.table.insertRow(self.next_index)
@@ -161,11 +205,15 @@ class CommunicationsView(QWidget):
                     time_item = QTableWidgetItem(format_time(time))
                     time_item.setBackground(col)
                     self.table.setItem(self.next_index, 1, time_item)
-                    text = msg[16:n_bytes+3].decode(encoding='utf-8')
+                    if lsb == 129:
+                        text = msg[16:n_bytes+3].decode(encoding='utf-8')
+                    else:
+                        # the template ID and binary arguments follow the time
+                        template_id, = unpack('<H', msg[16:18])
+                        text = taros_templates.format_template(template_id, msg[18:n_bytes+3])
                     text_item = QTableWidgetItem(text)
                     text_item.setBackground(col)
                     self.table.setItem(self.next_index, 2, text_item)
-                    rsi = msg[n_bytes+3]
                     rsi_item = QTableWidgetItem("%3d"%rsi)
                     rsi_item.setBackground(col)
                     self.table.setItem(self.next_index, 3, rsi_item)
@@ -185,18 +233,75 @@ class CommunicationsView(QWidget):
                     time_item = QTableWidgetItem("")
                     time_item.setBackground(col)
                     self.table.setItem(self.next_index, 1, time_item)
-                    up_rsi = msg[5]
-                    down_rsi = msg[6]
+                    # the body holds the hash of the ping and the uplink RSSI
+                    up_rsi = msg[13]
+                    down_rsi = rsi
                     text = f'ping RSI up={up_rsi} down = {down_rsi}'
                     text_item = QTableWidgetItem(text)
                     text_item.setBackground(col)
                     self.table.setItem(self.next_index, 2, text_item)
-                    # the RSI is appended after the counted payload bytes
-                    rsi = msg[n_bytes+3]
                     rsi_item = QTableWidgetItem("%3d"%rsi)
                     rsi_item.setBackground(col)
                     self.table.setItem(self.next_index, 3, rsi_item)
                     self.table.setCurrentCell(self.next_index, 0)
+                # if it is a command acknowledge
+                elif lsb == 139:
+                    sequence, status, up_rsi = unpack('<HBB', msg[11:15])
+                    result = self.mv.mcv.commands.acknowledge(sequence, status, up_rsi)
+                    if result is not None:
+                        command, status, up_rsi, rtt = result
+                        if status <= taros_commands.CMD_ACK_DUPLICATE:
+                            col = QColor.fromRgb(210, 210, 210)
+                            text = 'command %s acknowledged' % command[:4].decode(errors='replace')
+                        else:
+                            col = QColor.fromRgb(255, 200, 200)
+                            text = 'command %s rejected (%d)' % (command[:4].decode(errors='replace'), status)
+                        text += ' RSI up=%d after %.0f ms' % (up_rsi, 1000*rtt)
+                        self.next_index = self.table.rowCount()
+                        self.table.insertRow(self.next_index)
+                        self.table.setRowCount(self.next_index+1)
+                        for column, item_text in enumerate(["", "", text, "%3d"%rsi]):
+                            item = QTableWidgetItem(item_text)
+                            item.setBackground(col)
+                            self.table.setItem(self.next_index, column, item)
+                        self.table.setCurrentCell(self.next_index, 0)
+                # if it is a telemetry variable declaration
+                elif lsb == 137:
+                    sender = msg[3:11].decode(encoding='utf-8').rstrip()
+                    hash, data_type, var_count = unpack('<HHB', msg[11:16])
+                    name = msg[16:16+var_count].decode(encoding='utf-8')
+                    units = msg[16+var_count:n_bytes+3].decode(encoding='utf-8')
+                    self.tm_variables[hash] = (sender, name, units)
+                # if it is a telemetry data message
+                # these have no size byte and no sender, hash and time follow the type
+                elif lsb in TM_DATA_FORMATS:
+                    fmt = TM_DATA_FORMATS[lsb]
+                    if len(msg) >= 2+calcsize(fmt):
+                        values = unpack(fmt, msg[2:2+calcsize(fmt)])
+                        hash, time = values[0], values[1]
+                        if hash in self.tm_variables:
+                            sender, name, units = self.tm_variables[hash]
+                        else:
+                            sender, name, units = "", "#%04X" % hash, ""
+                        self.next_index = self.table.rowCount()
+                        self.table.insertRow(self.next_index)
+                        self.table.setRowCount(self.next_index+1)
+                        col = QColor.fromRgb(200, 220, 255)
+                        sender_item = QTableWidgetItem(sender)
+                        sender_item.setBackground(col)
+                        self.table.setItem(self.next_index, 0, sender_item)
+                        time_item = QTableWidgetItem(format_time(time))
+                        time_item.setBackground(col)
+                        self.table.setItem(self.next_index, 1, time_item)
+                        text = name + " = " + ", ".join("%.9g" % v for v in values[2:])
+                        text += " " + units
+                        text_item = QTableWidgetItem(text)
+                        text_item.setBackground(col)
+                        self.table.setItem(self.next_index, 2, text_item)
+                        rsi_item = QTableWidgetItem("%3d"%rsi)
+                        rsi_item.setBackground(col)
+                        self.table.setItem(self.next_index, 3, rsi_item)
+                        self.table.setCurrentCell(self.next_index, 0)
 
     def clear_list(self):
         """
@@ -229,17 +334,33 @@ class MissionControlView(QWidget):
         calsave_button.clicked.connect(self.calsave)
         layout.addWidget(calsave_button, 2, 0)
         self.setLayout(layout)
+        # commands are retransmitted until they are acknowledged
+        self.commands = taros_commands.CommandSender(self.transmit_command)
+        self.retransmit_timer = QTimer()
+        self.retransmit_timer.timeout.connect(self.check_commands)
+        self.retransmit_timer.start(20)
+
+    def encode_message(self, msg_type, body):
+        """
+        Assemble a message in the compact binary format used by TAROS.
+        Type word (high byte first), number of bytes following,
+        8 characters sender ID and the message body.
+        """
+        msg_buffer = bytearray(msg_type.to_bytes(2,'big'))
+        msg_buffer.extend([8+len(body)])
+        msg_buffer.extend(b'GCS     ')
+        msg_buffer.extend(body)
+        return msg_buffer
 
     def send_ping(self):
         if hasattr(self.cv, 'serial'):
-            # assemple an empty command message header (3 payload bytes)
-            msg_buffer = bytearray(b'\xCC\x87\x03')
-            # generate a random 16-bit hash
+            # the ping body is a random 16-bit hash and a placeholder for the uplink RSSI
             hash = random.randint(0,65535)
-            msg_buffer.extend(hash.to_bytes(2,'big'))
-            msg_buffer.extend([0])
-            # transmit
-            self.cv.serial.write(msg_buffer)
+            body = bytearray(hash.to_bytes(2,'big'))
+            body.extend([0])
+            msg_buffer = self.encode_message(0xCC87, body)
+            # transmit, the frame carries the CRC
+            self.cv.serial.write(taros_framing.frame_encode(msg_buffer))
             line = "sent ping "
             for c in msg_buffer:
                 line += (" %0.2X" % c)
@@ -247,44 +368,24 @@ class MissionControlView(QWidget):
         else:
             print('port not open.')
 
-    def calc_crc(self, payload):
-        """
-        Calculate a simple checksum over the payload.
-        If one later on calculates the checksum over the payload plus this checksum, zero must be obtained.
-        """
-        crc = 0
-        for byte in payload: crc ^= byte
-        return crc
-        
-    def motor_off(self):
+    def send_command(self, payload, critical=False):
         if hasattr(self.cv, 'serial'):
-            # assemple a command message header (4 payload bytes)
-            msg_buffer = bytearray(b'\xCC\x86')
-            payload = bytearray(b'MOFF')
-            crc = self.calc_crc(payload)
-            payload.extend([crc])
-            # transmit
-            msg_buffer.extend([len(payload)])
-            msg_buffer.extend(payload)
-            self.cv.serial.write(msg_buffer)
-            line = "sent command "
-            for c in msg_buffer:
-                line += (" %0.2X" % c)
-            print(line)
+            self.commands.send(payload, critical)
         else:
             print('port not open.')
 
-    def motor_full(self):
+    def check_commands(self):
+        for command in self.commands.poll():
+            print('command not acknowledged :', command)
+
+    def transmit_command(self, body):
+        """
+        Send one command message, the body starts with the sequence number.
+        """
         if hasattr(self.cv, 'serial'):
-            # assemple a command message header (4 payload bytes)
-            msg_buffer = bytearray(b'\xCC\x86')
-            payload = bytearray(b'MFULL')
-            crc = self.calc_crc(payload)
-            payload.extend([crc])
-            # transmit
-            msg_buffer.extend([len(payload)])
-            msg_buffer.extend(payload)
-            self.cv.serial.write(msg_buffer)
+            msg_buffer = self.encode_message(0xCC86, body)
+            # transmit, the frame carries the CRC
+            self.cv.serial.write(taros_framing.frame_encode(msg_buffer))
             line = "sent command "
             for c in msg_buffer:
                 line += (" %0.2X" % c)
@@ -292,23 +393,14 @@ class MissionControlView(QWidget):
         else:
             print('port not open.')
 
+    def motor_off(self):
+        self.send_command(b'MOFF', critical=True)
+
+    def motor_full(self):
+        self.send_command(b'MFULL')
+
     def calsave(self):
-        if hasattr(self.cv, 'serial'):
-            # assemple a command message header (4 payload bytes)
-            msg_buffer = bytearray(b'\xCC\x86')
-            payload = bytearray(b'CALSAVE')
-            crc = self.calc_crc(payload)
-            payload.extend([crc])
-            # transmit
-            msg_buffer.extend([len(payload)])
-            msg_buffer.extend(payload)
-            self.cv.serial.write(msg_buffer)
-            line = "sent command "
-            for c in msg_buffer:
-                line += (" %0.2X" % c)
-            print(line)
-        else:
-            print('port not open.')
+        self.send_command(b'CALSAVE')
 
 
 class MainWindow(QWidget):
@@ -0,0 +1,276 @@
+#!/usr/bin/env python3
+
+"""
+Reliable transport of commands over the TAROS uplink.
+
+Every command (MSG_TYPE_COMMAND) carries a 16-bit sequence number in front
+of the command keyword. The flight controller acknowledges every command
+received (MSG_TYPE_COMMAND_ACK) with the sequence number, a status
+and the uplink RSSI. It delivers every sequence number only once.
+
+The flight controller detects duplicates within a window of SEQUENCE_WINDOW
+sequence numbers (MODEM_CMD_WINDOW), so the sender never has outstanding
+commands with sequence numbers further apart. The sender keeps up to WINDOW
+normal commands unacknowledged at a time and retransmits them when no acknowledge has been received within the
+retransmit timeout. The timeout follows the measured round trip time
+(like TCP: smoothed RTT + 4 x deviation, only unambiguous samples are used).
+Normal commands back off exponentially and are given up after MAX_RETRIES
+retransmissions (about half a minute). With 30% loss in both directions a transmission
+and its acknowledge get through with a probability of 0.49, so fewer retries
+would give up (and lose) commands regularly.
+Critical commands (e.g. motors off) bypass the window, are never backed off
+and are retransmitted until they are acknowledged.
+
+Running this module performs a loopback test with simulated packet loss.
+"""
+
+import random
+import time
+from struct import pack, unpack
+
+# the status of an acknowledged command (see src/message.h)
+CMD_ACK_OK = 0
+CMD_ACK_DUPLICATE = 1
+CMD_NACK_FORMAT = 2
+CMD_NACK_NO_RECEIVER = 3
+
+# the width of the duplicate detection window of the flight controller (MODEM_CMD_WINDOW)
+SEQUENCE_WINDOW = 32
+# the number of normal commands outstanding at a time
+WINDOW = 8
+MAX_RETRIES = 10
+# bounds of the retransmit timeout [s]
+MIN_TIMEOUT = 0.15
+MAX_TIMEOUT = 4.0
+INITIAL_TIMEOUT = 0.5
+
+
+class PendingCommand:
+
+    def __init__(self, command, critical):
+        self.sequence = None
+        self.command = command
+        self.critical = critical
+        self.first_sent = None
+        self.last_sent = None
+        self.timeout = None
+        self.transmissions = 0
+
+
+class CommandSender:
+    """
+    transmit(body) is called with the body of a MSG_TYPE_COMMAND message
+    (sequence number and command) whenever it has to be sent.
+    poll() has to be called periodically to handle the retransmissions.
+    """
+
+    def __init__(self, transmit, clock=time.monotonic):
+        self.transmit = transmit
+        self.clock = clock
+        # start with a random sequence number, so a restarted ground station
+        # is not mistaken for a retransmission
+        self.next_sequence = random.randint(0, 65535)
+        # commands sent but not acknowledged
+        self.pending = {}
+        # commands waiting for a free slot in the window
+        self.waiting = []
+        self.srtt = None
+        self.rttvar = None
+        self.rto = INITIAL_TIMEOUT
+        # statistics
+        self.sent = 0
+        self.retransmissions = 0
+        self.acknowledged = 0
+        self.failed = 0
+
+    def send(self, command, critical=False):
+        """
+        Queue a command for transmission.
+        Critical commands are sent ahead of all waiting ones.
+        """
+        entry = PendingCommand(bytes(command), critical)
+        if critical:
+            self.waiting.insert(sum(1 for e in self.waiting if e.critical), entry)
+        else:
+            self.waiting.append(entry)
+        self.fill_window()
+
+    def window_used(self):
+        return sum(1 for e in self.pending.values() if not e.critical)
+
+    def sequence_span(self):
+        """
+        The distance of the next sequence number from the oldest outstanding one.
+        """
+        if not self.pending:
+            return 0
+        return max((self.next_sequence - s) & 0xFFFF for s in self.pending)
+
+    def start(self, entry):
+        entry.sequence = self.next_sequence
+        self.next_sequence = (self.next_sequence + 1) & 0xFFFF
+        entry.first_sent = self.clock()
+        entry.timeout = self.rto
+        self.pending[entry.sequence] = entry
+        self.sent += 1
+        self.send_entry(entry)
+
+    def send_entry(self, entry):
+        entry.last_sent = self.clock()
+        entry.transmissions += 1
+        self.transmit(pack('<H', entry.sequence) + entry.command)
+
+    def acknowledge(self, sequence, status, rssi):
+        """
+        Handle a received acknowledge.
+        Returns the (command, status, rssi, round trip time) or None if unknown.
+        """
+        entry = self.pending.pop(sequence, None)
+        if entry is None:
+            # an acknowledge of a retransmission already answered
+            return None
+        now = self.clock()
+        rtt = now - entry.first_sent
+        # only samples of commands sent once are unambiguous (Karn)
+        if entry.transmissions == 1:
+            self.update_rtt(rtt)
+        self.acknowledged += 1
+        self.fill_window()
+        return (entry.command, status, rssi, rtt)
+
+    def update_rtt(self, rtt):
+        if self.srtt is None:
+            self.srtt = rtt
+            self.rttvar = rtt / 2
+        else:
+            self.rttvar = 0.75 * self.rttvar + 0.25 * abs(self.srtt - rtt)
+            self.srtt = 0.875 * self.srtt + 0.125 * rtt
+        self.rto = min(MAX_TIMEOUT, max(MIN_TIMEOUT, self.srtt + 4 * self.rttvar))
+
+    def fill_window(self):
+        while self.waiting and self.sequence_span() < SEQUENCE_WINDOW:
+            if not self.waiting[0].critical and self.window_used() >= WINDOW:
+                break
+            self.start(self.waiting.pop(0))
+
+    def poll(self):
+        """
+        Retransmit all commands with an expired timeout.
+        Returns the list of commands given up.
+        """
+        now = self.clock()
+        given_up = []
+        for entry in list(self.pending.values()):
+            if now - entry.last_sent < entry.timeout:
+                continue
+            if not entry.critical:
+                if entry.transmissions > MAX_RETRIES:
+                    del self.pending[entry.sequence]
+                    self.failed += 1
+                    given_up.append(entry.command)
+                    continue
+                entry.timeout = min(MAX_TIMEOUT, 2 * entry.timeout)
+            else:
+                entry.timeout = self.rto
+            self.retransmissions += 1
+            self.send_entry(entry)
+        if given_up:
+            self.fill_window()
+        return given_up
+
+
+class Receiver:
+    """
+    The duplicate detection of the flight controller (Modem::command_seen).
+    """
+
+    def __init__(self):
+        self.highest = None
+        self.mask = 0
+
+    def receive(self, sequence):
+        """
+        Returns True if the command has to be delivered.
+        """
+        if self.highest is not None:
+            d = (sequence - self.highest + 0x8000) % 0x10000 - 0x8000
+            if -SEQUENCE_WINDOW < d <= 0:
+                if (self.mask >> -d) & 1:
+                    return False
+                self.mask |= 1 << -d
+                return True
+            if 0 < d < SEQUENCE_WINDOW:
+                self.mask = ((self.mask << d) | 1) & 0xFFFFFFFF
+                self.highest = sequence
+                return True
+        self.highest = sequence
+        self.mask = 1
+        return True
+
+
+def loopback_test(loss=0.3, commands=2000, seed=1):
+    """
+    Send commands over a simulated link losing packets in both directions.
+    Every 10th command is critical. One command is sent every 20 ms,
+    the one-way delay is 50 .. 90 ms.
+    Returns True if every command was delivered exactly once.
+    A command given up may still have been delivered (only the acknowledges were lost).
+    """
+    random.seed(seed)
+    now = [0.0]
+    in_flight = []
+    receiver = Receiver()
+    delivered = []
+    latencies = {False: [], True: []}
+
+    def air(direction, data):
+        if random.random() >= loss:
+            in_flight.append((now[0] + random.uniform(0.05, 0.09), direction, data))
+
+    sender = CommandSender(lambda body: air('up', body), clock=lambda: now[0])
+
+    def step():
+        now[0] += 0.01
+        arrived = sorted(item for item in in_flight if item[0] <= now[0])
+        for item in arrived:
+            in_flight.remove(item)
+            _, direction, data = item
+            if direction == 'up':
+                sequence, = unpack('<H', data[:2])
+                if receiver.receive(sequence):
+                    delivered.append(unpack('<I', data[6:10])[0])
+                    air('down', (sequence, CMD_ACK_OK, 200))
+                else:
+                    air('down', (sequence, CMD_ACK_DUPLICATE, 200))
+            else:
+                result = sender.acknowledge(*data)
+                if result is not None:
+                    number = unpack('<I', result[0][4:8])[0]
+                    latencies[number % 10 == 0].append(result[3])
+        sender.poll()
+
+    for i in range(commands):
+        sender.send(b'TEST' + pack('<I', i), critical=(i % 10 == 0))
+        step()
+        step()
+    while (sender.pending or sender.waiting or in_flight) and now[0] < 1e4:
+        step()
+
+    unique = set(delivered)
+    print("loss %.0f%% : sent %d delivered %d duplicates %d given up %d retransmissions %d"
+          % (100 * loss, commands, len(unique), len(delivered) - len(unique),
+             sender.failed, sender.retransmissions))
+    for is_critical in (False, True):
+        lat = sorted(latencies[is_critical])
+        if lat:
+            print("    %-8s acknowledged %4d  latency median %4.0f ms  95%% %4.0f ms  max %4.0f ms" %
+                  ("critical" if is_critical else "normal", len(lat),
+                   1000 * lat[len(lat) // 2], 1000 * lat[int(0.95 * len(lat))], 1000 * lat[-1]))
+    return len(delivered) == commands and unique == set(range(commands))
+
+
+if __name__ == '__main__':
+    ok = True
+    for loss in (0.0, 0.1, 0.3):
+        ok = loopback_test(loss) and ok
+    print("OK" if ok else "FAILED")
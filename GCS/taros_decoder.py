@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+
+"""
+Python interface to the C++ stream decoder (tools/taros_decode).
+
+The decoder does the framing, the CRC check and the splitting of frames
+into messages in compiled code, so the ground station keeps up with
+any stream rate. It is loaded with ctypes from libtaros_decoder.so
+(build it with make in tools/taros_decode). The library can be given
+by the environment variable TAROS_DECODER_LIB.
+
+    decoder = taros_decoder.StreamDecoder(trailer_bytes=1)
+    for msg, rssi in decoder.push(data):
+        ...
+
+The messages are returned as bytes in the compact binary format
+(see src/message.h), exactly like taros_framing.FrameDecoder.push()
+followed by splitting the payload.
+
+Run this file with a recorded stream to get NDJSON on stdout.
+"""
+
+import ctypes
+import os
+import sys
+
+FORMAT_NONE = 0
+FORMAT_JSON = 1
+FORMAT_CSV = 2
+
+_lib = None
+
+
+def load_library():
+    """
+    Load the decoder library, returns None if it is not available.
+    """
+    global _lib
+    if _lib is not None:
+        return _lib
+    here = os.path.dirname(os.path.abspath(__file__))
+    candidates = [
+        os.environ.get('TAROS_DECODER_LIB'),
+        os.path.join(here, 'libtaros_decoder.so'),
+        os.path.join(here, '..', 'tools', 'taros_decode', 'libtaros_decoder.so'),
+    ]
+    for path in candidates:
+        if path and os.path.exists(path):
+            try:
+                lib = ctypes.CDLL(path)
+            except OSError:
+                continue
+            _declare(lib)
+            _lib = lib
+            return lib
+    return None
+
+
+def _declare(lib):
+    p = ctypes.c_void_p
+    size = ctypes.c_size_t
+    lib.taros_decoder_new.restype = p
+    lib.taros_decoder_new.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.taros_decoder_free.restype = None
+    lib.taros_decoder_free.argtypes = [p]
+    lib.taros_decoder_push.restype = size
+    lib.taros_decoder_push.argtypes = [p, ctypes.c_char_p, size]
+    lib.taros_decoder_text.restype = ctypes.POINTER(ctypes.c_char)
+    lib.taros_decoder_text.argtypes = [p, ctypes.POINTER(size)]
+    lib.taros_decoder_message.restype = ctypes.POINTER(ctypes.c_char)
+    lib.taros_decoder_message.argtypes = [p, size, ctypes.POINTER(size), ctypes.POINTER(ctypes.c_int)]
+    lib.taros_decoder_csv_header.restype = ctypes.c_char_p
+    lib.taros_decoder_csv_header.argtypes = []
+    for name in ['taros_decoder_bytes_in', 'taros_decoder_messages']:
+        getattr(lib, name).restype = ctypes.c_uint64
+        getattr(lib, name).argtypes = [p]
+    for name in ['taros_decoder_frames_ok', 'taros_decoder_frames_lost']:
+        getattr(lib, name).restype = ctypes.c_uint32
+        getattr(lib, name).argtypes = [p]
+
+
+class StreamDecoder:
+    """
+    The decoder of a received stream.
+    framed : the framed link stream, otherwise plain messages (binary logs)
+    trailer_bytes : the bytes following every frame (1 for the RSSI byte of the E220)
+    text_format : FORMAT_JSON or FORMAT_CSV to get formatted text from push_text()
+        instead of the messages from push()
+    Raises OSError if the library is not available.
+    """
+
+    def __init__(self, trailer_bytes=1, framed=True, text_format=FORMAT_NONE):
+        self.lib = load_library()
+        if self.lib is None:
+            raise OSError("libtaros_decoder.so not found")
+        self.handle = self.lib.taros_decoder_new(
+            text_format, 1 if framed else 0, trailer_bytes,
+            1 if text_format == FORMAT_NONE else 0)
+        if not self.handle:
+            raise ValueError("illegal decoder parameters")
+
+    def __del__(self):
+        if getattr(self, 'handle', None):
+            self.lib.taros_decoder_free(self.handle)
+            self.handle = None
+
+    def push(self, data):
+        """
+        Decode a block of received data.
+        Returns a list of (message, rssi) tuples, rssi is None without trailer.
+        """
+        n = self.lib.taros_decoder_push(self.handle, bytes(data), len(data))
+        messages = []
+        size = ctypes.c_size_t()
+        rssi = ctypes.c_int()
+        for i in range(n):
+            ptr = self.lib.taros_decoder_message(self.handle, i, ctypes.byref(size), ctypes.byref(rssi))
+            messages.append((ptr[:size.value], rssi.value if rssi.value >= 0 else None))
+        return messages
+
+    def push_text(self, data):
+        """
+        Decode a block of received data.
+        Returns the formatted text of all messages (NDJSON lines or CSV rows).
+        """
+        self.lib.taros_decoder_push(self.handle, bytes(data), len(data))
+        size = ctypes.c_size_t()
+        ptr = self.lib.taros_decoder_text(self.handle, ctypes.byref(size))
+        return ptr[:size.value].decode('utf-8')
+
+    def messages(self):
+        return self.lib.taros_decoder_messages(self.handle)
+
+    def frames_ok(self):
+        return self.lib.taros_decoder_frames_ok(self.handle)
+
+    def frames_lost(self):
+        return self.lib.taros_decoder_frames_lost(self.handle)
+
+
+if __name__ == '__main__':
+    decoder = StreamDecoder(trailer_bytes=1, text_format=FORMAT_JSON)
+    source = open(sys.argv[1], 'rb') if len(sys.argv) > 1 else sys.stdin.buffer
+    while True:
+        block = source.read(1 << 20)
+        if not block:
+            break
+        sys.stdout.write(decoder.push_text(block))
+    print("%d messages, frames ok %d lost %d" %
+          (decoder.messages(), decoder.frames_ok(), decoder.frames_lost()), file=sys.stderr)
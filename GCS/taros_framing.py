@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+
+"""
+Framing of the TAROS link protocol (see src/framing.h).
+
+Every frame is COBS encoded from the payload with a CRC-16/CCITT-FALSE
+appended (high byte first) and terminated by a 0x00 delimiter.
+The E220 modem appends one RSSI byte after every received packet.
+
+The decoder searches for delimiters with bytes.find(), so every received
+byte is looked at only once and resynchronization runs in linear time.
+"""
+
+DELIMITER = 0x00
+MAX_PAYLOAD = 254
+MAX_ENCODED = MAX_PAYLOAD + 2 + (MAX_PAYLOAD + 2) // 254 + 2
+
+
+def crc16(data, crc=0xFFFF):
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            if crc & 0x8000:
+                crc = ((crc << 1) ^ 0x1021) & 0xFFFF
+            else:
+                crc = (crc << 1) & 0xFFFF
+    return crc
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_pos = 0
+    code = 1
+    for byte in data:
+        if byte == 0:
+            out[code_pos] = code
+            code_pos = len(out)
+            out.append(0)
+            code = 1
+        else:
+            out.append(byte)
+            code += 1
+            if code == 0xFF:
+                out[code_pos] = code
+                code_pos = len(out)
+                out.append(0)
+                code = 1
+    out[code_pos] = code
+    return out
+
+
+def cobs_decode(data):
+    """
+    Returns the decoded data or None if the encoding is invalid.
+    """
+    out = bytearray()
+    i = 0
+    n = len(data)
+    while i < n:
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > n:
+            return None
+        out.extend(data[i:i+code-1])
+        i += code - 1
+        if code < 0xFF and i < n:
+            out.append(0)
+    return out
+
+
+def frame_encode(payload):
+    """
+    Encode a payload into a frame including the delimiter.
+    """
+    if len(payload) > MAX_PAYLOAD:
+        raise ValueError("frame payload too large")
+    crc = crc16(payload)
+    data = bytearray(payload)
+    data.extend([crc >> 8, crc & 0xFF])
+    frame = cobs_encode(data)
+    frame.append(DELIMITER)
+    return frame
+
+
+class FrameDecoder:
+    """
+    Streaming decoder for frames.
+    Received bytes are added with push(), which returns a list of
+    (payload, trailer) tuples for all valid frames completed.
+    """
+
+    def __init__(self, trailer_bytes=0):
+        self.trailer_bytes = trailer_bytes
+        self.buffer = bytearray()
+        # a valid frame waiting for its trailer bytes
+        self.pending = None
+        self.trailer_expected = False
+        # the rest of an overrun frame is discarded up to the next delimiter
+        self.skip = False
+        self.frames_ok = 0
+        self.crc_errors = 0
+        self.format_errors = 0
+        self.overruns = 0
+
+    def frames_lost(self):
+        return self.crc_errors + self.format_errors + self.overruns
+
+    def error_rate(self):
+        total = self.frames_ok + self.frames_lost()
+        if total == 0:
+            return 0.0
+        return self.frames_lost() / total
+
+    def push(self, data):
+        frames = []
+        self.buffer.extend(data)
+        start = 0
+        while True:
+            if self.trailer_expected:
+                if len(self.buffer) - start < self.trailer_bytes:
+                    break
+                trailer = bytes(self.buffer[start:start+self.trailer_bytes])
+                start += self.trailer_bytes
+                self.trailer_expected = False
+                if self.pending is not None:
+                    frames.append((self.pending, trailer))
+                    self.pending = None
+            end = self.buffer.find(DELIMITER, start)
+            if end < 0:
+                break
+            data = self.buffer[start:end]
+            start = end + 1
+            # two subsequent delimiters don't make a frame
+            if len(data) == 0 and not self.skip:
+                continue
+            payload = self.complete_frame(data)
+            # the trailer follows every packet - even the broken ones
+            if self.trailer_bytes > 0:
+                self.pending = payload
+                self.trailer_expected = True
+            elif payload is not None:
+                frames.append((payload, b''))
+        # keep the incomplete rest, anything too long is discarded
+        del self.buffer[:start]
+        if len(self.buffer) > MAX_ENCODED:
+            if not self.skip:
+                self.overruns += 1
+            # skip everything up to the next delimiter
+            self.buffer.clear()
+            self.skip = True
+        return frames
+
+    def complete_frame(self, data):
+        if self.skip:
+            self.skip = False
+            return None
+        decoded = cobs_decode(data)
+        if decoded is None or len(decoded) < 2:
+            self.format_errors += 1
+            return None
+        payload = decoded[:-2]
+        crc = (decoded[-2] << 8) | decoded[-1]
+        if crc != crc16(payload):
+            self.crc_errors += 1
+            return None
+        self.frames_ok += 1
+        return bytes(payload)
@@ -0,0 +1,70 @@
+# generated by tools/gen_msg_templates.py from src/msg_templates.h - do not edit
+
+import re
+from struct import unpack_from
+
+# template ID : (name, format)
+TEMPLATES = {
+    1: ('TPL_WATCHDOG_IRQ', "IRQ total : %.2f us -- %s : %.2f us -- spacing : %.2f us"),
+    2: ('TPL_WATCHDOG_SYSTICK', "delayed systick (spacing %.1f us)"),
+    3: ('TPL_WATCHDOG_TASK_DELAY', "delayed task start %.1f us"),
+    4: ('TPL_WATCHDOG_RUNTIME', "Module runtime -- %s : %.1f us"),
+    5: ('TPL_WATCHDOG_HEAP', "HEAP from 0x%x to 0x%x used up to 0x%x"),
+    16: ('TPL_IMU_CALIBRATION', "calibration status : %02X"),
+    32: ('TPL_MODEM_CONFIG', "configuration response : %H"),
+    33: ('TPL_MODEM_FRAME', "received frame : %H"),
+    34: ('TPL_MODEM_UPLINK', "uplink frames received %u lost %u (crc %u format %u overrun %u)"),
+    35: ('TPL_MODEM_DOWNLINK', "downlink frames %u messages %u (%.1f per frame) efficiency %.1f%% merged %u dropped %u oversize %u max latency %u ms"),
+    36: ('TPL_MODEM_COMMANDS', "commands delivered %u duplicates %u rejected %u"),
+    48: ('TPL_FASTLOG_WRITE', "fast log sectors %u errors %u dropped %u ring max %u bytes -- write latency <100us %u <200us %u <500us %u <1ms %u <2ms %u <5ms %u <10ms %u >10ms %u max %u us"),
+    49: ('TPL_SYSLOG_WRITE', "system log messages %u (%.0f cycles per message) dropped %u sectors %u errors %u max write latency %u us"),
+    50: ('TPL_STORAGE_BENCH', "storage %s : append %.1f us (max %u us) throughput %.2f MB/s sync %.0f us (max %u us)"),
+    51: ('TPL_LOG_REPEATED', "last message repeated %u times"),
+    52: ('TPL_LOG_LIMITED', "%u messages suppressed by the rate limit"),
+    53: ('TPL_LOG_DEGRADED', "backlog of %u messages, only critical messages are passed"),
+    54: ('TPL_LOG_RECOVERED', "backlog cleared after %u ms, %u messages dropped"),
+    55: ('TPL_FASTLOG_BUFFER', "fast log buffer %u kB in %s used %u bytes max %u bytes (%.1f%%)"),
+    56: ('TPL_RECORDER_TRIGGER', "flight recorder triggered by %s"),
+    57: ('TPL_RECORDER_EVENT', "flight recorder event saved to %s : %u bytes, %.1f s before and %.1f s after the trigger, dropped %u errors %u"),
+    58: ('TPL_LOG_COMPRESSION', "compressed %u bytes into %u blocks, ratio %.2f (payload %.2f) %.1f cycles per byte"),
+}
+
+# literal text, flags/width/precision and the conversion character
+SPEC = re.compile(r'([^%]*)(?:(%[-+ #0-9.]*)(.))?', re.S)
+
+def format_template(template_id, args):
+    """
+    Format the binary arguments of a template message into a text.
+    """
+    if template_id not in TEMPLATES:
+        return "unknown template %d" % template_id
+    name, fmt = TEMPLATES[template_id]
+    text = ""
+    pos = 0
+    for literal, spec, conv in SPEC.findall(fmt):
+        text += literal
+        if conv == '':
+            continue
+        if conv == '%':
+            text += '%'
+        elif conv in 'di':
+            value, = unpack_from('<i', args, pos) if pos+4 <= len(args) else (0,)
+            pos += 4
+            text += (spec+conv) % value
+        elif conv in 'uxX':
+            value, = unpack_from('<I', args, pos) if pos+4 <= len(args) else (0,)
+            pos += 4
+            text += (spec+('d' if conv == 'u' else conv)) % value
+        elif conv in 'feg':
+            value, = unpack_from('<f', args, pos) if pos+4 <= len(args) else (0.0,)
+            pos += 4
+            text += (spec+conv) % value
+        elif conv in 'sH':
+            count = args[pos] if pos < len(args) else 0
+            block = args[pos+1:pos+1+count]
+            pos += 1+count
+            if conv == 's':
+                text += block.decode(encoding='utf-8', errors='replace')
+            else:
+                text += "".join("%02X " % b for b in block)
+    return text
@@ -0,0 +1,133 @@
+// Binding of the C++ stream decoder (tools/taros_decode/taros_decoder.h).
+//
+// The decoder does the framing, the CRC check and the splitting of frames
+// into messages in compiled code. The library libtaros_decoder.so
+// (build it with make in tools/taros_decode) has to be found by the
+// dynamic loader or given by its path.
+//
+// Only dart:ffi is used, all memory is owned by the decoder.
+
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:typed_data';
+
+typedef _NewNative = Pointer<Void> Function(Int32, Int32, Int32, Int32);
+typedef _NewDart = Pointer<Void> Function(int, int, int, int);
+typedef _FreeNative = Void Function(Pointer<Void>);
+typedef _FreeDart = void Function(Pointer<Void>);
+typedef _InputNative = Pointer<Uint8> Function(Pointer<Void>);
+typedef _PushInputNative = IntPtr Function(Pointer<Void>, IntPtr);
+typedef _PushInputDart = int Function(Pointer<Void>, int);
+typedef _SizeNative = IntPtr Function(Pointer<Void>);
+typedef _SizeDart = int Function(Pointer<Void>);
+typedef _TextNative = Pointer<Uint8> Function(Pointer<Void>, Pointer<IntPtr>);
+typedef _TextDart = Pointer<Uint8> Function(Pointer<Void>, Pointer<IntPtr>);
+typedef _MessageDataNative = Pointer<Uint8> Function(Pointer<Void>, IntPtr);
+typedef _MessageDataDart = Pointer<Uint8> Function(Pointer<Void>, int);
+typedef _MessageSizeNative = IntPtr Function(Pointer<Void>, IntPtr);
+typedef _MessageSizeDart = int Function(Pointer<Void>, int);
+typedef _MessageRssiNative = Int32 Function(Pointer<Void>, IntPtr);
+typedef _MessageRssiDart = int Function(Pointer<Void>, int);
+
+// the size of the input buffer (TAROS_DECODER_INPUT_SIZE)
+const int tarosDecoderInputSize = 65536;
+
+const int tarosFormatNone = 0;
+const int tarosFormatJson = 1;
+const int tarosFormatCsv = 2;
+
+// one message in the compact binary format with the RSSI of its frame
+class DecodedMessage {
+  DecodedMessage(this.data, this.rssi);
+
+  final Uint8List data;
+  // -1 if the stream has no RSSI bytes
+  final int rssi;
+
+  int get type => (data[0] << 8) | data[1];
+}
+
+class TarosDecoder {
+  // trailerBytes : the bytes following every frame (1 for the RSSI byte of the E220)
+  // framed : the framed link stream, otherwise plain messages (binary logs)
+  // format : tarosFormatJson or tarosFormatCsv to get text from pushText()
+  TarosDecoder(
+      {int trailerBytes = 1,
+      bool framed = true,
+      int format = tarosFormatNone,
+      String library = 'libtaros_decoder.so'}) {
+    final lib = DynamicLibrary.open(library);
+    _free = lib.lookupFunction<_FreeNative, _FreeDart>('taros_decoder_free');
+    _input = lib.lookupFunction<_InputNative, _InputNative>('taros_decoder_input');
+    _pushInput = lib.lookupFunction<_PushInputNative, _PushInputDart>(
+        'taros_decoder_push_input');
+    _textSize =
+        lib.lookupFunction<_SizeNative, _SizeDart>('taros_decoder_text_size');
+    _text = lib.lookupFunction<_TextNative, _TextDart>('taros_decoder_text');
+    _messageData = lib.lookupFunction<_MessageDataNative, _MessageDataDart>(
+        'taros_decoder_message_data');
+    _messageSize = lib.lookupFunction<_MessageSizeNative, _MessageSizeDart>(
+        'taros_decoder_message_size');
+    _messageRssi = lib.lookupFunction<_MessageRssiNative, _MessageRssiDart>(
+        'taros_decoder_message_rssi');
+    final create = lib.lookupFunction<_NewNative, _NewDart>('taros_decoder_new');
+    _handle = create(format, framed ? 1 : 0, trailerBytes,
+        format == tarosFormatNone ? 1 : 0);
+    if (_handle == nullptr) {
+      throw ArgumentError('illegal decoder parameters');
+    }
+    _buffer = _input(_handle).asTypedList(tarosDecoderInputSize);
+  }
+
+  late final _FreeDart _free;
+  late final _InputNative _input;
+  late final _PushInputDart _pushInput;
+  late final _SizeDart _textSize;
+  late final _TextDart _text;
+  late final _MessageDataDart _messageData;
+  late final _MessageSizeDart _messageSize;
+  late final _MessageRssiDart _messageRssi;
+  late final Pointer<Void> _handle;
+  late final Uint8List _buffer;
+
+  // decode received data, returns all messages completed
+  List<DecodedMessage> push(Uint8List data) {
+    final messages = <DecodedMessage>[];
+    for (var pos = 0; pos < data.length; pos += tarosDecoderInputSize) {
+      final n = _pushBlock(data, pos);
+      for (var i = 0; i < n; i++) {
+        final size = _messageSize(_handle, i);
+        // the data are copied, the buffer of the decoder is re-used
+        final bytes =
+            Uint8List.fromList(_messageData(_handle, i).asTypedList(size));
+        messages.add(DecodedMessage(bytes, _messageRssi(_handle, i)));
+      }
+    }
+    return messages;
+  }
+
+  // decode received data, returns the formatted text (NDJSON lines or CSV rows)
+  String pushText(Uint8List data) {
+    final text = StringBuffer();
+    for (var pos = 0; pos < data.length; pos += tarosDecoderInputSize) {
+      _pushBlock(data, pos);
+      final size = _textSize(_handle);
+      if (size > 0) {
+        text.write(utf8.decode(_text(_handle, nullptr).asTypedList(size),
+            allowMalformed: true));
+      }
+    }
+    return text.toString();
+  }
+
+  int _pushBlock(Uint8List data, int pos) {
+    var end = pos + tarosDecoderInputSize;
+    if (end > data.length) end = data.length;
+    _buffer.setRange(0, end - pos, data, pos);
+    return _pushInput(_handle, end - pos);
+  }
+
+  void dispose() {
+    _free(_handle);
+  }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+    A ring buffer of bytes in a memory area given by the owner,
+    so it can be placed anywhere (e.g. in the external PSRAM).
+
+    Copying in and out costs one or two memcpy() independent of the fill level.
+    There is no locking, the owner has to prevent concurrent access
+    (e.g. by disabling the interrupts while one side is in an interrupt).
+*/
+class ByteRing
+{
+
+public:
+
+    ByteRing() { m_buf = NULL; m_size = 0; m_head = 0; m_used = 0; };
+
+    // use the given memory, the ring is empty afterwards
+    void begin(uint8_t* buffer, size_t size)
+    {
+        m_buf = buffer;
+        m_size = (buffer == NULL) ? 0 : size;
+        m_head = 0;
+        m_used = 0;
+    };
+
+    size_t capacity() { return m_size; };
+    size_t bytesUsed() { return m_used; };
+    size_t bytesFree() { return m_size - m_used; };
+
+    // append data, returns false (and copies nothing) if there is not enough space
+    bool memcpyIn(const void* data, size_t n)
+    {
+        if (n > m_size - m_used) return false;
+        size_t pos = m_head + m_used;
+        if (pos >= m_size) pos -= m_size;
+        size_t first = m_size - pos;
+        if (first > n) first = n;
+        memcpy(m_buf + pos, data, first);
+        if (n > first) memcpy(m_buf, (const uint8_t*)data + first, n - first);
+        m_used += n;
+        return true;
+    };
+
+    // take data out, returns false (and copies nothing) if there are not enough data
+    bool memcpyOut(void* data, size_t n)
+    {
+        if (n > m_used) return false;
+        size_t first = m_size - m_head;
+        if (first > n) first = n;
+        memcpy(data, m_buf + m_head, first);
+        if (n > first) memcpy((uint8_t*)data + first, m_buf, n - first);
+        m_head += n;
+        if (m_head >= m_size) m_head -= m_size;
+        m_used -= n;
+        return true;
+    };
+
+    // copy the oldest data without taking them out
+    // returns false (and copies nothing) if there are not enough data
+    bool peek(void* data, size_t n)
+    {
+        if (n > m_used) return false;
+        size_t first = m_size - m_head;
+        if (first > n) first = n;
+        memcpy(data, m_buf + m_head, first);
+        if (n > first) memcpy((uint8_t*)data + first, m_buf, n - first);
+        return true;
+    };
+
+    // drop the oldest data, returns false (and drops nothing) if there are not enough data
+    bool skip(size_t n)
+    {
+        if (n > m_used) return false;
+        m_head += n;
+        if (m_head >= m_size) m_head -= m_size;
+        m_used -= n;
+        return true;
+    };
+
+private:
+
+    uint8_t* m_buf;
+    size_t m_size;
+    // the position of the oldest byte and the number of bytes stored
+    volatile size_t m_head;
+    volatile size_t m_used;
+
+};
@@ -5,6 +5,7 @@
 #include "kernel.h"
 #include "kernel.h"
 #include "commander.h"
+#include "system.h"
 #include "util.h"
 
 Commander::Commander(
@@ -49,23 +50,111 @@ void Commander::interrupt()
 
 void Commander::handle_uplink()
 {
-    /* TODO: at present we don't do anything
     Message msg = command_in.fetch();
     // process the command messages
     if (msg.type()==MSG_TYPE_COMMAND)
     {
-        uint16_t msg_size = msg.size();
-        char* msg_body = (char*) msg.get_data();
-        // send read-back
-        std::stringstream ss;
-        ss << "received command : ";
-        ss << hexbyte(msg_body[0]);
-        ss << hexbyte(msg_body[1]);
-        ss << " size = " << msg_size;
-        Message read_back = Message::SystemMessage(
-            id, FC_time_now(), MSG_LEVEL_READBACK, ss.str());
-        status_out.transmit(read_back);        
+        // the sequence number has been handled by the modem already
+        if (msg.size()<CMD_SEQUENCE_SIZE) return;
+        uint16_t msg_size = msg.size()-CMD_SEQUENCE_SIZE;
+        char* msg_body = (char*) msg.get_data() + CMD_SEQUENCE_SIZE;
+        // all commands start with a 4-character keyword
+        if (msg_size<4) return;
+        std::string keyword(msg_body, 4);
+        // attach/detach a topic to/from the downlink
+        // the topic ID follows the keyword as a single byte
+        if ((keyword=="TSUB" or keyword=="TUNS") and (msg_size>=5))
+        {
+            TopicID topic = (TopicID) msg_body[4];
+            bool ok;
+            if (keyword=="TSUB")
+                ok = topics->subscribe(topic, &(modem->downlink));
+            else
+                ok = topics->unsubscribe(topic, &(modem->downlink));
+            // send read-back
+            std::stringstream ss;
+            ss << keyword << " topic " << (int)topic;
+            if (ok)
+                ss << " done.";
+            else
+                ss << " failed.";
+            status_out.transmit(
+                Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_READBACK, ss.str()) );
+        }
+        // the filters of the system log
+        else if ((keyword=="LLEV") and (msg_size>=5))
+        {
+            uint8_t level = msg_body[4];
+            std::string module(msg_body+5, msg_size-5);
+            system_log->set_level(module, level);
+            std::stringstream ss;
+            ss << keyword << " " << (module.empty() ? "all" : module) << " level " << (int)level << " done.";
+            status_out.transmit(
+                Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_READBACK, ss.str()) );
+        }
+        else if ((keyword=="LSNK") and (msg_size>=6))
+        {
+            uint8_t sink = msg_body[4];
+            uint8_t level = msg_body[5];
+            bool ok = system_log->set_sink_level(sink, level);
+            std::stringstream ss;
+            ss << keyword << " sink " << (int)sink << " level " << (int)level;
+            if (ok)
+                ss << " done.";
+            else
+                ss << " failed.";
+            status_out.transmit(
+                Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_READBACK, ss.str()) );
+        }
+        else if ((keyword=="LRAT") and (msg_size>=6))
+        {
+            uint8_t rate = msg_body[4];
+            uint8_t burst = msg_body[5];
+            std::string module(msg_body+6, msg_size-6);
+            system_log->set_rate(module, rate, burst);
+            std::stringstream ss;
+            ss << keyword << " " << (module.empty() ? "all" : module) << " rate " << (int)rate
+               << " burst " << (int)burst << " done.";
+            status_out.transmit(
+                Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_READBACK, ss.str()) );
+        }
+        // the flight recorder
+        else if (keyword=="FREC")
+        {
+            bool ok = flight_recorder and flight_recorder->trigger("uplink");
+            std::stringstream ss;
+            ss << keyword;
+            if (ok)
+                ss << " done.";
+            else
+                ss << " failed.";
+            status_out.transmit(
+                Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_READBACK, ss.str()) );
+        }
+        else if ((keyword=="FLEV") and (msg_size>=5))
+        {
+            uint8_t level = msg_body[4];
+            if (flight_recorder) flight_recorder->set_trigger_level(level);
+            std::stringstream ss;
+            ss << keyword << " level " << (int)level;
+            if (flight_recorder)
+                ss << " done.";
+            else
+                ss << " failed.";
+            status_out.transmit(
+                Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_READBACK, ss.str()) );
+        }
+        else
+        {
+            // send read-back of unknown commands
+            std::stringstream ss;
+            ss << "received command : ";
+            ss << hexbyte(msg_body[0]);
+            ss << hexbyte(msg_body[1]);
+            ss << " size = " << msg_size;
+            Message read_back = Message::SystemMessage(
+                id, FC_time_now(), MSG_LEVEL_READBACK, ss.str());
+            status_out.transmit(read_back);        
+        };
     };
-    */
 };
-
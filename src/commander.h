@@ -38,6 +38,19 @@ public:
     virtual void interrupt();
     
     // this is for handling commands that are sent over the uplink from ground control
+    // the commands start with a 4-character keyword followed by binary arguments
+    // (the preceding sequence number has already been checked by the modem)
+    //     TSUB <topic> : attach a topic to the downlink
+    //     TUNS <topic> : detach a topic from the downlink
+    //     LLEV <level> [<module>] : severity threshold of the system messages of a module
+    //                               (all modules if none is given)
+    //     LSNK <sink> <level> : severity threshold of a sink of the system log (LOGGER_SINK_...)
+    //     LRAT <rate> <burst> [<module>] : rate limit of the system messages of a module [1/s]
+    //                                      (0 for unlimited, all modules if none is given)
+    //     FREC : trigger the flight recorder
+    //     FLEV <level> : severity threshold of the system messages triggering the flight recorder
+    //                    (0 disables this trigger, the filters of the system log do not apply)
+    // the numbers are single bytes, the module ID is the rest of the command
     virtual void handle_uplink();
     
     // port over which status messages are sent
@@ -51,9 +51,10 @@ public:
     // data are stored internally and will be updated during the next display cycle
     ReceiverPort data_in;
 
-    // a receiver for data streams
-    StreamReceiver<DATA_IMU_AHRS> ahrs_in;
-    StreamReceiver<DATA_IMU_GYRO> gyro_in;
+    // receivers for data streams
+    // we only display the latest data, so we don't need to queue them
+    StreamMailbox<DATA_IMU_AHRS> ahrs_in;
+    StreamMailbox<DATA_IMU_GYRO> gyro_in;
     
 private:
 
@@ -1,8 +1,7 @@
-#include <cstdio>
-
 #include "kernel.h"
 #include "kernel.h"
 #include "dummy_gps.h"
+#include "system.h"
 
 DummyGPS::DummyGPS(
     std::string name,
@@ -26,11 +25,19 @@ DummyGPS::DummyGPS(
     vx = 0.0;
     vy = 0.0;
     vz = 3.0;
+    tm_position = 0;
     // we cannot send a status message that we are ready to run
     // because the port is not yet wired to any receiver
     runlevel_=MODULE_RUNLEVEL_OPERATIONAL;
 }
 
+void DummyGPS::setup()
+{
+    // the position is sent as one binary sample
+    tm_position = telemetry->declare(id, "GPS_POS", MSG_TYPE_DATA_GPS, "deg,deg,m");
+    runlevel_ = MODULE_RUNLEVEL_OPERATIONAL;
+}
+
 void DummyGPS::interrupt()
 {
     float elapsed = FC_elapsed_millis(last_update);
@@ -77,18 +84,8 @@ void DummyGPS::run()
 
     if (flag_telemetry_pending)
     {
-        char buffer[16];
-        int n = snprintf(buffer, 15, "%.6f", lat);
-        tm_out.transmit(
-            Message::TelemetryMessage(id, FC_time_now(), "GPS_LAT", std::string(buffer,n)) );
-
-        n = snprintf(buffer, 15, "%.6f", lon);
-        tm_out.transmit(
-            Message::TelemetryMessage(id, FC_time_now(), "GPS_LONG", std::string(buffer,n)) );
-
-        n = snprintf(buffer, 15, "%.2f", alt);
         tm_out.transmit(
-            Message::TelemetryMessage(id, FC_time_now(), "GPS_ALTI", std::string(buffer,n)) );
+            Message::DataGPS(id, tm_position, FC_time_now(), lat, lon, alt) );
 
         last_telemetry = FC_time_now();
         flag_telemetry_pending = false;
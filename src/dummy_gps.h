@@ -12,6 +12,8 @@
 /*  
     This is a module simulating a GPS sensor.
     It can send MESSAGE_GPS_POSITION at regular intervals (10 Hz).
+    The position is sent as binary telemetry data (MSG_TYPE_DATA_GPS)
+    with the hash of the variable declared in the telemetry dictionary.
 */
 class DummyGPS : public Module
 {
@@ -25,8 +27,8 @@ public:
         float tm_rate        // the rate at which telemetry messages are sent
             );
     
-    // nothing to do
-    virtual void setup() { runlevel_ = MODULE_RUNLEVEL_OPERATIONAL; };
+    // declare the telemetry variables
+    virtual void setup();
     
     virtual void interrupt();
 
@@ -59,6 +61,9 @@ private:
     float       vy;         // simulated velocity in north direction [m/s]
     float       vz;         // simulated velocity in up direction [m/s]
 
+    // the hash of the position in the telemetry dictionary
+    uint16_t    tm_position;
+
     uint32_t    startup_time;
     float       gps_rate;
     uint32_t    last_update;
@@ -1,155 +1,497 @@
 #include "file_writer.h"
-#include "kernel.h"
+
+#include <cstddef>
+#include <cstring>
+
+// this is needed to have ARM_DWT_CYCCNT
+#include "../core/core_pins.h"
+// this is needed to have extmem_malloc()
+#include "../core/wiring.h"
+
 #include "kernel.h"
 #include "global.h"
 
-FileWriter::FileWriter(
+// the size of the external PSRAM [MB], 0 if there is none (set in startup.c)
+extern "C" uint8_t external_psram_size;
+
+// the upper limits of the bins of the write latency histogram [us]
+// the last bin takes all longer writes
+static const uint32_t log_writer_latency_limits[LOGFILE_LATENCY_BINS-1] =
+    { 100, 200, 500, 1000, 2000, 5000, 10000 };
+
+LogFileWriter::LogFileWriter(
         std::string name,
-        std::string file_name) : Module(name)
+        std::string file_name,
+        uint64_t preallocate) : Module(name)
 {
     // copy the name
     id = name;
     runlevel_= MODULE_RUNLEVEL_INITALIZED;
     fileName = file_name;
+    preallocate_size = preallocate;
+    myFile = NULL;
+    compressor = NULL;
+#ifdef LOG_COMPRESSION
+    compressor = new LogCompressor();
+#endif
+    pack_bytes = 0;
+    pack_cycles = 0;
+    block_written = 0;
+    write_pending = false;
+    data_confirmed = 0;
+    size_committed = 0;
+    commit_state = LOGFILE_COMMIT_IDLE;
+    last_commit = FC_time_now();
+    last_report = FC_time_now();
+    reset_write_statistics();
     runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
-    last_flush = FC_time_now();
 }
 
-void FileWriter::setup()
+void LogFileWriter::setup()
 {
-    // open the file
-    myFile = SD.open(fileName.c_str(), FILE_WRITE);
-    if (myFile)
+    if (storage != NULL)
+        myFile = storage->open(fileName.c_str(), STORAGE_WRITE);
+    if (myFile != NULL)
     {
+        // the head block with the schema is the first one to be written
+        blocks.set_compressor(compressor);
+        blocks.begin(SD_file_No, LOG_SCHEMA_TEXT LOG_MESSAGE_SCHEMA, FC_time_us());
+        block_written = 0;
         runlevel_= MODULE_RUNLEVEL_LINK_OPEN;
         system_log->in.receive(
             Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_MILESTONE, "file opened.") );
+        // allocating the clusters now avoids FAT updates while logging
+        // this fails if there is no contiguous free space of that size,
+        // logging still works then, but the writes may occasionally take longer
+        if (not myFile->preallocate(preallocate_size))
+            system_log->in.receive(
+                Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_WARNING, "file preallocation failed.") );
+        // the preallocation has written the directory entry
+        // on FAT it holds the preallocated size, on exFAT the size of the data (0)
+        data_confirmed = 0;
+        size_committed = myFile->size();
+        commit_state = LOGFILE_COMMIT_IDLE;
+        last_commit = FC_time_now();
     }
     else
         runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
 }
 
+size_t LogFileWriter::write_block(size_t size)
+{
+    const uint8_t* block = blocks.ready();
+    if (block == NULL) return 0;
+    if (size > LOG_BLOCK_SIZE - block_written) size = LOG_BLOCK_SIZE - block_written;
+    size_t n = myFile->write(block + block_written, size);
+    if (n != size)
+    {
+        // the same piece is tried again
+        write_errors++;
+        return 0;
+    };
+    block_written += n;
+    if (block_written >= LOG_BLOCK_SIZE)
+    {
+        blocks.release();
+        block_written = 0;
+    };
+    return n;
+}
+
+bool LogFileWriter::add_record(const void* record, size_t size, uint64_t time)
+{
+    uint32_t start = ARM_DWT_CYCCNT;
+    if (not blocks.add(record, size, time)) return false;
+    pack_cycles += ARM_DWT_CYCCNT - start;
+    pack_bytes += size;
+    return true;
+}
+
+void LogFileWriter::report_compression()
+{
+    if (compressor == NULL) return;
+    // the blocks are written as a whole, so the size on the card is what counts
+    // (the ratio of the payload is limited by LOG_PACK_RAW_SIZE)
+    float ratio = 0.0;
+    if (compressor->packed_blocks() > 0)
+        ratio = (float)compressor->raw_bytes() / ((float)compressor->packed_blocks() * LOG_BLOCK_SIZE);
+    float payload_ratio = 0.0;
+    if (compressor->packed_bytes() > 0)
+        payload_ratio = (float)compressor->raw_bytes() / compressor->packed_bytes();
+    float cycles = 0.0;
+    if (pack_bytes > 0) cycles = (float)pack_cycles / pack_bytes;
+    system_log->in.receive(
+        Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, TPL_LOG_COMPRESSION,
+            (uint32_t)compressor->raw_bytes(), compressor->packed_blocks(), ratio, payload_ratio, cycles) );
+    compressor->reset_statistics();
+    pack_bytes = 0;
+    pack_cycles = 0;
+}
+
+bool LogFileWriter::write_due()
+{
+    if ((blocks.ready() != NULL) or (commit_state != LOGFILE_COMMIT_IDLE)) return true;
+    return (myFile->position() > size_committed) and
+        (FC_elapsed_millis(last_commit) > LOGFILE_COMMIT_INTERVAL);
+}
+
+void LogFileWriter::write_sector()
+{
+    if (runlevel_ == MODULE_RUNLEVEL_LINK_OPEN)
+    {
+        pack_records();
+        // if the card is still busy with the previous sector
+        // we try again with the next systick instead of waiting here
+        if (not myFile->busy())
+        {
+            // everything written so far has been accepted by the card
+            data_confirmed = myFile->position();
+            if ((commit_state == LOGFILE_COMMIT_IDLE) and (data_confirmed > size_committed) and
+                (FC_elapsed_millis(last_commit) > LOGFILE_COMMIT_INTERVAL))
+                commit_state = LOGFILE_COMMIT_STOP;
+            if (commit_state != LOGFILE_COMMIT_IDLE)
+                commit_step();
+            else if (blocks.ready() != NULL)
+            {
+                uint64_t start = FC_time_us();
+                size_t n = write_block(write_size());
+                if (n > 0)
+                {
+                    sectors_written += n / LOGFILE_SECTOR_SIZE;
+                    count_latency(FC_time_us() - start);
+                };
+            };
+        };
+    };
+    write_pending = false;
+}
+
+void LogFileWriter::commit_step()
+{
+    uint64_t start = FC_time_us();
+    switch (commit_state)
+    {
+        case LOGFILE_COMMIT_STOP:
+            // end the multi-sector write, as the card is idle this does not wait
+            if (not myFile->end_transfer()) write_errors++;
+            commit_state = LOGFILE_COMMIT_ENTRY;
+            break;
+        case LOGFILE_COMMIT_ENTRY:
+            // read, update and write the sector with the directory entry
+            // only the data confirmed by the card are committed
+            if (myFile->sync())
+                size_committed = data_confirmed;
+            else
+                write_errors++;
+            last_commit = FC_time_now();
+            commit_state = LOGFILE_COMMIT_IDLE;
+            break;
+        default:
+            commit_state = LOGFILE_COMMIT_IDLE;
+    };
+    count_latency(FC_time_us() - start);
+}
+
+void LogFileWriter::count_latency(uint32_t latency)
+{
+    int bin = 0;
+    while ((bin < LOGFILE_LATENCY_BINS-1) and (latency >= log_writer_latency_limits[bin])) bin++;
+    latency_histogram[bin]++;
+    if (latency > latency_max) latency_max = latency;
+}
+
+void LogFileWriter::reset_write_statistics()
+{
+    sectors_written = 0;
+    write_errors = 0;
+    for (int i=0; i<LOGFILE_LATENCY_BINS; i++) latency_histogram[i] = 0;
+    latency_max = 0;
+}
+
+void LogFileWriter::close()
+{
+    if (runlevel_ == MODULE_RUNLEVEL_LINK_OPEN)
+    {
+        // stop the producers before the remaining records are packed
+        noInterrupts();
+        runlevel_ = MODULE_RUNLEVEL_OPERATIONAL;
+        interrupts();
+        // here we have to wait for the card
+        bool done = false;
+        while (true)
+        {
+            if (not done)
+            {
+                done = pack_records() and all_packed();
+                if (done) blocks.finish();
+            };
+            if (blocks.ready() == NULL)
+            {
+                if (done) break;
+                continue;
+            };
+            if (write_block(LOG_BLOCK_SIZE) == 0) break;
+        };
+        // drop the preallocated but unused space
+        myFile->truncate();
+        myFile->close();
+        delete myFile;
+        myFile = NULL;
+    };
+}
+
+FileWriter::FileWriter(
+        std::string name,
+        std::string file_name) :
+    LogFileWriter(name, file_name, SYSLOG_PREALLOCATE)
+{
+    pending_size = 0;
+    messages_logged = 0;
+    messages_dropped = 0;
+    log_cycles = 0;
+}
+
 void FileWriter::interrupt()
 {
     if (runlevel_ == MODULE_RUNLEVEL_LINK_OPEN)
     {
-        if (in.count()>0)
-            schedule_task(this, std::bind(&FileWriter::handle_MSG, this));
-        if (FC_elapsed_millis(last_flush) > 5000)
-            schedule_task(this, std::bind(&FileWriter::flush, this));
+        if ((not write_pending) and ((in.count()>0) or write_due()))
+        {
+            write_pending = true;
+            schedule_task(this, std::bind(&FileWriter::write_sector, this));
+        };
+        if (FC_elapsed_millis(last_report) > LOGFILE_REPORT_INTERVAL)
+            schedule_task(this, std::bind(&FileWriter::report, this));
     };
 }
 
-void FileWriter::handle_MSG()
+bool FileWriter::pack_records()
 {
-    if (in.count()>0)
+    for (int i=0; i<SYSLOG_PACK_LIMIT; i++)
     {
-        Message msg = in.fetch();
-        // write to file
-        std::string buffer = msg.printout();
-        buffer += std::string("\r\n");
-        // write out
-        // the write is buffered and should return immediately
-        // if the is data flushed to card it may take longer
-        myFile.write(buffer.c_str(), buffer.size());
-        // TODO: handle write failures
+        if (pending_size == 0)
+        {
+            if (in.count() == 0) break;
+            // the messages are stored in the compact binary format, that is
+            // much cheaper than printing them and takes less space on the card
+            uint32_t start = ARM_DWT_CYCCNT;
+            Message msg = in.fetch();
+            // the record keeps the acquisition time of the message, not the time of writing
+            uint64_t time = msg.time();
+            if (time == 0) time = FC_time_us();
+            uint8_t n = msg.buffer((char*)pending + LOG_MESSAGE_HEADER, MSG_MAX_ENCODED_SIZE);
+            if (n == 0)
+            {
+                messages_dropped++;
+                continue;
+            };
+            pending[0] = LOG_MESSAGE_SIGNATURE;
+            memcpy(pending+1, &time, sizeof(time));
+            pending[9] = n;
+            pending_size = LOG_MESSAGE_HEADER + n;
+            log_cycles += ARM_DWT_CYCCNT - start;
+        };
+        uint64_t time;
+        memcpy(&time, pending+1, sizeof(time));
+        uint32_t start = ARM_DWT_CYCCNT;
+        if (not add_record(pending, pending_size, time)) return false;
+        log_cycles += ARM_DWT_CYCCNT - start;
+        messages_logged++;
+        pending_size = 0;
     };
+    return true;
 }
 
-void FileWriter::flush()
+void FileWriter::report()
 {
-    myFile.flush();
-    last_flush = FC_time_now();
+    last_report = FC_time_now();
+    float cycles = 0.0;
+    if (messages_logged > 0) cycles = (float)log_cycles / messages_logged;
+    uint8_t level = MSG_LEVEL_STATUSREPORT;
+    if ((messages_dropped > 0) or (write_errors > 0)) level = MSG_LEVEL_WARNING;
+    // this message is logged itself with the next task
+    system_log->in.receive(
+        Message::SystemTemplate(id, last_report, level, TPL_SYSLOG_WRITE,
+            messages_logged, cycles, messages_dropped,
+            sectors_written, write_errors, latency_max) );
+    messages_logged = 0;
+    messages_dropped = 0;
+    log_cycles = 0;
+    reset_write_statistics();
+    report_compression();
 }
 
 FileWriter::~FileWriter()
 {
-    myFile.close();
+    close();
+}
+
+RingFileWriter::RingFileWriter(
+        std::string name,
+        std::string file_name,
+        uint64_t preallocate,
+        size_t psram_size,
+        size_t ram_size) :
+    LogFileWriter(name, file_name, preallocate)
+{
+    // the ring buffer is placed in the PSRAM if there is one
+    // extmem_malloc() falls back to the internal RAM, where the large buffer does not fit
+    uint8_t* buffer = NULL;
+    ring_in_psram = false;
+    if (external_psram_size > 0)
+    {
+        buffer = (uint8_t*)extmem_malloc(psram_size);
+        if (buffer != NULL)
+        {
+            ring.begin(buffer, psram_size);
+            ring_in_psram = true;
+        };
+    };
+    // without memory the ring buffer has no capacity (see ByteRing::begin())
+    if (buffer == NULL)
+        ring.begin((uint8_t*)malloc(ram_size), ram_size);
+    pending_size = 0;
+}
+
+void RingFileWriter::append(uint8_t signature, const void* data, size_t size)
+{
+    // only the records described in the schema can be logged
+    if ((size == 0) or (size != log_record_size(signature)) or (size+1 > FASTLOG_MAX_RECORD)) return;
+    uint8_t record[FASTLOG_MAX_RECORD];
+    record[0] = signature;
+    memcpy(record+1, data, size);
+    // every record starts with the acquisition time
+    uint64_t time;
+    memcpy(&time, record+1, sizeof(time));
+    // the producers may run in tasks and in interrupts,
+    // so the record must not be interleaved with another one
+    noInterrupts();
+    store(record, size+1, time);
+    interrupts();
+}
+
+size_t RingFileWriter::oldest(uint64_t &time)
+{
+    // every record starts with the signature and the time
+    uint8_t head[LOG_MESSAGE_HEADER];
+    if (not ring.peek(head, 1 + sizeof(time))) return 0;
+    memcpy(&time, head+1, sizeof(time));
+    if (head[0] != LOG_MESSAGE_SIGNATURE) return 1 + log_record_size(head[0]);
+    if (not ring.peek(head, LOG_MESSAGE_HEADER)) return 0;
+    return LOG_MESSAGE_HEADER + head[9];
+}
+
+bool RingFileWriter::pack_records()
+{
+    size_t packed = 0;
+    while (packed < FASTLOG_PACK_LIMIT)
+    {
+        if (pending_size == 0)
+        {
+            // the producers may interrupt, so the record is taken out in one piece
+            noInterrupts();
+            uint64_t time;
+            size_t size = oldest(time);
+            if ((size > 0) and (size <= sizeof(pending)) and ring.memcpyOut(pending, size))
+                pending_size = size;
+            interrupts();
+            if (pending_size == 0) break;
+        };
+        uint64_t time;
+        memcpy(&time, pending+1, sizeof(time));
+        if (not add_record(pending, pending_size, time)) return false;
+        packed += pending_size;
+        pending_size = 0;
+    };
+    return true;
 }
 
 StreamFileWriter::StreamFileWriter(
         std::string name,
-        std::string file_name) : Module(name)
+        std::string file_name) :
+    RingFileWriter(name, file_name, FASTLOG_PREALLOCATE, FASTLOG_PSRAM_RING_SIZE, FASTLOG_RING_SIZE),
+    ahrs_in(this, DATA_IMU_AHRS_SIGNATURE),
+    gyro_in(this, DATA_IMU_GYRO_SIGNATURE)
 {
-    // copy the name
-    id = name;
-    runlevel_= MODULE_RUNLEVEL_INITALIZED;
-    fileName = file_name;
-    runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
-    last_flush = FC_time_now();
+    records_dropped = 0;
+    ring_max_used = 0;
 }
 
 void StreamFileWriter::setup()
 {
-    // open the file
-    myFile = SD.open(fileName.c_str(), FILE_WRITE);
-    if (myFile)
-    {
-        runlevel_= MODULE_RUNLEVEL_LINK_OPEN;
+    LogFileWriter::setup();
+    if (ring.capacity() == 0)
         system_log->in.receive(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_MILESTONE, "file opened.") );
-    }
-    else
-        runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
+            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_ERROR,
+                "no memory for the ring buffer, all records are dropped.") );
 }
 
 void StreamFileWriter::interrupt()
 {
     if (runlevel_ == MODULE_RUNLEVEL_LINK_OPEN)
     {
-        if (ahrs_in.count()>0)
-            schedule_task(this, std::bind(&StreamFileWriter::handle_AHRS, this));
-        if (gyro_in.count()>0)
-            schedule_task(this, std::bind(&StreamFileWriter::handle_GYRO, this));
-        if (FC_elapsed_millis(last_flush) > 5000)
-            schedule_task(this, std::bind(&StreamFileWriter::flush, this));
+        // the records are packed when there is at least a sector worth of them,
+        // a complete block is written one sector per task
+        if ((not write_pending) and
+            ((ring.bytesUsed() >= LOGFILE_SECTOR_SIZE) or write_due()))
+        {
+            write_pending = true;
+            schedule_task(this, std::bind(&StreamFileWriter::write_sector, this));
+        };
+        if (FC_elapsed_millis(last_report) > LOGFILE_REPORT_INTERVAL)
+            schedule_task(this, std::bind(&StreamFileWriter::report, this));
     };
 }
 
-void StreamFileWriter::handle_AHRS()
+void StreamFileWriter::store(const uint8_t* record, size_t size, uint64_t time)
 {
-    if (ahrs_in.count()>0)
+    if (runlevel_ != MODULE_RUNLEVEL_LINK_OPEN)
     {
-        // get the message from the queue
-        uint8_t sig = DATA_IMU_AHRS_SIGNATURE;
-        uint32_t time = FC_time_now();
-        DATA_IMU_AHRS data = ahrs_in.fetch();
-        if (runlevel_== MODULE_RUNLEVEL_LINK_OPEN)
-        {
-            myFile.write(&sig,1);
-            myFile.write(&time,4);
-            myFile.write(&data,12);
-        };        
-        // TODO: handle write failures
-    };
+        // no file - the data are quietly discarded
+    }
+    else if (ring.memcpyIn(record, size))
+    {
+        uint32_t used = ring.bytesUsed();
+        if (used > ring_max_used) ring_max_used = used;
+    }
+    else
+        records_dropped++;
 }
-    
-void StreamFileWriter::handle_GYRO()
+
+void StreamFileWriter::report()
 {
-    if (gyro_in.count()>0)
-    {
-        // get the message from the queue
-        uint8_t sig = DATA_IMU_GYRO_SIGNATURE;
-        uint32_t time = FC_time_now();
-        DATA_IMU_GYRO data = gyro_in.fetch();
-        if (runlevel_== MODULE_RUNLEVEL_LINK_OPEN)
-        {
-            myFile.write(&sig,1);
-            myFile.write(&time,4);
-            myFile.write(&data,12);
-        };        
-        // TODO: handle write failures
-    };
+    last_report = FC_time_now();
+    noInterrupts();
+    uint32_t dropped = records_dropped;
+    records_dropped = 0;
+    uint32_t max_used = ring_max_used;
+    uint32_t used = ring.bytesUsed();
+    ring_max_used = used;
+    interrupts();
+    uint8_t level = MSG_LEVEL_STATUSREPORT;
+    if ((dropped > 0) or (write_errors > 0)) level = MSG_LEVEL_WARNING;
+    system_log->in.receive(
+        Message::SystemTemplate(id, last_report, level, TPL_FASTLOG_WRITE,
+            sectors_written, write_errors, dropped, max_used,
+            latency_histogram[0], latency_histogram[1], latency_histogram[2], latency_histogram[3],
+            latency_histogram[4], latency_histogram[5], latency_histogram[6], latency_histogram[7],
+            latency_max) );
+    float fill = 0.0;
+    if (ring.capacity() > 0) fill = 100.0 * max_used / ring.capacity();
+    system_log->in.receive(
+        Message::SystemTemplate(id, last_report, MSG_LEVEL_STATUSREPORT, TPL_FASTLOG_BUFFER,
+            (uint32_t)(ring.capacity() / 1024), ring_in_psram ? "PSRAM" : "RAM", used, max_used, fill) );
+    reset_write_statistics();
+    report_compression();
 }
 
-void StreamFileWriter::flush()
+size_t StreamFileWriter::write_size()
 {
-    myFile.flush();
-    last_flush = FC_time_now();
+    if (ring.bytesUsed() > FASTLOG_CATCHUP_LEVEL) return LOG_BLOCK_SIZE;
+    return LOGFILE_SECTOR_SIZE;
 }
 
 StreamFileWriter::~StreamFileWriter()
 {
-    myFile.close();
+    close();
 }
-
@@ -2,23 +2,189 @@
 #pragma once
 
 #include <string>
-#include <SD.h>
 
 #include "module.h"
 #include "message.h"
 #include "port.h"
 #include "stream.h"
+#include "storage.h"
+#include "byte_ring.h"
+#include "log_format.h"
+#include "log_schema.h"
+
+// the size of the sectors written to the card
+#define LOGFILE_SECTOR_SIZE 512
+
+// the number of bins of the write latency histogram
+// the upper limits of the bins are given in log_writer_latency_limits[] (file_writer.cpp)
+#define LOGFILE_LATENCY_BINS 8
+
+// the interval of the status reports of the log file writers [ms]
+#define LOGFILE_REPORT_INTERVAL 10000
+
+// the minimum interval of committing the file size to the directory entry [ms]
+#define LOGFILE_COMMIT_INTERVAL 2000
+
+// the steps of committing the file size
+#define LOGFILE_COMMIT_IDLE 0
+#define LOGFILE_COMMIT_STOP 1
+#define LOGFILE_COMMIT_ENTRY 2
+
+/*
+    This is the common part of the modules writing log files.
+    The file is opened on the storage (see storage.h, global.h).
+    It is a log container (see log_format.h) with the schema
+    of all record types in its head block, the records are stored in blocks
+    with CRC and time range and an index allows seeking by time.
+
+    The file is preallocated (contiguous, if the card has enough free space in one piece)
+    when it is opened. The derived writers move their records into the log blocks.
+    The writer task only ever writes whole 512 byte sectors of complete blocks
+    and only when the card is not busy, so a single write cannot wait for the card.
+    The remaining data are written and the file is truncated to its content when it is closed.
+
+    The writes only start the transfer of a sector, whether the card has stored it
+    is polled with the following systicks. The file size in the directory entry is only
+    committed after the card has reported all data written so far as done. This is never
+    needed on FAT with a successful preallocation (the directory entry holds the
+    preallocated size from the start, the log blocks tell where the data end).
+    Otherwise (exFAT, no contiguous space) it is done every LOGFILE_COMMIT_INTERVAL in two steps
+    (ending the multi-sector write, writing the directory entry) each with its own systick
+    and only when the card is idle, so none of the waits inside the SdFat library
+    actually has to wait for the card.
+
+    The sector write latencies are collected in a histogram
+    that is sent with the status reports of the derived writers.
+
+    If built with LOG_COMPRESSION (see Makefile) the data blocks are compressed
+    (LOG_BLOCK_PACKED, see log_format.h) while the records are moved into them.
+    This costs about 24 kB of RAM per writer. The status reports then also give
+    the compression ratio and the CPU cycles spent per byte of records.
 
-/*  
-    This is a module for logging messages.
-    It writes all received text messages (serialized) to a file.
-    
     MODULE_RUNLEVEL_LINK_OPEN indicates that the file has been successfully opened
-    and can be written to. If this is not the case all incoming messages are quietly discarded
+    and can be written to. If this is not the case all incoming data are quietly discarded
     and the runlevel is reset to MODULE_RUNLEVEL_OPERATIONAL.
     This information could be used by some supervisor to try and re-open the file by calling setup().
 */
-class FileWriter : public Module
+class LogFileWriter : public Module
+{
+
+public:
+
+    // constructor
+    // the file is preallocated with the given size [bytes]
+    LogFileWriter(
+        std::string name,
+        std::string file_name,
+        uint64_t preallocate);
+
+    // here the file is actually opened and preallocated
+    virtual void setup();
+
+    // move records into the log blocks and write one sector to the card
+    // or do one step of committing the file size
+    virtual void write_sector();
+
+    // write all remaining data and close the file
+    // this has to be called by the destructors of the derived writers
+    virtual void close();
+
+    // append a stream record (see StreamRecorder), this may be called from an interrupt
+    // writers that do not log streams quietly discard the data
+    virtual void append(uint8_t signature, const void* data, size_t size) {};
+
+    virtual ~LogFileWriter() { delete compressor; };
+
+protected:
+
+    // move records into the log blocks
+    // returns false if the blocks cannot take more records
+    virtual bool pack_records() = 0;
+
+    // true if there are no more records to be packed
+    virtual bool all_packed() = 0;
+
+    // the size of the piece of a block written with one task [bytes]
+    virtual size_t write_size() { return LOGFILE_SECTOR_SIZE; };
+
+    // move one record into the log blocks (compressing it if enabled)
+    // returns false if the blocks cannot take it
+    bool add_record(const void* record, size_t size, uint64_t time);
+
+    // send the compression statistics and clear them (if the blocks are compressed)
+    void report_compression();
+
+    // write a piece of the first ready block, returns the number of bytes written
+    size_t write_block(size_t size);
+
+    // there is a block to be written or the file size is to be committed
+    bool write_due();
+
+    // do the next step of committing the file size, the card must not be busy
+    void commit_step();
+
+    // add the duration of a card operation to the latency statistics
+    void count_latency(uint32_t latency);
+
+    // clear the write statistics after a report
+    void reset_write_statistics();
+
+    std::string fileName;
+    uint64_t preallocate_size;
+    // the open file, NULL if there is none
+    StorageFile* myFile;
+
+    // the log blocks being assembled and written
+    LogBlockWriter blocks;
+    // the compressor of the data blocks, NULL if they are stored as they are
+    LogCompressor* compressor;
+    // the records moved into the log blocks since the last report and the cycles it took
+    uint32_t pack_bytes;
+    uint32_t pack_cycles;
+    // the number of bytes of the first ready block already written
+    size_t block_written;
+
+    // a write task has been scheduled but not yet run
+    volatile bool write_pending;
+
+    // the number of bytes the card has reported as done
+    uint64_t data_confirmed;
+    // the file size in the directory entry on the card
+    uint64_t size_committed;
+    // the step of committing the file size (LOGFILE_COMMIT_...)
+    uint8_t commit_state;
+    uint32_t last_commit;
+
+    // statistics since the last report
+    uint32_t last_report;
+    uint32_t sectors_written;
+    uint32_t write_errors;
+    // the sector writes and the commit steps
+    uint32_t latency_histogram[LOGFILE_LATENCY_BINS];
+    uint32_t latency_max;
+
+};
+
+
+// the file is preallocated with this size [bytes] when it is opened
+#define SYSLOG_PREALLOCATE (16ULL*1024*1024)
+
+// the maximum number of messages moved into the log blocks per task
+#define SYSLOG_PACK_LIMIT 16
+
+/*
+    This is a module for logging messages.
+    It writes all received messages to a file.
+
+    The messages are stored as they are in the compact binary format (see message.h),
+    no text is formatted on board. The text is only rendered when the log
+    is read (tools/taros_log --format text).
+
+    Every LOGFILE_REPORT_INTERVAL a status report gives the number of messages logged,
+    the average number of CPU cycles it took to log one, the messages that could not be stored,
+    the sectors written and the maximum sector write latency.
+*/
+class FileWriter : public LogFileWriter
 {
 
 public:
@@ -27,49 +193,161 @@ public:
     FileWriter(
         std::string name,
         std::string file_name);
-    
-    // here the file is actually opened
-    virtual void setup();
-    
+
     virtual void interrupt();
 
-    // process an incoming message
-    virtual void handle_MSG();
-    
-    // Once per second we make sure all buffered data is flushed to the card
-    virtual void flush();
+    // send the status report
+    virtual void report();
 
     // destructor
     // it should be called to actually cleanly close the file
-    // if this does not happen we try to flush as often as possible,
-    // still, data loss may occur
+    // if this does not happen the data of the last block are lost
     virtual ~FileWriter();
 
-    // port at which text messages are received to be written to the file
+    // port at which the messages are received to be written to the file
     ReceiverPort in;
 
+protected:
+
+    // move the received messages into the log blocks
+    virtual bool pack_records();
+
+    virtual bool all_packed() { return (in.count() == 0) and (pending_size == 0); };
+
 private:
 
-    std::string fileName;
-    File myFile;
-    
-    // we flush once per second
-    uint32_t last_flush;
-    
+    // a message record that did not fit into the blocks yet
+    uint8_t pending[LOG_MESSAGE_HEADER + MSG_MAX_ENCODED_SIZE];
+    size_t pending_size;
+
+    // statistics since the last report
+    uint32_t messages_logged;
+    uint32_t messages_dropped;
+    uint32_t log_cycles;
+
 };
 
 
-/*  
+// the size of the ring buffer of the stream file writer in the external PSRAM [bytes]
+// at 2 kHz of 21 byte records this covers an SD card stall of about 100 s
+#define FASTLOG_PSRAM_RING_SIZE (4*1024*1024)
+
+// the size of the ring buffer in the internal RAM if there is no PSRAM [bytes]
+// at 2 kHz of 21 byte records this covers an SD card stall of about 0.8 s
+#define FASTLOG_RING_SIZE (64*512)
+
+// with more data in the ring buffer a whole block is written with one task [bytes]
+#define FASTLOG_CATCHUP_LEVEL (16*1024)
+
+// the file is preallocated with this size [bytes] when it is opened
+// (about 3 h of 2 kHz of 21 byte records), it is truncated to the data when closed
+#define FASTLOG_PREALLOCATE (256ULL*1024*1024)
+
+// the largest record (signature and data) that can be logged
+#define FASTLOG_MAX_RECORD 64
+
+// the maximum number of bytes moved from the ring buffer into the log blocks per task
+#define FASTLOG_PACK_LIMIT LOG_BLOCK_SIZE
+
+/*
+    This is the common part of the log file writers buffering their records
+    in a ring buffer (StreamFileWriter, FlightRecorder).
+
+    The ring buffer is placed in the external PSRAM if there is one,
+    otherwise (or if that allocation fails) a smaller one in the internal RAM.
+    If there is no memory at all the capacity is 0 and every record is dropped,
+    the derived writers report that in their setup().
+
+    The stream records are appended by append(), which may be called from an interrupt.
+    The derived writers decide in store() what happens to a record (and may add other ones
+    like message records). The writer task moves the records from the ring buffer into the log blocks.
+*/
+class RingFileWriter : public LogFileWriter
+{
+
+public:
+
+    // constructor
+    // the ring buffer has psram_size bytes in the PSRAM or ram_size bytes in the internal RAM
+    RingFileWriter(
+        std::string name,
+        std::string file_name,
+        uint64_t preallocate,
+        size_t psram_size,
+        size_t ram_size);
+
+    // append a stream record to the ring buffer, this may be called from an interrupt
+    // only the records described in the schema are taken
+    virtual void append(uint8_t signature, const void* data, size_t size);
+
+    virtual ~RingFileWriter() {};
+
+protected:
+
+    // put a record into the ring buffer (or drop it), the interrupts are disabled
+    // every record starts with the signature and the 64-bit time
+    virtual void store(const uint8_t* record, size_t size, uint64_t time) = 0;
+
+    // move records from the ring buffer into the log blocks
+    virtual bool pack_records();
+
+    virtual bool all_packed() { return (ring.bytesUsed() == 0) and (pending_size == 0); };
+
+    // the size of the oldest record in the ring buffer (0 if there is none)
+    // and its time [us], the interrupts have to be disabled
+    size_t oldest(uint64_t &time);
+
+    // the ring buffer between the producers and the log blocks
+    ByteRing ring;
+    bool ring_in_psram;
+
+    // a record taken from the ring buffer that did not fit into the blocks yet
+    uint8_t pending[LOG_MESSAGE_HEADER + MSG_MAX_ENCODED_SIZE];
+    size_t pending_size;
+
+};
+
+/*
+    A stream receiver that does not queue the data blocks.
+    Every data block is appended as a record to the ring buffer of a log file writer
+    (see RingFileWriter) right when it is transmitted, so the sender may run in an interrupt.
+    A record consists of the signature byte followed by the data
+    without the padding at the end of the struct (see src/log_schema.h).
+*/
+template <typename datatype>
+class StreamRecorder : public StreamReceiver<datatype> {
+    public:
+        StreamRecorder(LogFileWriter *writer, uint8_t signature)
+            { m_writer = writer; m_signature = signature; };
+        virtual void receive(datatype data);
+        // nothing is ever queued
+        virtual uint16_t count() { return 0; };
+    protected:
+        LogFileWriter*      m_writer;
+        uint8_t             m_signature;
+};
+
+/*
     This is a module for logging streams.
     It writes all received stream to a file.
-    It adds a type signature and a timestamp to every dataset.
-    
-    MODULE_RUNLEVEL_LINK_OPEN indicates that the file has been successfully opened
-    and can be written to. If this is not the case all incoming messages are quietly discarded
-    and the runlevel is reset to MODULE_RUNLEVEL_OPERATIONAL.
-    This information could be used by some supervisor to try and re-open the file by calling setup().
+    It adds a type signature to every dataset, which is followed by
+    the 64-bit acquisition timestamp [us] and the data values.
+
+    The records are appended to a ring buffer by the stream receivers,
+    which may run in an interrupt. No SD card operation is done there.
+    The writer task moves the records from the ring buffer into the log blocks.
+    If the card stalls the ring buffer absorbs the data, only when it is full
+    the records are dropped (and counted) - the kernel loop is never stalled.
+    The ring buffer is placed in the external PSRAM (FASTLOG_PSRAM_RING_SIZE)
+    if there is one, otherwise in the internal RAM (FASTLOG_RING_SIZE).
+    While it holds more than FASTLOG_CATCHUP_LEVEL the writer catches up
+    with whole blocks written at once instead of single sectors.
+
+    Every LOGFILE_REPORT_INTERVAL a status report gives the number of sectors written,
+    the records dropped, the maximum fill of the ring buffer and a histogram
+    of the write latencies, followed by the capacity and fill of the ring buffer.
 */
-class StreamFileWriter : public Module
+class StreamFileWriter : public RingFileWriter
 {
 
 public:
@@ -78,37 +356,42 @@ public:
     StreamFileWriter(
         std::string name,
         std::string file_name);
-    
-    // here the file is actually opened
+
+    // the file is opened, a missing ring buffer is reported
     virtual void setup();
-    
-    virtual void interrupt();
-    
-    // handle incomming messages on ahrs_in
-    virtual void handle_AHRS();
 
-    // handle incomming messages on gyro_in
-    virtual void handle_GYRO();
+    virtual void interrupt();
 
-    // Once per second we make sure all buffered data is flushed to the card
-    virtual void flush();
+    // send the status report
+    virtual void report();
 
     // destructor
     // it should be called to actually cleanly close the file
-    // if this does not happen we try to flush as often as possible,
-    // still, data loss may occur
+    // if this does not happen the data of the last block are lost
     virtual ~StreamFileWriter();
 
     // ports at which data are received to be written to the file
-    StreamReceiver<DATA_IMU_AHRS> ahrs_in;
-    StreamReceiver<DATA_IMU_GYRO> gyro_in;
+    StreamRecorder<DATA_IMU_AHRS> ahrs_in;
+    StreamRecorder<DATA_IMU_GYRO> gyro_in;
+
+protected:
+
+    // if the ring buffer cannot take the whole record it is dropped
+    virtual void store(const uint8_t* record, size_t size, uint64_t time);
+
+    // whole blocks while catching up
+    virtual size_t write_size();
 
 private:
 
-    std::string fileName;
-    File myFile;
-    
-    // we flush once per second
-    uint32_t last_flush;
-    
+    // statistics since the last report
+    volatile uint32_t records_dropped;
+    volatile uint32_t ring_max_used;
+
 };
+
+template <typename datatype>
+void StreamRecorder<datatype>::receive(datatype data)
+{
+    m_writer->append(m_signature, &data, log_record_size(m_signature));
+}
@@ -0,0 +1,238 @@
+#include "flight_recorder.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include "kernel.h"
+#include "global.h"
+#include "run_files.h"
+
+FlightRecorder::FlightRecorder(std::string name) :
+    RingFileWriter(name, "", 0, FR_PSRAM_RING_SIZE, FR_RING_SIZE),
+    ahrs_in(this, DATA_IMU_AHRS_SIGNATURE),
+    gyro_in(this, DATA_IMU_GYRO_SIGNATURE)
+{
+    // the whole ring buffer plus the block headers and the index blocks
+    preallocate_size = ring.capacity() + ring.capacity()/8 + 4*LOG_BLOCK_SIZE;
+    fr_state = FR_CAPTURE;
+    trigger_level = MSG_LEVEL_CRITICAL;
+    trigger_time = 0;
+    first_time = 0;
+    last_time = 0;
+    events = 0;
+    record_pending = false;
+    freeze_pending = false;
+    end_pending = false;
+    blocks_finished = false;
+    records_dropped = 0;
+    bytes_frozen = 0;
+}
+
+void FlightRecorder::setup()
+{
+    // there is nothing to be opened before an event has been recorded
+    if (ring.capacity() == 0)
+    {
+        runlevel_ = MODULE_RUNLEVEL_ERROR;
+        system_log->in.receive(
+            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_ERROR,
+                "no memory for the ring buffer, nothing is captured.") );
+        return;
+    };
+    runlevel_ = MODULE_RUNLEVEL_OPERATIONAL;
+    std::stringstream ss;
+    ss << "capturing into " << ring.capacity()/1024 << " kB in " << (ring_in_psram ? "PSRAM." : "RAM.");
+    system_log->in.receive(
+        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, ss.str()) );
+}
+
+void FlightRecorder::interrupt()
+{
+    // the messages are recorded (or discarded while the ring buffer is frozen)
+    if ((not record_pending) and (in.count() > 0))
+    {
+        record_pending = true;
+        schedule_task(this, std::bind(&FlightRecorder::record_messages, this));
+    };
+    if ((fr_state == FR_POST) and (not freeze_pending) and
+        (FC_time_us() - trigger_time >= FR_POST_TRIGGER))
+    {
+        freeze_pending = true;
+        schedule_task(this, std::bind(&FlightRecorder::freeze, this));
+    };
+    if (runlevel_ == MODULE_RUNLEVEL_LINK_OPEN)
+    {
+        // the file is closed when the last block has been written
+        if (blocks_finished and (blocks.ready() == NULL) and
+            (not write_pending) and (not end_pending))
+        {
+            end_pending = true;
+            schedule_task(this, std::bind(&FlightRecorder::end_dump, this));
+        }
+        else if ((not write_pending) and (not end_pending))
+        {
+            write_pending = true;
+            schedule_task(this, std::bind(&FlightRecorder::write_sector, this));
+        };
+    };
+}
+
+void FlightRecorder::store(const uint8_t* record, size_t size, uint64_t time)
+{
+    switch (fr_state)
+    {
+        case FR_CAPTURE:
+        {
+            // drop the records that have left the pre-trigger window
+            // and as many more as needed to leave the room for the post-trigger window
+            uint64_t t;
+            size_t n;
+            while ((n = oldest(t)) > 0)
+            {
+                if ((t + FR_PRE_TRIGGER >= time) and
+                    (ring.bytesUsed() + size <= ring.capacity() - ring.capacity()/FR_POST_SHARE)) break;
+                ring.skip(n);
+            };
+            ring.memcpyIn(record, size);
+            break;
+        }
+        case FR_POST:
+            // the pre-trigger window is kept, new records are dropped if there is no room
+            if (ring.memcpyIn(record, size))
+                last_time = time;
+            else
+                records_dropped++;
+            break;
+        default:
+            // the ring buffer is frozen - the data are quietly discarded
+            break;
+    };
+}
+
+void FlightRecorder::record_messages()
+{
+    for (int i=0; (i<FR_MESSAGE_LIMIT) and (in.count()>0); i++)
+    {
+        Message msg = in.fetch();
+        if ((msg.type()==MSG_TYPE_SYSTEM) or (msg.type()==MSG_TYPE_SYSTEM_TEMPLATE))
+        {
+            // the severity is the first item of both system message types
+            uint8_t level = MSG_LEVEL_STATUSREPORT;
+            if (msg.size() > 0) level = *(uint8_t*)msg.get_data();
+            bool watchdog = false;
+            if ((msg.type()==MSG_TYPE_SYSTEM_TEMPLATE) and (msg.size() >= sizeof(MSG_DATA_SYSTEM_TEMPLATE)))
+            {
+                uint16_t tpl = ((MSG_DATA_SYSTEM_TEMPLATE*)msg.get_data())->template_id;
+                watchdog = (tpl == TPL_WATCHDOG_SYSTICK) or (tpl == TPL_WATCHDOG_TASK_DELAY);
+            };
+            // the milestones are no incidents even if they are more severe than the threshold
+            if (watchdog or ((level <= trigger_level) and (level != MSG_LEVEL_MILESTONE)))
+                trigger(msg.sender());
+        };
+        // the message is recorded in the same format as in the system log file
+        // (the triggering message itself is part of the event)
+        uint8_t record[LOG_MESSAGE_HEADER + MSG_MAX_ENCODED_SIZE];
+        uint8_t n = msg.buffer((char*)record + LOG_MESSAGE_HEADER, MSG_MAX_ENCODED_SIZE);
+        if (n == 0) continue;
+        // the record keeps the acquisition time of the message, like in the system log file
+        uint64_t time = msg.time();
+        if (time == 0) time = FC_time_us();
+        noInterrupts();
+        record[0] = LOG_MESSAGE_SIGNATURE;
+        memcpy(record+1, &time, sizeof(time));
+        record[9] = n;
+        store(record, LOG_MESSAGE_HEADER + n, time);
+        interrupts();
+    };
+    record_pending = false;
+}
+
+bool FlightRecorder::trigger(std::string cause)
+{
+    noInterrupts();
+    bool ok = (fr_state == FR_CAPTURE);
+    if (ok)
+    {
+        trigger_time = FC_time_us();
+        last_time = trigger_time;
+        fr_state = FR_POST;
+        records_dropped = 0;
+    };
+    interrupts();
+    if (ok)
+    {
+        trigger_cause = cause;
+        system_log->in.receive(
+            Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_MILESTONE, TPL_RECORDER_TRIGGER,
+                cause.c_str()) );
+    };
+    return ok;
+}
+
+void FlightRecorder::freeze()
+{
+    noInterrupts();
+    fr_state = FR_DUMP;
+    interrupts();
+    freeze_pending = false;
+    // the producers have stopped, the ring buffer is only read from here on
+    if ((oldest(first_time) == 0) or (first_time > trigger_time)) first_time = trigger_time;
+    bytes_frozen = ring.bytesUsed();
+    events++;
+    char name[20];
+    snprintf(name, sizeof(name), "event.%03u.log", (unsigned int)events);
+    fileName = FC_run_file(name);
+    pending_size = 0;
+    blocks_finished = false;
+    end_pending = false;
+    // this opens the file, the interrupt writes it from here on
+    LogFileWriter::setup();
+    if (runlevel_ != MODULE_RUNLEVEL_LINK_OPEN)
+    {
+        // the data are kept, the next trigger may try again
+        system_log->in.receive(
+            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_ERROR,
+                std::string("event file ") + name + " not opened.") );
+        noInterrupts();
+        fr_state = FR_CAPTURE;
+        interrupts();
+    };
+}
+
+bool FlightRecorder::pack_records()
+{
+    if (not RingFileWriter::pack_records()) return false;
+    // nothing is added to the frozen ring buffer, so the last block can be completed
+    if ((fr_state == FR_DUMP) and all_packed() and (not blocks_finished))
+    {
+        blocks.finish();
+        blocks_finished = true;
+    };
+    return true;
+}
+
+void FlightRecorder::end_dump()
+{
+    // all blocks have been written, this only truncates and closes the file
+    close();
+    system_log->in.receive(
+        Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_MILESTONE, TPL_RECORDER_EVENT,
+            fileName.c_str(), bytes_frozen,
+            (float)(trigger_time - first_time) * 1.0e-6, (float)(last_time - trigger_time) * 1.0e-6,
+            (uint32_t)records_dropped, write_errors) );
+    reset_write_statistics();
+    report_compression();
+    blocks_finished = false;
+    end_pending = false;
+    noInterrupts();
+    records_dropped = 0;
+    fr_state = FR_CAPTURE;
+    interrupts();
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    close();
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string>
+
+#include "module.h"
+#include "message.h"
+#include "port.h"
+#include "stream.h"
+#include "byte_ring.h"
+#include "file_writer.h"
+
+// the size of the ring buffer of the flight recorder in the external PSRAM [bytes]
+// at 2 kHz of 21 byte records (and the system messages) this covers about 45 s
+#define FR_PSRAM_RING_SIZE (2*1024*1024)
+
+// the size of the ring buffer in the internal RAM if there is no PSRAM [bytes]
+// this covers only about 0.7 s, the windows are cut short then
+#define FR_RING_SIZE (64*512)
+
+// the time kept in the ring buffer before the trigger [us]
+#define FR_PRE_TRIGGER 10000000
+
+// the time recorded after the trigger before the snapshot is written [us]
+#define FR_POST_TRIGGER 5000000
+
+// while capturing 1/FR_POST_SHARE of the ring buffer is kept free for the post-trigger window
+#define FR_POST_SHARE 3
+
+// the maximum number of messages recorded per task
+#define FR_MESSAGE_LIMIT 16
+
+// the states of the flight recorder
+// the last FR_PRE_TRIGGER of data are kept, older ones are dropped
+#define FR_CAPTURE 0
+// the trigger has occured, the data are kept until FR_POST_TRIGGER after it
+#define FR_POST 1
+// the ring buffer is frozen and written to the event file, new data are discarded
+#define FR_DUMP 2
+
+/*
+    This is a flight recorder capturing the last seconds of all streams
+    and system messages (including the kernel statistics of the watchdog)
+    in a ring buffer - much like the fast log, but nothing is written to the card
+    as long as nothing happens.
+
+    When a trigger occurs the recording continues for FR_POST_TRIGGER,
+    then the ring buffer is frozen and written to an event file (event.NNN.log)
+    in the run directory. The file is a log container like the other log files
+    (see log_format.h) and can be read with tools/taros_log.
+    The triggers are :
+        - a system message with a severity up to the trigger level (default MSG_LEVEL_CRITICAL),
+          milestones never trigger
+        - a delayed systick or task start reported by the watchdog
+        - a call of trigger(), e.g. by the commander from the uplink
+    Triggers occuring while an event is recorded or written are ignored.
+    The system messages are received from Logger::recorder_out, which is served
+    ahead of all filters of the logger (module thresholds, rate limits, duplicate suppression,
+    degraded mode and sink thresholds). So, a message hidden from the log file
+    or the downlink is still recorded and can still trigger. Only the own
+    trigger level (set_trigger_level()) decides about the triggers.
+
+    The ring buffer is placed in the external PSRAM (FR_PSRAM_RING_SIZE)
+    if there is one, otherwise in the internal RAM (FR_RING_SIZE), see RingFileWriter.
+    Without any memory for it the setup reports an error and nothing is captured.
+    While capturing the oldest records are dropped before the ring buffer fills up
+    (1/FR_POST_SHARE of it is kept free for the post-trigger window).
+    After the trigger the new ones are dropped (and counted) if it is full,
+    so the pre-trigger window is kept.
+
+    MODULE_RUNLEVEL_LINK_OPEN indicates that an event file is being written,
+    otherwise the runlevel is MODULE_RUNLEVEL_OPERATIONAL.
+    After an event has been written a report gives the file name, its size,
+    the windows before and after the trigger and the number of records dropped.
+*/
+class FlightRecorder : public RingFileWriter
+{
+
+public:
+
+    // constructor
+    FlightRecorder(std::string name);
+
+    // no file is opened here, only when an event has been recorded
+    virtual void setup();
+
+    virtual void interrupt();
+
+    // start the recording of an event, the cause is given in the report
+    // returns false if an event is already being recorded
+    bool trigger(std::string cause);
+
+    // set the severity up to which system messages trigger an event
+    // 0 disables the trigger by system messages
+    void set_trigger_level(uint8_t level) { trigger_level = level; };
+
+    // destructor
+    // an event file being written is closed
+    virtual ~FlightRecorder();
+
+    // ports at which data are received to be recorded
+    StreamRecorder<DATA_IMU_AHRS> ahrs_in;
+    StreamRecorder<DATA_IMU_GYRO> gyro_in;
+
+    // port at which the system messages are received to be recorded
+    ReceiverPort in;
+
+protected:
+
+    // keep, drop or discard a record depending on the state of the recorder
+    virtual void store(const uint8_t* record, size_t size, uint64_t time);
+
+    // move records from the ring buffer into the log blocks
+    // and complete the last block when the frozen ring buffer is empty
+    virtual bool pack_records();
+
+private:
+
+    // record the received system messages and check them for triggers
+    void record_messages();
+
+    // freeze the ring buffer and open the event file
+    void freeze();
+
+    // close the event file and resume capturing
+    void end_dump();
+
+    // the state of the recorder (FR_...)
+    volatile uint8_t fr_state;
+    uint8_t trigger_level;
+    std::string trigger_cause;
+    uint64_t trigger_time;
+    // the times of the oldest and the latest record of the event
+    uint64_t first_time;
+    volatile uint64_t last_time;
+    // the number of events recorded so far
+    uint32_t events;
+
+    // a task has been scheduled but not yet run
+    volatile bool record_pending;
+    volatile bool freeze_pending;
+    bool end_pending;
+    // the data blocks have been completed
+    bool blocks_finished;
+
+    // statistics of the event being recorded
+    volatile uint32_t records_dropped;
+    uint32_t bytes_frozen;
+
+};
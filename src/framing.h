@@ -0,0 +1,120 @@
+/*
+    Framing of data blocks for transmission over serial links (e.g. the modem).
+
+    Every data block (usually one or more messages in the compact binary format)
+    gets a CRC-16 appended and is then COBS encoded (consistent overhead byte stuffing).
+    COBS removes all zero bytes from the data, so a single 0x00 byte can be used
+    as an unambiguous frame delimiter.
+
+        COBS( payload + CRC-16 (high byte first) ) + 0x00
+
+    A receiver can always resynchronize at the next delimiter, so corrupted
+    or truncated frames cost at most one frame. Every byte is touched only once,
+    the decoding runs in linear time even on noisy links.
+    Frames with a CRC mismatch are never delivered.
+
+    The code is platform-independent, it is shared between the flight software
+    and the ground station tools.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define FRAME_DELIMITER 0x00
+
+// the largest payload of a single frame
+#define FRAME_MAX_PAYLOAD 254
+
+// the maximum number of bytes a frame with n payload bytes can take when encoded
+// (payload + 2 bytes CRC + COBS overhead + delimiter)
+#define FRAME_ENCODED_SIZE(n) ((n)+2+((n)+2)/254+2)
+
+// CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF)
+// A running CRC can be continued by passing the previous value.
+uint16_t crc16(const uint8_t* data, size_t n, uint16_t crc = 0xFFFF);
+
+// Encode a payload into a frame including the delimiter.
+// Returns the number of bytes written to out.
+// If the payload is too large or the frame would not fit into the output buffer
+// nothing is written and 0 is returned.
+size_t frame_encode(const uint8_t* payload, size_t n, uint8_t* out, size_t out_size);
+
+/*
+    This is a streaming decoder for frames.
+    Bytes are pushed one at a time as they are received.
+    Whenever a valid frame is completed the payload is available
+    until the next byte is pushed.
+
+    Some transmission channels append additional bytes after every
+    transmitted packet (e.g. the RSSI byte of the E220 modem).
+    The number of such trailer bytes can be given, they are then
+    expected after every frame delimiter and reported with the frame.
+*/
+class FrameDecoder
+{
+
+public:
+
+    FrameDecoder(size_t trailer_bytes = 0);
+
+    // Push one received byte into the decoder.
+    // Returns true if a valid frame has just been completed.
+    bool push(uint8_t c);
+
+    // Push a number of bytes, stops after a complete frame has been found.
+    // Returns the number of bytes consumed.
+    // If a frame was found, frame_available() is true.
+    size_t push(const uint8_t* data, size_t n);
+
+    // true after push() has completed a valid frame, reset with the next push
+    bool frame_available() { return m_available; };
+
+    // the payload of the last completed frame (without CRC)
+    const uint8_t* frame() { return m_buffer; };
+    size_t frame_size() { return m_frame_size; };
+
+    // the trailer bytes received after the last completed frame
+    const uint8_t* trailer() { return m_trailer; };
+
+    // discard any partially received frame
+    void reset();
+
+    // link statistics
+    uint32_t frames_ok() { return m_frames_ok; };
+    uint32_t crc_errors() { return m_crc_errors; };
+    // frames with invalid COBS encoding or too short to hold a CRC
+    uint32_t format_errors() { return m_format_errors; };
+    // frames exceeding the maximum size
+    uint32_t overruns() { return m_overruns; };
+    // the total number of frames lost
+    uint32_t frames_lost() { return m_crc_errors+m_format_errors+m_overruns; };
+    void reset_statistics();
+
+private:
+
+    // decode the collected bytes in place and check the CRC
+    bool complete_frame();
+
+    // we collect the encoded frame, it gets decoded in place at the delimiter
+    uint8_t     m_buffer[FRAME_ENCODED_SIZE(FRAME_MAX_PAYLOAD)];
+    size_t      m_count;
+    bool        m_overrun;
+
+    // after every frame (valid or not) the trailer is expected
+    size_t      m_trailer_bytes;
+    size_t      m_trailer_expected;
+    size_t      m_trailer_count;
+    uint8_t     m_trailer[4];
+    bool        m_pending;
+
+    bool        m_available;
+    size_t      m_frame_size;
+
+    uint32_t    m_frames_ok;
+    uint32_t    m_crc_errors;
+    uint32_t    m_format_errors;
+    uint32_t    m_overruns;
+
+};
@@ -6,6 +6,7 @@
 
 #include "logger.h"
 #include "file_writer.h"
+#include "storage.h"
 
 #ifdef USE_USB_SERIAL
 # include "usb_serial.h"
@@ -29,9 +30,13 @@ extern FileWriter* system_log_file_writer;
 // -- actually defined in main.cpp --
 extern bool SD_card_OK;
 
-// this is the run number used to name log files
-// it is assigned when opening the 'taros.0000.system.log'
-// and should be used for all other log files of the same run
+// the file system on the SD card, through which all files are accessed
+// NULL if there is no SD card
+// -- actually defined in main.cpp --
+extern Storage* storage;
+
+// this is the run number, all log files of the run are stored
+// in its directory (see run_files.h), -1 if there is none
 // -- actually defined in main.cpp --
 extern int SD_file_No;
 
@@ -27,6 +27,28 @@ uint32_t FC_elapsed_millis(uint32_t timestamp)
 // we store its value with every systick to procide sub-millisecond timing
 static volatile uint32_t FC_systick_cycle_count;
 
+// ARM_DWT_CYCCNT wraps around every 7 seconds, so we extend it to 64 bit
+// with every systick the cycles elapsed since the previous one are accumulated
+static volatile uint64_t FC_systick_cycles_total;
+
+uint64_t FC_time_us()
+{
+    uint32_t millis;
+    uint32_t cycles;
+    uint64_t total;
+    // the systick may interrupt us while reading the 64-bit value
+    // in that case the millisecond count has changed and we read again
+    // (the systick itself updates the three values as one, see FC_systick_isr())
+    do {
+        millis = FC_systick_millis_count;
+        total = FC_systick_cycles_total;
+        cycles = FC_systick_cycle_count;
+    } while (millis != FC_systick_millis_count);
+    // the difference automatically wraps around
+    total += ARM_DWT_CYCCNT - cycles;
+    return total / (F_CPU_ACTUAL/1000000);
+}
+
 // we use a flag to indicate if it is allowed to call module interrupts
 static volatile bool FC_module_interrupts_active;
 
@@ -81,11 +103,18 @@ void FC_systick_isr(void)
     systick_cycle_count = ARM_DWT_CYCCNT;
     systick_millis_count++;
     // --- end original code
+    // the time base is updated with the interrupts disabled,
+    // so an interrupt of higher priority calling FC_time_us() never sees
+    // the new cycle count with the old total (a time 1 ms in the past)
+    noInterrupts();
     uint32_t last_count = FC_systick_cycle_count;
     FC_systick_cycle_count = ARM_DWT_CYCCNT;
-    FC_systick_millis_count++;
     // keep track of potentially delayed interrupts
     uint32_t spacing = FC_systick_cycle_count-last_count;
+    FC_systick_cycles_total += spacing;
+    // this has to be the last update of the time base (see FC_time_us())
+    FC_systick_millis_count++;
+    interrupts();
     if (spacing > FC_max_isr_spacing) FC_max_isr_spacing=spacing;
     // call all module interrupts - record timing
     std::list<Module*>::iterator it;
@@ -119,6 +148,7 @@ void setup_core_system()
 {
     FC_systick_millis_count = 0;
     FC_systick_cycle_count = ARM_DWT_CYCCNT;
+    FC_systick_cycles_total = 0;
     FC_max_isr_spacing = 0;
     FC_max_isr_time_to_completion = 0;
     FC_module_interrupts_active = false;
@@ -36,6 +36,12 @@ class Module;
 // miliseconds since program start (about 50 days capacity)
 uint32_t FC_time_now();
 
+// microseconds since program start as a 64-bit value (no wrap-around within the lifetime)
+// This is extended from the CPU cycle counter, so it has sub-microsecond resolution.
+// It can be called from interrupt and task context alike.
+// All data samples are stamped with this time at acquisition.
+uint64_t FC_time_us();
+
 // report the time elapsed since the timestamp
 // if current FC_systick_millis_count is small than timestamp wrap-around
 uint32_t FC_elapsed_millis(uint32_t timestamp);
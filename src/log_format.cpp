@@ -0,0 +1,444 @@
+#include "log_format.h"
+
+#include <cstring>
+
+// the CRC of every possible value of the low byte, one table lookup per byte
+// (the table resides in flash on the target)
+static const uint32_t crc32_table[256] = {
+    0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
+    0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
+    0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2,
+    0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
+    0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9,
+    0xfa0f3d63, 0x8d080df5, 0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
+    0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b, 0x35b5a8fa, 0x42b2986c,
+    0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
+    0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423,
+    0xcfba9599, 0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
+    0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d, 0x76dc4190, 0x01db7106,
+    0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
+    0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d,
+    0x91646c97, 0xe6635c01, 0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
+    0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457, 0x65b0d9c6, 0x12b7e950,
+    0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
+    0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7,
+    0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
+    0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9, 0x5005713c, 0x270241aa,
+    0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
+    0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81,
+    0xb7bd5c3b, 0xc0ba6cad, 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
+    0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683, 0xe3630b12, 0x94643b84,
+    0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
+    0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb,
+    0x196c3671, 0x6e6b06e7, 0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
+    0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5, 0xd6d6a3e8, 0xa1d1937e,
+    0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
+    0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55,
+    0x316e8eef, 0x4669be79, 0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
+    0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28,
+    0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
+    0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f,
+    0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
+    0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21, 0x86d3d2d4, 0xf1d4e242,
+    0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
+    0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69,
+    0x616bffd3, 0x166ccf45, 0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
+    0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db, 0xaed16a4a, 0xd9d65adc,
+    0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
+    0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693,
+    0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
+    0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
+};
+
+uint32_t crc32(const uint8_t* data, size_t n, uint32_t crc)
+{
+    crc = ~crc;
+    for (size_t i=0; i<n; i++)
+        crc = (crc >> 8) ^ crc32_table[(crc ^ data[i]) & 0xFF];
+    return ~crc;
+}
+
+uint32_t log_block_crc(const uint8_t* block, uint32_t file_id)
+{
+    const LogBlockHeader* h = (const LogBlockHeader*)block;
+    size_t size = h->size;
+    if (size > LOG_BLOCK_PAYLOAD) size = LOG_BLOCK_PAYLOAD;
+    // the head block has to be read before the file identifier is known
+    if (h->type == LOG_BLOCK_HEAD) file_id = 0;
+    // everything but the CRC itself
+    uint32_t crc = crc32(block, offsetof(LogBlockHeader, crc), file_id);
+    crc = crc32(block + offsetof(LogBlockHeader, first_time),
+        sizeof(LogBlockHeader) - offsetof(LogBlockHeader, first_time) + size, crc);
+    return crc;
+}
+
+bool log_block_valid(const uint8_t* block, uint32_t file_id)
+{
+    const LogBlockHeader* h = (const LogBlockHeader*)block;
+    if (h->magic != LOG_BLOCK_MAGIC) return false;
+    if (h->size > LOG_BLOCK_PAYLOAD) return false;
+    return h->crc == log_block_crc(block, file_id);
+}
+
+LogBlockWriter::LogBlockWriter()
+{
+    for (int i=0; i<LOG_WRITER_BUFFERS; i++) m_used[i] = false;
+    m_queue_head = 0;
+    m_queue_count = 0;
+    m_current = -1;
+    m_sequence = 0;
+    m_file_id = 0;
+    m_compressor = NULL;
+    m_index_count = 0;
+}
+
+bool LogBlockWriter::begin(uint32_t run, const char* schema, uint64_t time)
+{
+    size_t schema_size = strlen(schema);
+    if (sizeof(LogHeadInfo) + schema_size > LOG_BLOCK_PAYLOAD) return false;
+    for (int i=0; i<LOG_WRITER_BUFFERS; i++) m_used[i] = false;
+    m_queue_head = 0;
+    m_queue_count = 0;
+    m_current = -1;
+    m_sequence = 0;
+    m_index_count = 0;
+    // unique for every file as no two files are created at the same time
+    m_file_id = crc32((const uint8_t*)&time, sizeof(time), run);
+    int b = acquire();
+    start(b, LOG_BLOCK_HEAD);
+    LogHeadInfo info;
+    memset(&info, 0, sizeof(info));
+    memcpy(info.format, "TAROSLOG", 8);
+    info.version = LOG_FORMAT_VERSION;
+    info.block_size = LOG_BLOCK_SIZE;
+    info.index_interval = LOG_INDEX_INTERVAL;
+    info.schema_size = schema_size;
+    info.run = run;
+    info.file_id = m_file_id;
+    memcpy(payload(b), &info, sizeof(info));
+    memcpy(payload(b) + sizeof(info), schema, schema_size);
+    LogBlockHeader* h = header(b);
+    h->size = sizeof(info) + schema_size;
+    h->first_time = time;
+    h->last_time = time;
+    m_current = b;
+    complete();
+    return true;
+}
+
+bool LogBlockWriter::add(const void* record, size_t size, uint64_t time)
+{
+    if (size > LOG_BLOCK_PAYLOAD) return false;
+    if (m_current >= 0)
+    {
+        LogBlockHeader* h = header(m_current);
+        if (h->type == LOG_BLOCK_PACKED)
+        {
+            if (not m_compressor->fits(size)) complete();
+        }
+        else if (h->size + size > LOG_BLOCK_PAYLOAD)
+            complete();
+    };
+    if (m_current < 0)
+    {
+        // the index follows every LOG_INDEX_INTERVAL data blocks
+        if (m_index_count >= LOG_INDEX_INTERVAL)
+            if (not add_index()) return false;
+        int b = acquire();
+        if (b < 0) return false;
+        if (m_compressor != NULL)
+        {
+            start(b, LOG_BLOCK_PACKED);
+            m_compressor->reset(payload(b));
+        }
+        else
+            start(b, LOG_BLOCK_DATA);
+        m_current = b;
+    };
+    LogBlockHeader* h = header(m_current);
+    bool first = (h->size == 0);
+    if (h->type == LOG_BLOCK_PACKED)
+    {
+        // even an empty block cannot take the record
+        if (not m_compressor->fits(size)) return false;
+        m_compressor->add((const uint8_t*)record, size);
+        h->size = m_compressor->size();
+    }
+    else
+    {
+        memcpy(payload(m_current) + h->size, record, size);
+        h->size += size;
+    };
+    if (first)
+    {
+        h->first_time = time;
+        h->last_time = time;
+    }
+    else
+    {
+        if (time < h->first_time) h->first_time = time;
+        if (time > h->last_time) h->last_time = time;
+    };
+    return true;
+}
+
+void LogBlockWriter::finish()
+{
+    if ((m_current >= 0) and (header(m_current)->size > 0))
+        complete();
+}
+
+const uint8_t* LogBlockWriter::ready()
+{
+    if (m_queue_count == 0) return NULL;
+    return m_buffer[m_queue[m_queue_head]];
+}
+
+void LogBlockWriter::release()
+{
+    if (m_queue_count == 0) return;
+    m_used[m_queue[m_queue_head]] = false;
+    m_queue_head = (m_queue_head + 1) % LOG_WRITER_BUFFERS;
+    m_queue_count--;
+}
+
+int LogBlockWriter::acquire()
+{
+    for (int i=0; i<LOG_WRITER_BUFFERS; i++)
+        if (not m_used[i])
+        {
+            m_used[i] = true;
+            return i;
+        };
+    return -1;
+}
+
+void LogBlockWriter::start(int buffer, uint16_t type)
+{
+    memset(m_buffer[buffer], 0, LOG_BLOCK_SIZE);
+    LogBlockHeader* h = header(buffer);
+    h->magic = LOG_BLOCK_MAGIC;
+    h->sequence = m_sequence++;
+    h->type = type;
+}
+
+void LogBlockWriter::complete()
+{
+    LogBlockHeader* h = header(m_current);
+    if (h->type == LOG_BLOCK_PACKED) h->size = m_compressor->finish();
+    h->crc = log_block_crc(m_buffer[m_current], m_file_id);
+    if (log_data_block(h->type) and (m_index_count < LOG_INDEX_INTERVAL))
+    {
+        LogIndexEntry* entry = &m_index[m_index_count++];
+        entry->sequence = h->sequence;
+        entry->size = h->size;
+        entry->first_time = h->first_time;
+        entry->last_time = h->last_time;
+    };
+    m_queue[(m_queue_head + m_queue_count) % LOG_WRITER_BUFFERS] = m_current;
+    m_queue_count++;
+    m_current = -1;
+}
+
+bool LogBlockWriter::add_index()
+{
+    int b = acquire();
+    if (b < 0) return false;
+    start(b, LOG_BLOCK_INDEX);
+    LogBlockHeader* h = header(b);
+    h->size = m_index_count * sizeof(LogIndexEntry);
+    memcpy(payload(b), m_index, h->size);
+    h->first_time = m_index[0].first_time;
+    h->last_time = m_index[0].last_time;
+    for (int i=1; i<m_index_count; i++)
+    {
+        if (m_index[i].first_time < h->first_time) h->first_time = m_index[i].first_time;
+        if (m_index[i].last_time > h->last_time) h->last_time = m_index[i].last_time;
+    };
+    m_index_count = 0;
+    m_current = b;
+    complete();
+    return true;
+}
+
+// the number of bytes continuing a length of the LZ4 sequences
+static inline size_t pack_length_bytes(size_t n)
+{
+    return (n < 15) ? 0 : (n - 15)/255 + 1;
+}
+
+static inline uint8_t* pack_write_length(uint8_t* out, size_t n)
+{
+    if (n < 15) return out;
+    n -= 15;
+    while (n >= 255)
+    {
+        *out++ = 255;
+        n -= 255;
+    };
+    *out++ = n;
+    return out;
+}
+
+static inline uint32_t pack_read32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+LogCompressor::LogCompressor()
+{
+    m_raw_size = 0;
+    m_scan = 0;
+    m_literals = 0;
+    m_out = NULL;
+    m_out_size = 0;
+    reset_statistics();
+}
+
+void LogCompressor::reset(uint8_t* out)
+{
+    m_out = out;
+    // the size of the records is stored in front of the sequences
+    m_out_size = 2;
+    m_raw_size = 0;
+    m_scan = 0;
+    m_literals = 0;
+    memset(m_hash, 0, sizeof(m_hash));
+}
+
+size_t LogCompressor::finish_size(size_t literals)
+{
+    return m_out_size + 1 + pack_length_bytes(literals) + literals;
+}
+
+bool LogCompressor::fits(size_t size)
+{
+    if (m_raw_size + size > LOG_PACK_RAW_SIZE) return false;
+    // replacing literals by a match never takes more space, so this is the worst case
+    return finish_size(m_raw_size - m_literals + size) <= LOG_BLOCK_PAYLOAD;
+}
+
+size_t LogCompressor::size()
+{
+    return m_out_size;
+}
+
+bool LogCompressor::emit(size_t end, size_t offset, size_t length)
+{
+    size_t literals = end - m_literals;
+    size_t need = 1 + pack_length_bytes(literals) + literals;
+    if (length > 0) need += 2 + pack_length_bytes(length - LOG_PACK_MIN_MATCH);
+    if (m_out_size + need > LOG_BLOCK_PAYLOAD) return false;
+    uint8_t* token = m_out + m_out_size;
+    uint8_t* out = token + 1;
+    *token = ((literals < 15) ? literals : 15) << 4;
+    out = pack_write_length(out, literals);
+    memcpy(out, m_raw + m_literals, literals);
+    out += literals;
+    if (length > 0)
+    {
+        *out++ = offset & 0xFF;
+        *out++ = offset >> 8;
+        size_t n = length - LOG_PACK_MIN_MATCH;
+        *token |= (n < 15) ? n : 15;
+        out = pack_write_length(out, n);
+    };
+    m_out_size = out - m_out;
+    m_literals = end + length;
+    return true;
+}
+
+void LogCompressor::add(const uint8_t* record, size_t size)
+{
+    memcpy(m_raw + m_raw_size, record, size);
+    m_raw_size += size;
+    size_t pos = m_scan;
+    while (pos + LOG_PACK_MIN_MATCH <= m_raw_size)
+    {
+        uint32_t seq = pack_read32(m_raw + pos);
+        uint32_t h = (seq * 2654435761u) >> (32 - LOG_PACK_HASH_BITS);
+        size_t candidate = m_hash[h];
+        m_hash[h] = pos + 1;
+        // the whole block is within the reach of the 16-bit offsets
+        if ((candidate > 0) and (pack_read32(m_raw + candidate - 1) == seq))
+        {
+            candidate--;
+            size_t length = LOG_PACK_MIN_MATCH;
+            while ((pos + length < m_raw_size) and (m_raw[candidate + length] == m_raw[pos + length]))
+                length++;
+            if (emit(pos, pos - candidate, length))
+            {
+                pos += length;
+                // the end of the match is hashed, so a repeated record is found as one match
+                if (pos - 2 + LOG_PACK_MIN_MATCH <= m_raw_size)
+                    m_hash[(pack_read32(m_raw + pos - 2) * 2654435761u) >> (32 - LOG_PACK_HASH_BITS)] = pos - 1;
+                continue;
+            };
+        };
+        pos++;
+    };
+    m_scan = pos;
+}
+
+size_t LogCompressor::finish()
+{
+    // the last sequence has only literals, fits() has reserved the space for it
+    emit(m_raw_size, 0, 0);
+    m_out[0] = m_raw_size & 0xFF;
+    m_out[1] = m_raw_size >> 8;
+    m_raw_bytes += m_raw_size;
+    m_packed_bytes += m_out_size;
+    m_packed_blocks++;
+    return m_out_size;
+}
+
+size_t log_unpack(const uint8_t* payload, size_t size, uint8_t* out, size_t capacity)
+{
+    if (size < 2) return 0;
+    size_t raw = payload[0] | (payload[1] << 8);
+    if (raw > capacity) return 0;
+    size_t in = 2;
+    size_t pos = 0;
+    while (in < size)
+    {
+        uint8_t token = payload[in++];
+        size_t literals = token >> 4;
+        if (literals == 15)
+        {
+            uint8_t b;
+            do {
+                if (in >= size) return 0;
+                b = payload[in++];
+                literals += b;
+            } while (b == 255);
+        };
+        if ((in + literals > size) or (pos + literals > raw)) return 0;
+        memcpy(out + pos, payload + in, literals);
+        in += literals;
+        pos += literals;
+        // the last sequence ends after the literals
+        if (in == size) break;
+        if (in + 2 > size) return 0;
+        size_t offset = payload[in] | (payload[in+1] << 8);
+        in += 2;
+        if ((offset == 0) or (offset > pos)) return 0;
+        size_t length = token & 15;
+        if (length == 15)
+        {
+            uint8_t b;
+            do {
+                if (in >= size) return 0;
+                b = payload[in++];
+                length += b;
+            } while (b == 255);
+        };
+        length += LOG_PACK_MIN_MATCH;
+        if (pos + length > raw) return 0;
+        // the match may overlap the bytes being written
+        for (size_t i=0; i<length; i++, pos++)
+            out[pos] = out[pos - offset];
+    };
+    return (pos == raw) ? raw : 0;
+}
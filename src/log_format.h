@@ -0,0 +1,326 @@
+/*
+    The container format of the binary log files.
+
+    A log file is a sequence of blocks of LOG_BLOCK_SIZE bytes,
+    block n starts at the file position n*LOG_BLOCK_SIZE. Every block starts
+    with a header giving its type, its sequence number, the number of payload
+    bytes used, a CRC-32 and the time range of its content. The rest of the
+    payload is filled with zeros. All numbers are little-endian.
+
+    block 0             head block : LogHeadInfo followed by the schema text
+    block 1 ... 128     data blocks : records
+    block 129           index block : a LogIndexEntry for each of the 128 preceding data blocks
+    block 130 ... 257   data blocks
+    block 258           index block
+    ...
+
+    The schema (src/log_schema.h, generated from src/types.h) describes
+    the layout of all record types with names, types and units of the fields.
+    So, a reader needs nothing but the file to decode it.
+
+    A record is the signature byte followed by the data (without the padding
+    at the end of the struct), the first field is always the 64-bit acquisition time [us].
+    Messages (see message.h) are stored in records of variable size :
+    LOG_MESSAGE_SIGNATURE, the 64-bit time [us] of the message (when it was created,
+    the time of logging if it has none), the size (1 byte) and the message
+    in the compact binary format.
+    Records are never split across blocks. The time range of a block is the
+    minimum and maximum acquisition time of its records.
+
+    Every file has an identifier (in the head block) which is the start value
+    of the CRC of all other blocks. So, blocks of a file that occupied the same
+    space on the card before do not pass as blocks of this file.
+    As the files are preallocated in one contiguous piece and only the data sectors
+    are written while logging, a file can be recovered after a power loss
+    even from a raw image of the card - the head block is found by its content,
+    the blocks following it are valid up to the last one completely written
+    (see tools/taros_log/taros_recover).
+
+    The records of the data blocks may be compressed (LOG_BLOCK_PACKED, see LogCompressor).
+    Every such block is compressed on its own, so it can be decoded without any other block
+    and a recovered file is readable up to its last valid block as before.
+    Only the payload is compressed, the headers and the index are the same.
+
+    Because the index blocks are at known positions a reader can find
+    any time by a binary search over the index blocks, reading only a few blocks
+    of even a very large file (see tools/taros_log). The data after the last
+    index block is searched through the block headers.
+
+    The code is platform-independent, it is shared between the flight software
+    and the host tools.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define LOG_BLOCK_SIZE 4096
+
+// "TBLK" at the start of every block
+#define LOG_BLOCK_MAGIC 0x4b4c4254
+
+// version 2 adds the file identifier (0 in version 1 files, so they are read the same way)
+// version 3 adds the compressed data blocks
+#define LOG_FORMAT_VERSION 3
+
+// the block types
+#define LOG_BLOCK_HEAD 1
+#define LOG_BLOCK_DATA 2
+#define LOG_BLOCK_INDEX 3
+#define LOG_BLOCK_PACKED 4
+
+// the signature of the message records
+#define LOG_MESSAGE_SIGNATURE 0x01
+
+// the bytes in front of the message in a message record (signature, time, size)
+#define LOG_MESSAGE_HEADER 10
+
+// the line of the schema declaring the message records
+#define LOG_MESSAGE_SCHEMA "message 0x01 MESSAGE\n"
+
+// the number of data blocks between two index blocks
+#define LOG_INDEX_INTERVAL 128
+
+// the number of blocks that can be filled or waiting to be written
+#define LOG_WRITER_BUFFERS 2
+
+// the maximum size of the records compressed into one block [bytes]
+#define LOG_PACK_RAW_SIZE 16384
+
+// the size of the hash table of the compressor (2^n entries)
+#define LOG_PACK_HASH_BITS 12
+
+// the shortest match of the compressor [bytes]
+#define LOG_PACK_MIN_MATCH 4
+
+struct LogBlockHeader {
+    uint32_t    magic;          // LOG_BLOCK_MAGIC
+    uint32_t    sequence;       // the number of the block in the file
+    uint16_t    type;           // LOG_BLOCK_...
+    uint16_t    size;           // the number of payload bytes used
+    uint32_t    crc;            // CRC-32 of the header (without the CRC) and the payload bytes used
+    uint64_t    first_time;     // the earliest time of the content [us]
+    uint64_t    last_time;      // the latest time of the content [us]
+};
+
+#define LOG_BLOCK_PAYLOAD (LOG_BLOCK_SIZE-sizeof(LogBlockHeader))
+
+// the start of the payload of the head block
+struct LogHeadInfo {
+    char        format[8];      // "TAROSLOG"
+    uint16_t    version;        // LOG_FORMAT_VERSION
+    uint16_t    block_size;     // LOG_BLOCK_SIZE
+    uint16_t    index_interval; // LOG_INDEX_INTERVAL
+    uint16_t    schema_size;    // the number of bytes of schema text following this info
+    uint32_t    run;            // the run number the file belongs to
+    uint32_t    file_id;        // the start value of the CRC of all but the head block
+};
+
+// the payload of the index blocks
+struct LogIndexEntry {
+    uint32_t    sequence;       // the number of the data block
+    uint32_t    size;           // the number of payload bytes used
+    uint64_t    first_time;     // the time range of the data block [us]
+    uint64_t    last_time;
+};
+
+static_assert(sizeof(LogBlockHeader) == 32, "unexpected padding of LogBlockHeader");
+static_assert(sizeof(LogHeadInfo) == 24, "unexpected padding of LogHeadInfo");
+static_assert(sizeof(LogIndexEntry) == 24, "unexpected padding of LogIndexEntry");
+static_assert(LOG_INDEX_INTERVAL*sizeof(LogIndexEntry) <= LOG_BLOCK_PAYLOAD, "index does not fit into a block");
+static_assert(LOG_PACK_RAW_SIZE <= 65535, "the raw size of a packed block is stored in 16 bit");
+
+// both types of data blocks hold records
+inline bool log_data_block(uint16_t type)
+{
+    return (type == LOG_BLOCK_DATA) or (type == LOG_BLOCK_PACKED);
+}
+
+// CRC-32 (the one of zlib, polynomial 0x04C11DB7 reflected)
+// A running CRC can be continued by passing the previous value.
+uint32_t crc32(const uint8_t* data, size_t n, uint32_t crc = 0);
+
+// the CRC of a block as stored in its header
+// the file identifier is not used for the head block
+uint32_t log_block_crc(const uint8_t* block, uint32_t file_id);
+
+// check the magic number, the size and the CRC of a block
+bool log_block_valid(const uint8_t* block, uint32_t file_id);
+
+// the sequence number of the index block following the data blocks of group g (counting from 0)
+inline uint64_t log_index_sequence(uint64_t group)
+{
+    return 1 + group*(LOG_INDEX_INTERVAL+1) + LOG_INDEX_INTERVAL;
+}
+
+/*
+    This compresses the records of one data block (LOG_BLOCK_PACKED)
+    while they are added, the cost of each call is proportional to the size of the record.
+
+    The payload of a packed block starts with the size of the records (16 bit),
+    followed by the sequences of the LZ4 block format : a token byte with the number
+    of literals (high nibble) and the match length - LOG_PACK_MIN_MATCH (low nibble),
+    each continued by bytes of 255 if the nibble is 15, then the literals,
+    then the 16-bit offset of the match and its continued length.
+    The last sequence has only literals. The matches never reach beyond the block,
+    there is no dictionary carried from one block to the next.
+    Other than with the reference LZ4 encoder a match may end right at the end of the data,
+    so the blocks are decoded with log_unpack() (or any LZ4 decoder not relying on the end rules).
+
+    Matches are found with a hash table of the last position of every 4-byte sequence,
+    which costs one lookup per input byte not covered by a match. A match is only
+    searched within the records added so far, bytes at the end of a record are matched
+    when the next one arrives.
+*/
+class LogCompressor
+{
+
+public:
+
+    LogCompressor();
+
+    // start a new block, the output is written behind the size at out[2]
+    void reset(uint8_t* out);
+
+    // true if a record of the given size can be added without overflowing the payload
+    // of the block, even if it cannot be compressed at all
+    bool fits(size_t size);
+
+    // compress a record, it must fit
+    void add(const uint8_t* record, size_t size);
+
+    // the number of payload bytes of the block with the records added so far
+    size_t size();
+
+    // the number of record bytes added to the block
+    size_t raw_size() { return m_raw_size; };
+
+    // write the remaining literals and the size, returns the number of payload bytes
+    size_t finish();
+
+    // statistics of all blocks since the last reset_statistics()
+    uint64_t raw_bytes() { return m_raw_bytes; };
+    uint64_t packed_bytes() { return m_packed_bytes; };
+    uint32_t packed_blocks() { return m_packed_blocks; };
+    void reset_statistics() { m_raw_bytes = 0; m_packed_bytes = 0; m_packed_blocks = 0; };
+
+private:
+
+    // the maximum number of payload bytes needed to finish the block with the given number of literals
+    size_t finish_size(size_t literals);
+
+    // write a sequence of the literals up to the given position and a match (if length > 0)
+    // returns false (and writes nothing) if it does not fit into the payload
+    bool emit(size_t end, size_t offset, size_t length);
+
+    // the records of the block
+    uint8_t         m_raw[LOG_PACK_RAW_SIZE];
+    size_t          m_raw_size;
+    // the last position + 1 of every hashed 4-byte sequence (0 for none)
+    uint16_t        m_hash[1 << LOG_PACK_HASH_BITS];
+    // the position up to which the input has been searched for matches
+    size_t          m_scan;
+    // the start of the literals not yet written
+    size_t          m_literals;
+    // the output (the payload of the block) and the number of bytes written
+    uint8_t*        m_out;
+    size_t          m_out_size;
+    // statistics
+    uint64_t        m_raw_bytes;
+    uint64_t        m_packed_bytes;
+    uint32_t        m_packed_blocks;
+
+};
+
+// decode the payload of a packed block into the records
+// returns the number of record bytes, 0 if the payload is malformed or does not fit into the output
+size_t log_unpack(const uint8_t* payload, size_t size, uint8_t* out, size_t capacity);
+
+/*
+    This assembles the blocks of a log file from records.
+
+    The blocks are built in a small number of buffers. Complete blocks
+    are handed out with ready() in the order of their sequence numbers,
+    the caller writes them to the file (in any number of pieces) and
+    returns the buffer with release(). The index blocks are inserted
+    automatically.
+
+    If a compressor is given the data blocks are packed (see LogCompressor),
+    a block is completed when the next record could not be stored in it
+    even uncompressed.
+
+    No memory is allocated, nothing in here ever waits.
+*/
+class LogBlockWriter
+{
+
+public:
+
+    LogBlockWriter();
+
+    // start a new file, the head block with the schema is the first block ready to be written
+    // time is the creation time [us]
+    // returns false if the schema does not fit into the head block
+    bool begin(uint32_t run, const char* schema, uint64_t time);
+
+    // compress the data blocks, NULL to store them as they are
+    // this has to be set before begin(), the compressor is owned by the caller
+    void set_compressor(LogCompressor* compressor) { m_compressor = compressor; };
+
+    // append a record, time is its acquisition time [us]
+    // returns false if there is no free buffer (the blocks are not written fast enough)
+    // or the record is larger than a block
+    bool add(const void* record, size_t size, uint64_t time);
+
+    // complete the data block being filled, so it can be written
+    void finish();
+
+    // the next complete block to be written (LOG_BLOCK_SIZE bytes), NULL if there is none
+    const uint8_t* ready();
+
+    // the block returned by ready() has been written, its buffer can be re-used
+    void release();
+
+    // the number of blocks started so far (including the head and index blocks)
+    uint32_t blocks() { return m_sequence; };
+
+    // the identifier of the file (see LogHeadInfo)
+    uint32_t file_id() { return m_file_id; };
+
+private:
+
+    // get a free buffer, -1 if there is none
+    int acquire();
+
+    // start a block of the given type in a buffer
+    void start(int buffer, uint16_t type);
+
+    // compute the CRC of the current block and queue it for writing
+    void complete();
+
+    // build the index block of the last LOG_INDEX_INTERVAL data blocks
+    bool add_index();
+
+    LogBlockHeader* header(int buffer) { return (LogBlockHeader*)m_buffer[buffer]; };
+    uint8_t* payload(int buffer) { return m_buffer[buffer]+sizeof(LogBlockHeader); };
+
+    uint8_t         m_buffer[LOG_WRITER_BUFFERS][LOG_BLOCK_SIZE] __attribute__((aligned(8)));
+    // the buffer is being filled or waits to be written
+    bool            m_used[LOG_WRITER_BUFFERS];
+    // the buffers ready to be written in the order of their sequence numbers
+    int             m_queue[LOG_WRITER_BUFFERS];
+    int             m_queue_head;
+    int             m_queue_count;
+    // the buffer of the data block being filled, -1 if there is none
+    int             m_current;
+    // the sequence number of the next block started
+    uint32_t        m_sequence;
+    uint32_t        m_file_id;
+    // the compressor of the data blocks, NULL if they are not packed
+    LogCompressor*  m_compressor;
+    // the data blocks completed since the last index block
+    LogIndexEntry   m_index[LOG_INDEX_INTERVAL];
+    int             m_index_count;
+
+};
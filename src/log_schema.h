@@ -0,0 +1,52 @@
+// generated by tools/gen_log_schema.py from src/types.h - do not edit
+
+#pragma once
+
+#include <cstddef>
+
+#include "types.h"
+
+// the schema of all records, stored in the head block of every log file
+// record <signature> <name> <size>
+// field <name> <type> <offset> <unit>
+#define LOG_SCHEMA_TEXT \
+    "taros-schema 1\n" \
+    "record 0xa0 DATA_IMU_AHRS 20\n" \
+    "field time u64 0 us\n" \
+    "field attitude f32 8 deg\n" \
+    "field heading f32 12 deg\n" \
+    "field roll f32 16 deg\n" \
+    "record 0xa1 DATA_IMU_GYRO 20\n" \
+    "field time u64 0 us\n" \
+    "field nick f32 8 deg/s\n" \
+    "field yaw f32 12 deg/s\n" \
+    "field roll f32 16 deg/s\n" \
+    ""
+
+// X(name, signature, size) for all record types
+#define LOG_RECORD_TABLE(X) \
+    X(DATA_IMU_AHRS, 0xa0, 20) \
+    X(DATA_IMU_GYRO, 0xa1, 20)
+
+// the size of a record (without the signature), 0 for an unknown signature
+inline size_t log_record_size(uint8_t signature)
+{
+    switch (signature)
+    {
+        case DATA_IMU_AHRS_SIGNATURE: return 20;
+        case DATA_IMU_GYRO_SIGNATURE: return 20;
+        default: return 0;
+    };
+}
+
+// the layout given in the schema must be the one of the compiler
+static_assert(offsetof(DATA_IMU_AHRS, time) == 0, "log schema out of date, run tools/gen_log_schema.py");
+static_assert(offsetof(DATA_IMU_AHRS, attitude) == 8, "log schema out of date, run tools/gen_log_schema.py");
+static_assert(offsetof(DATA_IMU_AHRS, heading) == 12, "log schema out of date, run tools/gen_log_schema.py");
+static_assert(offsetof(DATA_IMU_AHRS, roll) == 16, "log schema out of date, run tools/gen_log_schema.py");
+static_assert(sizeof(DATA_IMU_AHRS) >= 20, "log schema out of date, run tools/gen_log_schema.py");
+static_assert(offsetof(DATA_IMU_GYRO, time) == 0, "log schema out of date, run tools/gen_log_schema.py");
+static_assert(offsetof(DATA_IMU_GYRO, nick) == 8, "log schema out of date, run tools/gen_log_schema.py");
+static_assert(offsetof(DATA_IMU_GYRO, yaw) == 12, "log schema out of date, run tools/gen_log_schema.py");
+static_assert(offsetof(DATA_IMU_GYRO, roll) == 16, "log schema out of date, run tools/gen_log_schema.py");
+static_assert(sizeof(DATA_IMU_GYRO) >= 20, "log schema out of date, run tools/gen_log_schema.py");
@@ -1,14 +1,43 @@
 #include <cstdio>
 
+// this is needed to have ARM_DWT_CYCCNT
+#include "../core/core_pins.h"
+
 #include "global.h"
 #include "logger.h"
 #include "message.h"
+#include "log_format.h"
 
 Logger::Logger(std::string name) : Module(name)
 {
     runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
     // open the connection
     flag_message_pending = false;
+    flag_summary_due = false;
+    // by default all messages are forwarded
+    num_sources = 0;
+    default_threshold = 255;
+    default_rate = LOGGER_DEFAULT_RATE;
+    default_burst = LOGGER_DEFAULT_BURST;
+    for (int i=0; i<LOGGER_NUM_SINKS; i++)
+        sink_threshold[i] = 255;
+    last_summary_check = FC_time_now();
+    flag_metrics_due = false;
+    run_pending = false;
+    degraded = false;
+    degraded_since = 0;
+    degraded_dropped = 0;
+    last_metrics = FC_time_now();
+    messages_drained = 0;
+    backlog_max = 0;
+    tm_backlog = 0;
+    tm_drain = 0;
+}
+
+void Logger::declare_telemetry(TelemetryDictionary* dict)
+{
+    tm_backlog = dict->declare(id, "BACKLOG", MSG_TYPE_DATA_INT16, "msg");
+    tm_drain = dict->declare(id, "DRAIN", MSG_TYPE_DATA_FLOAT, "msg/s");
 }
 
 void Logger::interrupt()
@@ -16,25 +45,260 @@ void Logger::interrupt()
     // if there is something received in one of the input ports
     // we have to handle it
     if (in.count()>0) flag_message_pending = true;
-    if (flag_message_pending)
-    	schedule_task(this, std::bind(&Logger::run, this));
+    if (FC_elapsed_millis(last_summary_check) >= LOGGER_SUMMARY_INTERVAL) flag_summary_due = true;
+    if (FC_elapsed_millis(last_metrics) >= LOGGER_METRICS_INTERVAL) flag_metrics_due = true;
+    // only one run is scheduled at a time, every run uses up to LOGGER_CYCLE_BUDGET
+    // (several queued runs would execute back-to-back when the task loop is behind)
+    if ((not run_pending) and (flag_message_pending or flag_summary_due or flag_metrics_due))
+    {
+        run_pending = true;
+        schedule_task(this, std::bind(&Logger::run, this));
+    };
 }
 
 void Logger::run()
 {
+    uint32_t start = ARM_DWT_CYCCNT;
 
     while (flag_message_pending)
     {
         Message msg = in.fetch();
-        // write out
+        uint16_t backlog = in.count();
+        flag_message_pending = (backlog>0);
+        messages_drained++;
+        if (backlog > backlog_max) backlog_max = backlog;
+        check_backlog(backlog);
+        // the recorder gets everything, even in the degraded mode
+        recorder_out.transmit(msg);
+        if ((msg.type()==MSG_TYPE_SYSTEM) or (msg.type()==MSG_TYPE_SYSTEM_TEMPLATE))
+        {
+            // the severity is the first item of both system message types
+            // it is checked before anything is formatted
+            uint8_t level = 255;
+            if (msg.size() > 0) level = *(uint8_t*)msg.get_data();
+            if (degraded and (level > MSG_LEVEL_CRITICAL))
+                degraded_dropped++;
+            else if (filter(msg, level))
+                forward(msg, level);
+        }
+        else if (degraded)
+            degraded_dropped++;
+        else
+        {
+            // write out
+            message_out.transmit(msg);
+            // the text is only rendered for sinks that really need it
+            if (text_out.count_receivers() > 0)
+                text_out.transmit(msg.as_text());
+        };
+        // the remaining messages are handled with the next task
+        if (ARM_DWT_CYCCNT - start > LOGGER_CYCLE_BUDGET) break;
+    };
+    if (flag_metrics_due)
+    {
+        flag_metrics_due = false;
+        send_metrics();
+    };
+    if (flag_summary_due)
+    {
+        flag_summary_due = false;
+        last_summary_check = FC_time_now();
+        for (int i=0; i<num_sources; i++)
+        {
+            report_repeats(&sources[i]);
+            report_limited(&sources[i]);
+        };
+    };
+    run_pending = false;
+}
+
+// a key identifying the content of a system message apart from its time
+static uint32_t message_key(Message &msg)
+{
+    const uint8_t* data = (const uint8_t*)msg.get_data();
+    if (msg.type() == MSG_TYPE_SYSTEM)
+    {
+        size_t n = sizeof(MSG_DATA_SYSTEM);
+        if (msg.size() < n) return 0;
+        return crc32(data + n, msg.size() - n, MSG_TYPE_SYSTEM);
+    }
+    else
+    {
+        size_t n = sizeof(MSG_DATA_SYSTEM_TEMPLATE);
+        if (msg.size() < n) return 0;
+        const MSG_DATA_SYSTEM_TEMPLATE* d = (const MSG_DATA_SYSTEM_TEMPLATE*)data;
+        return crc32(data + n, msg.size() - n, ((uint32_t)MSG_TYPE_SYSTEM_TEMPLATE << 16) | d->template_id);
+    };
+}
+
+bool Logger::filter(Message &msg, uint8_t level)
+{
+    LoggerSource* src = source(msg.sender());
+    if (level > src->threshold) return false;
+    uint32_t key = message_key(msg);
+    if (level > LOGGER_LEVEL_ALWAYS)
+    {
+        // the same message again is only counted
+        if ((key == src->last_key) and (level == src->last_level))
+        {
+            src->repeats++;
+            return false;
+        };
+        if (src->rate > 0)
+        {
+            // refill the bucket with the time elapsed
+            uint32_t now = FC_time_now();
+            uint32_t elapsed = now - src->last_refill;
+            uint32_t capacity = 1000 * (uint32_t)src->burst;
+            src->last_refill = now;
+            if (elapsed >= capacity)
+                src->tokens = capacity;
+            else
+                src->tokens += elapsed * src->rate;
+            if (src->tokens > capacity) src->tokens = capacity;
+            if (src->tokens < 1000)
+            {
+                src->limited++;
+                return false;
+            };
+            src->tokens -= 1000;
+        };
+    };
+    // a different message ends a series of repetitions
+    report_repeats(src);
+    src->last_key = key;
+    src->last_level = level;
+    return true;
+}
+
+void Logger::report_repeats(LoggerSource* src)
+{
+    if (src->repeats == 0) return;
+    Message msg = Message::SystemTemplate(src->id, FC_time_now(), src->last_level,
+        TPL_LOG_REPEATED, src->repeats);
+    report(msg, src->last_level);
+    src->repeats = 0;
+}
+
+void Logger::report_limited(LoggerSource* src)
+{
+    if (src->limited == 0) return;
+    Message msg = Message::SystemTemplate(src->id, FC_time_now(), MSG_LEVEL_WARNING,
+        TPL_LOG_LIMITED, src->limited);
+    report(msg, MSG_LEVEL_WARNING);
+    src->limited = 0;
+}
+
+void Logger::check_backlog(uint16_t backlog)
+{
+    if (not degraded and (backlog > LOGGER_BACKLOG_DEGRADED))
+    {
+        degraded = true;
+        degraded_since = FC_time_now();
+        degraded_dropped = 0;
+        Message msg = Message::SystemTemplate(id, degraded_since, MSG_LEVEL_CRITICAL,
+            TPL_LOG_DEGRADED, (uint32_t)backlog);
+        report(msg, MSG_LEVEL_CRITICAL);
+    }
+    else if (degraded and (backlog < LOGGER_BACKLOG_RECOVER))
+    {
+        degraded = false;
+        Message msg = Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_WARNING,
+            TPL_LOG_RECOVERED, FC_elapsed_millis(degraded_since), degraded_dropped);
+        report(msg, MSG_LEVEL_WARNING);
+    };
+}
+
+void Logger::send_metrics()
+{
+    uint32_t now = FC_time_now();
+    uint32_t elapsed = now - last_metrics;
+    float drain = 0.0;
+    if (elapsed > 0) drain = 1000.0 * messages_drained / elapsed;
+    int16_t backlog = (backlog_max > 32767) ? 32767 : backlog_max;
+    if (tm_backlog != 0)
+        tm_out.transmit(Message::DataInt16(id, tm_backlog, now, backlog));
+    if (tm_drain != 0)
+        tm_out.transmit(Message::DataFloat(id, tm_drain, now, drain));
+    last_metrics = now;
+    messages_drained = 0;
+    backlog_max = 0;
+}
+
+void Logger::forward(Message &msg, uint8_t level)
+{
+    if (level <= sink_threshold[LOGGER_SINK_MESSAGE])
+        message_out.transmit(msg);
+    // the text is only rendered for sinks that really need it
+    if ((level <= sink_threshold[LOGGER_SINK_TEXT]) and (text_out.count_receivers() > 0))
         text_out.transmit(msg.as_text());
-        flag_message_pending = (in.count()>0);
-        // system messages are also sent via the system_out port
-        if (msg.type()==MSG_TYPE_SYSTEM)
+    if (level <= sink_threshold[LOGGER_SINK_SYSTEM])
+        system_out.transmit(msg);
+}
+
+void Logger::report(Message &msg, uint8_t level)
+{
+    recorder_out.transmit(msg);
+    forward(msg, level);
+}
+
+LoggerSource* Logger::source(const std::string &module)
+{
+    for (int i=0; i<num_sources; i++)
+        if (sources[i].id == module) return &sources[i];
+    // all further modules share the last entry
+    if (num_sources >= LOGGER_MAX_SOURCES) return &sources[LOGGER_MAX_SOURCES-1];
+    LoggerSource* src = &sources[num_sources++];
+    src->id = module;
+    src->threshold = default_threshold;
+    src->rate = default_rate;
+    src->burst = default_burst;
+    src->tokens = 1000 * (uint32_t)default_burst;
+    src->last_refill = FC_time_now();
+    src->last_key = 0;
+    src->last_level = 0;
+    src->repeats = 0;
+    src->limited = 0;
+    return src;
+}
+
+void Logger::set_level(std::string module, uint8_t level)
+{
+    if (module.empty())
+    {
+        default_threshold = level;
+        for (int i=0; i<num_sources; i++)
+            sources[i].threshold = level;
+    }
+    else
+        source(module)->threshold = level;
+}
+
+bool Logger::set_sink_level(int sink, uint8_t level)
+{
+    if ((sink < 0) or (sink >= LOGGER_NUM_SINKS)) return false;
+    sink_threshold[sink] = level;
+    return true;
+}
+
+void Logger::set_rate(std::string module, uint8_t rate, uint8_t burst)
+{
+    if (module.empty())
+    {
+        default_rate = rate;
+        default_burst = burst;
+        for (int i=0; i<num_sources; i++)
         {
-            system_out.transmit(msg);
+            sources[i].rate = rate;
+            sources[i].burst = burst;
         };
     }
+    else
+    {
+        LoggerSource* src = source(module);
+        src->rate = rate;
+        src->burst = burst;
+    };
 }
 
 Requester::Requester(std::string name, float rate) : Module(name)
@@ -8,15 +8,92 @@
 #include "module.h"
 #include "message.h"
 #include "port.h"
+#include "telemetry.h"
+
+// the output ports of the logger which can be given a severity threshold
+#define LOGGER_SINK_MESSAGE     0       // message_out (the log file)
+#define LOGGER_SINK_TEXT        1       // text_out
+#define LOGGER_SINK_SYSTEM      2       // system_out (the downlink)
+#define LOGGER_NUM_SINKS        3
+
+// the number of modules for which the system messages are filtered individually
+// all further modules share the last entry
+#define LOGGER_MAX_SOURCES      24
+
+// the default rate limit of every module [messages/s] and the burst allowed
+#define LOGGER_DEFAULT_RATE     20
+#define LOGGER_DEFAULT_BURST    50
+
+// the interval in which summaries of suppressed messages are sent [ms]
+#define LOGGER_SUMMARY_INTERVAL 5000
+
+// messages of this severity or higher (lower level) are never suppressed
+#define LOGGER_LEVEL_ALWAYS     MSG_LEVEL_MILESTONE
+
+// the CPU cycles one call of Logger::run() may use (100 us at 600 MHz)
+// at least one message is handled with every call
+#define LOGGER_CYCLE_BUDGET     60000
+
+// with more messages waiting the logger only passes critical messages
+// until the backlog has been reduced below the lower limit
+#define LOGGER_BACKLOG_DEGRADED 256
+#define LOGGER_BACKLOG_RECOVER  32
+
+// the interval in which the metrics of the logger are sent [ms]
+#define LOGGER_METRICS_INTERVAL 1000
+
+// the filter state of one module sending system messages
+struct LoggerSource {
+    std::string id;
+    // messages with a higher level are dropped
+    uint8_t     threshold;
+    // the rate limit [messages/s], 0 is unlimited, and the burst allowed
+    uint8_t     rate;
+    uint8_t     burst;
+    // the token bucket [1/1000 messages]
+    uint32_t    tokens;
+    uint32_t    last_refill;
+    // the last message forwarded and how often it has been repeated since
+    uint32_t    last_key;
+    uint8_t     last_level;
+    uint32_t    repeats;
+    // the messages dropped by the rate limit
+    uint32_t    limited;
+};
 
 /* 
-    The logger receives a number of possible messages, serializes
-    them and sends them as text messages to a number of receivers.
+    The logger receives a number of possible messages and forwards
+    them unchanged to a number of receivers (e.g. the log file).
+    Only if there are receivers for text they are serialized
+    and sent as text messages, formatting costs a lot of CPU time.
     
     One instance of this class will be created right at system
     start (system_log) that will hold all system messages until
     the taskmanagement is running and these messages can be written
     to a downlink an/or log-file.
+
+    System messages are filtered before anything is formatted :
+    - every module has a severity threshold, messages with a higher level are dropped
+    - every module has a rate limit (token bucket), the messages exceeding it
+      are dropped and counted
+    - a message identical to the previous one of the same module (apart from the time)
+      is counted instead of being forwarded
+    The numbers of dropped messages are reported in summaries (TPL_LOG_REPEATED, TPL_LOG_LIMITED)
+    sent in the name of the module, at the latest after LOGGER_SUMMARY_INTERVAL.
+    Messages of level LOGGER_LEVEL_ALWAYS or more severe are never rate limited or merged.
+    Every sink has a severity threshold of its own in addition.
+    All settings can be changed at runtime (uplink commands, see Commander).
+    Other messages than system messages are forwarded unfiltered.
+    The recorder_out port gets every message received (and the reports of the logger)
+    ahead of all filters, none of the settings above affects it.
+
+    Every call of run() ends when LOGGER_CYCLE_BUDGET is used up,
+    the remaining messages are handled with the following systicks.
+    If the backlog grows beyond LOGGER_BACKLOG_DEGRADED anyway the logger
+    switches to a degraded mode, where only messages of level MSG_LEVEL_CRITICAL
+    or more severe are passed, until the backlog is below LOGGER_BACKLOG_RECOVER.
+    The maximum backlog and the rate of messages handled are sent
+    as telemetry variables (BACKLOG, DRAIN) every LOGGER_METRICS_INTERVAL.
 */
 class Logger : public Module
 {
@@ -28,6 +105,10 @@ public:
     
     // nothing to do
     virtual void setup() { runlevel_ = MODULE_RUNLEVEL_OPERATIONAL; };
+
+    // declare the metrics of the logger as telemetry variables
+    // without that no metrics are sent
+    void declare_telemetry(TelemetryDictionary* dict);
     
     virtual void interrupt();
     
@@ -41,16 +122,90 @@ public:
     // port at which arbitrary messages are received
     ReceiverPort in;
 
+    // port over which all messages are sent as they are
+    SenderPort message_out;
+
     // port over which all messages are sent as text messages
+    // (only formatted if there is a receiver connected)
     SenderPort text_out;
 
     // filtered port for system messages only
     SenderPort system_out;
+
+    // port over which the metrics are sent as telemetry
+    SenderPort tm_out;
+
+    // port over which all messages are sent as they are received, before any filtering
+    // (for the flight recorder, which must see every possible trigger)
+    SenderPort recorder_out;
+
+    // set the severity threshold of a module, an empty id sets all modules
+    // a module that has not sent any message yet is registered
+    void set_level(std::string module, uint8_t level);
+
+    // set the severity threshold of a sink (LOGGER_SINK_...)
+    bool set_sink_level(int sink, uint8_t level);
+
+    // set the rate limit of a module [messages/s] (0 for unlimited), an empty id sets all modules
+    void set_rate(std::string module, uint8_t rate, uint8_t burst);
     
 private:
 
+    // find the filter state of a module, a new one is created if the module is not known yet
+    LoggerSource* source(const std::string &module);
+
+    // decide whether a system message is forwarded, update the filter state
+    bool filter(Message &msg, uint8_t level);
+
+    // send the summaries of the suppressed messages of a module if there are any
+    void report_repeats(LoggerSource* src);
+    void report_limited(LoggerSource* src);
+
+    // send a message to all sinks with a threshold not below its level
+    void forward(Message &msg, uint8_t level);
+
+    // send a message created by the logger itself to the recorder and the sinks
+    void report(Message &msg, uint8_t level);
+
+    // enter or leave the degraded mode depending on the backlog
+    void check_backlog(uint16_t backlog);
+
+    // send the metrics of the last interval
+    void send_metrics();
+
     // here are some flags indicating which work is due
     bool  flag_message_pending;
+    bool  flag_summary_due;
+    bool  flag_metrics_due;
+    // a run has been scheduled but not yet executed
+    volatile bool run_pending;
+
+    // the filter state of all modules known
+    LoggerSource sources[LOGGER_MAX_SOURCES];
+    int num_sources;
+    // the settings given to new modules
+    uint8_t default_threshold;
+    uint8_t default_rate;
+    uint8_t default_burst;
+
+    // the severity thresholds of the sinks
+    uint8_t sink_threshold[LOGGER_NUM_SINKS];
+
+    // the time the summaries were last checked
+    uint32_t last_summary_check;
+
+    // the degraded mode with the time it was entered and the messages dropped since
+    bool degraded;
+    uint32_t degraded_since;
+    uint32_t degraded_dropped;
+
+    // the metrics of the current interval
+    uint32_t last_metrics;
+    uint32_t messages_drained;
+    uint16_t backlog_max;
+    // the hashes of the telemetry variables, 0 if not declared
+    uint16_t tm_backlog;
+    uint16_t tm_drain;
 
 };
 
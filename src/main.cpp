@@ -15,6 +15,15 @@
 #include "module.h"
 #include "message.h"
 #include "system.h"
+#include "run_files.h"
+#ifdef USE_LITTLEFS
+#include "storage_lfs.h"
+#else
+#include "storage_fat.h"
+#endif
+#ifdef STORAGE_BENCHMARK
+#include "storage_bench.h"
+#endif
 
 #ifndef VERSION_MAJOR
 #define VERSION_MAJOR 0
@@ -36,7 +45,8 @@ usb_serial_class usb_serial_debug;
 #endif
 
 bool SD_card_OK;
-int SD_file_No;
+Storage* storage = NULL;
+int SD_file_No = -1;
 Logger *system_log;
 FileWriter* system_log_file_writer = 0;
 
@@ -71,28 +81,83 @@ extern "C" int main(void)
     
     // we initialize the SD card here as some modules may want to read or
     // write data during setup
-    SD_card_OK = SD.begin(BUILTIN_SDCARD);
+#ifdef USE_LITTLEFS
+    // the card is not formatted automatically, that would destroy a FAT card
+    LfsSdCard* card = new LfsSdCard();
+    if (card->begin())
+    {
+        LfsStorage* lfs = new LfsStorage(card);
+        if (lfs->begin(false))
+            storage = lfs;
+        else
+            delete lfs;
+    };
+#else
+    if (SD.begin(BUILTIN_SDCARD))
+        storage = new FatStorage();
+#endif
+    SD_card_OK = (storage != NULL);
     if (SD_card_OK)
     {
         system_log->in.receive(
-            Message::SystemMessage("SYSTEM", FC_time_now(), MSG_LEVEL_MILESTONE, "found SD card.") );
-        // search through the files to determine the run number
-        SD_file_No = 0;
-        char syslog_filename[40];
-        sprintf(syslog_filename, "taros.%05d.system.log", SD_file_No);
-        while (SD.open(syslog_filename, FILE_READ))
+            Message::SystemMessage("SYSTEM", FC_time_now(), MSG_LEVEL_MILESTONE,
+                std::string("found SD card (") + storage->name() + ").") );
+        // the run number is taken from the counter file and a directory for the run is created
+        SD_file_No = FC_start_run();
+    };
+    if (SD_card_OK and (SD_file_No >= 0))
+    {
+        std::stringstream run;
+        run << "run " << SD_file_No;
+        system_log->in.receive(
+            Message::SystemMessage("SYSTEM", FC_time_now(), MSG_LEVEL_MILESTONE, run.str()) );
+#ifdef STORAGE_BENCHMARK
+        // measure the storage before the log files are created
+        StorageBenchResult bench;
+        if (storage_benchmark(storage, FC_run_file("bench.dat").c_str(), micros, bench))
+            system_log->in.receive(
+                Message::SystemTemplate("SYSTEM", FC_time_now(), MSG_LEVEL_STATUSREPORT, TPL_STORAGE_BENCH,
+                    storage->name(), bench.append_mean, bench.append_max,
+                    bench.throughput, bench.sync_mean, bench.sync_max) );
+        else
+            system_log->in.receive(
+                Message::SystemMessage("SYSTEM", FC_time_now(), MSG_LEVEL_ERROR, "storage benchmark failed.") );
+#endif
+        // all log files of the run are created and preallocated in one go
+        system_log_file_writer = new FileWriter("SYSLOGF", FC_run_file("system.log"));
+        system_log_file_writer->setup();
+        if (system_log_file_writer->state() >= MODULE_RUNLEVEL_SETUP_OK)
         {
-            // file already exists, use next number
-            SD_file_No++;
-            sprintf(syslog_filename, "taros.%05d.system.log", SD_file_No);
+            module_list.push_back(system_log_file_writer);
+            // wire the syslog output to the file, the messages are stored unformatted
+            system_log->message_out.set_receiver(&(system_log_file_writer->in));
         };
-        // create a file writer
-        system_log_file_writer = new FileWriter("SYSLOGF",std::string(syslog_filename));
-        system_log_file_writer->setup();
-        // TODO: what if a problem occurs ?
-        // module_list.push_back(system_log_file_writer);
-        // wire the syslog output to the file
-        // system_log->text_out.set_receiver(&(system_log_file_writer->in));
+        // the logfile writer for streaming data, it is wired in FC_build_system()
+        fast_log_file_writer = new StreamFileWriter("FASTLOG", FC_run_file("fast.log"));
+        fast_log_file_writer->setup();
+        if (fast_log_file_writer->state() >= MODULE_RUNLEVEL_SETUP_OK)
+            module_list.push_back(fast_log_file_writer);
+        // the flight recorder only creates a file when an event has been recorded
+        // it gets all messages of the system log ahead of the filters of the logger,
+        // the streams are wired in FC_build_system()
+        flight_recorder = new FlightRecorder("FLTREC");
+        flight_recorder->setup();
+        if (flight_recorder->state() >= MODULE_RUNLEVEL_SETUP_OK)
+        {
+            module_list.push_back(flight_recorder);
+            system_log->recorder_out.set_receiver(&(flight_recorder->in));
+        }
+        else
+        {
+            // without a ring buffer there is nothing to record (and nothing to trigger)
+            delete flight_recorder;
+            flight_recorder = 0;
+        };
+    }
+    else if (SD_card_OK)
+    {
+        system_log->in.receive(
+            Message::SystemMessage("SYSTEM", FC_time_now(), MSG_LEVEL_ERROR, "run directory not created.") );
     }
     else
     {
@@ -1,9 +1,9 @@
 #include "message.h"
+#include "types.h"
 #include <cstdio>
 #include <cstdlib> // for C-style memory handling
 #include <cstring> // for std::memcpy
 // include <iostream> // for std::cout during debugging
-#include <Arduino.h> // for USB during debugging
 
 Message::Message(
     std::string sender_module,
@@ -15,6 +15,7 @@ Message::Message(
     m_sender_module = sender_module;
     m_type = msg_type;
     m_size = msg_size;
+    m_time = 0;
     // std::cout << " size=" << m_size << std::endl;
     if (m_size>0)
     {
@@ -31,6 +32,7 @@ Message::Message(const Message& other)
     m_sender_module = other.m_sender_module;
     m_type = other.m_type;
     m_size = other.m_size;
+    m_time = other.m_time;
     // std::cout << " size=" << m_size << std::endl;
     if (m_size>0)
     {
@@ -46,11 +48,12 @@ Message& Message::operator=(const Message& other)
     // protct against invalid self-assignment
     if (this != &other)
     {
+        // free the old memory
+        if (m_size>0) free(m_data);
         m_sender_module = other.m_sender_module;
         m_type = other.m_type;
         m_size = other.m_size;
-        // free the old memory
-        if (m_size>0) free(m_data);
+        m_time = other.m_time;
         // copy the new data
         if (other.m_size>0)
         {
@@ -63,10 +66,176 @@ Message& Message::operator=(const Message& other)
     return *this;
 }
 
-Message::Message(char* buffer)
+Message::Message(const char* buffer, size_t size) :
+    Message(MessageView(buffer, size))
 {
 }
 
+Message::Message(MessageView view)
+{
+    // start with an empty message, so the assignments below don't free anything
+    m_type = MSG_TYPE_ABSTRACT;
+    m_size = 0;
+    m_data = NULL;
+    m_time = 0;
+    if (!view.valid()) return;
+    m_sender_module = view.sender();
+    const char* body = view.body();
+    uint8_t n = view.body_size();
+    switch (view.type())
+    {
+        case MSG_TYPE_SYSTEM:
+        {
+            uint8_t level = body[0];
+            uint32_t time;
+            std::memcpy(&time, body+1, 4);
+            *this = SystemMessage(m_sender_module, time, level, std::string(body+5, n-5));
+            break;
+        };
+        case MSG_TYPE_TEXT:
+        {
+            *this = TextMessage(m_sender_module, std::string(body, n));
+            break;
+        };
+        case MSG_TYPE_SYSTEM_TEMPLATE:
+        {
+            uint8_t level = body[0];
+            uint32_t time;
+            uint16_t template_id;
+            std::memcpy(&time, body+1, 4);
+            std::memcpy(&template_id, body+5, 2);
+            *this = SystemTemplate(m_sender_module, time, level, template_id, body+7, (uint8_t)(n-7));
+            break;
+        };
+        case MSG_TYPE_TELEMETRY:
+        {
+            uint32_t time;
+            std::memcpy(&time, body, 4);
+            uint8_t var_count = body[4];
+            *this = TelemetryMessage(m_sender_module, time,
+                std::string(body+5, var_count),
+                std::string(body+5+var_count, n-5-var_count));
+            break;
+        };
+        case MSG_TYPE_GPS_POSITION:
+        {
+            MSG_DATA_GPS_POSITION data;
+            std::memcpy(&data.latitude, body, 8);
+            std::memcpy(&data.longitude, body+8, 8);
+            std::memcpy(&data.altitude, body+16, 4);
+            *this = Message(m_sender_module, MSG_TYPE_GPS_POSITION, sizeof(data), &data);
+            break;
+        };
+        case MSG_TYPE_SERVO:
+        {
+            MSG_DATA_SERVO data;
+            std::memcpy(data.pos, body, 2*NUM_SERVO_CHANNELS);
+            *this = Message(m_sender_module, MSG_TYPE_SERVO, sizeof(data), &data);
+            break;
+        };
+        case MSG_TYPE_IMU_AHRS:
+        {
+            DATA_IMU_AHRS data;
+            std::memcpy(&data.time, body, 8);
+            std::memcpy(&data.attitude, body+8, 4);
+            std::memcpy(&data.heading, body+12, 4);
+            std::memcpy(&data.roll, body+16, 4);
+            *this = Message(m_sender_module, MSG_TYPE_IMU_AHRS, sizeof(data), &data);
+            m_time = data.time;
+            break;
+        };
+        case MSG_TYPE_IMU_GYRO:
+        {
+            DATA_IMU_GYRO data;
+            std::memcpy(&data.time, body, 8);
+            std::memcpy(&data.nick, body+8, 4);
+            std::memcpy(&data.yaw, body+12, 4);
+            std::memcpy(&data.roll, body+16, 4);
+            *this = Message(m_sender_module, MSG_TYPE_IMU_GYRO, sizeof(data), &data);
+            m_time = data.time;
+            break;
+        };
+        case MSG_TYPE_TM_VARIABLE:
+        {
+            uint16_t hash, data_type;
+            std::memcpy(&hash, body, 2);
+            std::memcpy(&data_type, body+2, 2);
+            uint8_t var_count = body[4];
+            *this = TelemetryVariable(m_sender_module, hash, data_type,
+                std::string(body+5, var_count),
+                std::string(body+5+var_count, n-5-var_count));
+            break;
+        };
+        case MSG_TYPE_DATA_INT16:
+        {
+            MSG_DATA_INT16 data;
+            std::memcpy(&data.hash, body, 2);
+            std::memcpy(&data.time, body+2, 4);
+            std::memcpy(&data.value, body+6, 2);
+            *this = Message(m_sender_module, MSG_TYPE_DATA_INT16, sizeof(data), &data);
+            break;
+        };
+        case MSG_TYPE_DATA_FLOAT:
+        {
+            MSG_DATA_FLOAT data;
+            std::memcpy(&data.hash, body, 2);
+            std::memcpy(&data.time, body+2, 4);
+            std::memcpy(&data.value, body+6, 4);
+            *this = Message(m_sender_module, MSG_TYPE_DATA_FLOAT, sizeof(data), &data);
+            break;
+        };
+        case MSG_TYPE_DATA_DOUBLE:
+        {
+            MSG_DATA_DOUBLE data;
+            std::memcpy(&data.hash, body, 2);
+            std::memcpy(&data.time, body+2, 4);
+            std::memcpy(&data.value, body+6, 8);
+            *this = Message(m_sender_module, MSG_TYPE_DATA_DOUBLE, sizeof(data), &data);
+            break;
+        };
+        case MSG_TYPE_DATA_GPS:
+        {
+            MSG_DATA_GPS data;
+            std::memcpy(&data.hash, body, 2);
+            std::memcpy(&data.time, body+2, 4);
+            std::memcpy(&data.latitude, body+6, 8);
+            std::memcpy(&data.longitude, body+14, 8);
+            std::memcpy(&data.altitude, body+22, 4);
+            *this = Message(m_sender_module, MSG_TYPE_DATA_GPS, sizeof(data), &data);
+            break;
+        };
+        default:
+        {
+            // the data blob as is
+            *this = Message(m_sender_module, view.type(), n, (void*)body);
+            break;
+        };
+    }
+    // the microsecond time is not encoded (but for the IMU types),
+    // the types with a millisecond time field at least get that back
+    if (m_time == 0)
+    {
+        uint32_t millis = 0;
+        switch (m_type)
+        {
+            case MSG_TYPE_SYSTEM:
+            case MSG_TYPE_SYSTEM_TEMPLATE:
+                std::memcpy(&millis, body+1, 4);
+                break;
+            case MSG_TYPE_TELEMETRY:
+                std::memcpy(&millis, body, 4);
+                break;
+            case MSG_TYPE_DATA_INT16:
+            case MSG_TYPE_DATA_FLOAT:
+            case MSG_TYPE_DATA_DOUBLE:
+            case MSG_TYPE_DATA_GPS:
+                std::memcpy(&millis, body+2, 4);
+                break;
+        };
+        m_time = (uint64_t)millis * 1000;
+    };
+}
+
 Message Message::TextMessage(
     std::string sender_module,
     std::string text)
@@ -119,6 +288,41 @@ Message Message::SystemMessage(
     return msg;
 };
 
+Message Message::SystemTemplate(
+    std::string sender_module,
+    uint32_t    time,
+    uint8_t     severity_level,
+    uint16_t    template_id,
+    const char* args,
+    uint8_t     args_size)
+{
+    Message msg = Message(sender_module, MSG_TYPE_SYSTEM_TEMPLATE, 0, NULL);
+    msg.m_size = sizeof(MSG_DATA_SYSTEM_TEMPLATE) + args_size;
+    msg.m_data = malloc(msg.m_size);
+    MSG_DATA_SYSTEM_TEMPLATE *d = (MSG_DATA_SYSTEM_TEMPLATE *)msg.m_data;
+    d->severity_level = severity_level;
+    d->time = time;
+    d->template_id = template_id;
+    d->args = args_size;
+    // the arguments follow the struct
+    if (args_size>0) std::memcpy(d+1, args, args_size);
+    return msg;
+}
+
+Message Message::CommandAck(
+    std::string sender_module,
+    uint16_t    sequence,
+    uint8_t     status,
+    uint8_t     rssi)
+{
+    MSG_DATA_COMMAND_ACK data;
+    data.sequence = sequence;
+    data.status = status;
+    data.rssi = rssi;
+    // the struct has no padding, it is transmitted as is
+    return Message(sender_module, MSG_TYPE_COMMAND_ACK, sizeof(data), &data);
+}
+
 Message Message::TelemetryMessage(
     std::string sender_module,
     uint32_t    time,
@@ -127,7 +331,7 @@ Message Message::TelemetryMessage(
 {
     Message msg = Message(sender_module, MSG_TYPE_TELEMETRY, 0, NULL);
     // std::cout << "MSG_TYPE_TELEMETRY constructor";
-    msg.m_size = sizeof(MSG_DATA_SYSTEM) + variable.size() + value.size();
+    msg.m_size = sizeof(MSG_DATA_TELEMETRY) + variable.size() + value.size();
     msg.m_data = malloc(msg.m_size);
     // std::cout << " size=" << m_size << std::endl;
     // pointer to the allocated memory
@@ -147,6 +351,79 @@ Message Message::TelemetryMessage(
     return msg;
 }
 
+Message Message::TelemetryVariable(
+    std::string sender_module,
+    uint16_t    hash,
+    uint16_t    data_type,
+    std::string variable,
+    std::string units)
+{
+    Message msg = Message(sender_module, MSG_TYPE_TM_VARIABLE, 0, NULL);
+    msg.m_size = sizeof(MSG_TELEMETRY_VARIABLE) + variable.size() + units.size();
+    msg.m_data = malloc(msg.m_size);
+    // pointer to the allocated memory
+    MSG_TELEMETRY_VARIABLE *d = (MSG_TELEMETRY_VARIABLE *)msg.m_data;
+    d->hash = hash;
+    d->data_type = data_type;
+    d->variable = variable.size();
+    d->units = units.size();
+    // both strings follow the struct
+    d++;
+    char *t = (char *)d;
+    for (size_t i=0; i<variable.size(); i++)
+        *t++ = variable[i];
+    for (size_t i=0; i<units.size(); i++)
+        *t++ = units[i];
+    return msg;
+}
+
+Message Message::DataInt16(
+    std::string sender_module,
+    uint16_t    hash,
+    uint32_t    time,
+    int16_t     value)
+{
+    MSG_DATA_INT16 data { .hash = hash, .time = time, .value = value };
+    return Message(sender_module, MSG_TYPE_DATA_INT16, sizeof(data), &data);
+}
+
+Message Message::DataFloat(
+    std::string sender_module,
+    uint16_t    hash,
+    uint32_t    time,
+    float       value)
+{
+    MSG_DATA_FLOAT data { .hash = hash, .time = time, .value = value };
+    return Message(sender_module, MSG_TYPE_DATA_FLOAT, sizeof(data), &data);
+}
+
+Message Message::DataDouble(
+    std::string sender_module,
+    uint16_t    hash,
+    uint32_t    time,
+    double      value)
+{
+    MSG_DATA_DOUBLE data { .hash = hash, .time = time, .value = value };
+    return Message(sender_module, MSG_TYPE_DATA_DOUBLE, sizeof(data), &data);
+}
+
+Message Message::DataGPS(
+    std::string sender_module,
+    uint16_t    hash,
+    uint32_t    time,
+    double      latitude,
+    double      longitude,
+    float       altitude)
+{
+    MSG_DATA_GPS data {
+        .hash = hash,
+        .time = time,
+        .latitude = latitude,
+        .longitude = longitude,
+        .altitude = altitude };
+    return Message(sender_module, MSG_TYPE_DATA_GPS, sizeof(data), &data);
+}
+
 Message::~Message()
 {
     // std::cout << "Message destructor ";
@@ -173,6 +450,8 @@ std::string Message::print_content()
     // std::cout << "Message::print_content() size=" << m_size << std::endl;
     // TODO: handle all other message types
     std::string ret("");
+    // the numbers are formatted with snprintf() which truncates but always terminates
+    // the buffers, values from a received message may be arbitrarily large
     switch (m_type)
         {
             case MSG_TYPE_ABSTRACT:
@@ -185,13 +464,13 @@ std::string Message::print_content()
                     MSG_DATA_SYSTEM *ptr = (MSG_DATA_SYSTEM *)m_data;
                     char buffer[12];
                     // time
-                    int n = snprintf(buffer, 11, "%10.3f", (double)(ptr->time)*0.001);
-                    ret += std::string(buffer,n);
+                    snprintf(buffer, sizeof(buffer), "%10.3f", (double)(ptr->time)*0.001);
+                    ret += buffer;
                     // separator
                     ret += std::string(" : ");
                     // severity level
-                    n = snprintf(buffer, 5, "%4d", ptr->severity_level);
-                    ret += std::string(buffer,n);
+                    snprintf(buffer, sizeof(buffer), "%4d", ptr->severity_level);
+                    ret += buffer;
                     // separator
                     ret += std::string(" : ");
                     // this is the number of characters in the text
@@ -205,6 +484,25 @@ std::string Message::print_content()
                         ret += *t++;
                     break;
                 };
+            case MSG_TYPE_SYSTEM_TEMPLATE:
+                {
+                    // the same format as a MSG_TYPE_SYSTEM message
+                    MSG_DATA_SYSTEM_TEMPLATE *ptr = (MSG_DATA_SYSTEM_TEMPLATE *)m_data;
+                    char buffer[12];
+                    // time
+                    snprintf(buffer, sizeof(buffer), "%10.3f", (double)(ptr->time)*0.001);
+                    ret += buffer;
+                    // separator
+                    ret += std::string(" : ");
+                    // severity level
+                    snprintf(buffer, sizeof(buffer), "%4d", ptr->severity_level);
+                    ret += buffer;
+                    // separator
+                    ret += std::string(" : ");
+                    // the text is formatted from the template
+                    ret += msg_template_format(ptr->template_id, (char *)(ptr+1), ptr->args);
+                    break;
+                };
             case MSG_TYPE_TEXT:
                 {
                     // std::cout << "MSG_TYPE_TEXT  header=" << sizeof(MSG_TYPE_TEXT);
@@ -224,8 +522,8 @@ std::string Message::print_content()
                     MSG_DATA_TELEMETRY *ptr = (MSG_DATA_TELEMETRY *)m_data;
                     char buffer[12];
                     // time
-                    int n = snprintf(buffer, 11, "%10.3f", (double)(ptr->time)*0.001);
-                    ret += std::string(buffer,n);
+                    snprintf(buffer, sizeof(buffer), "%10.3f", (double)(ptr->time)*0.001);
+                    ret += buffer;
                     // separator
                     ret += std::string(" : ");
                     // size of the text fields
@@ -252,17 +550,70 @@ std::string Message::print_content()
                     MSG_DATA_GPS_POSITION *ptr = (MSG_DATA_GPS_POSITION *)m_data;
                     char buffer[16];
                     // latitude
-                    int n = snprintf(buffer, 15, "%10.6f", ptr->latitude);
+                    snprintf(buffer, sizeof(buffer), "%10.6f", ptr->latitude);
                     ret += "lat=";
-                    ret += std::string(buffer,n);
+                    ret += buffer;
                     // longitude
-                    n = snprintf(buffer, 15, "%11.6f", ptr->longitude);
+                    snprintf(buffer, sizeof(buffer), "%11.6f", ptr->longitude);
                     ret += ", long=";
-                    ret += std::string(buffer,n);
+                    ret += buffer;
                     // altitude
-                    n = snprintf(buffer, 15, "%7.2f", ptr->altitude);
+                    snprintf(buffer, sizeof(buffer), "%7.2f", ptr->altitude);
                     ret += ", alti=";
-                    ret += std::string(buffer,n);
+                    ret += buffer;
+                    break;
+                };
+            case MSG_TYPE_TM_VARIABLE:
+                {
+                    MSG_TELEMETRY_VARIABLE *ptr = (MSG_TELEMETRY_VARIABLE *)m_data;
+                    char buffer[24];
+                    snprintf(buffer, sizeof(buffer), "#%04x type=%04x : ", ptr->hash, ptr->data_type);
+                    ret += buffer;
+                    int var_count = ptr->variable;
+                    int units_count = ptr->units;
+                    ptr++;
+                    char *t = (char *)ptr;
+                    // variable name
+                    for (int i=0; i<var_count; i++)
+                        ret += *t++;
+                    // units
+                    ret += " [";
+                    for (int i=0; i<units_count; i++)
+                        ret += *t++;
+                    ret += "]";
+                    break;
+                };
+            case MSG_TYPE_DATA_INT16:
+            case MSG_TYPE_DATA_FLOAT:
+            case MSG_TYPE_DATA_DOUBLE:
+            case MSG_TYPE_DATA_GPS:
+                {
+                    // all data messages start with the hash and the time
+                    MSG_DATA_INT16 *ptr = (MSG_DATA_INT16 *)m_data;
+                    char buffer[48];
+                    snprintf(buffer, sizeof(buffer), "%10.3f : #%04x : ", (double)(ptr->time)*0.001, ptr->hash);
+                    ret += buffer;
+                    if (m_type == MSG_TYPE_DATA_INT16)
+                        snprintf(buffer, sizeof(buffer), "%d", ptr->value);
+                    if (m_type == MSG_TYPE_DATA_FLOAT)
+                        snprintf(buffer, sizeof(buffer), "%g", ((MSG_DATA_FLOAT *)m_data)->value);
+                    if (m_type == MSG_TYPE_DATA_DOUBLE)
+                        snprintf(buffer, sizeof(buffer), "%.9g", ((MSG_DATA_DOUBLE *)m_data)->value);
+                    if (m_type == MSG_TYPE_DATA_GPS)
+                    {
+                        MSG_DATA_GPS *gps = (MSG_DATA_GPS *)m_data;
+                        snprintf(buffer, sizeof(buffer), "%.6f, %.6f, %.2f", gps->latitude, gps->longitude, gps->altitude);
+                    };
+                    ret += buffer;
+                    break;
+                };
+            case MSG_TYPE_COMMAND_ACK:
+                {
+                    MSG_DATA_COMMAND_ACK *ptr = (MSG_DATA_COMMAND_ACK *)m_data;
+                    char buffer[48];
+                    snprintf(buffer, sizeof(buffer), "ack %5d status %d RSSI %d",
+                        ptr->sequence, ptr->status, ptr->rssi);
+                    ret += buffer;
                     break;
                 };
             default:
@@ -293,21 +644,116 @@ std::string Message::printout()
 
 Message Message::as_text()
 {
-    return Message::TextMessage(m_sender_module, print_content());
+    Message msg = Message::TextMessage(m_sender_module, print_content());
+    // the text keeps the time of the original content
+    msg.m_time = m_time;
+    return msg;
+}
+
+size_t Message::encoded_size()
+{
+    // data messages have just the type word in front of the body
+    if (msg_data_size(m_type) > 0)
+        return 2 + msg_data_size(m_type);
+    size_t n = MSG_HEADER_SIZE;
+    switch (m_type)
+    {
+        case MSG_TYPE_SYSTEM:
+        {
+            MSG_DATA_SYSTEM *md = (MSG_DATA_SYSTEM *)m_data;
+            n += 5 + md->text;
+            break;
+        };
+        case MSG_TYPE_TEXT:
+        {
+            MSG_DATA_TEXT *md = (MSG_DATA_TEXT *)m_data;
+            n += md->text;
+            break;
+        };
+        case MSG_TYPE_SYSTEM_TEMPLATE:
+        {
+            MSG_DATA_SYSTEM_TEMPLATE *md = (MSG_DATA_SYSTEM_TEMPLATE *)m_data;
+            n += 7 + md->args;
+            break;
+        };
+        case MSG_TYPE_TELEMETRY:
+        {
+            MSG_DATA_TELEMETRY *md = (MSG_DATA_TELEMETRY *)m_data;
+            n += 5 + md->variable + md->value;
+            break;
+        };
+        case MSG_TYPE_GPS_POSITION:
+        {
+            n += 20;
+            break;
+        };
+        case MSG_TYPE_SERVO:
+        {
+            n += 2*NUM_SERVO_CHANNELS;
+            break;
+        };
+        case MSG_TYPE_IMU_AHRS:
+        case MSG_TYPE_IMU_GYRO:
+        {
+            n += 20;
+            break;
+        };
+        case MSG_TYPE_TM_VARIABLE:
+        {
+            MSG_TELEMETRY_VARIABLE *md = (MSG_TELEMETRY_VARIABLE *)m_data;
+            n += 5 + md->variable + md->units;
+            break;
+        };
+        default:
+        {
+            n += m_size;
+        };
+    }
+    return n;
 }
 
 uint8_t Message::buffer(char* buffer, size_t size)
 {
     // check for buffer size
-    if (size<12) return 0;
-    char* ptr = buffer;
+    // oversize messages are rejected as a whole
+    size_t n_bytes = encoded_size();
+    if ((n_bytes>size) or (n_bytes>MSG_MAX_ENCODED_SIZE)) return 0;
     // mesagge type is encoded with two bytes, high byte first
-    char *source = (char*) &m_type;
-    buffer[1] = *source++;
-    buffer[0] = *source++;
-    // reserve one byte for the message size (we don't know it yet)
-    ptr+=3;
+    buffer[0] = (m_type >> 8) & 0xFF;
+    buffer[1] = m_type & 0xFF;
+    // data messages have no size and sender ID, hash and time come first
+    if (msg_data_size(m_type) > 0)
+    {
+        MSG_DATA_INT16 *md = (MSG_DATA_INT16 *)m_data;
+        std::memcpy(buffer+2, &(md->hash), 2);
+        std::memcpy(buffer+4, &(md->time), 4);
+        char* ptr = buffer+8;
+        switch (m_type)
+        {
+            case MSG_TYPE_DATA_INT16:
+                std::memcpy(ptr, &(md->value), 2);
+                break;
+            case MSG_TYPE_DATA_FLOAT:
+                std::memcpy(ptr, &(((MSG_DATA_FLOAT *)m_data)->value), 4);
+                break;
+            case MSG_TYPE_DATA_DOUBLE:
+                std::memcpy(ptr, &(((MSG_DATA_DOUBLE *)m_data)->value), 8);
+                break;
+            case MSG_TYPE_DATA_GPS:
+            {
+                MSG_DATA_GPS *gps = (MSG_DATA_GPS *)m_data;
+                std::memcpy(ptr, &(gps->latitude), 8);
+                std::memcpy(ptr+8, &(gps->longitude), 8);
+                std::memcpy(ptr+16, &(gps->altitude), 4);
+                break;
+            };
+        }
+        return n_bytes;
+    };
+    // the message size is put into the buffer (the type word and size byte are not counted)
+    buffer[2] = n_bytes-3;
     // sender ID is put as a fixed length of 8 characters
+    char* ptr = buffer+3;
     size_t n=0;
     while ((n<m_sender_module.size()) and (n<8))
     {
@@ -319,50 +765,171 @@ uint8_t Message::buffer(char* buffer, size_t size)
         *ptr++ = 0x20; // fill with spaces
         n++;
     };
-    uint8_t n_bytes = 11; // 2+1+8 bytes fixed information
     // the data block is put as compact as possible (depending on the type)
-    // number of free bytes remaining in the buffer
-    uint8_t remaining = size-11;
     switch (m_type)
     {
         case MSG_TYPE_SYSTEM:
         {
             MSG_DATA_SYSTEM *md = (MSG_DATA_SYSTEM *)m_data;
-            int count = md->text;
-            // Serial.print("\nMSG_DATA_SYSTEM size=");
-            // Serial.println(count);
-            // check for buffer size (keep one byte for checksum)
-            if (remaining > 5)
-            {
-	            // if we can at least send a single character we go with a truncated message
-            	if (count>remaining-5) count=remaining-5;
-                *ptr = md->severity_level;
-                std::memcpy(ptr+1, &(md->time), 4);
-                n_bytes += 5;
-                // the number of characters is not needed in the block, because the total length is known
-                // the text content starts at the next character after the m_data struct
-                uint8_t *txt = (uint8_t *) m_data;
-                txt += sizeof(MSG_DATA_SYSTEM);
-                // now append all characters
-                std::memcpy(ptr+5, txt, count);
-                n_bytes += count;
-            };
-            // if buffer size is insufficient go ahead with missing data block
+            *ptr = md->severity_level;
+            std::memcpy(ptr+1, &(md->time), 4);
+            // the number of characters is not needed in the block, because the total length is known
+            // the text content starts at the next character after the m_data struct
+            std::memcpy(ptr+5, md+1, md->text);
             break;
         };
         case MSG_TYPE_TEXT:
         {
-            // TODO
+            MSG_DATA_TEXT *md = (MSG_DATA_TEXT *)m_data;
+            std::memcpy(ptr, md+1, md->text);
+            break;
+        };
+        case MSG_TYPE_SYSTEM_TEMPLATE:
+        {
+            MSG_DATA_SYSTEM_TEMPLATE *md = (MSG_DATA_SYSTEM_TEMPLATE *)m_data;
+            *ptr = md->severity_level;
+            std::memcpy(ptr+1, &(md->time), 4);
+            std::memcpy(ptr+5, &(md->template_id), 2);
+            std::memcpy(ptr+7, md+1, md->args);
+            break;
+        };
+        case MSG_TYPE_TELEMETRY:
+        {
+            MSG_DATA_TELEMETRY *md = (MSG_DATA_TELEMETRY *)m_data;
+            std::memcpy(ptr, &(md->time), 4);
+            ptr[4] = md->variable;
+            // both strings follow the struct
+            std::memcpy(ptr+5, md+1, md->variable + md->value);
+            break;
+        };
+        case MSG_TYPE_GPS_POSITION:
+        {
+            MSG_DATA_GPS_POSITION *md = (MSG_DATA_GPS_POSITION *)m_data;
+            std::memcpy(ptr, &(md->latitude), 8);
+            std::memcpy(ptr+8, &(md->longitude), 8);
+            std::memcpy(ptr+16, &(md->altitude), 4);
+            break;
+        };
+        case MSG_TYPE_SERVO:
+        {
+            MSG_DATA_SERVO *md = (MSG_DATA_SERVO *)m_data;
+            std::memcpy(ptr, md->pos, 2*NUM_SERVO_CHANNELS);
+            break;
+        };
+        case MSG_TYPE_IMU_AHRS:
+        {
+            DATA_IMU_AHRS *md = (DATA_IMU_AHRS *)m_data;
+            std::memcpy(ptr, &(md->time), 8);
+            std::memcpy(ptr+8, &(md->attitude), 4);
+            std::memcpy(ptr+12, &(md->heading), 4);
+            std::memcpy(ptr+16, &(md->roll), 4);
+            break;
+        };
+        case MSG_TYPE_IMU_GYRO:
+        {
+            DATA_IMU_GYRO *md = (DATA_IMU_GYRO *)m_data;
+            std::memcpy(ptr, &(md->time), 8);
+            std::memcpy(ptr+8, &(md->nick), 4);
+            std::memcpy(ptr+12, &(md->yaw), 4);
+            std::memcpy(ptr+16, &(md->roll), 4);
+            break;
+        };
+        case MSG_TYPE_TM_VARIABLE:
+        {
+            MSG_TELEMETRY_VARIABLE *md = (MSG_TELEMETRY_VARIABLE *)m_data;
+            std::memcpy(ptr, &(md->hash), 2);
+            std::memcpy(ptr+2, &(md->data_type), 2);
+            ptr[4] = md->variable;
+            // both strings follow the struct
+            std::memcpy(ptr+5, md+1, md->variable + md->units);
             break;
         };
-        // TODO: more cases
         default:
         {
+            // the data blob as is
+            if (m_size>0) std::memcpy(ptr, m_data, m_size);
         };
     }    
-    // the message size is put into the buffer (the type word and size byte are not counted)
-    buffer[2] = n_bytes-3;
-    // TODO add a CRC checksum
     return n_bytes;
 }
 
+MessageView::MessageView(const char* buffer, size_t size)
+{
+    m_buffer = buffer;
+    m_type = MSG_TYPE_ABSTRACT;
+    m_header_size = MSG_HEADER_SIZE;
+    m_body_size = 0;
+    m_valid = false;
+    // we need at least the type word
+    if (size<2) return;
+    m_type = ((uint8_t)buffer[0] << 8) | (uint8_t)buffer[1];
+    // all message types have the same signature in the upper 10 bits
+    if ((m_type & 0xFFC0) != MSG_TYPE_ABSTRACT) return;
+    // data messages have a fixed size and no sender ID
+    if (msg_data_size(m_type) > 0)
+    {
+        m_header_size = 2;
+        m_body_size = msg_data_size(m_type);
+        m_valid = (size >= m_header_size+m_body_size);
+        return;
+    };
+    // we need at least the complete header
+    if (size<MSG_HEADER_SIZE) return;
+    uint8_t n = buffer[2];
+    // the sender ID is always present
+    if (n<8) return;
+    // the encoder never creates longer messages, so they could not be forwarded
+    if ((size_t)n+3>MSG_MAX_ENCODED_SIZE) return;
+    // the message must be complete
+    if (size<(size_t)n+3) return;
+    m_body_size = n-8;
+    // check the body size for the message type
+    switch (m_type)
+    {
+        case MSG_TYPE_SYSTEM:
+            m_valid = (m_body_size>=5);
+            break;
+        case MSG_TYPE_SYSTEM_TEMPLATE:
+            m_valid = (m_body_size>=7);
+            break;
+        case MSG_TYPE_COMMAND_ACK:
+            m_valid = (m_body_size==sizeof(MSG_DATA_COMMAND_ACK));
+            break;
+        case MSG_TYPE_TELEMETRY:
+        case MSG_TYPE_TM_VARIABLE:
+            m_valid = (m_body_size>=5) and ((uint8_t)buffer[MSG_HEADER_SIZE+4] <= m_body_size-5);
+            break;
+        case MSG_TYPE_GPS_POSITION:
+        case MSG_TYPE_IMU_AHRS:
+        case MSG_TYPE_IMU_GYRO:
+            m_valid = (m_body_size==20);
+            break;
+        case MSG_TYPE_SERVO:
+            m_valid = (m_body_size==2*NUM_SERVO_CHANNELS);
+            break;
+        default:
+            m_valid = true;
+    }
+}
+
+std::string MessageView::sender()
+{
+    if (m_header_size<MSG_HEADER_SIZE) return std::string("");
+    // remove the padding
+    size_t n = 8;
+    while ((n>0) and (m_buffer[3+n-1]==0x20)) n--;
+    return std::string(m_buffer+3, n);
+}
+
+uint8_t msg_data_size(uint16_t msg_type)
+{
+    // hash(2) time(4) value
+    switch (msg_type)
+    {
+        case MSG_TYPE_DATA_INT16:   return 6+2;
+        case MSG_TYPE_DATA_FLOAT:   return 6+4;
+        case MSG_TYPE_DATA_DOUBLE:  return 6+8;
+        case MSG_TYPE_DATA_GPS:     return 6+20;
+        default:                    return 0;
+    }
+}
@@ -23,6 +23,8 @@
 #include <cstdint>
 #include <string>
 
+#include "msg_templates.h"
+
 /*
     All messages carry a type information.
     This is a 16-bit integer value which ist also transmitted over
@@ -41,6 +43,9 @@
 #define MSG_TYPE_COMMAND        0xcc86
 #define MSG_TYPE_PING           0xcc87
 #define MSG_TYPE_PINGRESPONSE   0xcc88
+#define MSG_TYPE_TM_VARIABLE    0xcc89
+#define MSG_TYPE_SYSTEM_TEMPLATE 0xcc8a
+#define MSG_TYPE_COMMAND_ACK    0xcc8b
 
 /*
     All messages have a data body which has to be interpreted depending on the message type.
@@ -72,6 +77,18 @@ struct MSG_DATA_SYSTEM {
 #define MSG_LEVEL_READBACK 15
 #define MSG_LEVEL_STATUSREPORT 30
 
+/*
+    A system message given by a template ID and binary arguments
+    (see msg_templates.h). The arguments follow the struct.
+    The text is only formatted when needed (print_content()).
+*/
+struct MSG_DATA_SYSTEM_TEMPLATE {
+    uint8_t     severity_level;
+    uint32_t    time;
+    uint16_t    template_id;
+    TextSize    args;
+};
+
 struct MSG_DATA_TEXT {
     TextSize    text;
 };
@@ -98,10 +115,14 @@ struct MSG_DATA_SERVO {
     The combination of sender and variable name can be replaced
     by the hash in future data value transmissions.
     The hash also defines the data size and variable types
+    (data_type is one of the MSG_TYPE_DATA_... types below).
+    Both strings follow the struct.
 */
 struct MSG_TELEMETRY_VARIABLE {
     uint16_t    hash;
+    uint16_t    data_type;
     TextSize    variable;
+    TextSize    units;
 };
 
 /*
@@ -116,6 +137,140 @@ struct MSG_TELEMETRY_VARIABLE {
 #define MSG_TYPE_IMU_AHRS       0xcca1      // float attitude, heading, roll
 #define MSG_TYPE_IMU_GYRO       0xcca2      // float nick, yaw, roll
 
+struct MSG_DATA_INT16 {
+    uint16_t    hash;
+    uint32_t    time;
+    int16_t     value;
+};
+
+struct MSG_DATA_FLOAT {
+    uint16_t    hash;
+    uint32_t    time;
+    float       value;
+};
+
+struct MSG_DATA_DOUBLE {
+    uint16_t    hash;
+    uint32_t    time;
+    double      value;
+};
+
+struct MSG_DATA_GPS {
+    uint16_t    hash;
+    uint32_t    time;
+    double      latitude;
+    double      longitude;
+    float       altitude;
+};
+
+/*
+    Every command sent over the uplink carries a sequence number (the first two bytes
+    of the MSG_TYPE_COMMAND body). The modem answers every received command
+    with an acknowledge of that sequence number reporting the uplink RSSI.
+    A sender retransmits unacknowledged commands, the receiver suppresses duplicates.
+*/
+struct MSG_DATA_COMMAND_ACK {
+    uint16_t    sequence;
+    uint8_t     status;
+    uint8_t     rssi;
+};
+
+// the status of an acknowledged command
+#define CMD_ACK_OK          0   // delivered to the commander
+#define CMD_ACK_DUPLICATE   1   // already delivered before, not delivered again
+#define CMD_NACK_FORMAT     2   // no command keyword, not delivered
+#define CMD_NACK_NO_RECEIVER 3  // nobody listening to the uplink, not delivered
+
+// the number of bytes of the sequence number preceding every command
+#define CMD_SEQUENCE_SIZE   2
+
+// the number of body bytes of the data messages, 0 for all other types
+uint8_t msg_data_size(uint16_t msg_type);
+
+/*
+    The compact binary format of messages used for transmission over
+    low-bandwidth channels (e.g. the modem) and for binary logs.
+    
+        2 bytes     message type (high byte first)
+        1 byte      number of bytes following (sender + body)
+        8 bytes     sender ID (padded with spaces)
+        n bytes     message body
+        
+    The body is the content of the data struct of the message type
+    without padding and with all strings appended (all values little-endian).
+    The number of characters of the last string is not transmitted,
+    it is given by the total size.
+        MSG_TYPE_SYSTEM         severity_level(1) time(4) text
+        MSG_TYPE_TEXT           text
+        MSG_TYPE_TELEMETRY      time(4) variable size(1) variable value
+        MSG_TYPE_GPS_POSITION   latitude(8) longitude(8) altitude(4)
+        MSG_TYPE_SERVO          pos(2) x NUM_SERVO_CHANNELS
+        MSG_TYPE_IMU_AHRS       time(8) attitude(4) heading(4) roll(4)
+        MSG_TYPE_IMU_GYRO       time(8) nick(4) yaw(4) roll(4)
+        MSG_TYPE_TM_VARIABLE    hash(2) data type(2) variable size(1) variable units
+        MSG_TYPE_SYSTEM_TEMPLATE severity_level(1) time(4) template ID(2) arguments
+        MSG_TYPE_COMMAND        sequence(2) command keyword(4) arguments
+        MSG_TYPE_COMMAND_ACK    sequence(2) status(1) RSSI(1)
+        all other types         the data blob as is
+        
+    The acquisition time of the message (Message::time(), 64 bit [us]) is not part
+    of the encoding, on the downlink the 8 bytes would cost too much airtime.
+    Only the IMU types carry it in their body. The types with a time field [ms]
+    get the time back with millisecond resolution when they are decoded,
+    all others are decoded with the time 0. The log files keep the full time
+    in the header of every message record (see log_format.h).
+
+    The telemetry data messages (MSG_TYPE_DATA_...) are transmitted without
+    size byte and sender ID, these are given by the type and the hash.
+    
+        2 bytes     message type (high byte first)
+        2 bytes     hash of the telemetry variable
+        4 bytes     time [ms]
+        n bytes     value(s) (the size is given by the type)
+        
+    The format carries no checksum, transmissions are protected
+    by the framing layer (see framing.h).
+*/
+#define MSG_HEADER_SIZE 11
+#define MSG_MAX_ENCODED_SIZE (MSG_HEADER_SIZE+244)
+
+/*
+    This is a read-only view of a message in the compact binary format.
+    Nothing is copied, all accessors refer to the underlying buffer
+    which must stay valid as long as the view is used.
+    This allows to inspect received data before deciding to create a Message.
+*/
+class MessageView {
+    public:
+        // the buffer may be larger than the message, the rest is ignored
+        MessageView(const char* buffer, size_t size);
+        
+        // true if the buffer holds a complete message
+        // with a body size that is consistent with its type
+        // (and not exceeding MSG_MAX_ENCODED_SIZE)
+        bool valid() { return m_valid; };
+        
+        uint16_t type() { return m_type; };
+        
+        // the sender ID with the padding removed
+        // telemetry data messages carry no sender ID, an empty string is returned
+        std::string sender();
+        
+        // the body of the message within the buffer
+        const char* body() { return m_buffer+m_header_size; };
+        uint8_t body_size() { return m_body_size; };
+        
+        // the total number of bytes the message takes in the buffer
+        size_t size() { return m_header_size+m_body_size; };
+        
+    private:
+        const char* m_buffer;
+        uint16_t    m_type;
+        uint8_t     m_header_size;
+        uint8_t     m_body_size;
+        bool        m_valid;
+};
+
 /*
     This is a message the can be sent and received in between modules.
     It holds information about the sender module and the size of the transmitted data block.
@@ -147,8 +302,12 @@ class Message {
         // This is used to re-create a message from the compact binary format
         // which is used for transmission over low-bandwidth channels (e.g. modem)
         // All information is contained in the buffer (sender id, message type, length).
-        // TODO: no implementation yet
-        Message(char* buffer);
+        // If the buffer does not hold a valid message an empty MSG_TYPE_ABSTRACT message is created.
+        Message(const char* buffer, size_t size);
+        
+        // Constructor from a view into a buffer holding the compact binary format.
+        // If the view is not valid an empty MSG_TYPE_ABSTRACT message is created.
+        Message(MessageView view);
         
         // named Constructor for a MSG_TYPE_TEXT message
         static Message TextMessage(
@@ -162,6 +321,38 @@ class Message {
             uint8_t     severity_level,
             std::string text);
                     
+        // Constructor for a MSG_TYPE_SYSTEM_TEMPLATE message from packed arguments
+        static Message SystemTemplate(
+            std::string sender_module,
+            uint32_t    time,
+            uint8_t     severity_level,
+            uint16_t    template_id,
+            const char* args,
+            uint8_t     args_size);
+        
+        // Constructor for a MSG_TYPE_SYSTEM_TEMPLATE message
+        // the arguments must match the conversions of the template format
+        template <typename... Args>
+        static Message SystemTemplate(
+            std::string sender_module,
+            uint32_t    time,
+            uint8_t     severity_level,
+            uint16_t    template_id,
+            Args...     args)
+        {
+            MsgTemplateArgs packed;
+            packed.pack(args...);
+            return SystemTemplate(sender_module, time, severity_level, template_id,
+                packed.data(), packed.size());
+        };
+        
+        // Constructor for a MSG_TYPE_COMMAND_ACK message
+        static Message CommandAck(
+            std::string sender_module,
+            uint16_t    sequence,
+            uint8_t     status,
+            uint8_t     rssi);
+        
         // Constructor for a MSG_TYPE_TELEMETRY message
         // this also creates the hash for the defined message
         // the sender must store this hash to subsequently send data messages
@@ -170,6 +361,40 @@ class Message {
             uint32_t    time,
             std::string variable,
             std::string value);
+        
+        // Constructor for a MSG_TYPE_TM_VARIABLE message
+        // declaring a telemetry variable (see TelemetryDictionary)
+        static Message TelemetryVariable(
+            std::string sender_module,
+            uint16_t    hash,
+            uint16_t    data_type,
+            std::string variable,
+            std::string units);
+        
+        // Constructors for telemetry data messages
+        // the sender is not transmitted, it is encoded in the hash
+        static Message DataInt16(
+            std::string sender_module,
+            uint16_t    hash,
+            uint32_t    time,
+            int16_t     value);
+        static Message DataFloat(
+            std::string sender_module,
+            uint16_t    hash,
+            uint32_t    time,
+            float       value);
+        static Message DataDouble(
+            std::string sender_module,
+            uint16_t    hash,
+            uint32_t    time,
+            double      value);
+        static Message DataGPS(
+            std::string sender_module,
+            uint16_t    hash,
+            uint32_t    time,
+            double      latitude,
+            double      longitude,
+            float       altitude);
                  
         // we need a destructor to free any allocated memory
         ~Message();
@@ -180,9 +405,19 @@ class Message {
         // type reporting function
         uint16_t size() { return m_size; };
         
+        // the ID of the module which created the message
+        std::string sender() { return m_sender_module; };
+        
         // data extraction fuction - get a pointer to the data struct
         void* get_data() { return m_data; }; 
         
+        // The time the content of the message was acquired in microseconds (see FC_time_us()).
+        // A value of 0 indicates the message has not been stamped yet,
+        // in that case the time is set when the message is first transmitted.
+        // Producers which know better (e.g. sensors) should set it explicitly.
+        uint64_t time() { return m_time; };
+        void set_time(uint64_t time) { m_time = time; };
+        
         // Generate a string with a standardized format holding the content of the message.
         std::string print_content();
 
@@ -199,8 +434,13 @@ class Message {
         // put a compact date block describing the message, suitable for transmission
         // over low-bandwidth communication channels into a given data buffer
         // it returns the number of bytes actually used
+        // If the message does not fit into the buffer (or exceeds MSG_MAX_ENCODED_SIZE)
+        // nothing is written and 0 is returned. Messages are never truncated.
         uint8_t buffer(char* buffer, size_t size);
         
+        // the number of bytes buffer() needs for this message
+        size_t encoded_size();
+        
     protected:
         // there is one single member that is required for all messages
         // the sender module of the message
@@ -208,5 +448,6 @@ class Message {
         uint16_t    m_type;
         uint16_t    m_size;
         void*       m_data;
+        uint64_t    m_time;
 };
 
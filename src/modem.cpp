@@ -1,23 +1,48 @@
 #include "modem.h"
 
-#include "HardwareSerial.h"
-#include "util.h"
+#include <cstring>
 
-// this is the RTS pin for the modem, used for M0 and M1 wired in parallel
-// high means config mode, low is transceiver mode
-#define MODEM_M0_M1 22
-// this is the CTS pin for the modem, used for AUX
-#define MODEM_AUX 23
+#include "util.h"
 
 Modem::Modem(
-    std::string name ) :
-    Module(name)
+    std::string name,
+    ModemSerial *serial ) :
+    Module(name),
+    uplink_decoder(1)
 {
+    this->serial = serial;
     runlevel_= MODULE_RUNLEVEL_STOP;
     last_time = FC_time_now();
+    last_report = FC_time_now();
     // nothing received yet
     uplink_num_chars = 0;
-    message_num_chars_pending = 0;
+    message_size = 0;
+    outbox_count = 0;
+    outbox_bytes = 0;
+    // start with a full bucket
+    tokens = MODEM_BUCKET_SIZE;
+    share[MODEM_PRIORITY_URGENT] = MODEM_SHARE_URGENT;
+    share[MODEM_PRIORITY_TELEMETRY] = MODEM_SHARE_TELEMETRY;
+    share[MODEM_PRIORITY_STATUS] = MODEM_SHARE_STATUS;
+    for (int p=0; p<MODEM_PRIORITY_LEVELS; p++)
+        class_tokens[p] = MODEM_BUCKET_SIZE;
+    last_refill = FC_time_us();
+    hold_start = FC_time_now();
+    hold_time = 0;
+    down_frames = 0;
+    down_messages = 0;
+    down_payload_bytes = 0;
+    down_frame_bytes = 0;
+    down_oversize = 0;
+    down_merged = 0;
+    down_dropped = 0;
+    down_max_latency = 0;
+    up_commands = 0;
+    up_duplicates = 0;
+    up_rejected = 0;
+    cmd_any = false;
+    cmd_highest = 0;
+    cmd_mask = 0;
 }
 
 /*
@@ -31,13 +56,16 @@ Modem::Modem(
 */
 bool Modem::busy()
 {
-    return digitalRead(MODEM_AUX) == LOW;
+    return serial->aux_busy();
 }
 
 void Modem::setup()
 {
 
     runlevel_ = 0;
+    // open serial port for configuration
+    // default SERIAL_8N1  == 0x00
+    serial->begin(9600);
     last_time = FC_time_now();
     // internal initialization
     while(busy())
@@ -50,36 +78,31 @@ void Modem::setup()
             return;
         }
     }
-    // open serial port for configuration
-    // default SERIAL_8N1  == 0x00
-    Serial1.begin(9600);
-    Serial1.setTimeout(0);
     // send a message to the system_log
     status_out.transmit(
         Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "initialized.") );
     // init hardware
     // pull M0/M1 high (sleep/config mode)
-    pinMode(MODEM_M0_M1, OUTPUT);
-    digitalWriteFast(MODEM_M0_M1, HIGH);
-    // prepare CTS pin
-    pinMode(MODEM_AUX, INPUT);
+    serial->set_config_mode(true);
     // wait 100 ms
     last_time = FC_time_now();
     while (FC_elapsed_millis(last_time) < 100) {};
     // send the configuration command
-    Serial1.write(0xc0);
-    Serial1.write(0x00);
-    Serial1.write(0x06);    // 6 command bytes
-    Serial1.write(0x00);
-    Serial1.write(0x00);
-    Serial1.write(0xE4);    // modem 115200,8N1 air=9600bps
-    // Serial1.write(0x64);    // modem 9600,8N1 air=9600bps
-    Serial1.write(0x00);
-    Serial1.write(0x12);    // freq ch18 = 868.125 MHz
-    Serial1.write(0x80);    // enable RSSI
+    const uint8_t config[9] = {
+        0xc0,
+        0x00,
+        0x06,   // 6 command bytes
+        0x00,
+        0x00,
+        0xE4,   // modem 115200,8N1 air=9600bps
+                // 0x64 : modem 9600,8N1 air=9600bps
+        0x00,
+        0x12,   // freq ch18 = 868.125 MHz
+        0x80 }; // enable RSSI
+    serial->write(config, sizeof(config));
     // check the response from the modem
     last_time = FC_time_now();
-    while (Serial1.available() < 3)
+    while (serial->available() < 3)
     {
         if (FC_elapsed_millis(last_time)>1000)
         {
@@ -94,22 +117,17 @@ void Modem::setup()
     // read the response with 10 ms timeout
     while (FC_elapsed_millis(last_time)<10)
     {
-        if (Serial1.available() > 0)
+        if ((serial->available() > 0) and (uplink_num_chars < MODEM_BUFFER_SIZE))
         {
-            int incoming = Serial1.read();
-            char c = incoming & 0xFF;
-            uplink_buffer[uplink_num_chars++] = c;
+            uplink_num_chars += serial->read(
+                (uint8_t *)uplink_buffer+uplink_num_chars, MODEM_BUFFER_SIZE-uplink_num_chars);
             last_time = FC_time_now();
         }
     };
     // report the response to system log
-    std::string report("configuration response : ");
-    for (int i=0; i<uplink_num_chars; i++)
-    {
-        report += hexbyte(uplink_buffer[i]);
-    };
+    MsgTemplateBlob response = { uplink_buffer, (size_t)uplink_num_chars };
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, report) );
+        Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, TPL_MODEM_CONFIG, response) );
     // check for correct configuration
     if ((uplink_num_chars==9) and (uplink_buffer[0]==0xC1))
     {
@@ -126,14 +144,13 @@ void Modem::setup()
     // clear the receive buffer
     uplink_num_chars = 0;
     // done with configuration
-    digitalWriteFast(MODEM_M0_M1, LOW);
-    Serial1.end();
+    serial->set_config_mode(false);
+    serial->end();
     // wait 100 ms
     last_time = FC_time_now();
     while (FC_elapsed_millis(last_time) < 100) {};
     // re-open using communication mode serial baud rate
-    Serial1.begin(115200);
-    Serial1.setTimeout(0);
+    serial->begin(115200);
     // wait 100 ms
     last_time = FC_time_now();
     while (FC_elapsed_millis(last_time) < 100) {};
@@ -142,129 +159,385 @@ void Modem::setup()
     runlevel_ =  MODULE_RUNLEVEL_OPERATIONAL;
 }
 
-// TODO: handle uplink messages
-// these should be command messages (with a unique identifier)
-// we should respond with a confirmation containing the UID and RSI
-// an empty command is used as a ping
-
 void Modem::interrupt()
 {
-    uint32_t elapsed = FC_elapsed_millis(last_time);
     // we detect the time elapsed as long as there is no activity at the modem
-    if(busy())
+    // the AUX pin is watched by an interrupt, nothing is polled here
+    uint32_t elapsed = FC_elapsed_millis(last_time);
+    if (busy())
+        elapsed = 0;
+    else
     {
-        elapsed=0;
-        last_time = FC_time_now();
+        uint32_t idle = FC_elapsed_millis(serial->aux_last_change());
+        if (idle < elapsed) elapsed = idle;
     };
     // see if we have received something
-    if (Serial1.available() > 0)
+    // this is signalled when the line has become idle after a packet
+    if (serial->rx_pending())
     	schedule_task(this, std::bind(&Modem::receive, this));
-    // when we have received something, but the receeiver is idle for 5ms
-    // then we have the complete message
-    // this implies the modem is not busy()
-    if ((uplink_num_chars>0) and elapsed>5)
-    	schedule_task(this, std::bind(&Modem::process_message, this));
-    // if there is something received in one of the input ports
-    // we have to handle it unless the modem is busy()
-    // we wait 10 ms after busy() giving receiving messages higher priority than sending
-    if ((runlevel_>=16) and (downlink.count()>0) and (elapsed>10))
+    // messages received in the downlink port are moved into the outbox right away
+    if ((runlevel_>=16) and (downlink.count()>0))
     	schedule_task(this, std::bind(&Modem::send_message, this));
-	// if the message is not yet completely sent, we try to continue
-    if (message_num_chars_pending>0)
+    // if there is something in the outbox we have to send it unless the modem is busy()
+    // we wait 10 ms after busy() giving receiving messages higher priority than sending
+    // and we wait for the airtime budget
+    // a frame is handed over to the serial port as a whole, so nothing has to
+    // be continued while it is transmitted
+    if ((runlevel_>=16) and (outbox_count>0) and (elapsed>10) and
+        (FC_elapsed_millis(hold_start)>=hold_time) and !serial->tx_busy())
     	schedule_task(this, std::bind(&Modem::send_message, this));
+    // periodically report the link statistics
+    if ((runlevel_>=16) and (FC_elapsed_millis(last_report)>MODEM_REPORT_INTERVAL))
+    {
+        last_report = FC_time_now();
+    	schedule_task(this, std::bind(&Modem::report_link, this));
+    };
 }
 
 void Modem::receive()
 {
-    // something is in the incoming FIFO - read it
-    while (Serial1.available() > 0)
-    {
-        int incoming = Serial1.read();
-        char c = incoming & 0xFF;
-        uplink_buffer[uplink_num_chars] = c;
-        uplink_num_chars++;
-    }
+    // something is in the receive buffer - read it in blocks
+    uint8_t block[64];
+    size_t n;
+    while ((n = serial->read(block, sizeof(block))) > 0)
+        for (size_t i=0; i<n; i++)
+            // the decoder resynchronizes at every frame delimiter
+            if (uplink_decoder.push(block[i]))
+                process_message();
     // record the time
     last_time = FC_time_now();
 }
 
 void Modem::process_message()
 {
-	// there is something in the uplink buffer but the port is idle for 5ms (complete message)
-	std::string report("received command : ");
-	for (int i=0; i<uplink_num_chars; i++)
-	{
-	    report += hexbyte(uplink_buffer[i]);
-	};
+	// a valid frame has been received (the CRC has been checked already)
+	const char* frame = (const char*) uplink_decoder.frame();
+	size_t frame_size = uplink_decoder.frame_size();
+	MsgTemplateBlob received = { frame, frame_size };
 	status_out.transmit(
-	    Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, report) );
-	// check for and answer a ping
-	// TODO: this check could be a method of the Message class
-	if (uplink_num_chars>=7)
-	    if (uplink_buffer[0] == 0xcc)
-	        if (uplink_buffer[1] == 0x87)
+	    Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, TPL_MODEM_FRAME, received) );
+	// the modem appends the RSSI byte after the received packet
+	uint8_t rssi = uplink_decoder.trailer()[0];
+	// the frame may hold several messages
+	// decode them from the frame without copying
+	size_t pos = 0;
+	while (pos < frame_size)
+	{
+	    MessageView view(frame+pos, frame_size-pos);
+	    if (!view.valid()) break;
+	    // check for and answer a ping
+	    // the ping body is a 16-bit hash and a placeholder for the uplink RSSI
+	    if ((view.type() == MSG_TYPE_PING) and (view.body_size() == 3))
+	    {
+	        char body[3];
+	        body[0] = view.body()[0];
+	        body[1] = view.body()[1];
+	        body[2] = rssi;
+	        // the response is sent with the next frame
+	        queue_message(Message(id, MSG_TYPE_PINGRESPONSE, 3, body));
+	    };
+	    // if it is a command message it should be sent to the commander
+	    // every command is acknowledged with its sequence number right away
+	    // only the first copy of a retransmitted command is delivered
+	    if ((view.type() == MSG_TYPE_COMMAND) and (view.body_size() >= CMD_SEQUENCE_SIZE))
+	    {
+	        uint16_t sequence;
+	        std::memcpy(&sequence, view.body(), CMD_SEQUENCE_SIZE);
+	        uint8_t status = CMD_ACK_OK;
+	        if (command_seen(sequence))
 	        {
-	        	// this is a ping
-	            if (uplink_buffer[2] == 0x03)
-	            {
-	                // respond with the uplink RSI
-	                uplink_buffer[1] = 0x88;
-	                if (uplink_num_chars>=7) uplink_buffer[5] = uplink_buffer[6];
-	                // send downlink packet
-	                Serial1.write(uplink_buffer, 6);
-	            };
-	        };
-	// if it is a command message it should be sent to the commander
-	// TODO: this check could be a method of the Message class
-	if (uplink_num_chars>=4)
-	    if (uplink_buffer[0] == 0xcc)
-	        if (uplink_buffer[1] == 0x86)
+	            status = CMD_ACK_DUPLICATE;
+	            up_duplicates++;
+	        }
+	        else if (view.body_size() < CMD_SEQUENCE_SIZE+4)
+	            status = CMD_NACK_FORMAT;
+	        else if (uplink.count_receivers() == 0)
+	            status = CMD_NACK_NO_RECEIVER;
+	        if (status == CMD_ACK_OK)
 	        {
-	            // there is only an 8-bit message length for air transmission
-	            uint16_t msg_len = uplink_buffer[2];
-	            if (uplink_num_chars >= (msg_len+3))
-	            {
-	                Message command = Message(
-	                    std::string("UPLINK"),
-	                    MSG_TYPE_COMMAND,
-	                    msg_len,
-	                    uplink_buffer+3
-	                    );
-                    uplink.transmit(command);
-                };
-            };	
-	// empty the buffer
-	uplink_num_chars = 0;
+	            remember_command(sequence);
+	            uplink.transmit(Message(view));
+	            up_commands++;
+	        };
+	        if (status >= CMD_NACK_FORMAT) up_rejected++;
+	        queue_message(Message::CommandAck(id, sequence, status, rssi));
+	    };
+	    pos += view.size();
+	};
 	// record the time
 	last_time = FC_time_now();
  }
 
-void Modem::send_message()
+bool Modem::command_seen(uint16_t sequence)
 {
-	if (message_num_chars_pending>0)
-	{
-		// continue sending an incompletely transmitted message
-	}
-	else
-	{
-		// start to transmit a new message
-		Message msg = downlink.fetch();
-		message_num_chars_pending = msg.buffer(message_buffer, MODEM_BUFFER_SIZE);
-		message_buf_next = message_buffer;
-	}
-    // see if we can send something
-	uint16_t available = Serial1.availableForWrite();
-    if (available > 8)
+    if (!cmd_any) return false;
+    // the distance from the highest sequence number (with wrap-around)
+    int16_t d = (int16_t)(sequence - cmd_highest);
+    // newer or from a restarted sender
+    if ((d > 0) or (d <= -MODEM_CMD_WINDOW)) return false;
+    return (cmd_mask >> (-d)) & 1;
+}
+
+void Modem::remember_command(uint16_t sequence)
+{
+    int16_t d = (int16_t)(sequence - cmd_highest);
+    if (!cmd_any or (d <= -MODEM_CMD_WINDOW) or (d >= MODEM_CMD_WINDOW))
+    {
+        // start a new window
+        cmd_mask = 1;
+        cmd_highest = sequence;
+        cmd_any = true;
+    }
+    else if (d > 0)
+    {
+        // move the window up
+        cmd_mask = (cmd_mask << d) | 1;
+        cmd_highest = sequence;
+    }
+    else
+        cmd_mask |= (uint32_t)1 << (-d);
+}
+
+int Modem::priority(Message &msg)
+{
+    switch (msg.type())
+    {
+        case MSG_TYPE_PINGRESPONSE:
+        case MSG_TYPE_COMMAND_ACK:
+            return MODEM_PRIORITY_URGENT;
+        case MSG_TYPE_SYSTEM:
+        case MSG_TYPE_SYSTEM_TEMPLATE:
+        {
+            // both start with the severity level
+            MSG_DATA_SYSTEM *md = (MSG_DATA_SYSTEM *)msg.get_data();
+            if (md->severity_level <= MSG_LEVEL_STATE_CHANGE)
+                return MODEM_PRIORITY_URGENT;
+            return MODEM_PRIORITY_STATUS;
+        };
+        case MSG_TYPE_TM_VARIABLE:
+        case MSG_TYPE_TELEMETRY:
+        case MSG_TYPE_GPS_POSITION:
+        case MSG_TYPE_IMU_AHRS:
+        case MSG_TYPE_IMU_GYRO:
+            return MODEM_PRIORITY_TELEMETRY;
+        default:
+            if (msg_data_size(msg.type()) > 0)
+                return MODEM_PRIORITY_TELEMETRY;
+            return MODEM_PRIORITY_STATUS;
+    }
+}
+
+bool Modem::same_variable(Message &a, Message &b)
+{
+    if (a.type() != b.type()) return false;
+    // data messages are identified by the hash
+    if (msg_data_size(a.type()) > 0)
+        return ((MSG_DATA_INT16 *)a.get_data())->hash == ((MSG_DATA_INT16 *)b.get_data())->hash;
+    // sensor data are identified by the sender
+    switch (a.type())
     {
-    	uint16_t transmit_count = message_num_chars_pending;
-    	if (transmit_count>available) transmit_count=available;
-		// write out
-		// the write is buffered and returns immediately
-		Serial1.write(message_buf_next, transmit_count);
-		message_num_chars_pending -= transmit_count;
-		message_buf_next += transmit_count;
+        case MSG_TYPE_GPS_POSITION:
+        case MSG_TYPE_IMU_AHRS:
+        case MSG_TYPE_IMU_GYRO:
+            return a.sender() == b.sender();
+        default:
+            return false;
     }
+}
+
+void Modem::queue_message(Message msg)
+{
+    // the age in the outbox is measured from now, whatever the time of the message is
+    // (messages without a time get the time they are transmitted, see Message::time())
+    uint64_t now = FC_time_us();
+    if (msg.time() == 0) msg.set_time(now);
+    int p = priority(msg);
+    std::list<ModemQueuedMessage> &queue = outbox[p];
+    // a newer sample replaces a still queued one of the same variable
+    // it keeps the place in the queue of the older one, but its age starts now
+    if (p == MODEM_PRIORITY_TELEMETRY)
+    {
+        for (std::list<ModemQueuedMessage>::iterator it = queue.begin(); it != queue.end(); it++)
+            if (same_variable(it->msg, msg))
+            {
+                outbox_bytes -= it->msg.encoded_size();
+                it->msg = msg;
+                it->queued = now;
+                outbox_bytes += msg.encoded_size();
+                down_merged++;
+                return;
+            };
+    };
+    // the oldest message is discarded if the queue is full
+    if (queue.size() >= MODEM_QUEUE_LIMIT)
+    {
+        outbox_bytes -= queue.front().msg.encoded_size();
+        queue.pop_front();
+        outbox_count--;
+        down_dropped++;
+    };
+    outbox_bytes += msg.encoded_size();
+    queue.push_back(ModemQueuedMessage(msg, now));
+    outbox_count++;
+}
+
+void Modem::expire_messages()
+{
+    uint64_t now = FC_time_us();
+    for (int p=0; p<MODEM_PRIORITY_LEVELS; p++)
+    {
+        std::list<ModemQueuedMessage> &queue = outbox[p];
+        std::list<ModemQueuedMessage>::iterator it = queue.begin();
+        while (it != queue.end())
+        {
+            if (now - it->queued > 1000ull*MODEM_MAX_LATENCY)
+            {
+                outbox_bytes -= it->msg.encoded_size();
+                it = queue.erase(it);
+                outbox_count--;
+                down_dropped++;
+            }
+            else
+                it++;
+        };
+    };
+}
+
+void Modem::refill_tokens()
+{
+    uint64_t now = FC_time_us();
+    float chars = 1.0e-6 * (float)(now - last_refill) * MODEM_AIR_CHARS_PER_SECOND;
+    last_refill = now;
+    tokens += chars;
+    if (tokens > MODEM_BUCKET_SIZE) tokens = MODEM_BUCKET_SIZE;
+    for (int p=0; p<MODEM_PRIORITY_LEVELS; p++)
+    {
+        class_tokens[p] += share[p] * chars;
+        if (class_tokens[p] > MODEM_BUCKET_SIZE) class_tokens[p] = MODEM_BUCKET_SIZE;
+    };
+}
+
+void Modem::set_share(int priority, float value)
+{
+    if ((priority>=0) and (priority<MODEM_PRIORITY_LEVELS))
+        share[priority] = value;
+}
+
+bool Modem::pack_frame()
+{
+    refill_tokens();
+    expire_messages();
+    if (outbox_count == 0) return false;
+    // the payload we can afford with the available airtime
+    // (the framing adds 4 bytes for payloads up to MODEM_MAX_PAYLOAD)
+    float budget = tokens - MODEM_PACKET_OVERHEAD - 4;
+    if (budget > MODEM_MAX_PAYLOAD) budget = MODEM_MAX_PAYLOAD;
+    // we wait until either everything waiting or a full frame can be sent
+    // packets as large as possible use the airtime best
+    float wanted = (outbox_bytes < MODEM_MAX_PAYLOAD) ? outbox_bytes : MODEM_MAX_PAYLOAD;
+    if (budget < wanted)
+    {
+        // no need to try again before the bucket has enough tokens
+        hold_time = 1 + (uint32_t)(1000.0 * (wanted - budget) / MODEM_AIR_CHARS_PER_SECOND);
+        hold_start = FC_time_now();
+        return false;
+    };
+    hold_time = 0;
+    char payload[MODEM_MAX_PAYLOAD];
+    size_t n = 0;
+    int count = 0;
+    uint64_t now = FC_time_us();
+    // In the first pass every class can use its guaranteed share of the airtime.
+    // In the second pass the remaining space is filled in the order of priority.
+    for (int pass=0; pass<2; pass++)
+        for (int p=0; p<MODEM_PRIORITY_LEVELS; p++)
+        {
+            std::list<ModemQueuedMessage> &queue = outbox[p];
+            while (!queue.empty())
+            {
+                size_t size = queue.front().msg.encoded_size();
+                // messages that can never be sent are discarded
+                if (size > MODEM_MAX_PAYLOAD)
+                {
+                    outbox_bytes -= size;
+                    queue.pop_front();
+                    outbox_count--;
+                    down_oversize++;
+                    continue;
+                };
+                // the order within a priority class is kept,
+                // but smaller messages of lower priority may fill the frame
+                if (n+size > budget) break;
+                if ((pass==0) and (size > class_tokens[p])) break;
+                if (pass==0) class_tokens[p] -= size;
+                uint32_t latency = (now - queue.front().queued) / 1000;
+                if (latency > down_max_latency) down_max_latency = latency;
+                queue.front().msg.buffer(payload+n, MODEM_MAX_PAYLOAD-n);
+                outbox_bytes -= size;
+                queue.pop_front();
+                outbox_count--;
+                n += size;
+                count++;
+            };
+        };
+    message_size = 0;
+    if (count>0)
+        message_size = frame_encode(
+            (uint8_t*)payload, n, (uint8_t*)message_buffer, sizeof(message_buffer));
+    if (message_size == 0) return false;
+    // the airtime is used up
+    tokens -= message_size + MODEM_PACKET_OVERHEAD;
+    down_frames++;
+    down_messages += count;
+    down_payload_bytes += n;
+    down_frame_bytes += message_size;
+    return true;
+}
+
+void Modem::send_message()
+{
+	// collect all waiting messages
+	while (downlink.count() > 0)
+	    queue_message(downlink.fetch());
+	// a new frame is only started when the previous one has been sent,
+	// the channel is idle and the airtime budget allows
+	if (serial->tx_busy()) return;
+	if (FC_elapsed_millis(last_time) <= 10) return;
+	if (FC_elapsed_millis(serial->aux_last_change()) <= 10) return;
+	if (busy()) return;
+	if (FC_elapsed_millis(hold_start) < hold_time) return;
+	if (!pack_frame()) return;
+	// the whole frame is transmitted by the serial port in one go
+	serial->write((const uint8_t *)message_buffer, message_size);
     // record the time
     last_time = FC_time_now();
 }
 
+void Modem::report_link()
+{
+    status_out.transmit(
+        Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, TPL_MODEM_UPLINK,
+            uplink_decoder.frames_ok(),
+            uplink_decoder.frames_lost(),
+            uplink_decoder.crc_errors(),
+            uplink_decoder.format_errors(),
+            uplink_decoder.overruns()) );
+    status_out.transmit(
+        Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, TPL_MODEM_COMMANDS,
+            up_commands, up_duplicates, up_rejected) );
+    // the payload efficiency is the fraction of the airtime used for message content
+    float per_frame = 0.0;
+    float efficiency = 0.0;
+    if (down_frames>0)
+    {
+        float airtime = down_frame_bytes + down_frames*MODEM_PACKET_OVERHEAD;
+        per_frame = (float)down_messages / (float)down_frames;
+        efficiency = 100.0*down_payload_bytes/airtime;
+    };
+    status_out.transmit(
+        Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, TPL_MODEM_DOWNLINK,
+            down_frames, down_messages, per_frame, efficiency,
+            down_merged, down_dropped, down_oversize,
+            down_max_latency) );
+    down_max_latency = 0;
+}
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <list>
 #include <string>
 
-#include "global.h"
+#include "kernel.h"
+#include "framing.h"
 #include "module.h"
 #include "message.h"
+#include "modem_serial.h"
 #include "port.h"
 
 /*
@@ -35,10 +38,63 @@
     
 */
 
-// the buffer size in HardwareSerial is set at 64
-// but we can transmit larger messages in several chunks
+// a frame is handed to the serial port as a whole (see modem_serial.h)
+// 200 bytes is the sub-packet size of the E220, a frame must not exceed it
+// otherwise it would be split into two packets on the air (each with its own RSSI byte)
 #define MODEM_BUFFER_SIZE 200
 
+// the largest payload that fits into one frame of MODEM_BUFFER_SIZE
+// (CRC 2 bytes, COBS overhead 1 byte and the delimiter for payloads up to 254 bytes)
+#define MODEM_MAX_PAYLOAD (MODEM_BUFFER_SIZE-4)
+
+// every packet on the air costs the time of this number of characters
+// in addition to its content (the idle time before sending, preamble and header)
+#define MODEM_PACKET_OVERHEAD 12
+
+// the configured air data rate in bit/s (see setup())
+// the airtime budget assumes 10 bits per character (like 8N1 on the serial line)
+// which leaves some margin for the LoRa packet header
+#define MODEM_AIR_RATE 9600
+#define MODEM_AIR_CHARS_PER_SECOND (MODEM_AIR_RATE/10)
+
+// the capacity of the airtime token bucket in characters
+// it has to hold at least one complete frame including the overhead
+#define MODEM_BUCKET_SIZE (2*(MODEM_BUFFER_SIZE+MODEM_PACKET_OVERHEAD))
+
+// messages waiting longer than this time [ms] for transmission are discarded
+#define MODEM_MAX_LATENCY 2000
+
+// the maximum number of messages waiting in one priority class
+#define MODEM_QUEUE_LIMIT 40
+
+// a message waiting in the outbox with the time it was queued [us]
+// the age in the outbox is measured from that time, not from the time of the message
+// (which is the time the content was acquired, e.g. by a sensor)
+struct ModemQueuedMessage {
+    ModemQueuedMessage(Message msg, uint64_t queued) : msg(msg), queued(queued) {};
+    Message     msg;
+    uint64_t    queued;
+};
+
+// the downlink messages are transmitted in this order of priority
+#define MODEM_PRIORITY_URGENT       0   // ping responses, system messages up to MSG_LEVEL_STATE_CHANGE
+#define MODEM_PRIORITY_TELEMETRY    1   // telemetry data and variable declarations
+#define MODEM_PRIORITY_STATUS       2   // all other messages
+#define MODEM_PRIORITY_LEVELS       3
+
+// the default airtime shares of the priority classes
+#define MODEM_SHARE_URGENT          0.2
+#define MODEM_SHARE_TELEMETRY       0.5
+#define MODEM_SHARE_STATUS          0.3
+
+// the width of the sequence number window used for duplicate detection
+// the ground station never has commands outstanding with sequence numbers
+// further apart than that
+#define MODEM_CMD_WINDOW 32
+
+// the time between two reports of the link statistics in ms
+#define MODEM_REPORT_INTERVAL 10000
+
 /*  
     This is a class encapsulating the transmission channel.
     It sends all received messages to the ground station.
@@ -46,8 +102,37 @@
     
     At 9600 baud over-the-air rate a single character takes 1ms transmission time.
     Before starting a transmission one should check, that the transmission buffer
-    has been empty for 8ms. A duration of 5ms during which no character
-    has been received is recognized as the end of one message.
+    has been empty for 8ms.
+    
+    All transmissions in both directions are framed (see framing.h) with a CRC-16.
+    The modem appends one RSSI byte after every received packet.
+    As every packet on the air has a considerable overhead, as many
+    queued messages as fit are packed into one frame (in the order
+    of their priority). The messages in a frame are just concatenated,
+    the compact binary format allows to split them again.
+    
+    The modem is accessed through the ModemSerial interface. On the
+    flight controller the data are transferred by DMA and the AUX pin
+    raises interrupts, so the interrupt of this module only looks at
+    a few flags and nothing is polled or copied per character.
+    
+    The downlink is limited by a token bucket filled at the air data rate,
+    so the queue in the E220 never grows. Every priority class has a share
+    of the airtime which is guaranteed (its own token bucket), airtime not
+    used by a class is available to the others in the order of priority.
+    Queued telemetry samples of the same variable are merged, only the newest
+    one is kept. Messages waiting longer than MODEM_MAX_LATENCY are dropped,
+    so the latency stays bounded at any offered load.
+    Frames with errors are discarded and counted, the link statistics
+    are reported periodically.
+    
+    Every command received is acknowledged (MSG_TYPE_COMMAND_ACK) with its
+    sequence number and the uplink RSSI in the next downlink frame.
+    The ground station retransmits commands until they are acknowledged.
+    Which of the last MODEM_CMD_WINDOW sequence numbers below the highest one
+    have been delivered is kept in a bit mask, so a retransmitted command
+    is acknowledged again but delivered only once. A sequence number further
+    behind can only come from a restarted ground station and is accepted as new.
 */
 class Modem : public Module
 {
@@ -55,8 +140,10 @@ class Modem : public Module
 public:
 
     // constructor
+    // the modem is connected through the given serial port
     Modem(
-        std::string name);
+        std::string name,
+        ModemSerial *serial);
     
     // initialization of the modem
     // the modem gets configured for 115200,8N1 serial communication
@@ -69,23 +156,30 @@ public:
     
 	// This is one worker function to be executed by te task manager.
 	// It is scheduled whenever any characters are received via the uplink.
-	// It puts read characters into the uplink_buffer.
+	// It puts read characters into the uplink frame decoder.
 	void receive();
 
-	// This is one worker function to be executed by te task manager.
-	// When the channel is idle for 5m but has received something,
-	// the message is assumed to be complete.
-	// Here is it processed.
+	// This is called by receive() whenever the decoder has completed a valid frame.
+	// Here the messages in the frame are processed.
 	void process_message();
 
 	// This is one worker function to be executed by te task manager.
-	// It is scheduled when a message waits in the downlink queue and
-	// enough time has elapsed from the last transmission.
-    // It is not possible, to send out all pending messages at once -
-    // one message per millisecond is more than the air channel can handle.
-    // The next message will be processed after 10 ms.
+	// It is scheduled when a message waits in the downlink queue or
+	// the outbox and enough time has elapsed from the last transmission.
+    // All waiting messages are sorted into the outbox and one frame
+    // is packed with as many messages as fit (highest priority first)
+    // as soon as the airtime budget allows.
+    // The next frame will be processed 10 ms after the transmission has ended.
 	void send_message();
 
+    // set the guaranteed fraction of the airtime for one priority class
+    // the shares of all classes should add up to 1.0 (or less)
+    void set_share(int priority, float share);
+
+	// This is one worker function to be executed by te task manager.
+	// It reports the statistics of the uplink and downlink frames.
+	void report_link();
+
     // destructor
     virtual ~Modem() {};
 
@@ -107,14 +201,86 @@ private:
     // check the AUX pin
     bool        busy();
     
+    // the priority class of a message to be sent
+    static int  priority(Message &msg);
+    
+    // check if a command with that sequence number has been delivered recently
+    bool        command_seen(uint16_t sequence);
+    
+    // record the sequence number of a delivered command
+    void        remember_command(uint16_t sequence);
+    
+    // check if two messages hold samples of the same telemetry variable
+    static bool same_variable(Message &a, Message &b);
+    
+    // put a message into the outbox according to its priority
+    // older samples of the same telemetry variable are replaced
+    void        queue_message(Message msg);
+    
+    // remove all messages from the outbox that have been waiting too long
+    void        expire_messages();
+    
+    // add the tokens for the time elapsed since the last refill
+    void        refill_tokens();
+    
+    // pack the messages waiting in the outbox into the message_buffer
+    // returns false if the airtime budget does not allow a frame yet
+    bool        pack_frame();
+    
     // time of the last setup or channel test action
     uint32_t    last_time;
+    
+    // time of the last link statistics report
+    uint32_t    last_report;
 
-    // where to store incoming transmissions
+    // where to store incoming transmissions during setup
     char        uplink_buffer[MODEM_BUFFER_SIZE];
     uint16_t    uplink_num_chars;
+    // the decoder for all incoming transmissions during operation
+    FrameDecoder uplink_decoder;
+    
+    // the messages waiting for transmission, one queue per priority class
+    std::list<ModemQueuedMessage> outbox[MODEM_PRIORITY_LEVELS];
+    // the number of messages in the outbox (read in the interrupt)
+    volatile uint16_t outbox_count;
+    // the number of bytes of all messages in the outbox
+    uint32_t    outbox_bytes;
+    
+    // the airtime budget [characters], total and per priority class
+    float       tokens;
+    float       class_tokens[MODEM_PRIORITY_LEVELS];
+    float       share[MODEM_PRIORITY_LEVELS];
+    uint64_t    last_refill;
+    // no new frame is started before the bucket has refilled (set from the task)
+    volatile uint32_t hold_start;
+    volatile uint32_t hold_time;
+    
+    // the serial connection to the modem
+    ModemSerial *serial;
+    
+    // the frame last handed over for transmission
     char        message_buffer[MODEM_BUFFER_SIZE];
-    uint16_t    message_num_chars_pending;
-    char*		message_buf_next;
+    uint16_t    message_size;
+    
+    // downlink statistics
+    uint32_t    down_frames;
+    uint32_t    down_messages;
+    uint32_t    down_payload_bytes;
+    uint32_t    down_frame_bytes;
+    uint32_t    down_oversize;
+    uint32_t    down_merged;
+    uint32_t    down_dropped;
+    // the longest time a message has waited in the outbox since the last report [ms]
+    uint32_t    down_max_latency;
+    
+    // the highest sequence number delivered and the delivered ones below
+    // (bit i set for cmd_highest-i)
+    bool        cmd_any;
+    uint16_t    cmd_highest;
+    uint32_t    cmd_mask;
+    // command statistics
+    uint32_t    up_commands;
+    uint32_t    up_duplicates;
+    uint32_t    up_rejected;
     
 };
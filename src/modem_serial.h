@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+    The serial connection of the modem module to the E220 modem.
+
+    This is everything the Modem module needs of the hardware:
+    the UART (written frame by frame, read in blocks), the M0/M1 mode pin
+    and the AUX status pin. The flight controller uses a DMA driven
+    implementation (see modem_serial_dma.h), on the host the interface
+    can be implemented by an emulated modem for testing.
+
+    All methods are called from tasks, the status methods
+    rx_pending(), tx_busy() and aux_busy() are also called from the
+    interrupt of the modem module, so they have to be cheap.
+*/
+class ModemSerial
+{
+
+public:
+
+    // open the serial port with the given baud rate (8N1)
+    // a port already open is closed and re-opened
+    virtual void begin(uint32_t baud) = 0;
+
+    // close the serial port
+    virtual void end() = 0;
+
+    // switch the modem between configuration mode (M0=M1=1)
+    // and transparent transmission mode (M0=M1=0)
+    virtual void set_config_mode(bool config) = 0;
+
+    // the modem indicates activity (AUX low) - it is sending,
+    // receiving or busy with internal operations
+    virtual bool aux_busy() = 0;
+
+    // the time [ms] (FC_time_now()) of the last change of the AUX pin
+    virtual uint32_t aux_last_change() = 0;
+
+    // the number of received bytes waiting to be read
+    virtual size_t available() = 0;
+
+    // there are received bytes waiting
+    // this may be set only after the line has become idle,
+    // so complete packets get read in one go
+    virtual bool rx_pending() = 0;
+
+    // read up to max_size received bytes, returns the number of bytes read
+    virtual size_t read(uint8_t *buffer, size_t max_size) = 0;
+
+    // a transmission is still in progress
+    virtual bool tx_busy() = 0;
+
+    // start the transmission of a block of data (usually one complete frame)
+    // the data are copied, so the buffer can be re-used right away
+    // returns false (and sends nothing) if a transmission is still in progress
+    // or the block is larger than MODEM_SERIAL_TX_SIZE
+    virtual bool write(const uint8_t *data, size_t size) = 0;
+
+    virtual ~ModemSerial() {};
+
+};
+
+// the maximum size of one transmission
+#define MODEM_SERIAL_TX_SIZE 256
+
+// the size of the receive ring buffer (a power of 2)
+#define MODEM_SERIAL_RX_SIZE 512
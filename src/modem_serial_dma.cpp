@@ -0,0 +1,161 @@
+#include "modem_serial_dma.h"
+
+#include <cstring>
+
+#include "Arduino.h"
+#include "HardwareSerial.h"
+#include "imxrt.h"
+#include "kernel.h"
+
+// the receive ring must be aligned to its size for the circular DMA addressing
+static volatile uint8_t rx_ring[MODEM_SERIAL_RX_SIZE] __attribute__((aligned(MODEM_SERIAL_RX_SIZE)));
+static volatile uint8_t tx_buffer[MODEM_SERIAL_TX_SIZE] __attribute__((aligned(32)));
+
+DMAModemSerial *DMAModemSerial::instance = NULL;
+
+DMAModemSerial::DMAModemSerial(uint8_t pin_mode, uint8_t pin_aux)
+{
+    this->pin_mode = pin_mode;
+    this->pin_aux = pin_aux;
+    open = false;
+    rx_tail = 0;
+    tx_active = false;
+    rx_idle = false;
+    aux_low = false;
+    aux_time = FC_time_now();
+    instance = this;
+}
+
+DMAModemSerial::~DMAModemSerial()
+{
+    end();
+    instance = NULL;
+}
+
+void DMAModemSerial::begin(uint32_t baud)
+{
+    if (open) end();
+    // the AUX pin is watched by an edge interrupt
+    pinMode(pin_aux, INPUT);
+    aux_low = (digitalRead(pin_aux) == LOW);
+    aux_time = FC_time_now();
+    attachInterrupt(pin_aux, aux_isr, CHANGE);
+    // let the driver set up pins, clock and baud rate
+    Serial1.begin(baud);
+    // take over from the driver - no interrupts per character
+    uint32_t ctrl = LPUART6_CTRL & ~(LPUART_CTRL_TIE | LPUART_CTRL_TCIE | LPUART_CTRL_RIE);
+    // the idle configuration can only be changed with transmitter and receiver disabled
+    LPUART6_CTRL = ctrl & ~(LPUART_CTRL_TE | LPUART_CTRL_RE);
+    // idle line detected after 1 idle character following a stop bit
+    ctrl |= LPUART_CTRL_ILT | LPUART_CTRL_IDLECFG(0) | LPUART_CTRL_ILIE;
+    // every single character requests a DMA transfer
+    LPUART6_WATER = LPUART_WATER_RXWATER(0) | LPUART_WATER_TXWATER(0);
+    LPUART6_CTRL = ctrl;
+    // the receiver DMA runs continuously into the ring
+    rx_tail = 0;
+    rx_idle = false;
+    rx_dma.begin(true);
+    rx_dma.source(*(volatile uint8_t *)&LPUART6_DATA);
+    rx_dma.destinationCircular(rx_ring, MODEM_SERIAL_RX_SIZE);
+    rx_dma.triggerAtHardwareEvent(DMAMUX_SOURCE_LPUART6_RX);
+    rx_dma.enable();
+    // the transmitter DMA is started for every block
+    tx_active = false;
+    tx_dma.begin(true);
+    tx_dma.destination(*(volatile uint8_t *)&LPUART6_DATA);
+    tx_dma.triggerAtHardwareEvent(DMAMUX_SOURCE_LPUART6_TX);
+    tx_dma.disableOnCompletion();
+    tx_dma.interruptAtCompletion();
+    tx_dma.attachInterrupt(tx_complete_isr);
+    LPUART6_BAUD |= LPUART_BAUD_TDMAE | LPUART_BAUD_RDMAE;
+    // the idle-line interrupt replaces the interrupt of the driver
+    attachInterruptVector(IRQ_LPUART6, uart_isr);
+    NVIC_ENABLE_IRQ(IRQ_LPUART6);
+    open = true;
+}
+
+void DMAModemSerial::end()
+{
+    if (!open) return;
+    LPUART6_BAUD &= ~(LPUART_BAUD_TDMAE | LPUART_BAUD_RDMAE);
+    LPUART6_CTRL &= ~LPUART_CTRL_ILIE;
+    tx_dma.disable();
+    rx_dma.disable();
+    tx_active = false;
+    Serial1.end();
+    detachInterrupt(pin_aux);
+    open = false;
+}
+
+void DMAModemSerial::set_config_mode(bool config)
+{
+    pinMode(pin_mode, OUTPUT);
+    digitalWrite(pin_mode, config ? HIGH : LOW);
+}
+
+size_t DMAModemSerial::available()
+{
+    if (!open) return 0;
+    size_t head = (volatile uint8_t *)rx_dma.destinationAddress() - rx_ring;
+    return (head - rx_tail) & (MODEM_SERIAL_RX_SIZE-1);
+}
+
+bool DMAModemSerial::rx_pending()
+{
+    // don't wait for the idle line if the ring is getting full
+    return rx_idle or (available() >= MODEM_SERIAL_RX_SIZE/2);
+}
+
+size_t DMAModemSerial::read(uint8_t *buffer, size_t max_size)
+{
+    // clear the flag first, so an idle line detected while reading is not lost
+    rx_idle = false;
+    size_t n = available();
+    if (n > max_size) n = max_size;
+    for (size_t i=0; i<n; i++)
+    {
+        buffer[i] = rx_ring[rx_tail];
+        rx_tail = (rx_tail+1) & (MODEM_SERIAL_RX_SIZE-1);
+    };
+    return n;
+}
+
+bool DMAModemSerial::tx_busy()
+{
+    // the last characters are still being shifted out after the DMA has completed
+    return tx_active or ((LPUART6_STAT & LPUART_STAT_TC) == 0);
+}
+
+bool DMAModemSerial::write(const uint8_t *data, size_t size)
+{
+    if (!open or tx_busy() or (size > MODEM_SERIAL_TX_SIZE)) return false;
+    if (size == 0) return true;
+    std::memcpy((void *)tx_buffer, data, size);
+    tx_active = true;
+    tx_dma.sourceBuffer(tx_buffer, size);
+    tx_dma.enable();
+    return true;
+}
+
+void DMAModemSerial::tx_complete_isr()
+{
+    instance->tx_dma.clearInterrupt();
+    instance->tx_active = false;
+    asm("DSB");
+}
+
+void DMAModemSerial::uart_isr()
+{
+    uint32_t stat = LPUART6_STAT;
+    // clear the idle and overrun flags (write 1 to clear)
+    LPUART6_STAT = stat & (LPUART_STAT_IDLE | LPUART_STAT_OR);
+    if (stat & LPUART_STAT_IDLE)
+        instance->rx_idle = true;
+    asm("DSB");
+}
+
+void DMAModemSerial::aux_isr()
+{
+    instance->aux_low = (digitalRead(instance->pin_aux) == LOW);
+    instance->aux_time = FC_time_now();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "modem_serial.h"
+#include "DMAChannel.h"
+
+// this is the RTS pin for the modem, used for M0 and M1 wired in parallel
+// high means config mode, low is transceiver mode
+#define MODEM_M0_M1 22
+// this is the CTS pin for the modem, used for AUX
+#define MODEM_AUX 23
+
+/*
+    The modem connected to Serial1 (LPUART6, pins 0/1) of the Teensy 4.1.
+
+    The UART is initialized by the Serial1 driver (pins, clock, baud rate),
+    then all data transfers are taken over by two DMA channels,
+    no interrupt per character is needed any more.
+
+    Transmissions are copied into a buffer and sent by the DMA in one go,
+    so a complete frame leaves without gaps. The DMA completion interrupt
+    marks the transmitter as free again.
+
+    The receiver DMA writes into a ring buffer continuously. The UART
+    raises an idle-line interrupt after the end of every received packet,
+    so the received data are read in one block when a packet is complete.
+
+    The AUX pin raises an interrupt on every edge, its state is never polled.
+
+    The buffers are static (located in the DTCM which is not cached),
+    there can only be one instance of this class.
+*/
+class DMAModemSerial : public ModemSerial
+{
+
+public:
+
+    // pin_mode is wired to M0 and M1, pin_aux to AUX
+    DMAModemSerial(uint8_t pin_mode, uint8_t pin_aux);
+
+    virtual void begin(uint32_t baud);
+    virtual void end();
+    virtual void set_config_mode(bool config);
+    virtual bool aux_busy() { return aux_low; };
+    virtual uint32_t aux_last_change() { return aux_time; };
+    virtual size_t available();
+    virtual bool rx_pending();
+    virtual size_t read(uint8_t *buffer, size_t max_size);
+    virtual bool tx_busy();
+    virtual bool write(const uint8_t *data, size_t size);
+
+    virtual ~DMAModemSerial();
+
+private:
+
+    // interrupt service routines
+    static void tx_complete_isr();
+    static void uart_isr();
+    static void aux_isr();
+
+    // the instance served by the interrupts
+    static DMAModemSerial *instance;
+
+    uint8_t     pin_mode;
+    uint8_t     pin_aux;
+    bool        open;
+
+    DMAChannel  tx_dma;
+    DMAChannel  rx_dma;
+
+    // the position in the receive ring up to which data have been read
+    size_t      rx_tail;
+
+    // set from the interrupts
+    volatile bool       tx_active;
+    volatile bool       rx_idle;
+    volatile bool       aux_low;
+    volatile uint32_t   aux_time;
+};
@@ -24,6 +24,8 @@ MotionSensor::MotionSensor(
     gyr_z = 0.0;
     last_calib_check = 0;
     last_cal_state = 0;
+    quat_time = 0;
+    gyro_time = 0;
     runlevel_= MODULE_RUNLEVEL_STOP;
 }
 
@@ -117,13 +119,14 @@ void MotionSensor::setup()
     // read calibration data from file
     bool data_OK = false;
     uint8_t data[22];
-    if (SD_card_OK and SD.exists("BNO055_calibration.dat"))
+    if (SD_card_OK and storage->exists("BNO055_calibration.dat"))
     {
-        File dataFile = SD.open("BNO055_calibration.dat", FILE_READ);
-        if (dataFile)
+        StorageFile* dataFile = storage->open("BNO055_calibration.dat", STORAGE_READ);
+        if (dataFile != NULL)
         {
-            size_t numbytes = dataFile.read(data, 22);
-            dataFile.close();
+            int numbytes = dataFile->read(data, 22);
+            dataFile->close();
+            delete dataFile;
             if (numbytes==22) data_OK = true;
         };
     };
@@ -170,10 +173,8 @@ void MotionSensor::check_calibration()
     if (cal != last_cal_state)
     {
         last_cal_state = cal;
-        std::string report("calibration status : ");
-        report += hexbyte(cal);
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, report) );
+            Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, TPL_IMU_CALIBRATION, cal) );
     }
     if (cal>=(uint8_t)0xc0)
     {
@@ -248,6 +249,8 @@ void MotionSensor::read_sensor()
             // most often this takes one more cycle
             if (bno055->NonBlockingRead_finished())
             {
+                // the data are acquired now
+                quat_time = FC_time_us();
                 uint8_t n_bytes = bno055->NonBlockingRead_available();
                 if (n_bytes == sizeof(raw))
                     // copy the data from buffer
@@ -267,6 +270,7 @@ void MotionSensor::read_sensor()
             convert_Quaternion(raw);
             // send out data messages
             DATA_IMU_AHRS data {
+                .time = quat_time,
                 .attitude = pitch,
                 .heading = heading,
                 .roll = roll };
@@ -303,6 +307,8 @@ void MotionSensor::read_sensor()
             // most often this takes one more cycle
             if (bno055->NonBlockingRead_finished())
             {
+                // the data are acquired now
+                gyro_time = FC_time_us();
                 uint8_t n_bytes = bno055->NonBlockingRead_available();
                 if (n_bytes == sizeof(gyr))
                     // copy the data from buffer
@@ -323,6 +329,7 @@ void MotionSensor::read_sensor()
             gyr_y = 0.0625*gyr.y;
             gyr_z = 0.0625*gyr.z;
             DATA_IMU_GYRO data {
+                .time = gyro_time,
                 .nick = gyr_y,
                 .yaw = gyr_z,
                 .roll = gyr_x };
@@ -96,6 +96,9 @@ private:
     float       gyr_y;      // rate of angular rotation [deg/s] about the wing axis (pitch up positive)
     float       gyr_z;      // rate of angular rotation [deg/s] about the belly axis (heading positive change or yaw right in hover)
 
+    uint64_t    quat_time;  // time [us] when the quaternion data have been read from the sensor
+    uint64_t    gyro_time;  // time [us] when the gyro data have been read from the sensor
+
     // variables for the sensor access
     
     BNO055                  *bno055;        // the IMU sensor
@@ -0,0 +1,130 @@
+#include "msg_templates.h"
+
+#include <cstdio>
+#include <cstring>
+
+const char* msg_template_format_string(uint16_t template_id)
+{
+    switch (template_id)
+    {
+#define MSG_TEMPLATE_CASE(name, id, format) case id: return format;
+        MSG_TEMPLATE_TABLE(MSG_TEMPLATE_CASE)
+#undef MSG_TEMPLATE_CASE
+        default: return NULL;
+    }
+}
+
+std::string msg_template_format(uint16_t template_id, const char* args, size_t size)
+{
+    const char* format = msg_template_format_string(template_id);
+    char buffer[48];
+    if (format == NULL)
+    {
+        int n = snprintf(buffer, sizeof(buffer), "unknown template %d", template_id);
+        return std::string(buffer, n);
+    };
+    std::string text;
+    size_t pos = 0;
+    while (*format != 0)
+    {
+        if (*format != '%')
+        {
+            text += *format++;
+            continue;
+        };
+        // collect the conversion specification up to the conversion character
+        char spec[16];
+        size_t len = 0;
+        spec[len++] = *format++;
+        while ((*format != 0) and (strchr("-+ #0123456789.", *format) != NULL) and (len < sizeof(spec)-2))
+            spec[len++] = *format++;
+        char conv = *format;
+        if (conv == 0) break;
+        format++;
+        spec[len++] = conv;
+        spec[len] = 0;
+        if (conv == '%')
+        {
+            text += '%';
+            continue;
+        };
+        int n = 0;
+        switch (conv)
+        {
+            case 'd':
+            case 'i':
+            {
+                int32_t value = 0;
+                if (pos+4 <= size) std::memcpy(&value, args+pos, 4);
+                pos += 4;
+                n = snprintf(buffer, sizeof(buffer), spec, (int)value);
+                break;
+            };
+            case 'u':
+            case 'x':
+            case 'X':
+            {
+                uint32_t value = 0;
+                if (pos+4 <= size) std::memcpy(&value, args+pos, 4);
+                pos += 4;
+                n = snprintf(buffer, sizeof(buffer), spec, (unsigned int)value);
+                break;
+            };
+            case 'f':
+            case 'e':
+            case 'g':
+            {
+                float value = 0.0;
+                if (pos+4 <= size) std::memcpy(&value, args+pos, 4);
+                pos += 4;
+                n = snprintf(buffer, sizeof(buffer), spec, (double)value);
+                break;
+            };
+            case 's':
+            case 'H':
+            {
+                // strings and blocks are copied directly
+                size_t count = 0;
+                if (pos < size) count = (uint8_t)args[pos];
+                pos++;
+                if (pos+count > size) count = (pos<size) ? size-pos : 0;
+                if (conv == 's')
+                    text += std::string(args+pos, count);
+                else
+                    for (size_t i=0; i<count; i++)
+                    {
+                        snprintf(buffer, sizeof(buffer), "%02X ", (uint8_t)args[pos+i]);
+                        text += buffer;
+                    };
+                pos += count;
+                break;
+            };
+            default:
+                break;
+        }
+        if (n > (int)sizeof(buffer)-1) n = sizeof(buffer)-1;
+        if (n > 0) text += std::string(buffer, n);
+    };
+    return text;
+}
+
+void MsgTemplateArgs::put(const char* text)
+{
+    put_block(text, strlen(text));
+}
+
+void MsgTemplateArgs::put_bytes(const void* src, size_t n)
+{
+    if (m_size+n > MSG_TEMPLATE_MAX_ARGS) return;
+    std::memcpy(m_data+m_size, src, n);
+    m_size += n;
+}
+
+void MsgTemplateArgs::put_block(const void* src, size_t n)
+{
+    if (n > 255) n = 255;
+    if (m_size+1+n > MSG_TEMPLATE_MAX_ARGS) return;
+    m_data[m_size++] = n;
+    std::memcpy(m_data+m_size, src, n);
+    m_size += n;
+}
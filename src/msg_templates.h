@@ -0,0 +1,116 @@
+/*
+    Templates for recurring system messages.
+
+    Instead of formatting a report into a text on the target, the sender
+    transmits the ID of a template and the values as binary arguments
+    (MSG_TYPE_SYSTEM_TEMPLATE). The text is only formatted by the consumer
+    that needs it (the text log, the ground station).
+
+    The format strings use printf-like conversions, the argument sizes
+    are determined by the conversion character :
+        %d %i       int32_t
+        %u %x %X    uint32_t
+        %f %e %g    float
+        %s          string (1 byte length + characters)
+        %H          byte block (1 byte length + bytes) printed as hex bytes
+        %%          the percent character (no argument)
+    Flags, width and precision are allowed for all but %H.
+
+    The table is parsed by tools/gen_msg_templates.py to generate the table
+    for the ground station (GCS/taros_templates.py). Keep one entry per line
+    and never change the ID of an existing template.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+#define MSG_TEMPLATE_TABLE(X) \
+    X(TPL_WATCHDOG_IRQ,         1, "IRQ total : %.2f us -- %s : %.2f us -- spacing : %.2f us") \
+    X(TPL_WATCHDOG_SYSTICK,     2, "delayed systick (spacing %.1f us)") \
+    X(TPL_WATCHDOG_TASK_DELAY,  3, "delayed task start %.1f us") \
+    X(TPL_WATCHDOG_RUNTIME,     4, "Module runtime -- %s : %.1f us") \
+    X(TPL_WATCHDOG_HEAP,        5, "HEAP from 0x%x to 0x%x used up to 0x%x") \
+    X(TPL_IMU_CALIBRATION,     16, "calibration status : %02X") \
+    X(TPL_MODEM_CONFIG,        32, "configuration response : %H") \
+    X(TPL_MODEM_FRAME,         33, "received frame : %H") \
+    X(TPL_MODEM_UPLINK,        34, "uplink frames received %u lost %u (crc %u format %u overrun %u)") \
+    X(TPL_MODEM_DOWNLINK,      35, "downlink frames %u messages %u (%.1f per frame) efficiency %.1f%% merged %u dropped %u oversize %u max latency %u ms") \
+    X(TPL_MODEM_COMMANDS,      36, "commands delivered %u duplicates %u rejected %u") \
+    X(TPL_FASTLOG_WRITE,       48, "fast log sectors %u errors %u dropped %u ring max %u bytes -- write latency <100us %u <200us %u <500us %u <1ms %u <2ms %u <5ms %u <10ms %u >10ms %u max %u us") \
+    X(TPL_SYSLOG_WRITE,        49, "system log messages %u (%.0f cycles per message) dropped %u sectors %u errors %u max write latency %u us") \
+    X(TPL_STORAGE_BENCH,       50, "storage %s : append %.1f us (max %u us) throughput %.2f MB/s sync %.0f us (max %u us)") \
+    X(TPL_LOG_REPEATED,        51, "last message repeated %u times") \
+    X(TPL_LOG_LIMITED,         52, "%u messages suppressed by the rate limit") \
+    X(TPL_LOG_DEGRADED,        53, "backlog of %u messages, only critical messages are passed") \
+    X(TPL_LOG_RECOVERED,       54, "backlog cleared after %u ms, %u messages dropped") \
+    X(TPL_FASTLOG_BUFFER,      55, "fast log buffer %u kB in %s used %u bytes max %u bytes (%.1f%%)") \
+    X(TPL_RECORDER_TRIGGER,    56, "flight recorder triggered by %s") \
+    X(TPL_RECORDER_EVENT,      57, "flight recorder event saved to %s : %u bytes, %.1f s before and %.1f s after the trigger, dropped %u errors %u") \
+    X(TPL_LOG_COMPRESSION,     58, "compressed %u bytes into %u blocks, ratio %.2f (payload %.2f) %.1f cycles per byte")
+
+#define MSG_TEMPLATE_ENUM(name, id, format) name = id,
+enum MsgTemplateID : uint16_t {
+    MSG_TEMPLATE_TABLE(MSG_TEMPLATE_ENUM)
+};
+#undef MSG_TEMPLATE_ENUM
+
+// the maximum number of bytes of all arguments of one template message
+#define MSG_TEMPLATE_MAX_ARGS 200
+
+// the format string of a template, NULL if the ID is unknown
+const char* msg_template_format_string(uint16_t template_id);
+
+// format the arguments of a template message into a text
+std::string msg_template_format(uint16_t template_id, const char* args, size_t size);
+
+/*
+    A block of bytes sent as template argument (printed with %H).
+    The data are copied when the message is created.
+*/
+struct MsgTemplateBlob {
+    const void* data;
+    size_t      size;
+};
+
+/*
+    The binary arguments of a template message.
+    The arguments are packed in the order given (little-endian),
+    the C++ type of every argument must match its conversion in the format.
+    Arguments exceeding MSG_TEMPLATE_MAX_ARGS are dropped.
+*/
+class MsgTemplateArgs {
+    public:
+        MsgTemplateArgs() { m_size = 0; };
+
+        // all integer types are sent as 32 bit
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value and std::is_signed<T>::value>::type
+        put(T value) { int32_t v = value; put_bytes(&v, 4); };
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value and std::is_unsigned<T>::value>::type
+        put(T value) { uint32_t v = value; put_bytes(&v, 4); };
+        void put(float value) { put_bytes(&value, 4); };
+        void put(double value) { put((float)value); };
+        void put(const char* text);
+        void put(const std::string &text) { put_block(text.data(), text.size()); };
+        void put(MsgTemplateBlob blob) { put_block(blob.data, blob.size); };
+
+        // pack any number of arguments
+        void pack() {};
+        template <typename T, typename... Rest>
+        void pack(T first, Rest... rest) { put(first); pack(rest...); };
+
+        const char* data() { return m_data; };
+        uint8_t size() { return m_size; };
+
+    private:
+        void put_bytes(const void* src, size_t n);
+        void put_block(const void* src, size_t n);
+
+        char    m_data[MSG_TEMPLATE_MAX_ARGS];
+        uint8_t m_size;
+};
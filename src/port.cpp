@@ -1,13 +1,27 @@
 #include "port.h"
-#include "global.h"
+#include "kernel.h"
 
 void SenderPort::set_receiver(ReceiverPort *receiver)
 {
     list_of_receivers.push_back(receiver);
 };
 
+void SenderPort::remove_receiver(ReceiverPort *receiver)
+{
+    auto it = list_of_receivers.begin();
+    while (it != list_of_receivers.end())
+    {
+        if (*it == receiver)
+            it = list_of_receivers.erase(it);
+        else
+            it++;
+    }
+};
+
 void SenderPort::transmit(Message message)
 {
+    // messages that have not been stamped by the producer get the time of transmission
+    if (message.time()==0) message.set_time(FC_time_us());
     for (auto const& port : list_of_receivers) {
         port->receive(message);
     }
@@ -18,6 +32,8 @@ void SenderPort::transmit(Message message)
 
 void ReceiverPort::receive(Message message)
 {
+    // messages may be directly put into a receiver port (e.g. system_log)
+    if (message.time()==0) message.set_time(FC_time_us());
     queue.push_back(message);
 };
 
@@ -15,6 +15,7 @@
 
 #include <cstdlib>
 #include <list>
+#include <vector>
 #include "message.h"
 
 class ReceiverPort;
@@ -30,9 +31,14 @@ class SenderPort {
         // there can be set several receivers that all will get
         // the messages sent through this port
         void set_receiver(ReceiverPort *receiver);
+        // receivers can be removed at runtime (all instances of that receiver)
+        void remove_receiver(ReceiverPort *receiver);
+        // the number of connected receivers
+        size_t count_receivers() { return list_of_receivers.size(); };
         void transmit(Message message);
     protected:
-        std::list<ReceiverPort*> list_of_receivers;
+        // the receivers are kept in a flat array to keep the fan-out cheap
+        std::vector<ReceiverPort*> list_of_receivers;
 };
 
 /*
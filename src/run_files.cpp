@@ -0,0 +1,77 @@
+#include "run_files.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "global.h"
+
+// the path of the directory of a run
+static std::string run_directory(int run)
+{
+    char path[40];
+    snprintf(path, sizeof(path), RUN_ROOT_DIR "/run.%05d", run);
+    return std::string(path);
+}
+
+// the number of the last run from the counter file, -1 if there is none
+static int read_run_counter()
+{
+    StorageFile* file = storage->open(RUN_COUNTER_FILE, STORAGE_READ);
+    if (file == NULL) return -1;
+    char text[16];
+    int n = file->read(text, sizeof(text)-1);
+    file->close();
+    delete file;
+    if (n <= 0) return -1;
+    text[n] = '\0';
+    char *end;
+    long run = strtol(text, &end, 10);
+    if ((end == text) or (run < 0)) return -1;
+    return (int)run;
+}
+
+static bool write_run_counter(int run)
+{
+    StorageFile* file = storage->open(RUN_COUNTER_FILE, STORAGE_WRITE);
+    if (file == NULL) return false;
+    char text[16];
+    int n = snprintf(text, sizeof(text), "%d\n", run);
+    bool ok = (file->write(text, n) == (size_t)n);
+    ok = file->close() and ok;
+    delete file;
+    return ok;
+}
+
+// the highest run number of all run directories present, -1 if there are none
+static int scan_runs()
+{
+    int last = -1;
+    storage->list(RUN_ROOT_DIR,
+        [&last](const char* name, bool directory)
+        {
+            int run;
+            if (directory and (sscanf(name, "run.%d", &run) == 1) and (run > last))
+                last = run;
+        });
+    return last;
+}
+
+int FC_start_run()
+{
+    if (not storage->exists(RUN_ROOT_DIR) and not storage->mkdir(RUN_ROOT_DIR)) return -1;
+    int run = read_run_counter() + 1;
+    // the counter is not to be trusted if the directory of the next run already exists
+    if ((run == 0) or storage->exists(run_directory(run).c_str()))
+        run = scan_runs() + 1;
+    // the counter is updated first, so the number is never used twice
+    if (not write_run_counter(run))
+        system_log->in.receive(
+            Message::SystemMessage("SYSTEM", FC_time_now(), MSG_LEVEL_WARNING, "run counter not written.") );
+    if (not storage->mkdir(run_directory(run).c_str())) return -1;
+    return run;
+}
+
+std::string FC_run_file(const char* name)
+{
+    return run_directory(SD_file_No) + "/" + name;
+}
@@ -0,0 +1,32 @@
+/*
+    The log files of every run are stored in a directory of their own.
+
+    /taros/run.cnt          the number of the last run (decimal text)
+    /taros/run.00000/       the log files of run 0 (system.log, fast.log, ...)
+    /taros/run.00001/
+    ...
+
+    The run number is taken from the counter file, so finding it takes
+    the same time no matter how many runs are on the card. Only if the counter
+    is missing, damaged or behind the directories present (e.g. the card was
+    written by an older software) the directory is scanned once for the highest run number.
+    The counter is updated before any file of the run is created,
+    so a run number is never used twice even if the system crashes during boot.
+*/
+
+#pragma once
+
+#include <string>
+
+// the directory holding the directories of all runs
+#define RUN_ROOT_DIR "/taros"
+
+// the file with the number of the last run
+#define RUN_COUNTER_FILE "/taros/run.cnt"
+
+// determine the number of this run and create its directory
+// returns the run number, -1 if the directory cannot be created
+int FC_start_run();
+
+// the path of a log file of the current run (SD_file_No)
+std::string FC_run_file(const char* name);
@@ -0,0 +1,94 @@
+/*
+    The interface to the file system holding the log files and the data files
+    (e.g. the sensor calibration).
+
+    The flight software accesses the storage only through this interface,
+    so the file system can be chosen when the software is built :
+        FatStorage (storage_fat.h)  FAT/exFAT on the SD card through SdFat (default)
+        LfsStorage (storage_lfs.h)  LittleFS on the SD card (USE_LITTLEFS)
+    The same code runs on the host against a block device in RAM or in a file
+    (see tools/storage_bench).
+
+    The storage is created in main.cpp before any module, see global.h.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// the modes of opening a file
+#define STORAGE_READ 0
+// the file is created if it does not exist, truncated if it does
+#define STORAGE_WRITE 1
+
+class StorageFile
+{
+
+public:
+
+    // the file is closed if this was not done before
+    virtual ~StorageFile() {};
+
+    // returns the number of bytes written
+    virtual size_t write(const void* data, size_t size) = 0;
+
+    // returns the number of bytes read, -1 on errors
+    virtual int read(void* data, size_t size) = 0;
+
+    // reserve the space for a file of the given size [bytes]
+    // returns false if that is not possible, the file can be written anyway
+    virtual bool preallocate(uint64_t size) = 0;
+
+    // the storage is still busy with a previous write,
+    // a write now would have to wait for it
+    virtual bool busy() = 0;
+
+    // end a write of multiple sectors on the storage device
+    // this should only be called if not busy(), then it returns immediately
+    virtual bool end_transfer() { return true; };
+
+    // write the metadata of the file (its size), so the data written so far survive a power loss
+    virtual bool sync() = 0;
+
+    // cut the file at the current position
+    virtual bool truncate() = 0;
+
+    // the current position [bytes]
+    virtual uint64_t position() = 0;
+
+    // the size of the file recorded on the storage [bytes]
+    virtual uint64_t size() = 0;
+
+    virtual bool close() = 0;
+
+};
+
+class Storage
+{
+
+public:
+
+    virtual ~Storage() {};
+
+    // the name of the file system used in reports
+    virtual const char* name() = 0;
+
+    // open a file in the given mode (STORAGE_READ, STORAGE_WRITE)
+    // returns NULL if that is not possible
+    // the file is owned by the caller and has to be deleted after use
+    virtual StorageFile* open(const char* path, int mode) = 0;
+
+    virtual bool exists(const char* path) = 0;
+
+    virtual bool mkdir(const char* path) = 0;
+
+    // delete a file
+    virtual bool remove(const char* path) = 0;
+
+    // call f with the name of every entry of a directory and whether it is a directory itself
+    // returns false if the directory cannot be read
+    virtual bool list(const char* path, std::function<void(const char* name, bool directory)> f) = 0;
+
+};
@@ -0,0 +1,60 @@
+#include "storage_bench.h"
+
+#include <cstring>
+
+bool storage_benchmark(Storage* storage, const char* path, uint32_t (*micros)(), StorageBenchResult &result)
+{
+    static uint8_t buffer[STORAGE_BENCH_CHUNK];
+    for (int i=0; i<STORAGE_BENCH_CHUNK; i++) buffer[i] = (uint8_t)i;
+    memset(&result, 0, sizeof(result));
+    bool ok = true;
+
+    // small appends
+    StorageFile* file = storage->open(path, STORAGE_WRITE);
+    if (file == NULL) return false;
+    uint32_t total = 0;
+    for (int i=0; i<STORAGE_BENCH_APPENDS; i++)
+    {
+        uint32_t start = micros();
+        if (file->write(buffer, STORAGE_BENCH_RECORD) != STORAGE_BENCH_RECORD) ok = false;
+        uint32_t dt = micros() - start;
+        total += dt;
+        if (dt > result.append_max) result.append_max = dt;
+    };
+    result.append_mean = (float)total / STORAGE_BENCH_APPENDS;
+    file->close();
+    delete file;
+
+    // throughput including the final commit of the file
+    file = storage->open(path, STORAGE_WRITE);
+    if (file == NULL) return false;
+    file->preallocate(STORAGE_BENCH_SIZE);
+    uint32_t start = micros();
+    for (int i=0; i<STORAGE_BENCH_SIZE/STORAGE_BENCH_CHUNK; i++)
+        if (file->write(buffer, STORAGE_BENCH_CHUNK) != STORAGE_BENCH_CHUNK) ok = false;
+    if (not file->sync()) ok = false;
+    uint32_t dt = micros() - start;
+    if (dt > 0) result.throughput = (float)STORAGE_BENCH_SIZE / dt;
+    file->close();
+    delete file;
+
+    // sectors written and committed one by one
+    file = storage->open(path, STORAGE_WRITE);
+    if (file == NULL) return false;
+    total = 0;
+    for (int i=0; i<STORAGE_BENCH_SYNCS; i++)
+    {
+        uint32_t start = micros();
+        if (file->write(buffer, 512) != 512) ok = false;
+        if (not file->sync()) ok = false;
+        uint32_t dt = micros() - start;
+        total += dt;
+        if (dt > result.sync_max) result.sync_max = dt;
+    };
+    result.sync_mean = (float)total / STORAGE_BENCH_SYNCS;
+    file->close();
+    delete file;
+
+    storage->remove(path);
+    return ok;
+}
@@ -0,0 +1,46 @@
+/*
+    A benchmark of the storage (see storage.h) with the access patterns of the log files :
+        append      small records (STORAGE_BENCH_RECORD bytes) written one by one,
+                    this is what the file writers do with every task
+        throughput  a large file written in big chunks
+        sync        a sector written and committed to the file system,
+                    the cost of making the data written so far survive a power loss
+
+    The same code runs on the target (STORAGE_BENCHMARK, see main.cpp)
+    and on the host against a block device in RAM or in a file (tools/storage_bench).
+    It does not depend on the kernel, the time is taken from the function given.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include "storage.h"
+
+// the size of the records appended [bytes]
+#define STORAGE_BENCH_RECORD 64
+// the number of records appended
+#define STORAGE_BENCH_APPENDS 2000
+// the size of the chunks written for the throughput [bytes]
+#define STORAGE_BENCH_CHUNK 4096
+// the size of the file written for the throughput [bytes]
+#define STORAGE_BENCH_SIZE (4*1024*1024)
+// the number of sectors written and synced
+#define STORAGE_BENCH_SYNCS 50
+
+struct StorageBenchResult
+{
+    // the time for appending one record [us]
+    float append_mean;
+    uint32_t append_max;
+    // the sustained write rate [MB/s]
+    float throughput;
+    // the time for writing one sector and syncing the file [us]
+    float sync_mean;
+    uint32_t sync_max;
+};
+
+// run the benchmark with a scratch file of the given path, which is deleted afterwards
+// micros() returns the time in microseconds
+// returns false if the file cannot be written
+bool storage_benchmark(Storage* storage, const char* path, uint32_t (*micros)(), StorageBenchResult &result);
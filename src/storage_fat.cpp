@@ -0,0 +1,98 @@
+#include "storage_fat.h"
+
+FatStorageFile::~FatStorageFile()
+{
+    if (m_file) m_file.close();
+}
+
+size_t FatStorageFile::write(const void* data, size_t size)
+{
+    return m_file.write(data, size);
+}
+
+int FatStorageFile::read(void* data, size_t size)
+{
+    return m_file.read(data, size);
+}
+
+bool FatStorageFile::preallocate(uint64_t size)
+{
+    return m_file.preAllocate(size);
+}
+
+bool FatStorageFile::busy()
+{
+    return m_file.isBusy();
+}
+
+bool FatStorageFile::end_transfer()
+{
+    return SD.sdfs.card()->syncDevice();
+}
+
+bool FatStorageFile::sync()
+{
+    return m_file.sync();
+}
+
+bool FatStorageFile::truncate()
+{
+    return m_file.truncate();
+}
+
+uint64_t FatStorageFile::position()
+{
+    return m_file.curPosition();
+}
+
+uint64_t FatStorageFile::size()
+{
+    return m_file.fileSize();
+}
+
+bool FatStorageFile::close()
+{
+    return m_file.close();
+}
+
+StorageFile* FatStorage::open(const char* path, int mode)
+{
+    // open the file through SdFat directly, the File wrapper of the SD library
+    // offers neither the preallocation nor the busy status of the card
+    oflag_t flags = O_RDONLY;
+    if (mode == STORAGE_WRITE) flags = O_RDWR | O_CREAT | O_TRUNC;
+    FsFile file = SD.sdfs.open(path, flags);
+    if (not file) return NULL;
+    return new FatStorageFile(file);
+}
+
+bool FatStorage::exists(const char* path)
+{
+    return SD.sdfs.exists(path);
+}
+
+bool FatStorage::mkdir(const char* path)
+{
+    return SD.sdfs.mkdir(path);
+}
+
+bool FatStorage::remove(const char* path)
+{
+    return SD.sdfs.remove(path);
+}
+
+bool FatStorage::list(const char* path, std::function<void(const char* name, bool directory)> f)
+{
+    FsFile dir = SD.sdfs.open(path, O_RDONLY);
+    if (not dir) return false;
+    FsFile entry;
+    while (entry.openNext(&dir, O_RDONLY))
+    {
+        char name[64];
+        if (entry.getName(name, sizeof(name)) > 0)
+            f(name, entry.isDir());
+        entry.close();
+    };
+    dir.close();
+    return true;
+}
@@ -0,0 +1,59 @@
+/*
+    The storage on the FAT/exFAT formatted SD card accessed through SdFat.
+    The card has to be initialized (SD.begin()) before the storage is used.
+*/
+
+#pragma once
+
+#include <SD.h>
+
+#include "storage.h"
+
+class FatStorageFile : public StorageFile
+{
+
+public:
+
+    FatStorageFile(FsFile file) { m_file = file; };
+
+    virtual ~FatStorageFile();
+
+    virtual size_t write(const void* data, size_t size);
+    virtual int read(void* data, size_t size);
+
+    // the clusters are allocated in one contiguous piece and the size is written
+    // to the directory entry (on FAT), so no metadata has to be written while the file is filled
+    virtual bool preallocate(uint64_t size);
+
+    // the card is busy with a previous sector
+    virtual bool busy();
+
+    // stop the multi-sector write of the card
+    virtual bool end_transfer();
+
+    virtual bool sync();
+    virtual bool truncate();
+    virtual uint64_t position();
+    virtual uint64_t size();
+    virtual bool close();
+
+private:
+
+    FsFile m_file;
+
+};
+
+class FatStorage : public Storage
+{
+
+public:
+
+    virtual const char* name() { return "FAT"; };
+
+    virtual StorageFile* open(const char* path, int mode);
+    virtual bool exists(const char* path);
+    virtual bool mkdir(const char* path);
+    virtual bool remove(const char* path);
+    virtual bool list(const char* path, std::function<void(const char* name, bool directory)> f);
+
+};
@@ -0,0 +1,217 @@
+#include "storage_lfs.h"
+
+#ifdef USE_LITTLEFS
+
+#include <cstring>
+
+// the callbacks of littlefs, the context is the block device
+
+static int lfs_device_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
+{
+    LfsBlockDevice* device = (LfsBlockDevice*)c->context;
+    return device->read(block, off, buffer, size) ? LFS_ERR_OK : LFS_ERR_IO;
+}
+
+static int lfs_device_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+    LfsBlockDevice* device = (LfsBlockDevice*)c->context;
+    return device->prog(block, off, buffer, size) ? LFS_ERR_OK : LFS_ERR_IO;
+}
+
+static int lfs_device_erase(const struct lfs_config *c, lfs_block_t block)
+{
+    LfsBlockDevice* device = (LfsBlockDevice*)c->context;
+    return device->erase(block) ? LFS_ERR_OK : LFS_ERR_IO;
+}
+
+static int lfs_device_sync(const struct lfs_config *c)
+{
+    LfsBlockDevice* device = (LfsBlockDevice*)c->context;
+    return device->sync() ? LFS_ERR_OK : LFS_ERR_IO;
+}
+
+LfsStorageFile::LfsStorageFile(LfsStorage* storage, int slot)
+{
+    m_storage = storage;
+    m_slot = slot;
+}
+
+LfsStorageFile::~LfsStorageFile()
+{
+    close();
+}
+
+size_t LfsStorageFile::write(const void* data, size_t size)
+{
+    if (m_slot < 0) return 0;
+    lfs_ssize_t n = lfs_file_write(&m_storage->m_lfs, &m_storage->m_files[m_slot], data, size);
+    return (n < 0) ? 0 : n;
+}
+
+int LfsStorageFile::read(void* data, size_t size)
+{
+    if (m_slot < 0) return -1;
+    lfs_ssize_t n = lfs_file_read(&m_storage->m_lfs, &m_storage->m_files[m_slot], data, size);
+    return (n < 0) ? -1 : n;
+}
+
+bool LfsStorageFile::busy()
+{
+    return m_storage->m_device->busy();
+}
+
+bool LfsStorageFile::sync()
+{
+    if (m_slot < 0) return false;
+    return lfs_file_sync(&m_storage->m_lfs, &m_storage->m_files[m_slot]) == LFS_ERR_OK;
+}
+
+bool LfsStorageFile::truncate()
+{
+    if (m_slot < 0) return false;
+    lfs_file_t* file = &m_storage->m_files[m_slot];
+    lfs_soff_t pos = lfs_file_tell(&m_storage->m_lfs, file);
+    if (pos < 0) return false;
+    return lfs_file_truncate(&m_storage->m_lfs, file, pos) == LFS_ERR_OK;
+}
+
+uint64_t LfsStorageFile::position()
+{
+    if (m_slot < 0) return 0;
+    lfs_soff_t pos = lfs_file_tell(&m_storage->m_lfs, &m_storage->m_files[m_slot]);
+    return (pos < 0) ? 0 : pos;
+}
+
+uint64_t LfsStorageFile::size()
+{
+    if (m_slot < 0) return 0;
+    lfs_soff_t size = lfs_file_size(&m_storage->m_lfs, &m_storage->m_files[m_slot]);
+    return (size < 0) ? 0 : size;
+}
+
+bool LfsStorageFile::close()
+{
+    if (m_slot < 0) return true;
+    bool ok = (lfs_file_close(&m_storage->m_lfs, &m_storage->m_files[m_slot]) == LFS_ERR_OK);
+    m_storage->m_file_used[m_slot] = false;
+    m_slot = -1;
+    return ok;
+}
+
+LfsStorage::LfsStorage(LfsBlockDevice* device)
+{
+    m_device = device;
+    memset(&m_config, 0, sizeof(m_config));
+    m_config.context = device;
+    m_config.read = lfs_device_read;
+    m_config.prog = lfs_device_prog;
+    m_config.erase = lfs_device_erase;
+    m_config.sync = lfs_device_sync;
+    m_config.read_size = LFS_STORAGE_IO_SIZE;
+    m_config.prog_size = LFS_STORAGE_IO_SIZE;
+    m_config.block_size = LFS_STORAGE_BLOCK_SIZE;
+    m_config.block_count = device->block_count();
+    // SD cards do their own wear leveling
+    m_config.block_cycles = -1;
+    m_config.cache_size = LFS_STORAGE_CACHE_SIZE;
+    m_config.lookahead_size = LFS_STORAGE_LOOKAHEAD_SIZE;
+    m_config.read_buffer = m_read_buffer;
+    m_config.prog_buffer = m_prog_buffer;
+    m_config.lookahead_buffer = m_lookahead_buffer;
+    for (int i=0; i<LFS_STORAGE_MAX_FILES; i++)
+    {
+        memset(&m_file_config[i], 0, sizeof(m_file_config[i]));
+        m_file_config[i].buffer = m_file_buffer[i];
+        m_file_used[i] = false;
+    };
+}
+
+bool LfsStorage::begin(bool format)
+{
+    if (lfs_mount(&m_lfs, &m_config) == LFS_ERR_OK) return true;
+    if (not format) return false;
+    if (lfs_format(&m_lfs, &m_config) != LFS_ERR_OK) return false;
+    return lfs_mount(&m_lfs, &m_config) == LFS_ERR_OK;
+}
+
+StorageFile* LfsStorage::open(const char* path, int mode)
+{
+    int slot = 0;
+    while ((slot < LFS_STORAGE_MAX_FILES) and m_file_used[slot]) slot++;
+    if (slot >= LFS_STORAGE_MAX_FILES) return NULL;
+    int flags = LFS_O_RDONLY;
+    if (mode == STORAGE_WRITE) flags = LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC;
+    if (lfs_file_opencfg(&m_lfs, &m_files[slot], path, flags, &m_file_config[slot]) != LFS_ERR_OK)
+        return NULL;
+    m_file_used[slot] = true;
+    return new LfsStorageFile(this, slot);
+}
+
+bool LfsStorage::exists(const char* path)
+{
+    struct lfs_info info;
+    return lfs_stat(&m_lfs, path, &info) == LFS_ERR_OK;
+}
+
+bool LfsStorage::mkdir(const char* path)
+{
+    return lfs_mkdir(&m_lfs, path) == LFS_ERR_OK;
+}
+
+bool LfsStorage::remove(const char* path)
+{
+    return lfs_remove(&m_lfs, path) == LFS_ERR_OK;
+}
+
+bool LfsStorage::list(const char* path, std::function<void(const char* name, bool directory)> f)
+{
+    lfs_dir_t dir;
+    if (lfs_dir_open(&m_lfs, &dir, path) != LFS_ERR_OK) return false;
+    struct lfs_info info;
+    while (lfs_dir_read(&m_lfs, &dir, &info) > 0)
+    {
+        if ((strcmp(info.name, ".") == 0) or (strcmp(info.name, "..") == 0)) continue;
+        f(info.name, info.type == LFS_TYPE_DIR);
+    };
+    lfs_dir_close(&m_lfs, &dir);
+    return true;
+}
+
+#ifdef ARDUINO
+
+// the sectors of the card in a block of the file system
+#define LFS_SD_SECTORS (LFS_STORAGE_BLOCK_SIZE/512)
+
+bool LfsSdCard::begin()
+{
+    return m_card.begin(SdioConfig(FIFO_SDIO));
+}
+
+uint32_t LfsSdCard::block_count()
+{
+    return m_card.sectorCount() / LFS_SD_SECTORS;
+}
+
+bool LfsSdCard::read(uint32_t block, uint32_t offset, void* buffer, uint32_t size)
+{
+    return m_card.readSectors(block*LFS_SD_SECTORS + offset/512, (uint8_t*)buffer, size/512);
+}
+
+bool LfsSdCard::prog(uint32_t block, uint32_t offset, const void* buffer, uint32_t size)
+{
+    return m_card.writeSectors(block*LFS_SD_SECTORS + offset/512, (const uint8_t*)buffer, size/512);
+}
+
+bool LfsSdCard::sync()
+{
+    return m_card.syncDevice();
+}
+
+bool LfsSdCard::busy()
+{
+    return m_card.isBusy();
+}
+
+#endif
+
+#endif
@@ -0,0 +1,169 @@
+/*
+    The storage on a LittleFS formatted block device, usually the SD card.
+
+    LittleFS is a copy-on-write file system, the data written
+    to a file become part of the file system only with sync() or close().
+    An interrupted write never damages the file system, the file is found
+    in the state of its last sync(). There is no preallocation, blocks are taken
+    from the free space as the file grows without any metadata being written.
+
+    This needs the littlefs library (https://github.com/littlefs-project/littlefs,
+    lfs.c lfs.h lfs_util.c lfs_util.h) in lib/littlefs and USE_LITTLEFS defined
+    (see the Makefile). Without it nothing of this is compiled.
+    No memory is allocated by littlefs, all buffers are part of the LfsStorage.
+*/
+
+#pragma once
+
+#ifdef USE_LITTLEFS
+
+#include "lfs.h"
+#include "storage.h"
+
+// the size of the blocks of the file system [bytes] (8 sectors of the SD card)
+#define LFS_STORAGE_BLOCK_SIZE 4096
+
+// the unit of reading and writing the device [bytes]
+#define LFS_STORAGE_IO_SIZE 512
+
+// the size of the caches (one for reading, one for writing and one per open file) [bytes]
+#define LFS_STORAGE_CACHE_SIZE 512
+
+// the size of the bitmap of free blocks searched at once [bytes]
+#define LFS_STORAGE_LOOKAHEAD_SIZE 128
+
+// the number of files that can be open at the same time
+#define LFS_STORAGE_MAX_FILES 4
+
+/*
+    The device holding the file system, read and written in blocks of LFS_STORAGE_BLOCK_SIZE.
+*/
+class LfsBlockDevice
+{
+
+public:
+
+    virtual ~LfsBlockDevice() {};
+
+    // the number of blocks of the device
+    virtual uint32_t block_count() = 0;
+
+    // read or write a part of a block
+    // offset and size are multiples of LFS_STORAGE_IO_SIZE
+    virtual bool read(uint32_t block, uint32_t offset, void* buffer, uint32_t size) = 0;
+    virtual bool prog(uint32_t block, uint32_t offset, const void* buffer, uint32_t size) = 0;
+
+    // SD cards do not need to be erased before they are written
+    virtual bool erase(uint32_t block) { return true; };
+
+    // wait until everything written has been stored
+    virtual bool sync() = 0;
+
+    // the device is still busy with a previous write
+    virtual bool busy() { return false; };
+
+};
+
+class LfsStorage;
+
+class LfsStorageFile : public StorageFile
+{
+
+public:
+
+    // the file uses one of the file slots of the storage
+    LfsStorageFile(LfsStorage* storage, int slot);
+
+    virtual ~LfsStorageFile();
+
+    virtual size_t write(const void* data, size_t size);
+    virtual int read(void* data, size_t size);
+
+    // nothing to do, there is no preallocation
+    virtual bool preallocate(uint64_t size) { return true; };
+
+    virtual bool busy();
+
+    // commit the file to the file system
+    virtual bool sync();
+
+    virtual bool truncate();
+    virtual uint64_t position();
+    virtual uint64_t size();
+    virtual bool close();
+
+private:
+
+    LfsStorage* m_storage;
+    int m_slot;
+
+};
+
+class LfsStorage : public Storage
+{
+
+public:
+
+    LfsStorage(LfsBlockDevice* device);
+
+    // mount the file system
+    // if format is true an unformatted device is formatted, otherwise that fails
+    bool begin(bool format);
+
+    virtual const char* name() { return "LittleFS"; };
+
+    virtual StorageFile* open(const char* path, int mode);
+    virtual bool exists(const char* path);
+    virtual bool mkdir(const char* path);
+    virtual bool remove(const char* path);
+    virtual bool list(const char* path, std::function<void(const char* name, bool directory)> f);
+
+private:
+
+    friend class LfsStorageFile;
+
+    LfsBlockDevice* m_device;
+    lfs_t m_lfs;
+    struct lfs_config m_config;
+    uint8_t m_read_buffer[LFS_STORAGE_CACHE_SIZE] __attribute__((aligned(4)));
+    uint8_t m_prog_buffer[LFS_STORAGE_CACHE_SIZE] __attribute__((aligned(4)));
+    uint8_t m_lookahead_buffer[LFS_STORAGE_LOOKAHEAD_SIZE] __attribute__((aligned(4)));
+
+    // the open files with their caches
+    lfs_file_t m_files[LFS_STORAGE_MAX_FILES];
+    struct lfs_file_config m_file_config[LFS_STORAGE_MAX_FILES];
+    uint8_t m_file_buffer[LFS_STORAGE_MAX_FILES][LFS_STORAGE_CACHE_SIZE] __attribute__((aligned(4)));
+    bool m_file_used[LFS_STORAGE_MAX_FILES];
+
+};
+
+#ifdef ARDUINO
+
+#include <SdFat.h>
+
+/*
+    The SD card accessed by its sectors, there is no FAT file system on it.
+*/
+class LfsSdCard : public LfsBlockDevice
+{
+
+public:
+
+    // initialize the card
+    bool begin();
+
+    virtual uint32_t block_count();
+    virtual bool read(uint32_t block, uint32_t offset, void* buffer, uint32_t size);
+    virtual bool prog(uint32_t block, uint32_t offset, const void* buffer, uint32_t size);
+    virtual bool sync();
+    virtual bool busy();
+
+private:
+
+    SdioCard m_card;
+
+};
+
+#endif
+
+#endif
@@ -1,3 +1,5 @@
+#include <atomic>
+
 #include "stream.h"
 #include "global.h"
 #include "message.h" // for the data types
@@ -8,6 +10,19 @@ void StreamSender<datatype>::set_receiver(StreamReceiver<datatype> *receiver)
     list_of_receivers.push_back(receiver);
 };
 
+template <typename datatype>
+void StreamSender<datatype>::remove_receiver(StreamReceiver<datatype> *receiver)
+{
+    auto it = list_of_receivers.begin();
+    while (it != list_of_receivers.end())
+    {
+        if (*it == receiver)
+            it = list_of_receivers.erase(it);
+        else
+            it++;
+    }
+};
+
 template <typename datatype>
 void StreamSender<datatype>::transmit(datatype data)
 {
@@ -41,8 +56,84 @@ datatype StreamReceiver<datatype>::fetch()
 };
 
 
+
+template <typename datatype>
+StreamMailbox<datatype>::StreamMailbox()
+{
+    box = datatype();
+    last_data = datatype();
+    sequence = 0;
+    last_sequence = 0;
+    skip_count = 0;
+};
+
+template <typename datatype>
+void StreamMailbox<datatype>::receive(datatype data)
+{
+    // the sequence number is odd while we are writing
+    sequence++;
+    // the compiler must not move the data copy across the sequence updates
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    box = data;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    sequence++;
+};
+
+template <typename datatype>
+uint16_t StreamMailbox<datatype>::count()
+{
+    uint32_t seq = sequence;
+    // nothing new or a write in progress
+    if ((seq == last_sequence) or (seq & 1)) return 0;
+    return 1;
+};
+
+template <typename datatype>
+datatype StreamMailbox<datatype>::fetch()
+{
+    datatype data;
+    uint32_t seq;
+    do
+    {
+        seq = sequence;
+        // we have preempted the sender within a write, we cannot wait for it
+        if (seq & 1) return last_data;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        data = box;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        // if the sender has preempted us during the copy we have to read again
+    } while (seq != sequence);
+    // every write advances the sequence by 2
+    uint32_t written = (seq - last_sequence) / 2;
+    if (written > 1) skip_count += written - 1;
+    last_sequence = seq;
+    last_data = data;
+    return data;
+};
+
+
+template <>
+uint16_t stream_message_type<DATA_IMU_AHRS>() { return MSG_TYPE_IMU_AHRS; };
+
+template <>
+uint16_t stream_message_type<DATA_IMU_GYRO>() { return MSG_TYPE_IMU_GYRO; };
+
+template <typename datatype>
+void StreamForwarder<datatype>::receive(datatype data)
+{
+    Message msg(sender, stream_message_type<datatype>(), sizeof(datatype), &data);
+    // the message keeps the acquisition time of the data
+    msg.set_time(data.time);
+    out.transmit(msg);
+};
+
+
 // we have to instantiate the classes for every possible data type
 template class StreamSender<DATA_IMU_AHRS>;
 template class StreamReceiver<DATA_IMU_AHRS>;
+template class StreamMailbox<DATA_IMU_AHRS>;
+template class StreamForwarder<DATA_IMU_AHRS>;
 template class StreamSender<DATA_IMU_GYRO>;
 template class StreamReceiver<DATA_IMU_GYRO>;
+template class StreamMailbox<DATA_IMU_GYRO>;
+template class StreamForwarder<DATA_IMU_GYRO>;
@@ -10,8 +10,11 @@
 #include <cstdint>
 #include <cstdlib>
 #include <list>
+#include <string>
+#include <vector>
 
 #include "types.h"
+#include "port.h"
 
 template <typename datatype>
 class StreamReceiver;
@@ -28,9 +31,12 @@ class StreamSender {
         // there can be set several receivers that all will get
         // the messages sent through this port
         void set_receiver(StreamReceiver<datatype> *receiver);
+        // receivers can be removed at runtime (all instances of that receiver)
+        void remove_receiver(StreamReceiver<datatype> *receiver);
         void transmit(datatype data);
     protected:
-        std::list<StreamReceiver<datatype>*> list_of_receivers;
+        // the receivers are kept in a flat array to keep the fan-out cheap
+        std::vector<StreamReceiver<datatype>*> list_of_receivers;
 };
 
 /*
@@ -45,12 +51,71 @@ class StreamReceiver {
         // When a sender decides to send a message to this port it will 
         // call this method. The receiver port will store the message
         // and do nothing else.
-        void receive(datatype data);
+        virtual void receive(datatype data);
         // The module owning the port must query the number of messages available
-        uint16_t count();
+        virtual uint16_t count();
         // The module can fetch the message from the queue for processing.
-        datatype fetch();
+        virtual datatype fetch();
+        // we need a virtual destructor for the derived receivers
+        virtual ~StreamReceiver() {};
     protected:
         std::list<datatype> queue;
 };
 
+/*
+ * This is a mailbox flavor of the stream receiver.
+ * It is intended for consumers that only need the latest data block
+ * (like a display) and run much slower than the sender.
+ * There is no queue - every received data block overwrites the previous one in place,
+ * so, no memory is allocated and a slow consumer costs no more than one data block.
+ *
+ * The box is guarded by a sequence counter (seqlock) which is odd while a write is in progress.
+ * There must be only one sender writing into the mailbox.
+ * The receiver may run in the interrupt or in a task, if it preempts an unfinished write
+ * it cannot wait for the write to complete and gets the previously fetched data block instead.
+ */
+template <typename datatype>
+class StreamMailbox : public StreamReceiver<datatype> {
+    public:
+        StreamMailbox();
+        // overwrite the data block in the box
+        virtual void receive(datatype data);
+        // this is 1 if a data block newer than the last fetched one is available, 0 otherwise
+        virtual uint16_t count();
+        // get a copy of the latest data block
+        virtual datatype fetch();
+        // number of data blocks that got overwritten before they could be fetched
+        uint32_t skipped() { return skip_count; };
+    protected:
+        datatype            box;
+        datatype            last_data;
+        volatile uint32_t   sequence;
+        uint32_t            last_sequence;
+        uint32_t            skip_count;
+};
+
+/*
+ * Every stream data type has a corresponding message type (see message.h)
+ * that is used when the data have to be sent as messages.
+ */
+template <typename datatype>
+uint16_t stream_message_type();
+
+/*
+ * This receiver converts every received data block into a message
+ * and sends it out through a message port.
+ * It is used to attach stream topics to message receivers (e.g. the downlink).
+ */
+template <typename datatype>
+class StreamForwarder : public StreamReceiver<datatype> {
+    public:
+        // the messages are sent in the name of the given module
+        StreamForwarder(std::string sender_module) { sender = sender_module; };
+        virtual void receive(datatype data);
+        // nothing is ever queued
+        virtual uint16_t count() { return 0; };
+        // port over which the messages are sent
+        SenderPort out;
+    protected:
+        std::string sender;
+};
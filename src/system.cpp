@@ -1,16 +1,26 @@
 #include "global.h"
 #include "system.h"
 
+TopicRegistry *topics;
+TelemetryDictionary *telemetry;
 Commander *commander;
 Watchdog *watchdog;
 DisplaySSD1331 *display;
-StreamFileWriter* fast_log_file_writer;
+StreamFileWriter* fast_log_file_writer = 0;
+FlightRecorder* flight_recorder = 0;
 DummyGPS *gps;
 MotionSensor *imu;
 Modem *modem;
 
 void FC_init_system()
 {
+    // the registry through which all modules get connected
+    topics = new TopicRegistry();
+
+    // the dictionary of all telemetry variables
+    telemetry = new TelemetryDictionary(std::string("TM_DICT"));
+    telemetry->status_out.set_receiver(&(system_log->in));
+
     // create the USB serial output channel
     // usb = new USB_Serial(std::string("USB_1"), 115200);
 	// system_log->text_out.set_receiver(&(usb->in));
@@ -26,13 +36,8 @@ void FC_init_system()
     display = new DisplaySSD1331(std::string("DISPLAY"), 2.0);
     display->status_out.set_receiver(&(system_log->in));
 
-    // create a logfile writer for streaming data
-    // char log_filename[40];
-    // sprintf(log_filename, "taros.%05d.fast.log", SD_file_No);
-    // fast_log_file_writer = new StreamFileWriter("FASTLOG",std::string(log_filename));
-
     // create a modem for communication with a ground station
-    modem = new Modem(std::string("MODEM_1"));
+    modem = new Modem(std::string("MODEM_1"), new DMAModemSerial(MODEM_M0_M1, MODEM_AUX));
     modem->status_out.set_receiver(&(system_log->in));
 
     // create a simulated GPS module
@@ -68,6 +73,13 @@ void FC_setup_system(
     if (watchdog->state() >= MODULE_RUNLEVEL_SETUP_OK)
         module_list->push_back(watchdog);
 
+    // the telemetry dictionary must be setup before all modules declaring variables
+    telemetry->setup();
+    if (telemetry->state() >= MODULE_RUNLEVEL_SETUP_OK)
+        module_list->push_back(telemetry);
+    // the system log was created before the dictionary
+    system_log->declare_telemetry(telemetry);
+
     commander->setup();
     if (commander->state() >= MODULE_RUNLEVEL_SETUP_OK)
         module_list->push_back(commander);
@@ -77,11 +89,6 @@ void FC_setup_system(
     if (display->state() >= MODULE_RUNLEVEL_SETUP_OK)
     	module_list->push_back(display);
 
-    // create a logfile writer for streaming data
-    // fast_log_file_writer->setup();
-    // if (fast_log_file_writer->state() >= MODULE_RUNLEVEL_SETUP_OK)
-    // 	module_list->push_back(fast_log_file_writer);
-    
     // create a modem for communication with a ground station
     modem->setup();
     if (modem->state() >= MODULE_RUNLEVEL_SETUP_OK)
@@ -121,21 +128,48 @@ void FC_setup_system(
 void FC_build_system()
 {
 
+    // all producers advertise their topics
+    topics->advertise(TOPIC_SYSLOG, &(system_log->system_out));
+    topics->advertise(TOPIC_SYSLOG_TEXT, &(system_log->text_out));
+    topics->advertise(TOPIC_UPLINK, &(modem->uplink));
+    topics->advertise(TOPIC_TM_DICTIONARY, &(telemetry->out));
+    topics->advertise(TOPIC_SYSLOG_METRICS, &(system_log->tm_out));
+    topics->advertise(TOPIC_GPS_TELEMETRY, &(gps->tm_out));
+    topics->advertise(TOPIC_IMU_AHRS, imu->id, &(imu->AHRS_out));
+    topics->advertise(TOPIC_IMU_GYRO, imu->id, &(imu->GYRO_out));
+
     // wire the syslog output to the modem for communication with a ground station
     // TODO : this leads to lots of systick overruns
-    system_log->system_out.set_receiver(&(modem->downlink));
+    topics->subscribe(TOPIC_SYSLOG, &(modem->downlink));
 
     // wire the modem uplink to the commander
-    // modem->uplink.set_receiver(&(commander->command_in));
+    topics->subscribe(TOPIC_UPLINK, &(commander->command_in));
     
+    // the ground station needs the dictionary to decode the telemetry data
+    topics->subscribe(TOPIC_TM_DICTIONARY, &(modem->downlink));
+    topics->subscribe(TOPIC_TM_DICTIONARY, &(system_log->in));
+
+    // the metrics of the system log are logged themselves
+    topics->subscribe(TOPIC_SYSLOG_METRICS, &(system_log->in));
+
     // wire the simulated GPS module
-    gps->tm_out.set_receiver(&(system_log->in));
+    topics->subscribe(TOPIC_GPS_TELEMETRY, &(system_log->in));
     
     // wire the motion controller
-    imu->AHRS_out.set_receiver(&(display->ahrs_in));
-    imu->GYRO_out.set_receiver(&(display->gyro_in));
-    imu->AHRS_out.set_receiver(&(fast_log_file_writer->ahrs_in));
-    imu->GYRO_out.set_receiver(&(fast_log_file_writer->gyro_in));
+    topics->subscribe(TOPIC_IMU_AHRS, &(display->ahrs_in));
+    topics->subscribe(TOPIC_IMU_GYRO, &(display->gyro_in));
+    // the fast log is only present if it has been created
+    if (fast_log_file_writer)
+    {
+        topics->subscribe(TOPIC_IMU_AHRS, &(fast_log_file_writer->ahrs_in));
+        topics->subscribe(TOPIC_IMU_GYRO, &(fast_log_file_writer->gyro_in));
+    };
+    // the flight recorder captures the same streams
+    if (flight_recorder)
+    {
+        topics->subscribe(TOPIC_IMU_AHRS, &(flight_recorder->ahrs_in));
+        topics->subscribe(TOPIC_IMU_GYRO, &(flight_recorder->gyro_in));
+    };
     
     
     // create a logger capturing telemetry data at specified rate
@@ -5,20 +5,31 @@
 
 #include "module.h"
 #include "message.h"
+#include "topics.h"
+#include "telemetry.h"
 
 #include "commander.h"
 #include "dummy_gps.h"
 #include "display.h"
+#include "flight_recorder.h"
 #include "modem.h"
+#include "modem_serial_dma.h"
 #include "motion.h"
 #include "servo.h"
 #include "watchdog.h"
 
+// all connections between modules are made via topics
+extern TopicRegistry *topics;
+
+// all telemetry variables are declared in this dictionary
+extern TelemetryDictionary *telemetry;
+
 // all modules that will be included during the system build
 extern Commander *commander;
 extern Watchdog *watchdog;
 extern DisplaySSD1331 *display;
 extern StreamFileWriter* fast_log_file_writer;
+extern FlightRecorder* flight_recorder;
 extern DummyGPS *gps;
 extern MotionSensor *imu;
 extern Modem *modem;
@@ -49,6 +60,7 @@ void FC_setup_system(
 /*
     This is the system definition.
     All modules (if properly active) are wired to each other.
+    Producers advertise their ports as topics, consumers subscribe to them.
     This has to be done in an appropriate sequence, such that modules are
     setup only after other modules they may rely on.
 */
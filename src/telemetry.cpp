@@ -0,0 +1,98 @@
+#include "telemetry.h"
+#include "kernel.h"
+
+TelemetryDictionary::TelemetryDictionary(
+    std::string name ) : Module(name)
+{
+    next_announce = 0;
+    last_announce = FC_time_now();
+    flag_pending = false;
+    runlevel_ = MODULE_RUNLEVEL_INITALIZED;
+}
+
+void TelemetryDictionary::interrupt()
+{
+    if (flag_pending or (FC_elapsed_millis(last_announce) > TM_ANNOUNCE_INTERVAL))
+        schedule_task(this, std::bind(&TelemetryDictionary::run, this));
+}
+
+void TelemetryDictionary::run()
+{
+    // first send all new declarations
+    if (flag_pending)
+    {
+        flag_pending = false;
+        for (size_t i=0; i<variables.size(); i++)
+        {
+            TelemetryVariable &v = variables[i];
+            if (v.pending)
+            {
+                out.transmit(
+                    Message::TelemetryVariable(v.sender, v.hash, v.data_type, v.variable, v.units) );
+                v.pending = false;
+            };
+        };
+    };
+    // periodically repeat one declaration at a time
+    if (FC_elapsed_millis(last_announce) > TM_ANNOUNCE_INTERVAL)
+    {
+        last_announce = FC_time_now();
+        if (variables.size() > 0)
+        {
+            if (next_announce >= variables.size()) next_announce = 0;
+            TelemetryVariable &v = variables[next_announce];
+            out.transmit(
+                Message::TelemetryVariable(v.sender, v.hash, v.data_type, v.variable, v.units) );
+            next_announce++;
+        };
+    };
+}
+
+uint16_t TelemetryDictionary::declare(
+    std::string sender_module,
+    std::string variable,
+    uint16_t    data_type,
+    std::string units)
+{
+    // a repeated declaration returns the known hash
+    for (size_t i=0; i<variables.size(); i++)
+        if ((variables[i].sender == sender_module) and (variables[i].variable == variable))
+            return variables[i].hash;
+    uint16_t h = hash(sender_module, variable);
+    // resolve collisions
+    while (hash_used(h) or (h==0)) h++;
+    TelemetryVariable v;
+    v.hash = h;
+    v.data_type = data_type;
+    v.sender = sender_module;
+    v.variable = variable;
+    v.units = units;
+    v.pending = true;
+    variables.push_back(v);
+    // the declaration is sent with the next task
+    flag_pending = true;
+    return h;
+}
+
+uint16_t TelemetryDictionary::hash(std::string sender_module, std::string variable)
+{
+    // FNV-1a over sender, a separator and the variable name
+    uint32_t h = 2166136261u;
+    std::string key = sender_module + "." + variable;
+    for (size_t i=0; i<key.size(); i++)
+    {
+        h ^= (uint8_t)key[i];
+        h *= 16777619u;
+    };
+    // fold to 16 bit
+    uint16_t h16 = (h >> 16) ^ (h & 0xFFFF);
+    if (h16 == 0) h16 = 1;
+    return h16;
+}
+
+bool TelemetryDictionary::hash_used(uint16_t hash)
+{
+    for (size_t i=0; i<variables.size(); i++)
+        if (variables[i].hash == hash) return true;
+    return false;
+}
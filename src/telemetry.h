@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "module.h"
+#include "message.h"
+#include "port.h"
+
+// the time between two announcements of telemetry variables in ms
+// one variable is announced at a time, so the full dictionary
+// is repeated every (number of variables) x TM_ANNOUNCE_INTERVAL
+#define TM_ANNOUNCE_INTERVAL 1000
+
+/*
+    This module keeps the dictionary of all telemetry variables.
+
+    A variable is declared once with its name, data type and units.
+    It gets a short hash which replaces sender and name in all data messages
+    (MSG_TYPE_DATA_...). So the samples are sent as binary values with
+    just the hash and a timestamp, no formatting of values is done on the target.
+
+    The declarations (MSG_TYPE_TM_VARIABLE) are sent out over the out port
+    when a variable is declared and are periodically repeated
+    so a ground station joining late can learn the dictionary.
+
+    The hash is computed from the sender and variable name,
+    so it is usually the same for every run of the software.
+    Collisions are resolved when declaring the variable,
+    a receiver must always use the hash as announced.
+*/
+class TelemetryDictionary : public Module
+{
+
+public:
+
+    // constructor
+    TelemetryDictionary(std::string name);
+
+    // nothing to do
+    virtual void setup() { runlevel_ = MODULE_RUNLEVEL_OPERATIONAL; };
+
+    virtual void interrupt();
+
+    // This is the worker function being executed by the taskmanager.
+    // It sends out all pending announcements.
+    void run();
+
+    // declare a telemetry variable
+    // data_type is one of the MSG_TYPE_DATA_... message types
+    // returns the hash to be used for all data messages of that variable
+    // A variable which has already been declared gets its previous hash.
+    uint16_t declare(
+        std::string sender_module,
+        std::string variable,
+        uint16_t    data_type,
+        std::string units);
+
+    // the number of declared variables
+    size_t count() { return variables.size(); };
+
+    // destructor
+    virtual ~TelemetryDictionary() {};
+
+    // port over which the declarations are sent
+    SenderPort out;
+
+private:
+
+    struct TelemetryVariable {
+        uint16_t    hash;
+        uint16_t    data_type;
+        std::string sender;
+        std::string variable;
+        std::string units;
+        // the declaration has not yet been sent
+        bool        pending;
+    };
+
+    // compute the hash from sender and variable name (never 0)
+    static uint16_t hash(std::string sender_module, std::string variable);
+
+    // check if a hash is already in use
+    bool hash_used(uint16_t hash);
+
+    std::vector<TelemetryVariable> variables;
+
+    // the index of the next variable to be re-announced
+    size_t      next_announce;
+    uint32_t    last_announce;
+
+    // there are declarations which have not yet been sent
+    // this is set from tasks and read in the interrupt
+    volatile bool flag_pending;
+};
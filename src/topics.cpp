@@ -0,0 +1,62 @@
+#include "topics.h"
+
+TopicRegistry::TopicRegistry()
+{
+    for (int i=0; i<TOPIC_MAX; i++)
+    {
+        entries[i].port = 0;
+        entries[i].stream = 0;
+        entries[i].stream_type = 0;
+    }
+}
+
+bool TopicRegistry::advertise(TopicID topic, SenderPort *port)
+{
+    if ((topic==TOPIC_NONE) or (topic>=TOPIC_MAX)) return false;
+    if (entries[topic].port != 0) return false;
+    entries[topic].port = port;
+    return true;
+}
+
+bool TopicRegistry::subscribe(TopicID topic, ReceiverPort *port)
+{
+    if (topic>=TOPIC_MAX) return false;
+    if (entries[topic].port == 0) return false;
+    // avoid double subscriptions which would deliver every message twice
+    entries[topic].port->remove_receiver(port);
+    entries[topic].port->set_receiver(port);
+    update_forwarding(topic);
+    return true;
+}
+
+bool TopicRegistry::unsubscribe(TopicID topic, ReceiverPort *port)
+{
+    if (topic>=TOPIC_MAX) return false;
+    if (entries[topic].port == 0) return false;
+    entries[topic].port->remove_receiver(port);
+    update_forwarding(topic);
+    return true;
+}
+
+void TopicRegistry::publish(TopicID topic, Message msg)
+{
+    if (topic>=TOPIC_MAX) return;
+    if (entries[topic].port == 0) return;
+    entries[topic].port->transmit(msg);
+}
+
+bool TopicRegistry::exists(TopicID topic)
+{
+    if (topic>=TOPIC_MAX) return false;
+    return entries[topic].port != 0;
+}
+
+void TopicRegistry::update_forwarding(TopicID topic)
+{
+    // only stream topics need a forwarder
+    if (entries[topic].stream == 0) return;
+    // remove it in any case so it is never attached twice
+    entries[topic].attach(false);
+    if (entries[topic].port->count_receivers() > 0)
+        entries[topic].attach(true);
+}
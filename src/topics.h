@@ -0,0 +1,155 @@
+/*
+    Instead of wiring every sender port to its receivers by hand
+    modules can communicate via topics.
+
+    A topic is identified by a compact ID (a single byte) which can also
+    be transmitted over the ground communication link. A producer advertises
+    its sender port under the topic ID and consumers subscribe to the topic.
+    Subscribing just adds the receiver to the flat receiver array
+    of the sender port, so the dispatch of messages costs no more than
+    with hand-wired ports.
+
+    Stream topics can also be subscribed with message receivers
+    (e.g. the modem downlink). In that case every data block is converted
+    into a message. That conversion is only attached to the stream
+    while there are message subscribers.
+
+    Subscriptions can be changed at runtime (e.g. by uplink commands)
+    but this must only happen within a task, never in interrupt context.
+    Ports that transmit from within interrupt routines must not be
+    changed after the system build.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "message.h"
+#include "port.h"
+#include "stream.h"
+
+using TopicID = uint8_t;
+
+// topics for messages
+#define TOPIC_NONE              0
+#define TOPIC_SYSLOG            1       // all system messages (from the system_log)
+#define TOPIC_SYSLOG_TEXT       2       // all messages received by the system_log as text
+#define TOPIC_UPLINK            3       // commands received from the ground station
+#define TOPIC_TM_DICTIONARY     4       // declarations of telemetry variables
+#define TOPIC_SYSLOG_METRICS    5       // telemetry of the system_log (backlog, drain rate)
+#define TOPIC_GPS_TELEMETRY     8
+// topics for streams
+#define TOPIC_IMU_AHRS          16
+#define TOPIC_IMU_GYRO          17
+
+// the number of possible topic IDs
+#define TOPIC_MAX               32
+
+/*
+    The registry holds one entry for every topic.
+    There can be only one producer per topic.
+*/
+class TopicRegistry
+{
+
+public:
+
+    TopicRegistry();
+
+    // register a message sender port as producer of a topic
+    // returns false if the topic ID is invalid or already in use
+    bool advertise(TopicID topic, SenderPort *port);
+
+    // register a stream sender as producer of a topic
+    // the name is used as the sender ID when the data have to be sent as messages
+    // returns false if the topic ID is invalid or already in use
+    template <typename datatype>
+    bool advertise(TopicID topic, std::string name, StreamSender<datatype> *sender);
+
+    // subscribe a message receiver to a topic (message or stream)
+    // returns false if there is no such topic
+    bool subscribe(TopicID topic, ReceiverPort *port);
+
+    // remove the subscription of a message receiver
+    // returns false if there is no such topic
+    bool unsubscribe(TopicID topic, ReceiverPort *port);
+
+    // subscribe a stream receiver to a stream topic
+    // returns false if there is no such topic or the data type does not match
+    template <typename datatype>
+    bool subscribe(TopicID topic, StreamReceiver<datatype> *receiver);
+
+    // remove the subscription of a stream receiver
+    template <typename datatype>
+    bool unsubscribe(TopicID topic, StreamReceiver<datatype> *receiver);
+
+    // publish a message on a topic
+    // this is the same as transmitting it with the advertised port
+    void publish(TopicID topic, Message msg);
+
+    // check if a topic has been advertised
+    bool exists(TopicID topic);
+
+private:
+
+    struct TopicEntry {
+        // the port over which messages are sent
+        // for stream topics this is the port of the StreamForwarder
+        SenderPort*     port;
+        // for stream topics : the StreamSender, the message type of the data blocks
+        // and a function attaching/detaching the StreamForwarder to the stream
+        void*           stream;
+        uint16_t        stream_type;
+        std::function<void(bool)> attach;
+    };
+
+    TopicEntry entries[TOPIC_MAX];
+
+    // attach or detach the message conversion of a stream topic
+    // depending on whether it has message subscribers
+    void update_forwarding(TopicID topic);
+
+};
+
+template <typename datatype>
+bool TopicRegistry::advertise(TopicID topic, std::string name, StreamSender<datatype> *sender)
+{
+    if ((topic==TOPIC_NONE) or (topic>=TOPIC_MAX)) return false;
+    if (entries[topic].port != 0) return false;
+    // the forwarder lives as long as the system
+    StreamForwarder<datatype> *fwd = new StreamForwarder<datatype>(name);
+    entries[topic].port = &(fwd->out);
+    entries[topic].stream = sender;
+    entries[topic].stream_type = stream_message_type<datatype>();
+    entries[topic].attach = [sender, fwd](bool on) {
+        if (on)
+            sender->set_receiver(fwd);
+        else
+            sender->remove_receiver(fwd);
+    };
+    return true;
+}
+
+template <typename datatype>
+bool TopicRegistry::subscribe(TopicID topic, StreamReceiver<datatype> *receiver)
+{
+    if (topic>=TOPIC_MAX) return false;
+    if (entries[topic].stream == 0) return false;
+    if (entries[topic].stream_type != stream_message_type<datatype>()) return false;
+    StreamSender<datatype> *sender = (StreamSender<datatype>*) entries[topic].stream;
+    sender->set_receiver(receiver);
+    return true;
+}
+
+template <typename datatype>
+bool TopicRegistry::unsubscribe(TopicID topic, StreamReceiver<datatype> *receiver)
+{
+    if (topic>=TOPIC_MAX) return false;
+    if (entries[topic].stream == 0) return false;
+    if (entries[topic].stream_type != stream_message_type<datatype>()) return false;
+    StreamSender<datatype> *sender = (StreamSender<datatype>*) entries[topic].stream;
+    sender->remove_receiver(receiver);
+    return true;
+}
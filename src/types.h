@@ -1,10 +1,22 @@
 /*
     Definitions of the composed data types that can be used
     for messages and streams
+
+    All data types carry the time of their acquisition as the first member.
+    This is taken from FC_time_us() by the producer when the data
+    was actually obtained (e.g. at completion of the sensor read)
+    and must be preserved by all consumers (logs, downlink).
+
+    The schema stored in the log files (src/log_schema.h) is generated from
+    this file by tools/gen_log_schema.py, it has to be re-generated after every change.
+    Every data type needs a signature DATA_<name>_SIGNATURE, the unit of every member
+    is taken from the first [...] in its comment.
 */
 
 #pragma once
 
+#include <cstdint>
+
 // all data types are assigned a signature that makes them recognizeable in the log files
 
 #define DATA_IMU_AHRS_SIGNATURE 0xa0
@@ -12,16 +24,18 @@
 
 // in earth-fixed coordinates
 struct DATA_IMU_AHRS {
+    uint64_t time;          // acquisition time [us]
     float   attitude;       // angle of attack with respect to horizontal flight [deg]
                             // range  -180 ... +180 deg, positive up (hover is +90 deg)
     float   heading;        // with respect to magnetic north [deg], range 0 ... 360 deg
                             // nose direction for attitude=-90..+90 deg, else tail direction
-    float   roll;           // roll angle about heading (roll in horizontal flight, yaw in hover)
+    float   roll;           // roll angle about heading [deg] (roll in horizontal flight, yaw in hover)
                             // range -90 ... 90 deg, positive left
 };
 
 // in airframe-fixed coordinates (right, forward, up)
 struct DATA_IMU_GYRO {
+    uint64_t time;          // acquisition time [us]
     float   nick;           // rate [deg/s] positive up
     float   yaw;            // rate [deg/s] positive left
     float   roll;           // rate [deg/s] positive left
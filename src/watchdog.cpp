@@ -1,7 +1,5 @@
 #include <iostream>
 #include <string>
-#include <sstream>
-#include <iomanip>
 
 // this is needed to have F_CPU_ACTUAL
 #include "../core/wiring.h"
@@ -47,46 +45,35 @@ void Watchdog::interrupt()
 void Watchdog::analyze_health()
 {
     // report the duration of the interrupt calls
-    std::stringstream report1;
-    report1 << "IRQ total : ";
-    report1 << std::fixed << std::setprecision(2) << 1e6*(float)FC_get_max_isr_duration()/(float)F_CPU_ACTUAL << " us";
-    report1 << " -- " << FC_max_isr_time_module_ID() << " : ";
-    report1 << 1e6*(float)FC_get_max_isr_time_to_completion()/(float)F_CPU_ACTUAL << " us";
+    // the values are sent in binary, the text is formatted by the receiver
     float delay = 1.0e6 * (float)FC_get_max_isr_spacing() / (float)F_CPU_ACTUAL;
-    report1 << " -- spacing : " << delay << " us";
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, report1.str()) );
+        Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, TPL_WATCHDOG_IRQ,
+            1e6f*(float)FC_get_max_isr_duration()/(float)F_CPU_ACTUAL,
+            FC_max_isr_time_module_ID(),
+            1e6f*(float)FC_get_max_isr_time_to_completion()/(float)F_CPU_ACTUAL,
+            delay) );
 
     // report potentially delayed systick interrupts
     if (delay>1100.0)
     {
-        std::stringstream report2;
-        report2 << "delayed systick (spacing ";
-        report2 << std::fixed << std::setprecision(1);
-        report2 << delay << " us)";
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_CRITICAL, report2.str()) );
+            Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_CRITICAL, TPL_WATCHDOG_SYSTICK, delay) );
     }
     
     // report potentially delayed task starts
     delay = 1.0e6 * (float)FC_get_max_task_delay() / (float)F_CPU_ACTUAL;
     if (delay>1100.0)
     {
-        std::stringstream report3;
-        report3 << "delayed task start ";
-        report3 << std::fixed << std::setprecision(1);
-        report3 << delay << " us";
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_CRITICAL, report3.str()) );
+            Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_CRITICAL, TPL_WATCHDOG_TASK_DELAY, delay) );
     }
     
     // report longest module runtime
-    std::stringstream report4;
-    report4 << "Module runtime -- ";
-    report4 << FC_max_task_runtime_module_ID() << " : ";
-    report4 << std::fixed << std::setprecision(1) << 1e6*(float)FC_get_max_task_runtime()/(float)F_CPU_ACTUAL << " us";
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, report4.str()) );
+        Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, TPL_WATCHDOG_RUNTIME,
+            FC_max_task_runtime_module_ID(),
+            1e6f*(float)FC_get_max_task_runtime()/(float)F_CPU_ACTUAL) );
     
     FC_reset_max_isr_time_to_completion();
     FC_reset_max_isr_spacing();
@@ -119,12 +106,10 @@ void Watchdog::analyze_memory()
     // report heap usage
     // TODO: HEAP from 0x41389527 to 0 used up to 0x20007180 -- that is unlikely, probably the start is wrong
     // memory block should be from 0x2000000 to 0x2007ffff (512kB)
-    std::stringstream report;
-    report << "HEAP from " << (void *)_heap_start << " to " << (void *)_heap_end;
-    report << " used up to " << &__brkval;
     // TODO: something here breaks the system -> stall/reboot
     // report << " (" << __brkval-_heap_start << " bytes used)";
     // report << " -- stack usage " << stack_used() << " bytes";
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, report.str()) );
+        Message::SystemTemplate(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, TPL_WATCHDOG_HEAP,
+            (uint32_t)_heap_start, (uint32_t)_heap_end, (uint32_t)(uintptr_t)&__brkval) );
 }
@@ -0,0 +1,309 @@
+#include "e220_emulator.h"
+
+#include <algorithm>
+
+#include "kernel.h"
+
+static const uint32_t baud_rates[8] = { 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 };
+static const uint32_t air_rates[8] = { 2400, 2400, 2400, 4800, 9600, 19200, 38400, 62500 };
+
+// the configuration mode always uses 9600 baud
+#define E220_CONFIG_BAUD 9600
+
+E220Emulator::E220Emulator(E220Settings settings) :
+    settings(settings),
+    rng(settings.seed)
+{
+    for (int s=0; s<2; s++)
+    {
+        Side &side = sides[s];
+        // factory defaults : 9600 8N1, air 2.4k, channel 18, no RSSI byte
+        const uint8_t defaults[6] = { 0x00, 0x00, 0x62, 0x00, 0x12, 0x00 };
+        std::copy(defaults, defaults+6, side.regs);
+        side.config_mode = false;
+        side.host_baud = 0;
+        side.last_in = 0;
+        side.aux_low = false;
+        side.aux_change = 0;
+        apply_registers(s);
+    };
+    // the ground modem is used as configured
+    sides[1].baud = settings.ground_baud;
+    sides[1].host_baud = settings.ground_baud;
+    sides[1].air_rate = settings.ground_air_rate;
+    sides[1].rssi = settings.ground_rssi;
+    air.active = false;
+    air.from = 0;
+    air.end = 0;
+    local_serial.emu = this;
+    local_serial.tx_end = 0;
+}
+
+void E220Emulator::apply_registers(int s)
+{
+    Side &side = sides[s];
+    side.baud = baud_rates[side.regs[2] >> 5];
+    side.air_rate = air_rates[side.regs[2] & 0x07];
+    side.rssi = (side.regs[5] & 0x80) != 0;
+}
+
+void E220Emulator::ground_in(const uint8_t *data, size_t size)
+{
+    update();
+    uint64_t now = FC_time_us();
+    serial_in(1, data, size, now + size*char_time(sides[1].host_baud));
+}
+
+size_t E220Emulator::ground_out(uint8_t *buffer, size_t max_size)
+{
+    update();
+    return take_output(1, buffer, max_size);
+}
+
+void E220Emulator::serial_in(int s, const uint8_t *data, size_t size, uint64_t time)
+{
+    Side &side = sides[s];
+    uint32_t baud = side.config_mode ? E220_CONFIG_BAUD : side.baud;
+    // with a wrong baud rate nothing useful arrives
+    if (side.host_baud != baud) return;
+    for (size_t i=0; i<size; i++)
+    {
+        if (side.tx_fifo.size() >= E220_BUFFER_SIZE)
+        {
+            stats.buffer_overflows[s]++;
+            break;
+        };
+        side.tx_fifo.push_back(data[i]);
+    };
+    side.last_in = time;
+    if (side.config_mode) configure(s, time);
+    update_aux(s, FC_time_us());
+}
+
+void E220Emulator::configure(int s, uint64_t time)
+{
+    Side &side = sides[s];
+    std::deque<uint8_t> &cmd = side.tx_fifo;
+    while (cmd.size() >= 3)
+    {
+        uint8_t code = cmd[0];
+        uint8_t addr = cmd[1];
+        uint8_t len = cmd[2];
+        if ((code != 0xC0) and (code != 0xC1) and (code != 0xC2))
+        {
+            // not a command - resynchronize
+            cmd.pop_front();
+            continue;
+        };
+        if ((addr+len > 6) or (len == 0))
+        {
+            // illegal register range - the command is ignored
+            cmd.erase(cmd.begin(), cmd.begin()+3);
+            continue;
+        };
+        // a write command needs all parameters
+        if ((code != 0xC1) and (cmd.size() < (size_t)3+len)) return;
+        std::vector<uint8_t> response = { 0xC1, addr, len };
+        if (code == 0xC1)
+            cmd.erase(cmd.begin(), cmd.begin()+3);
+        else
+        {
+            for (int i=0; i<len; i++)
+                side.regs[addr+i] = cmd[3+i];
+            cmd.erase(cmd.begin(), cmd.begin()+3+len);
+            apply_registers(s);
+        };
+        for (int i=0; i<len; i++)
+            response.push_back(side.regs[addr+i]);
+        serial_out(s, response, time + 1000);
+    };
+}
+
+void E220Emulator::serial_out(int s, const std::vector<uint8_t> &data, uint64_t start)
+{
+    Side &side = sides[s];
+    uint64_t step = char_time(side.config_mode ? E220_CONFIG_BAUD : side.baud);
+    uint64_t t = start;
+    if (!side.out.empty())
+        t = std::max(t, side.out.back().first);
+    for (size_t i=0; i<data.size(); i++)
+    {
+        t += step;
+        side.out.push_back(std::make_pair(t, data[i]));
+    };
+}
+
+size_t E220Emulator::take_output(int s, uint8_t *buffer, size_t max_size)
+{
+    Side &side = sides[s];
+    uint64_t now = FC_time_us();
+    uint32_t baud = side.config_mode ? E220_CONFIG_BAUD : side.baud;
+    size_t n = 0;
+    while ((n < max_size) and !side.out.empty() and (side.out.front().first <= now))
+    {
+        // with a wrong baud rate the data are lost
+        if (side.host_baud == baud)
+            buffer[n++] = side.out.front().second;
+        side.out.pop_front();
+    };
+    return n;
+}
+
+void E220Emulator::update()
+{
+    uint64_t now = FC_time_us();
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+        // a packet has been received
+        if (air.active and (air.end <= now))
+        {
+            air.active = false;
+            progress = true;
+            int to = 1-air.from;
+            double loss = (air.from == 0) ? settings.loss_down : settings.loss_up;
+            if ((uniform(rng) < loss) or sides[to].config_mode)
+                stats.packets_lost[air.from]++;
+            else
+            {
+                std::vector<uint8_t> data = air.data;
+                if (uniform(rng) < settings.corruption)
+                {
+                    size_t pos = rng() % data.size();
+                    data[pos] ^= 1 + rng() % 255;
+                    stats.packets_corrupted[air.from]++;
+                };
+                if (sides[to].rssi)
+                {
+                    int rssi = settings.rssi;
+                    if (settings.rssi_noise > 0)
+                        rssi += (int)(rng() % (2*settings.rssi_noise+1)) - settings.rssi_noise;
+                    data.push_back(std::min(255, std::max(0, rssi)));
+                };
+                serial_out(to, data, air.end + E220_RX_DELAY);
+            };
+        };
+        // start the next packet, the modems take turns
+        if (!air.active)
+            for (int i=0; i<2; i++)
+            {
+                int s = (air.from+1+i) % 2;
+                Side &side = sides[s];
+                if (side.config_mode or side.tx_fifo.empty()) continue;
+                // a packet is started when it is full or the serial line is idle for 3 characters
+                uint64_t ready = side.last_in;
+                if (side.tx_fifo.size() < E220_PACKET_SIZE)
+                    ready += 3*char_time(side.baud);
+                if (ready > now) continue;
+                uint64_t start = std::max(ready, air.end);
+                size_t n = std::min(side.tx_fifo.size(), (size_t)E220_PACKET_SIZE);
+                air.data.assign(side.tx_fifo.begin(), side.tx_fifo.begin()+n);
+                side.tx_fifo.erase(side.tx_fifo.begin(), side.tx_fifo.begin()+n);
+                uint64_t airtime = (uint64_t)((n + settings.packet_overhead) *
+                    settings.bits_per_char * 1.0e6 / side.air_rate);
+                air.active = true;
+                air.from = s;
+                air.end = start + airtime;
+                stats.packets_sent[s]++;
+                stats.bytes_sent[s] += n;
+                stats.airtime_us += airtime;
+                progress = true;
+                break;
+            };
+    };
+    update_aux(0, now);
+    update_aux(1, now);
+}
+
+void E220Emulator::update_aux(int s, uint64_t now)
+{
+    Side &side = sides[s];
+    bool low = !side.tx_fifo.empty() or (air.active and (air.from == s));
+    // AUX goes low when a packet has been received, before it is output
+    if (!side.out.empty() and (side.out.front().first <= now + E220_RX_DELAY + char_time(side.baud)))
+        low = true;
+    if (low != side.aux_low)
+    {
+        side.aux_low = low;
+        side.aux_change = now;
+    };
+}
+
+// the serial interface of the flight controller side --------------------------
+
+void E220Emulator::LocalSerial::begin(uint32_t baud)
+{
+    emu->sides[0].host_baud = baud;
+    tx_end = 0;
+}
+
+void E220Emulator::LocalSerial::end()
+{
+    emu->sides[0].host_baud = 0;
+}
+
+void E220Emulator::LocalSerial::set_config_mode(bool config)
+{
+    emu->update();
+    Side &side = emu->sides[0];
+    if (side.config_mode != config) side.tx_fifo.clear();
+    side.config_mode = config;
+}
+
+bool E220Emulator::LocalSerial::aux_busy()
+{
+    emu->update();
+    return emu->sides[0].aux_low;
+}
+
+uint32_t E220Emulator::LocalSerial::aux_last_change()
+{
+    return emu->sides[0].aux_change / 1000;
+}
+
+size_t E220Emulator::LocalSerial::available()
+{
+    emu->update();
+    uint64_t now = FC_time_us();
+    size_t n = 0;
+    for (auto &b : emu->sides[0].out)
+    {
+        if (b.first > now) break;
+        n++;
+    };
+    return n;
+}
+
+bool E220Emulator::LocalSerial::rx_pending()
+{
+    size_t n = available();
+    if (n == 0) return false;
+    // like an idle line interrupt - no further character within one character time
+    Side &side = emu->sides[0];
+    if (n == side.out.size()) return true;
+    return side.out[n].first > FC_time_us() + char_time(side.baud);
+}
+
+size_t E220Emulator::LocalSerial::read(uint8_t *buffer, size_t max_size)
+{
+    emu->update();
+    return emu->take_output(0, buffer, max_size);
+}
+
+bool E220Emulator::LocalSerial::tx_busy()
+{
+    return FC_time_us() < tx_end;
+}
+
+bool E220Emulator::LocalSerial::write(const uint8_t *data, size_t size)
+{
+    if (tx_busy() or (size > MODEM_SERIAL_TX_SIZE)) return false;
+    emu->update();
+    uint64_t now = FC_time_us();
+    tx_end = now + size*char_time(emu->sides[0].host_baud);
+    // the data arrive at the modem when the serial transfer is complete
+    emu->serial_in(0, data, size, tx_end);
+    return true;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "modem_serial.h"
+
+/*
+    Emulation of a pair of EBYTE E220 LoRa modems for testing on the host.
+
+    Side 0 is the modem of the flight controller, it is accessed by the
+    Modem module through the ModemSerial interface (see local()).
+    Side 1 is the modem of the ground station, its serial side is
+    exchanged as byte streams (ground_in() / ground_out()), e.g. with a pty.
+
+    What is emulated :
+    - configuration mode (M0=M1=1) at 9600 baud : the 0xC0 command writes the
+      registers and is answered by 0xC1, 0xC1 reads the registers back
+      UART baud rate, air data rate and the RSSI byte enable are taken from the registers
+    - transparent transmission : bytes received on the serial line are sent
+      as a packet when 200 bytes are collected or the line has been idle
+      for 3 characters, the airtime follows the air data rate plus a
+      constant overhead per packet, only one packet can be on the air
+    - the receiving modem outputs the packet on its serial line 2 ms
+      after the end of the airtime, with the RSSI byte appended (if enabled)
+    - AUX is low while data are waiting or transmitted and from 2 ms before
+      received data are output until the output is complete
+    - packets get lost or corrupted (one random byte changed)
+      with configurable probabilities
+
+    All timing uses FC_time_us(), the state is updated whenever a method
+    is called, so the emulation works with a simulated clock as well as in real time.
+*/
+
+// the maximum number of bytes sent as one packet
+#define E220_PACKET_SIZE 200
+
+// the size of the transmit buffer of the modem
+#define E220_BUFFER_SIZE 400
+
+// the time from the end of the airtime to the output of the received data [us]
+#define E220_RX_DELAY 2000
+
+struct E220Settings {
+    // the air data rate of the ground modem [bit/s]
+    // the flight controller modem gets its rate from the configuration
+    uint32_t    ground_air_rate = 9600;
+    // the baud rate of the serial line of the ground modem
+    uint32_t    ground_baud = 115200;
+    // the ground modem appends the RSSI byte
+    bool        ground_rssi = true;
+    // bits of airtime per character
+    double      bits_per_char = 10.0;
+    // additional airtime of every packet in characters
+    double      packet_overhead = 12.0;
+    // the probability of a packet getting lost in each direction
+    double      loss_up = 0.0;
+    double      loss_down = 0.0;
+    // the probability of a packet being corrupted
+    double      corruption = 0.0;
+    // the mean RSSI value reported and its random variation
+    int         rssi = 200;
+    int         rssi_noise = 5;
+    uint32_t    seed = 1;
+};
+
+struct E220Statistics {
+    uint32_t    packets_sent[2] = {0, 0};
+    uint32_t    packets_lost[2] = {0, 0};
+    uint32_t    packets_corrupted[2] = {0, 0};
+    uint32_t    bytes_sent[2] = {0, 0};
+    uint32_t    buffer_overflows[2] = {0, 0};
+    uint64_t    airtime_us = 0;
+};
+
+class E220Emulator
+{
+
+public:
+
+    E220Emulator(E220Settings settings);
+
+    // the serial interface of the flight controller side
+    ModemSerial *local() { return &local_serial; };
+
+    // bytes sent by the ground station
+    void ground_in(const uint8_t *data, size_t size);
+
+    // bytes output by the ground modem up to now
+    size_t ground_out(uint8_t *buffer, size_t max_size);
+
+    // advance the emulation to the current time
+    void update();
+
+    // a packet is on the air
+    bool air_busy() { return air.active; };
+
+    const E220Statistics &statistics() { return stats; };
+
+private:
+
+    struct Side {
+        // the registers ADDH, ADDL, REG0, REG1, REG2 (channel), REG3
+        uint8_t     regs[6];
+        bool        config_mode;
+        // the baud rate of the connected serial port (0 if closed)
+        uint32_t    host_baud;
+        // the baud rate and air rate configured
+        uint32_t    baud;
+        uint32_t    air_rate;
+        bool        rssi;
+        // bytes received on the serial line waiting for transmission
+        std::deque<uint8_t> tx_fifo;
+        uint64_t    last_in;
+        // bytes to be output on the serial line with their time
+        std::deque<std::pair<uint64_t, uint8_t>> out;
+        // AUX state and the time of its last change
+        bool        aux_low;
+        uint64_t    aux_change;
+    };
+
+    struct Packet {
+        bool        active;
+        int         from;
+        std::vector<uint8_t> data;
+        // the end of the airtime (of the last packet if none is active)
+        uint64_t    end;
+    };
+
+    // the adapter for the Modem module
+    class LocalSerial : public ModemSerial
+    {
+    public:
+        E220Emulator *emu;
+        uint64_t     tx_end;
+        virtual void begin(uint32_t baud);
+        virtual void end();
+        virtual void set_config_mode(bool config);
+        virtual bool aux_busy();
+        virtual uint32_t aux_last_change();
+        virtual size_t available();
+        virtual bool rx_pending();
+        virtual size_t read(uint8_t *buffer, size_t max_size);
+        virtual bool tx_busy();
+        virtual bool write(const uint8_t *data, size_t size);
+    };
+
+    // bytes arrive at the serial input of a modem
+    void serial_in(int side, const uint8_t *data, size_t size, uint64_t time);
+
+    // handle a command in configuration mode
+    void configure(int side, uint64_t time);
+
+    // output bytes on the serial line of a modem starting at the given time
+    void serial_out(int side, const std::vector<uint8_t> &data, uint64_t start);
+
+    // take the configured rates from the registers
+    void apply_registers(int side);
+
+    // the time of one character on the serial line [us]
+    static uint64_t char_time(uint32_t baud) { return baud>0 ? 10000000/baud : 0; };
+
+    // the number of bytes output up to now
+    size_t take_output(int side, uint8_t *buffer, size_t max_size);
+
+    void update_aux(int side, uint64_t now);
+
+    E220Settings    settings;
+    E220Statistics  stats;
+    Side            sides[2];
+    Packet          air;
+    LocalSerial     local_serial;
+    std::mt19937    rng;
+};
@@ -0,0 +1,65 @@
+#include "host_kernel.h"
+
+#include <chrono>
+#include <vector>
+
+static bool clock_simulated = false;
+static uint64_t clock_us = 0;
+static uint64_t clock_step = 0;
+static std::chrono::steady_clock::time_point clock_start = std::chrono::steady_clock::now();
+
+static std::vector<TaskFunct> tasks;
+
+void host_clock_simulated(bool simulated)
+{
+    clock_simulated = simulated;
+    clock_us = 0;
+    clock_start = std::chrono::steady_clock::now();
+}
+
+void host_clock_advance(uint64_t us)
+{
+    clock_us += us;
+}
+
+void host_clock_auto_advance(uint64_t step_us)
+{
+    clock_step = step_us;
+}
+
+uint64_t FC_time_us()
+{
+    if (clock_simulated)
+    {
+        clock_us += clock_step;
+        return clock_us;
+    };
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - clock_start).count();
+}
+
+uint32_t FC_time_now()
+{
+    return (uint32_t)(FC_time_us() / 1000);
+}
+
+uint32_t FC_elapsed_millis(uint32_t timestamp)
+{
+    // the difference automatically wraps around
+    return FC_time_now() - timestamp;
+}
+
+void schedule_task(Module *mod, TaskFunct f)
+{
+    (void)mod;
+    tasks.push_back(f);
+}
+
+int host_run_tasks()
+{
+    // tasks may schedule further tasks, those are run with the next call
+    std::vector<TaskFunct> pending;
+    pending.swap(tasks);
+    for (auto &f : pending) f();
+    return pending.size();
+}
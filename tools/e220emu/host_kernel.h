@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+#include "kernel.h"
+
+/*
+    A minimal replacement of the TAROS kernel for running modules on the host.
+
+    The time functions of kernel.h either follow the real time (steady clock)
+    or a simulated clock which only advances when told to. With the simulated
+    clock a benchmark runs as fast as the host allows and gives reproducible results.
+
+    The busy-waiting loops in the setup() of the modules never advance
+    a simulated clock. While auto-advance is enabled every reading of the
+    clock advances it by the given step, so these loops terminate.
+
+    Tasks are collected by schedule_task() and executed by host_run_tasks().
+*/
+
+// select the simulated clock (starting at zero) or the real time
+void host_clock_simulated(bool simulated);
+
+// advance the simulated clock by a number of microseconds
+void host_clock_advance(uint64_t us);
+
+// every reading of the simulated clock advances it by the given time (0 to switch off)
+void host_clock_auto_advance(uint64_t step_us);
+
+// execute all tasks scheduled up to now
+// returns the number of tasks executed
+int host_run_tasks();
@@ -0,0 +1,327 @@
+/*
+    Benchmark of the modem link on the host.
+
+    The Modem module of the flight software is run against the E220 emulator
+    with a simulated telemetry load. The ground side output is decoded
+    to measure the delivered message rate and the latency, pings are sent
+    uplink to measure the round-trip time.
+
+    With --pty the ground modem is connected to a pseudo terminal, so
+    test/message_receiver.py or the GCS can attach to it (real-time only).
+
+    usage: modem_bench [options]
+        --fast              run with a simulated clock as fast as possible
+        --seconds <s>       duration of the run (default 60)
+        --rate <n>          telemetry messages per second offered (default 100)
+        --loss-down <p>     probability of losing a downlink packet
+        --loss-up <p>       probability of losing an uplink packet
+        --corrupt <p>       probability of corrupting a packet
+        --ping <ms>         interval of uplink pings, 0 for none (default 1000)
+        --pty [<link>]      connect the ground modem to a pty, optionally symlinked
+        --seed <n>          seed of the random number generator
+        --verbose           print all status messages of the modem module
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "e220_emulator.h"
+#include "framing.h"
+#include "host_kernel.h"
+#include "message.h"
+#include "modem.h"
+
+// every fifth message offered is a status report, the others are telemetry
+#define BENCH_STATUS_RATIO 5
+// the number of different telemetry variables
+#define BENCH_VARIABLES 8
+
+struct BenchResult {
+    uint32_t    offered = 0;
+    uint32_t    delivered = 0;
+    uint32_t    telemetry = 0;
+    uint32_t    status = 0;
+    std::vector<uint32_t> latency;
+    uint32_t    pings = 0;
+    uint32_t    ping_responses = 0;
+    std::vector<uint32_t> rtt;
+};
+
+static int open_pty(const char *link)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((fd < 0) or (grantpt(fd) != 0) or (unlockpt(fd) != 0))
+    {
+        perror("pty");
+        exit(1);
+    };
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    const char *name = ptsname(fd);
+    // keep the slave side open, otherwise the master reports errors
+    // while no client is attached
+    if (open(name, O_RDWR | O_NOCTTY) < 0)
+    {
+        perror(name);
+        exit(1);
+    };
+    printf("ground modem at %s\n", name);
+    if (link != NULL)
+    {
+        unlink(link);
+        if (symlink(name, link) != 0)
+            perror(link);
+        else
+            printf("linked as %s\n", link);
+    };
+    // the name is needed right away to attach a client
+    fflush(stdout);
+    return fd;
+}
+
+static uint32_t percentile(std::vector<uint32_t> v, double p)
+{
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size()-1, (size_t)(p*v.size()))];
+}
+
+static void print_messages(ReceiverPort &port, bool verbose)
+{
+    while (port.count() > 0)
+    {
+        Message msg = port.fetch();
+        if (verbose or (msg.type() != MSG_TYPE_SYSTEM_TEMPLATE))
+            printf("%s\n", msg.printout().c_str());
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    E220Settings settings;
+    bool fast = false;
+    bool verbose = false;
+    double seconds = 60.0;
+    double rate = 100.0;
+    uint32_t ping_interval = 1000;
+    bool use_pty = false;
+    const char *pty_link = NULL;
+
+    static struct option options[] = {
+        { "fast",       no_argument,        0, 'f' },
+        { "seconds",    required_argument,  0, 's' },
+        { "rate",       required_argument,  0, 'r' },
+        { "loss-down",  required_argument,  0, 'd' },
+        { "loss-up",    required_argument,  0, 'u' },
+        { "corrupt",    required_argument,  0, 'c' },
+        { "ping",       required_argument,  0, 'p' },
+        { "pty",        optional_argument,  0, 't' },
+        { "seed",       required_argument,  0, 'x' },
+        { "verbose",    no_argument,        0, 'v' },
+        { 0, 0, 0, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+        switch (opt)
+        {
+            case 'f': fast = true; break;
+            case 's': seconds = atof(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'd': settings.loss_down = atof(optarg); break;
+            case 'u': settings.loss_up = atof(optarg); break;
+            case 'c': settings.corruption = atof(optarg); break;
+            case 'p': ping_interval = atoi(optarg); break;
+            case 't':
+                use_pty = true;
+                pty_link = optarg;
+                // also accept the link name as a separate argument
+                if ((pty_link == NULL) and (optind < argc) and (argv[optind][0] != '-'))
+                    pty_link = argv[optind++];
+                break;
+            case 'x': settings.seed = atoi(optarg); break;
+            case 'v': verbose = true; break;
+            default:
+                fprintf(stderr, "see the head of modem_bench.cpp for the options\n");
+                return 1;
+        };
+    if (use_pty and fast)
+    {
+        fprintf(stderr, "a pty can only be used in real time\n");
+        return 1;
+    };
+
+    host_clock_simulated(fast);
+    E220Emulator emu(settings);
+    Modem modem(std::string("MODEM_1"), emu.local());
+    ReceiverPort status;
+    modem.status_out.set_receiver(&status);
+    // commands are delivered but not used
+    ReceiverPort commands;
+    modem.uplink.set_receiver(&commands);
+
+    // the setup waits in busy loops
+    if (fast) host_clock_auto_advance(10);
+    modem.setup();
+    host_clock_auto_advance(0);
+    print_messages(status, true);
+    if (modem.state() != MODULE_RUNLEVEL_OPERATIONAL)
+    {
+        fprintf(stderr, "modem setup failed\n");
+        return 1;
+    };
+
+    int pty = use_pty ? open_pty(pty_link) : -1;
+
+    BenchResult result;
+    FrameDecoder ground_decoder(1);
+    std::map<uint16_t, uint32_t> ping_sent;
+    uint16_t ping_hash = 0;
+    double offered = 0.0;
+    uint32_t start = FC_time_now();
+    uint32_t last_ping = start;
+    uint64_t next_tick = FC_time_us();
+    uint8_t buffer[1024];
+
+    while (FC_elapsed_millis(start) < 1000.0*seconds)
+    {
+        // the millisecond tick
+        if (fast)
+            host_clock_advance(1000);
+        else
+        {
+            next_tick += 1000;
+            uint64_t now = FC_time_us();
+            if (next_tick > now)
+                std::this_thread::sleep_for(std::chrono::microseconds(next_tick-now));
+        };
+        uint32_t now = FC_time_now();
+
+        // the simulated load
+        offered += rate/1000.0;
+        while (offered >= 1.0)
+        {
+            offered -= 1.0;
+            result.offered++;
+            if (result.offered % BENCH_STATUS_RATIO == 0)
+                modem.downlink.receive(Message::SystemMessage(
+                    "BENCH", now, MSG_LEVEL_STATUSREPORT, "simulated status report of some length"));
+            else
+                modem.downlink.receive(Message::DataFloat(
+                    "BENCH", result.offered % BENCH_VARIABLES + 1, now, 1.0f));
+        };
+
+        // uplink pings
+        if ((ping_interval > 0) and (FC_elapsed_millis(last_ping) >= ping_interval))
+        {
+            last_ping = now;
+            char body[3] = { (char)(ping_hash & 0xff), (char)(ping_hash >> 8), 0 };
+            Message ping("GCS", MSG_TYPE_PING, 3, body);
+            char payload[64];
+            uint8_t frame[FRAME_ENCODED_SIZE(64)];
+            size_t n = frame_encode((uint8_t *)payload, ping.buffer(payload, sizeof(payload)),
+                frame, sizeof(frame));
+            emu.ground_in(frame, n);
+            ping_sent[ping_hash++] = now;
+            result.pings++;
+        };
+
+        // the ground station side
+        if (pty >= 0)
+        {
+            ssize_t n = read(pty, buffer, sizeof(buffer));
+            if (n > 0) emu.ground_in(buffer, n);
+        };
+        size_t n = emu.ground_out(buffer, sizeof(buffer));
+        if ((pty >= 0) and (n > 0))
+            if (write(pty, buffer, n) < 0) {};
+        for (size_t i=0; i<n; i++)
+            if (ground_decoder.push(buffer[i]))
+            {
+                const char *frame = (const char *)ground_decoder.frame();
+                size_t pos = 0;
+                while (pos < ground_decoder.frame_size())
+                {
+                    MessageView view(frame+pos, ground_decoder.frame_size()-pos);
+                    if (!view.valid()) break;
+                    result.delivered++;
+                    if (view.type() == MSG_TYPE_DATA_FLOAT)
+                    {
+                        // the body is packed : hash, time, value
+                        uint32_t time;
+                        std::memcpy(&time, view.body()+2, sizeof(time));
+                        result.telemetry++;
+                        result.latency.push_back(now - time);
+                    }
+                    else if (view.type() == MSG_TYPE_SYSTEM)
+                        result.status++;
+                    else if (view.type() == MSG_TYPE_PINGRESPONSE)
+                    {
+                        uint16_t hash = (uint8_t)view.body()[0] | ((uint8_t)view.body()[1] << 8);
+                        auto it = ping_sent.find(hash);
+                        if (it != ping_sent.end())
+                        {
+                            result.rtt.push_back(now - it->second);
+                            result.ping_responses++;
+                            ping_sent.erase(it);
+                        };
+                    };
+                    pos += view.size();
+                };
+            };
+
+        // the flight controller side
+        emu.update();
+        modem.interrupt();
+        host_run_tasks();
+        print_messages(status, verbose);
+        while (commands.count() > 0) commands.fetch();
+    };
+
+    modem.report_link();
+    print_messages(status, true);
+
+    const E220Statistics &stats = emu.statistics();
+    double duration = FC_elapsed_millis(start) / 1000.0;
+    printf("\n");
+    printf("loss down %.2f up %.2f corruption %.2f  %.1f s %s\n",
+        settings.loss_down, settings.loss_up, settings.corruption,
+        duration, fast ? "simulated" : "real time");
+    printf("air   : downlink %u packets %u bytes (%.0f B/s) lost %u corrupted %u\n",
+        stats.packets_sent[0], stats.bytes_sent[0], stats.bytes_sent[0]/duration,
+        stats.packets_lost[0], stats.packets_corrupted[0]);
+    printf("        uplink %u packets %u bytes lost %u corrupted %u  airtime %.1f%%\n",
+        stats.packets_sent[1], stats.bytes_sent[1],
+        stats.packets_lost[1], stats.packets_corrupted[1],
+        100.0*stats.airtime_us/(duration*1.0e6));
+    printf("ground: %u frames ok %u lost, %u messages (%.1f/s) of %u offered\n",
+        ground_decoder.frames_ok(), ground_decoder.frames_lost(),
+        result.delivered, result.delivered/duration, result.offered);
+    printf("        telemetry %u status %u  latency median %u p95 %u max %u ms\n",
+        result.telemetry, result.status,
+        percentile(result.latency, 0.5), percentile(result.latency, 0.95),
+        percentile(result.latency, 1.0));
+    printf("ping  : %u sent %u answered  round trip median %u p95 %u max %u ms\n",
+        result.pings, result.ping_responses,
+        percentile(result.rtt, 0.5), percentile(result.rtt, 0.95),
+        percentile(result.rtt, 1.0));
+    if (pty >= 0)
+    {
+        close(pty);
+        if (pty_link != NULL) unlink(pty_link);
+    };
+    return 0;
+}
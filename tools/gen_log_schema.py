@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+
+"""
+Generate the log schema from the data type definitions.
+
+The stream data types are defined in src/types.h. Every struct DATA_<name>
+with a signature DATA_<name>_SIGNATURE becomes a record type of the log files.
+This script computes the layout of the structs (natural alignment like
+the ARM EABI), takes the unit of every member from the first [...] in its
+comment and writes a header with the schema text, that is stored in the head
+block of every log file (see src/log_format.h), the record sizes and
+static assertions that the compiler agrees with the layout.
+
+usage: gen_log_schema.py src/types.h src/log_schema.h
+"""
+
+import re
+import sys
+
+# C type : (schema type, size)
+TYPES = {
+    'uint8_t': ('u8', 1), 'int8_t': ('i8', 1),
+    'uint16_t': ('u16', 2), 'int16_t': ('i16', 2),
+    'uint32_t': ('u32', 4), 'int32_t': ('i32', 4),
+    'uint64_t': ('u64', 8), 'int64_t': ('i64', 8),
+    'float': ('f32', 4), 'double': ('f64', 8),
+}
+
+SIGNATURE = re.compile(r'^\s*#define\s+DATA_(\w+)_SIGNATURE\s+(0x[0-9a-fA-F]+|\d+)')
+STRUCT = re.compile(r'^\s*struct\s+DATA_(\w+)\s*\{')
+MEMBER = re.compile(r'^\s*(\w+)\s+(\w+)\s*;\s*(?://(.*))?$')
+UNIT = re.compile(r'\[([^\]]*)\]')
+END = re.compile(r'^\s*\}\s*;')
+
+
+def parse(header):
+    signatures = {}
+    structs = []
+    current = None
+    with open(header) as f:
+        for number, line in enumerate(f, 1):
+            m = SIGNATURE.match(line)
+            if m:
+                signatures[m.group(1)] = int(m.group(2), 0)
+                continue
+            m = STRUCT.match(line)
+            if m:
+                current = (m.group(1), [])
+                structs.append(current)
+                continue
+            if current is None:
+                continue
+            if END.match(line):
+                current = None
+                continue
+            m = MEMBER.match(line)
+            if m:
+                if m.group(1) not in TYPES:
+                    sys.exit("%s:%d: unsupported member type %s" % (header, number, m.group(1)))
+                u = UNIT.search(m.group(3) or '')
+                current[1].append((m.group(2), m.group(1), u.group(1) if u else '-'))
+            elif line.strip() and not line.strip().startswith('//'):
+                sys.exit("%s:%d: cannot parse member" % (header, number))
+    records = []
+    for name, members in structs:
+        if name not in signatures:
+            sys.exit("gen_log_schema: no signature for DATA_" + name)
+        if not members or members[0][0] != 'time' or members[0][1] != 'uint64_t':
+            sys.exit("gen_log_schema: DATA_%s must start with uint64_t time" % name)
+        fields = []
+        offset = 0
+        for member, ctype, unit in members:
+            stype, size = TYPES[ctype]
+            offset = (offset + size - 1) // size * size
+            fields.append((member, stype, offset, unit.replace(' ', '')))
+            offset += size
+        # the record holds the data without the padding at the end of the struct
+        records.append((signatures[name], name, offset, fields))
+    sigs = [r[0] for r in records]
+    if len(set(sigs)) != len(sigs):
+        sys.exit("gen_log_schema: duplicate signature in " + header)
+    return records
+
+
+def main(header, output):
+    records = parse(header)
+    with open(output, 'w') as f:
+        f.write('// generated by tools/gen_log_schema.py from src/types.h - do not edit\n\n')
+        f.write('#pragma once\n\n')
+        f.write('#include <cstddef>\n\n')
+        f.write('#include "types.h"\n\n')
+        f.write('// the schema of all records, stored in the head block of every log file\n')
+        f.write('// record <signature> <name> <size>\n')
+        f.write('// field <name> <type> <offset> <unit>\n')
+        f.write('#define LOG_SCHEMA_TEXT \\\n')
+        f.write('    "taros-schema 1\\n" \\\n')
+        for sig, name, size, fields in records:
+            f.write('    "record 0x%02x DATA_%s %d\\n" \\\n' % (sig, name, size))
+            for member, stype, offset, unit in fields:
+                f.write('    "field %s %s %d %s\\n" \\\n' % (member, stype, offset, unit))
+        f.write('    ""\n\n')
+        f.write('// X(name, signature, size) for all record types\n')
+        f.write('#define LOG_RECORD_TABLE(X) \\\n')
+        f.write(' \\\n'.join('    X(DATA_%s, 0x%02x, %d)' % (name, sig, size)
+                            for sig, name, size, fields in records))
+        f.write('\n\n')
+        f.write('// the size of a record (without the signature), 0 for an unknown signature\n')
+        f.write('inline size_t log_record_size(uint8_t signature)\n{\n')
+        f.write('    switch (signature)\n    {\n')
+        for sig, name, size, fields in records:
+            f.write('        case DATA_%s_SIGNATURE: return %d;\n' % (name, size))
+        f.write('        default: return 0;\n    };\n}\n\n')
+        f.write('// the layout given in the schema must be the one of the compiler\n')
+        for sig, name, size, fields in records:
+            for member, stype, offset, unit in fields:
+                f.write('static_assert(offsetof(DATA_%s, %s) == %d, "log schema out of date, run tools/gen_log_schema.py");\n'
+                        % (name, member, offset))
+            f.write('static_assert(sizeof(DATA_%s) >= %d, "log schema out of date, run tools/gen_log_schema.py");\n'
+                    % (name, size))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    main(sys.argv[1], sys.argv[2])
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+
+"""
+Generate the table of system message templates for the ground station.
+
+The templates are defined in src/msg_templates.h (MSG_TEMPLATE_TABLE).
+This script parses that table and writes a python module with the
+format strings keyed by template ID and a formatter for the binary
+arguments of MSG_TYPE_SYSTEM_TEMPLATE messages.
+
+usage: gen_msg_templates.py src/msg_templates.h GCS/taros_templates.py
+"""
+
+import re
+import sys
+
+ENTRY = re.compile(r'^\s*X\(\s*(\w+)\s*,\s*(\d+)\s*,\s*("(?:[^"\\]|\\.)*")\s*\)')
+
+FORMATTER = '''
+def format_template(template_id, args):
+    """
+    Format the binary arguments of a template message into a text.
+    """
+    if template_id not in TEMPLATES:
+        return "unknown template %d" % template_id
+    name, fmt = TEMPLATES[template_id]
+    text = ""
+    pos = 0
+    for literal, spec, conv in SPEC.findall(fmt):
+        text += literal
+        if conv == '':
+            continue
+        if conv == '%':
+            text += '%'
+        elif conv in 'di':
+            value, = unpack_from('<i', args, pos) if pos+4 <= len(args) else (0,)
+            pos += 4
+            text += (spec+conv) % value
+        elif conv in 'uxX':
+            value, = unpack_from('<I', args, pos) if pos+4 <= len(args) else (0,)
+            pos += 4
+            text += (spec+('d' if conv == 'u' else conv)) % value
+        elif conv in 'feg':
+            value, = unpack_from('<f', args, pos) if pos+4 <= len(args) else (0.0,)
+            pos += 4
+            text += (spec+conv) % value
+        elif conv in 'sH':
+            count = args[pos] if pos < len(args) else 0
+            block = args[pos+1:pos+1+count]
+            pos += 1+count
+            if conv == 's':
+                text += block.decode(encoding='utf-8', errors='replace')
+            else:
+                text += "".join("%02X " % b for b in block)
+    return text
+'''
+
+
+def main(header, output):
+    templates = []
+    with open(header) as f:
+        for line in f:
+            m = ENTRY.match(line)
+            if m:
+                templates.append((int(m.group(2)), m.group(1), m.group(3)))
+    ids = [t[0] for t in templates]
+    if len(set(ids)) != len(ids):
+        sys.exit("gen_msg_templates: duplicate template ID in " + header)
+    with open(output, 'w') as f:
+        f.write('# generated by tools/gen_msg_templates.py from src/msg_templates.h - do not edit\n\n')
+        f.write('import re\n')
+        f.write('from struct import unpack_from\n\n')
+        f.write('# template ID : (name, format)\n')
+        f.write('TEMPLATES = {\n')
+        for tid, name, fmt in templates:
+            f.write('    %d: (%r, %s),\n' % (tid, name, fmt))
+        f.write('}\n\n')
+        f.write('# literal text, flags/width/precision and the conversion character\n')
+        f.write("SPEC = re.compile(r'([^%]*)(?:(%[-+ #0-9.]*)(.))?', re.S)\n")
+        f.write(FORMATTER)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    main(sys.argv[1], sys.argv[2])
@@ -0,0 +1,460 @@
+/*
+    Test and benchmark of the compact binary message codec on the host.
+
+    The encoder (Message::buffer()) and the decoder (MessageView and
+    Message(MessageView)) of the flight software are run against :
+        - a round trip of every message type with random content
+          (the decoded message must encode to the same bytes and print the same)
+        - buffers too short for the message (nothing is written, 0 is returned)
+          and truncated messages (the view is not valid)
+        - messages exceeding MSG_MAX_ENCODED_SIZE (rejected, never truncated)
+        - random bytes fed into MessageView and the Message constructor
+    Then the encode and decode throughput is measured in MB/s of encoded data.
+
+    usage: msg_codec_test [options]
+        --rounds <n>        random messages per type for the round trip (default 1000)
+        --fuzz <n>          number of random buffers decoded (default 1000000)
+        --seconds <s>       duration of each benchmark (default 1.0)
+        --seed <n>          seed of the random number generator
+
+    The exit code is 0 if all checks passed.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+
+#include "message.h"
+#include "msg_templates.h"
+#include "types.h"
+
+static std::mt19937 rng(1);
+static uint64_t checks = 0;
+static uint64_t failures = 0;
+
+static void check(bool ok, const char* what, Message &msg)
+{
+    checks++;
+    if (ok) return;
+    failures++;
+    // only the first failures are printed in detail
+    if (failures <= 20)
+        printf("FAILED %s : type 0x%04x size %u %s\n", what, msg.type(), msg.size(), msg.printout().c_str());
+}
+
+static uint32_t random_int(uint32_t max)
+{
+    return std::uniform_int_distribution<uint32_t>(0, max)(rng);
+}
+
+// any bytes, the strings of the messages may hold binary data
+static std::string random_bytes(size_t n)
+{
+    std::string s(n, ' ');
+    for (size_t i=0; i<n; i++) s[i] = (char)random_int(255);
+    return s;
+}
+
+// the padding of the sender ID is removed on decoding,
+// so the names have no trailing blanks (like the module IDs)
+static std::string random_sender()
+{
+    static const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    std::string s(1+random_int(7), ' ');
+    for (size_t i=0; i<s.size(); i++) s[i] = chars[random_int(sizeof(chars)-2)];
+    return s;
+}
+
+static float random_float()
+{
+    return std::uniform_real_distribution<float>(-1000.0, 1000.0)(rng);
+}
+
+static double random_double()
+{
+    return std::uniform_real_distribution<double>(-180.0, 180.0)(rng);
+}
+
+// the message types covered, one random message of each is created by make_message()
+static const uint16_t all_types[] = {
+    MSG_TYPE_SYSTEM, MSG_TYPE_TEXT, MSG_TYPE_TELEMETRY, MSG_TYPE_GPS_POSITION,
+    MSG_TYPE_SERVO, MSG_TYPE_COMMAND, MSG_TYPE_PING, MSG_TYPE_PINGRESPONSE,
+    MSG_TYPE_TM_VARIABLE, MSG_TYPE_SYSTEM_TEMPLATE, MSG_TYPE_COMMAND_ACK,
+    MSG_TYPE_DATA_INT16, MSG_TYPE_DATA_FLOAT, MSG_TYPE_DATA_DOUBLE, MSG_TYPE_DATA_GPS,
+    MSG_TYPE_IMU_AHRS, MSG_TYPE_IMU_GYRO };
+static const size_t num_types = sizeof(all_types)/sizeof(all_types[0]);
+
+// a message of the given type with random content that fits into MSG_MAX_ENCODED_SIZE
+// (the strings are up to 244 bytes long in total)
+static Message make_message(uint16_t type)
+{
+    std::string sender = random_sender();
+    uint32_t time = random_int(0xFFFFFFFF);
+    switch (type)
+    {
+        case MSG_TYPE_SYSTEM:
+            return Message::SystemMessage(sender, time, random_int(30), random_bytes(random_int(239)));
+        case MSG_TYPE_TEXT:
+            return Message::TextMessage(sender, random_bytes(random_int(244)));
+        case MSG_TYPE_TELEMETRY:
+        {
+            size_t n = random_int(60);
+            return Message::TelemetryMessage(sender, time, random_bytes(n), random_bytes(random_int(239-n)));
+        };
+        case MSG_TYPE_GPS_POSITION:
+        {
+            MSG_DATA_GPS_POSITION data;
+            memset(&data, 0, sizeof(data));
+            data.latitude = random_double();
+            data.longitude = random_double();
+            data.altitude = random_float();
+            return Message(sender, type, sizeof(data), &data);
+        };
+        case MSG_TYPE_SERVO:
+        {
+            MSG_DATA_SERVO data;
+            for (int i=0; i<NUM_SERVO_CHANNELS; i++) data.pos[i] = (short int)random_int(0xFFFF);
+            return Message(sender, type, sizeof(data), &data);
+        };
+        case MSG_TYPE_SYSTEM_TEMPLATE:
+        {
+            // the arguments are taken as they are, a valid template makes print_content() meaningful
+            switch (random_int(2))
+            {
+                case 0:
+                    return Message::SystemTemplate(sender, time, MSG_LEVEL_WARNING,
+                        TPL_WATCHDOG_SYSTICK, random_float());
+                case 1:
+                    return Message::SystemTemplate(sender, time, MSG_LEVEL_STATUSREPORT,
+                        TPL_WATCHDOG_RUNTIME, random_sender().c_str(), random_float());
+                default:
+                {
+                    std::string args = random_bytes(random_int(237));
+                    return Message::SystemTemplate(sender, time, random_int(30),
+                        (uint16_t)random_int(0xFFFF), args.data(), (uint8_t)args.size());
+                };
+            };
+        };
+        case MSG_TYPE_COMMAND_ACK:
+            return Message::CommandAck(sender, random_int(0xFFFF), random_int(1), random_int(255));
+        case MSG_TYPE_TM_VARIABLE:
+        {
+            size_t n = random_int(60);
+            return Message::TelemetryVariable(sender, random_int(0xFFFF), MSG_TYPE_DATA_FLOAT,
+                random_bytes(n), random_bytes(random_int(239-n)));
+        };
+        case MSG_TYPE_DATA_INT16:
+            return Message::DataInt16(sender, random_int(0xFFFF), time, (int16_t)random_int(0xFFFF));
+        case MSG_TYPE_DATA_FLOAT:
+            return Message::DataFloat(sender, random_int(0xFFFF), time, random_float());
+        case MSG_TYPE_DATA_DOUBLE:
+            return Message::DataDouble(sender, random_int(0xFFFF), time, random_double());
+        case MSG_TYPE_DATA_GPS:
+            return Message::DataGPS(sender, random_int(0xFFFF), time,
+                random_double(), random_double(), random_float());
+        case MSG_TYPE_IMU_AHRS:
+        {
+            DATA_IMU_AHRS data;
+            memset(&data, 0, sizeof(data));
+            data.time = ((uint64_t)random_int(0xFFFFFFFF) << 32) | random_int(0xFFFFFFFF);
+            data.attitude = random_float();
+            data.heading = random_float();
+            data.roll = random_float();
+            Message msg(sender, type, sizeof(data), &data);
+            msg.set_time(data.time);
+            return msg;
+        };
+        case MSG_TYPE_IMU_GYRO:
+        {
+            DATA_IMU_GYRO data;
+            memset(&data, 0, sizeof(data));
+            data.time = ((uint64_t)random_int(0xFFFFFFFF) << 32) | random_int(0xFFFFFFFF);
+            data.nick = random_float();
+            data.yaw = random_float();
+            data.roll = random_float();
+            Message msg(sender, type, sizeof(data), &data);
+            msg.set_time(data.time);
+            return msg;
+        };
+        default:
+        {
+            // commands and pings are transmitted as a data blob
+            std::string blob = random_bytes(random_int(244));
+            return Message(sender, type, blob.size(), (void*)blob.data());
+        };
+    };
+}
+
+// encode a message, decode it and check that nothing was lost
+static void round_trip(Message &msg)
+{
+    char buf[MSG_MAX_ENCODED_SIZE];
+    char again[MSG_MAX_ENCODED_SIZE];
+    size_t n = msg.buffer(buf, sizeof(buf));
+    check(n > 0, "encoding", msg);
+    if (n == 0) return;
+    check(n == msg.encoded_size(), "encoded size", msg);
+    MessageView view(buf, n);
+    check(view.valid(), "view valid", msg);
+    check(view.type() == msg.type(), "view type", msg);
+    check(view.size() == n, "view size", msg);
+    // the rest of a larger buffer is ignored
+    MessageView larger(buf, sizeof(buf));
+    check(larger.valid() and (larger.size() == n), "view of a larger buffer", msg);
+    Message decoded(view);
+    check(decoded.type() == msg.type(), "decoded type", msg);
+    // the data messages carry no sender ID
+    if (msg_data_size(msg.type()) == 0)
+        check(decoded.sender() == msg.sender(), "decoded sender", msg);
+    check(decoded.print_content() == msg.print_content(), "decoded content", msg);
+    // the decoded message must give the same bytes again
+    // (the structs are not compared directly, their padding is undefined)
+    size_t n2 = decoded.buffer(again, sizeof(again));
+    check((n2 == n) and (memcmp(buf, again, n) == 0), "encoding of the decoded message", msg);
+    // the time is only restored with the resolution which is encoded :
+    // the IMU types carry the us time, others the ms time field at some offset of the body
+    uint64_t time = 0;
+    int offset = -1;
+    switch (msg.type())
+    {
+        case MSG_TYPE_IMU_AHRS:
+        case MSG_TYPE_IMU_GYRO:
+            time = msg.time();
+            break;
+        case MSG_TYPE_TELEMETRY:
+            offset = 0;
+            break;
+        case MSG_TYPE_SYSTEM:
+        case MSG_TYPE_SYSTEM_TEMPLATE:
+            offset = 1;
+            break;
+        case MSG_TYPE_DATA_INT16:
+        case MSG_TYPE_DATA_FLOAT:
+        case MSG_TYPE_DATA_DOUBLE:
+        case MSG_TYPE_DATA_GPS:
+            offset = 2;
+            break;
+    };
+    if (offset >= 0)
+    {
+        uint32_t millis;
+        memcpy(&millis, view.body() + offset, 4);
+        time = (uint64_t)millis * 1000;
+    };
+    check(decoded.time() == time, "decoded time", msg);
+}
+
+// buffers too short for the message and truncated messages
+static void short_buffers(Message &msg)
+{
+    char buf[MSG_MAX_ENCODED_SIZE];
+    size_t n = msg.encoded_size();
+    if (n > sizeof(buf)) return;
+    // nothing may be written into a buffer that is too small
+    memset(buf, 0xA5, sizeof(buf));
+    bool untouched = (msg.buffer(buf, n-1) == 0);
+    for (size_t i=0; i<sizeof(buf); i++) untouched = untouched and ((uint8_t)buf[i] == 0xA5);
+    check(untouched, "buffer too short", msg);
+    // a message cut off anywhere is not valid
+    msg.buffer(buf, sizeof(buf));
+    bool invalid = true;
+    for (size_t k=0; k<n; k++)
+        invalid = invalid and not MessageView(buf, k).valid();
+    check(invalid, "truncated message", msg);
+    Message decoded(buf, n-1);
+    check(decoded.type() == MSG_TYPE_ABSTRACT, "decoding of a truncated message", msg);
+}
+
+// messages which do not fit into MSG_MAX_ENCODED_SIZE are rejected as a whole
+static void oversize()
+{
+    char buf[2*MSG_MAX_ENCODED_SIZE];
+    // the largest text that fits and one byte more
+    size_t max_text = MSG_MAX_ENCODED_SIZE - MSG_HEADER_SIZE;
+    Message fits = Message::TextMessage("TEST", random_bytes(max_text));
+    check(fits.buffer(buf, sizeof(buf)) == MSG_MAX_ENCODED_SIZE, "largest message", fits);
+    Message text = Message::TextMessage("TEST", random_bytes(max_text+1));
+    check(text.buffer(buf, sizeof(buf)) == 0, "oversize text", text);
+    Message system = Message::SystemMessage("TEST", 0, MSG_LEVEL_ERROR, random_bytes(max_text));
+    check(system.buffer(buf, sizeof(buf)) == 0, "oversize system message", system);
+    std::string args = random_bytes(250);
+    Message tpl = Message::SystemTemplate("TEST", 0, MSG_LEVEL_ERROR, 1, args.data(), (uint8_t)args.size());
+    check(tpl.buffer(buf, sizeof(buf)) == 0, "oversize template", tpl);
+    Message telemetry = Message::TelemetryMessage("TEST", 0, random_bytes(100), random_bytes(150));
+    check(telemetry.buffer(buf, sizeof(buf)) == 0, "oversize telemetry", telemetry);
+    std::string blob = random_bytes(300);
+    Message command(std::string("TEST"), MSG_TYPE_COMMAND, blob.size(), (void*)blob.data());
+    check(command.buffer(buf, sizeof(buf)) == 0, "oversize command", command);
+}
+
+// random bytes must never be read beyond the given size or crash the decoder
+static void fuzz(uint64_t count)
+{
+    // the buffer is allocated with the exact size for each test,
+    // so the address sanitizer (make SANITIZE=1) finds any read beyond it
+    uint64_t valid = 0;
+    for (uint64_t i=0; i<count; i++)
+    {
+        size_t size = random_int(MSG_MAX_ENCODED_SIZE + 8);
+        std::vector<char> data(size);
+        for (size_t k=0; k<size; k++) data[k] = (char)random_int(255);
+        // most of the time a known type, otherwise nothing would get past the signature
+        if ((size >= 2) and (random_int(3) > 0))
+        {
+            uint16_t type = all_types[random_int(num_types-1)];
+            data[0] = type >> 8;
+            data[1] = type & 0xFF;
+            // a plausible size (the sender ID and a body that fits)
+            if ((size >= 3) and (random_int(1) == 0))
+                data[2] = (char)(8 + random_int((size > MSG_HEADER_SIZE) ? size - MSG_HEADER_SIZE : 0));
+        };
+        MessageView view(data.data(), size);
+        Message msg(view);
+        if (not view.valid())
+        {
+            check(msg.type() == MSG_TYPE_ABSTRACT, "fuzz invalid", msg);
+            continue;
+        };
+        valid++;
+        check(view.size() <= size, "fuzz view size", msg);
+        check(msg.type() == view.type(), "fuzz type", msg);
+        // anything accepted must be encoded again and decoded to the same type
+        char buf[MSG_MAX_ENCODED_SIZE];
+        size_t n = msg.buffer(buf, sizeof(buf));
+        check(n > 0, "fuzz encoding", msg);
+        check(MessageView(buf, n).valid() and (MessageView(buf, n).type() == msg.type()), "fuzz round trip", msg);
+        msg.print_content();
+    };
+    printf("fuzz : %llu random buffers, %llu valid messages\n",
+        (unsigned long long)count, (unsigned long long)valid);
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// throughput of the encoder and the decoder with a mix of all message types
+static void benchmark(double seconds)
+{
+    std::vector<Message> messages;
+    for (int i=0; i<64; i++)
+        for (size_t t=0; t<num_types; t++)
+            messages.push_back(make_message(all_types[t]));
+    // the encoded messages are kept in one stream for the decoder
+    std::vector<char> stream(messages.size() * MSG_MAX_ENCODED_SIZE);
+    size_t stream_size = 0;
+    for (Message &msg : messages)
+        stream_size += msg.buffer(stream.data() + stream_size, stream.size() - stream_size);
+
+    char buf[MSG_MAX_ENCODED_SIZE];
+    uint64_t bytes = 0;
+    uint64_t count = 0;
+    double t = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    while (t < seconds)
+    {
+        for (Message &msg : messages)
+            bytes += msg.buffer(buf, sizeof(buf));
+        count += messages.size();
+        t = seconds_since(start);
+    };
+    printf("encode      : %8.1f MB/s  %6.1f ns per message\n", bytes / t * 1.0e-6, t / count * 1.0e9);
+
+    // the view only, this is what a receiver does before deciding on a message
+    bytes = 0;
+    count = 0;
+    t = 0.0;
+    uint32_t types = 0;
+    start = std::chrono::steady_clock::now();
+    while (t < seconds)
+    {
+        size_t pos = 0;
+        while (pos < stream_size)
+        {
+            MessageView view(stream.data() + pos, stream_size - pos);
+            if (not view.valid()) break;
+            types += view.type();
+            pos += view.size();
+            count++;
+        };
+        bytes += pos;
+        t = seconds_since(start);
+    };
+    printf("view        : %8.1f MB/s  %6.1f ns per message\n", bytes / t * 1.0e-6, t / count * 1.0e9);
+
+    // the complete decoding into a Message (with the heap allocation of the data)
+    bytes = 0;
+    count = 0;
+    t = 0.0;
+    start = std::chrono::steady_clock::now();
+    while (t < seconds)
+    {
+        size_t pos = 0;
+        while (pos < stream_size)
+        {
+            MessageView view(stream.data() + pos, stream_size - pos);
+            if (not view.valid()) break;
+            Message msg(view);
+            types += msg.size();
+            pos += view.size();
+            count++;
+        };
+        bytes += pos;
+        t = seconds_since(start);
+    };
+    printf("decode      : %8.1f MB/s  %6.1f ns per message\n", bytes / t * 1.0e-6, t / count * 1.0e9);
+    // the sum is printed, so the loops are not optimized away
+    printf("(%llu messages of %.1f bytes average, checksum %u)\n",
+        (unsigned long long)messages.size(), (double)stream_size / messages.size(), types & 0xFF);
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t rounds = 1000;
+    uint64_t fuzz_count = 1000000;
+    double seconds = 1.0;
+
+    static struct option options[] = {
+        { "rounds",     required_argument, 0, 'r' },
+        { "fuzz",       required_argument, 0, 'f' },
+        { "seconds",    required_argument, 0, 's' },
+        { "seed",       required_argument, 0, 'S' },
+        { 0, 0, 0, 0 }
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "", options, NULL)) != -1)
+    {
+        switch (c)
+        {
+            case 'r': rounds = strtoull(optarg, NULL, 0); break;
+            case 'f': fuzz_count = strtoull(optarg, NULL, 0); break;
+            case 's': seconds = atof(optarg); break;
+            case 'S': rng.seed(strtoul(optarg, NULL, 0)); break;
+            default:
+                fprintf(stderr, "usage: msg_codec_test [--rounds n] [--fuzz n] [--seconds s] [--seed n]\n");
+                return 1;
+        };
+    };
+
+    for (size_t t=0; t<num_types; t++)
+        for (uint64_t i=0; i<rounds; i++)
+        {
+            Message msg = make_message(all_types[t]);
+            round_trip(msg);
+            short_buffers(msg);
+        };
+    printf("round trip : %llu messages of %u types\n",
+        (unsigned long long)(rounds * num_types), (unsigned int)num_types);
+    oversize();
+    fuzz(fuzz_count);
+    printf("%llu checks, %llu failed\n", (unsigned long long)checks, (unsigned long long)failures);
+    if (seconds > 0.0) benchmark(seconds);
+    return (failures == 0) ? 0 : 1;
+}
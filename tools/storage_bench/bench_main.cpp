@@ -0,0 +1,103 @@
+/*
+    Benchmark of the storage on the host (see src/storage_bench.h).
+
+    The files of the host file system are measured as a baseline.
+    If built with littlefs (see Makefile) LfsStorage is measured on a block device
+    in RAM (the cost of the file system itself) and optionally in an image file.
+    The FAT storage of the SD card can only be measured on the target (STORAGE_BENCHMARK).
+
+    usage: storage_bench [options]
+        --dir <dir>         the directory of the host files (default /tmp)
+        --image <file>      also measure LittleFS in this image file
+        --size <MB>         the size of the block devices (default 64)
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <getopt.h>
+#include <time.h>
+
+#include "host_storage.h"
+#include "storage_bench.h"
+
+static uint32_t host_micros()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32_t)((uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000);
+}
+
+static void run(Storage* storage, const char* label)
+{
+    StorageBenchResult r;
+    if (not storage_benchmark(storage, "/bench.dat", host_micros, r))
+    {
+        printf("%-16s failed\n", label);
+        return;
+    };
+    printf("%-16s append %8.1f us (max %6u us)  throughput %8.2f MB/s  sync %8.0f us (max %6u us)\n",
+        label, r.append_mean, r.append_max, r.throughput, r.sync_mean, r.sync_max);
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: storage_bench [--dir <dir>] [--image <file>] [--size <MB>]\n");
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string dir = "/tmp";
+    const char* image = NULL;
+    uint32_t size_mb = 64;
+
+    static struct option options[] = {
+        {"dir",     required_argument, 0, 'd'},
+        {"image",   required_argument, 0, 'i'},
+        {"size",    required_argument, 0, 's'},
+        {0, 0, 0, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:i:s:", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'd': dir = optarg; break;
+            case 'i': image = optarg; break;
+            case 's': size_mb = atoi(optarg); break;
+            default: usage();
+        };
+    };
+    if (size_mb < 8) usage();
+
+    PosixStorage posix(dir);
+    run(&posix, "POSIX");
+
+#ifdef USE_LITTLEFS
+    uint32_t blocks = size_mb * 1024 * 1024 / LFS_STORAGE_BLOCK_SIZE;
+    {
+        RamBlockDevice ram(blocks);
+        LfsStorage lfs(&ram);
+        if (lfs.begin(true))
+            run(&lfs, "LittleFS (RAM)");
+        else
+            printf("%-16s not mounted\n", "LittleFS (RAM)");
+    }
+    if (image != NULL)
+    {
+        FileBlockDevice file(image, blocks);
+        LfsStorage lfs(&file);
+        if (file.ok() and lfs.begin(true))
+            run(&lfs, "LittleFS (image)");
+        else
+            printf("%-16s not mounted\n", "LittleFS (image)");
+    };
+#else
+    if (image != NULL)
+        fprintf(stderr, "built without littlefs, the image is not used\n");
+#endif
+
+    return 0;
+}
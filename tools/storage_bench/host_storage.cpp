@@ -0,0 +1,157 @@
+#include "host_storage.h"
+
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+PosixStorageFile::~PosixStorageFile()
+{
+    close();
+}
+
+size_t PosixStorageFile::write(const void* data, size_t size)
+{
+    ssize_t n = ::write(m_fd, data, size);
+    return (n < 0) ? 0 : n;
+}
+
+int PosixStorageFile::read(void* data, size_t size)
+{
+    return ::read(m_fd, data, size);
+}
+
+bool PosixStorageFile::preallocate(uint64_t size)
+{
+    return posix_fallocate(m_fd, 0, size) == 0;
+}
+
+bool PosixStorageFile::sync()
+{
+    return fsync(m_fd) == 0;
+}
+
+bool PosixStorageFile::truncate()
+{
+    return ftruncate(m_fd, lseek(m_fd, 0, SEEK_CUR)) == 0;
+}
+
+uint64_t PosixStorageFile::position()
+{
+    off_t pos = lseek(m_fd, 0, SEEK_CUR);
+    return (pos < 0) ? 0 : pos;
+}
+
+uint64_t PosixStorageFile::size()
+{
+    struct stat st;
+    if (fstat(m_fd, &st) != 0) return 0;
+    return st.st_size;
+}
+
+bool PosixStorageFile::close()
+{
+    if (m_fd < 0) return true;
+    bool ok = (::close(m_fd) == 0);
+    m_fd = -1;
+    return ok;
+}
+
+StorageFile* PosixStorage::open(const char* path, int mode)
+{
+    int flags = O_RDONLY;
+    if (mode == STORAGE_WRITE) flags = O_RDWR | O_CREAT | O_TRUNC;
+    int fd = ::open((m_root + path).c_str(), flags, 0644);
+    if (fd < 0) return NULL;
+    return new PosixStorageFile(fd);
+}
+
+bool PosixStorage::exists(const char* path)
+{
+    struct stat st;
+    return stat((m_root + path).c_str(), &st) == 0;
+}
+
+bool PosixStorage::mkdir(const char* path)
+{
+    return ::mkdir((m_root + path).c_str(), 0755) == 0;
+}
+
+bool PosixStorage::remove(const char* path)
+{
+    return unlink((m_root + path).c_str()) == 0;
+}
+
+bool PosixStorage::list(const char* path, std::function<void(const char* name, bool directory)> f)
+{
+    std::string dir_path = m_root + path;
+    DIR* dir = opendir(dir_path.c_str());
+    if (dir == NULL) return false;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if ((strcmp(entry->d_name, ".") == 0) or (strcmp(entry->d_name, "..") == 0)) continue;
+        struct stat st;
+        bool directory = (stat((dir_path + "/" + entry->d_name).c_str(), &st) == 0) and S_ISDIR(st.st_mode);
+        f(entry->d_name, directory);
+    };
+    closedir(dir);
+    return true;
+}
+
+#ifdef USE_LITTLEFS
+
+bool RamBlockDevice::read(uint32_t block, uint32_t offset, void* buffer, uint32_t size)
+{
+    if (block >= m_blocks) return false;
+    memcpy(buffer, m_data.data() + (size_t)block*LFS_STORAGE_BLOCK_SIZE + offset, size);
+    return true;
+}
+
+bool RamBlockDevice::prog(uint32_t block, uint32_t offset, const void* buffer, uint32_t size)
+{
+    if (block >= m_blocks) return false;
+    memcpy(m_data.data() + (size_t)block*LFS_STORAGE_BLOCK_SIZE + offset, buffer, size);
+    return true;
+}
+
+FileBlockDevice::FileBlockDevice(const char* path, uint32_t blocks)
+{
+    m_blocks = blocks;
+    m_fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (m_fd < 0) return;
+    struct stat st;
+    if ((fstat(m_fd, &st) == 0) and (st.st_size >= (off_t)blocks*LFS_STORAGE_BLOCK_SIZE))
+        m_blocks = st.st_size / LFS_STORAGE_BLOCK_SIZE;
+    else if (ftruncate(m_fd, (off_t)blocks*LFS_STORAGE_BLOCK_SIZE) != 0)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+    };
+}
+
+FileBlockDevice::~FileBlockDevice()
+{
+    if (m_fd >= 0) ::close(m_fd);
+}
+
+bool FileBlockDevice::read(uint32_t block, uint32_t offset, void* buffer, uint32_t size)
+{
+    off_t pos = (off_t)block*LFS_STORAGE_BLOCK_SIZE + offset;
+    return pread(m_fd, buffer, size, pos) == (ssize_t)size;
+}
+
+bool FileBlockDevice::prog(uint32_t block, uint32_t offset, const void* buffer, uint32_t size)
+{
+    off_t pos = (off_t)block*LFS_STORAGE_BLOCK_SIZE + offset;
+    return pwrite(m_fd, buffer, size, pos) == (ssize_t)size;
+}
+
+bool FileBlockDevice::sync()
+{
+    return fsync(m_fd) == 0;
+}
+
+#endif
@@ -0,0 +1,115 @@
+/*
+    The storage (see src/storage.h) on the host :
+        PosixStorage    the files of the host file system below a directory,
+                        the baseline the other file systems are compared with
+        RamBlockDevice  a block device for LfsStorage in memory
+        FileBlockDevice a block device for LfsStorage in an image file,
+                        the image can be written to an SD card (dd)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "storage.h"
+#ifdef USE_LITTLEFS
+#include "storage_lfs.h"
+#endif
+
+class PosixStorageFile : public StorageFile
+{
+
+public:
+
+    PosixStorageFile(int fd) { m_fd = fd; };
+
+    virtual ~PosixStorageFile();
+
+    virtual size_t write(const void* data, size_t size);
+    virtual int read(void* data, size_t size);
+    virtual bool preallocate(uint64_t size);
+    virtual bool busy() { return false; };
+
+    // the data are written to the disk (fsync)
+    virtual bool sync();
+
+    virtual bool truncate();
+    virtual uint64_t position();
+    virtual uint64_t size();
+    virtual bool close();
+
+private:
+
+    int m_fd;
+
+};
+
+class PosixStorage : public Storage
+{
+
+public:
+
+    // all paths are taken relative to the root directory
+    PosixStorage(const std::string &root) { m_root = root; };
+
+    virtual const char* name() { return "POSIX"; };
+
+    virtual StorageFile* open(const char* path, int mode);
+    virtual bool exists(const char* path);
+    virtual bool mkdir(const char* path);
+    virtual bool remove(const char* path);
+    virtual bool list(const char* path, std::function<void(const char* name, bool directory)> f);
+
+private:
+
+    std::string m_root;
+
+};
+
+#ifdef USE_LITTLEFS
+
+class RamBlockDevice : public LfsBlockDevice
+{
+
+public:
+
+    RamBlockDevice(uint32_t blocks) : m_data((size_t)blocks*LFS_STORAGE_BLOCK_SIZE, 0xFF) { m_blocks = blocks; };
+
+    virtual uint32_t block_count() { return m_blocks; };
+    virtual bool read(uint32_t block, uint32_t offset, void* buffer, uint32_t size);
+    virtual bool prog(uint32_t block, uint32_t offset, const void* buffer, uint32_t size);
+    virtual bool sync() { return true; };
+
+private:
+
+    uint32_t m_blocks;
+    std::vector<uint8_t> m_data;
+
+};
+
+class FileBlockDevice : public LfsBlockDevice
+{
+
+public:
+
+    // the image file is created with the given number of blocks if it does not exist
+    FileBlockDevice(const char* path, uint32_t blocks);
+
+    virtual ~FileBlockDevice();
+
+    bool ok() { return m_fd >= 0; };
+
+    virtual uint32_t block_count() { return m_blocks; };
+    virtual bool read(uint32_t block, uint32_t offset, void* buffer, uint32_t size);
+    virtual bool prog(uint32_t block, uint32_t offset, const void* buffer, uint32_t size);
+    virtual bool sync();
+
+private:
+
+    int m_fd;
+    uint32_t m_blocks;
+
+};
+
+#endif
@@ -0,0 +1,520 @@
+#include "stream_decoder.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+
+#include "message.h"
+#include "msg_templates.h"
+
+// all values in the message bodies are little-endian like on the host
+template <typename T>
+static T get(const uint8_t* ptr)
+{
+    T value;
+    std::memcpy(&value, ptr, sizeof(T));
+    return value;
+}
+
+static void append_uint(std::string& out, uint64_t value)
+{
+    char buffer[24];
+    char* p = buffer+sizeof(buffer);
+    do {
+        *--p = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    out.append(p, buffer+sizeof(buffer)-p);
+}
+
+// a fixed-point number with the given number of decimals (time stamps)
+static void append_fixed(std::string& out, uint64_t value, int decimals, uint64_t scale)
+{
+    append_uint(out, value/scale);
+    out += '.';
+    char buffer[8];
+    uint64_t frac = value % scale;
+    for (int i=decimals-1; i>=0; i--)
+    {
+        buffer[i] = '0' + frac % 10;
+        frac /= 10;
+    };
+    out.append(buffer, decimals);
+}
+
+// the shortest text that reproduces the value exactly
+// snprintf() is an order of magnitude slower and is only used
+// if the compiler does not provide floating point std::to_chars()
+template <typename T>
+static void append_real(std::string& out, T value, const char* format)
+{
+    char buffer[32];
+#if defined(__cpp_lib_to_chars) && (__cpp_lib_to_chars >= 201611L)
+    (void)format;
+    std::to_chars_result result = std::to_chars(buffer, buffer+sizeof(buffer), value);
+    out.append(buffer, result.ptr-buffer);
+#else
+    int n = snprintf(buffer, sizeof(buffer), format, (double)value);
+    out.append(buffer, n);
+#endif
+}
+
+static const char* hex_digits = "0123456789abcdef";
+
+StreamDecoder::StreamDecoder(DecoderFormat format, bool framed, size_t trailer_bytes, bool keep_raw) :
+    m_frames(trailer_bytes)
+{
+    m_format = format;
+    m_framed = framed;
+    m_trailer_bytes = trailer_bytes;
+    m_keep_raw = keep_raw;
+    m_bytes_in = 0;
+    m_message_count = 0;
+    m_bytes_skipped = 0;
+    m_bad_frames = 0;
+}
+
+const char* StreamDecoder::csv_header()
+{
+    return "type,sender,time,hash,level,rssi,values,text\n";
+}
+
+void StreamDecoder::clear()
+{
+    m_text.clear();
+    m_raw.clear();
+    m_messages.clear();
+}
+
+const uint8_t* StreamDecoder::message(size_t index, size_t* size, int* rssi)
+{
+    if ((index >= m_messages.size()) or !m_keep_raw) return NULL;
+    DecodedMessage &msg = m_messages[index];
+    if (size != NULL) *size = msg.size;
+    if (rssi != NULL) *rssi = msg.rssi;
+    return m_raw.data() + msg.offset;
+}
+
+size_t StreamDecoder::push(const uint8_t* data, size_t size)
+{
+    uint64_t before = m_message_count;
+    m_bytes_in += size;
+    if (m_framed)
+    {
+        size_t pos = 0;
+        while (pos < size)
+        {
+            pos += m_frames.push(data+pos, size-pos);
+            if (m_frames.frame_available())
+            {
+                int rssi = -1;
+                if (m_trailer_bytes > 0) rssi = m_frames.trailer()[0];
+                split(m_frames.frame(), m_frames.frame_size(), rssi, true);
+            };
+        };
+    }
+    else
+    {
+        m_pending.insert(m_pending.end(), data, data+size);
+        size_t used = split(m_pending.data(), m_pending.size(), -1, false);
+        m_pending.erase(m_pending.begin(), m_pending.begin()+used);
+    };
+    return m_message_count - before;
+}
+
+size_t StreamDecoder::split(const uint8_t* data, size_t size, int rssi, bool complete)
+{
+    size_t pos = 0;
+    while (pos < size)
+    {
+        const uint8_t* ptr = data+pos;
+        size_t left = size-pos;
+        MessageView view((const char*)ptr, left);
+        if (view.valid())
+        {
+            decode(ptr, view.size(), rssi);
+            pos += view.size();
+            continue;
+        };
+        // a frame must hold complete messages only
+        if (complete)
+        {
+            m_bad_frames++;
+            return size;
+        };
+        // in a plain stream the message may not be complete yet
+        if (left < 2) break;
+        uint16_t type = (ptr[0] << 8) | ptr[1];
+        if ((type & 0xFFC0) == MSG_TYPE_ABSTRACT)
+        {
+            if (msg_data_size(type) > 0)
+            {
+                if (left < (size_t)2+msg_data_size(type)) break;
+            }
+            else if ((left < 3) or (left < (size_t)ptr[2]+3))
+                break;
+        };
+        // no valid message here - try the next position
+        m_bytes_skipped++;
+        pos++;
+    };
+    return pos;
+}
+
+void StreamDecoder::decode(const uint8_t* data, size_t size, int rssi)
+{
+    m_message_count++;
+    if (m_keep_raw)
+    {
+        DecodedMessage msg = { m_raw.size(), size, rssi };
+        m_raw.insert(m_raw.end(), data, data+size);
+        m_messages.push_back(msg);
+    };
+    if (m_format != DECODER_FORMAT_NONE)
+        format_message(data, size, rssi);
+}
+
+void StreamDecoder::format_message(const uint8_t* data, size_t size, int rssi)
+{
+    MessageView view((const char*)data, size);
+    const uint8_t* body = (const uint8_t*)view.body();
+    size_t n = view.body_size();
+    switch (view.type())
+    {
+        case MSG_TYPE_SYSTEM:
+            begin_record("system");
+            field_sender(data);
+            field_time_ms(get<uint32_t>(body+1));
+            field_level(body[0]);
+            field_text("text", (const char*)body+5, n-5);
+            break;
+        case MSG_TYPE_SYSTEM_TEMPLATE:
+        {
+            begin_record("system");
+            field_sender(data);
+            field_time_ms(get<uint32_t>(body+1));
+            field_level(body[0]);
+            uint16_t id = get<uint16_t>(body+5);
+            field_uint("template", id);
+            std::string text = msg_template_format(id, (const char*)body+7, n-7);
+            field_text("text", text.data(), text.size());
+            break;
+        };
+        case MSG_TYPE_TEXT:
+            begin_record("text");
+            field_sender(data);
+            field_text("text", (const char*)body, n);
+            break;
+        case MSG_TYPE_TELEMETRY:
+            begin_record("telemetry");
+            field_sender(data);
+            field_time_ms(get<uint32_t>(body));
+            field_text("variable", (const char*)body+5, body[4]);
+            field_text("value", (const char*)body+5+body[4], n-5-body[4]);
+            break;
+        case MSG_TYPE_GPS_POSITION:
+            begin_record("gps_position");
+            field_sender(data);
+            field_double("latitude", get<double>(body));
+            field_double("longitude", get<double>(body+8));
+            field_float("altitude", get<float>(body+16));
+            break;
+        case MSG_TYPE_SERVO:
+            begin_record("servo");
+            field_sender(data);
+            for (int i=0; i<NUM_SERVO_CHANNELS; i++)
+            {
+                char name[8] = "pos0";
+                name[3] = '0'+i;
+                field_int(name, get<int16_t>(body+2*i));
+            };
+            break;
+        case MSG_TYPE_PING:
+            begin_record("ping");
+            field_sender(data);
+            if (n >= 2) field_hash(get<uint16_t>(body));
+            break;
+        case MSG_TYPE_PINGRESPONSE:
+            begin_record("ping_response");
+            field_sender(data);
+            if (n >= 2) field_hash(get<uint16_t>(body));
+            if (n >= 3) field_uint("rssi_up", body[2]);
+            break;
+        case MSG_TYPE_TM_VARIABLE:
+            begin_record("tm_variable");
+            field_sender(data);
+            field_hash(get<uint16_t>(body));
+            field_uint("data_type", get<uint16_t>(body+2));
+            field_text("variable", (const char*)body+5, body[4]);
+            field_text("units", (const char*)body+5+body[4], n-5-body[4]);
+            break;
+        case MSG_TYPE_COMMAND:
+            begin_record("command");
+            field_sender(data);
+            if (n >= CMD_SEQUENCE_SIZE)
+                field_uint("sequence", get<uint16_t>(body));
+            if (n >= CMD_SEQUENCE_SIZE+4)
+            {
+                field_text("keyword", (const char*)body+CMD_SEQUENCE_SIZE, 4);
+                field_hex("args", body+CMD_SEQUENCE_SIZE+4, n-CMD_SEQUENCE_SIZE-4);
+            };
+            break;
+        case MSG_TYPE_COMMAND_ACK:
+            begin_record("command_ack");
+            field_sender(data);
+            field_uint("sequence", get<uint16_t>(body));
+            field_uint("status", body[2]);
+            field_uint("rssi_up", body[3]);
+            break;
+        case MSG_TYPE_IMU_AHRS:
+            begin_record("imu_ahrs");
+            field_sender(data);
+            field_time_us(get<uint64_t>(body));
+            field_float("attitude", get<float>(body+8));
+            field_float("heading", get<float>(body+12));
+            field_float("roll", get<float>(body+16));
+            break;
+        case MSG_TYPE_IMU_GYRO:
+            begin_record("imu_gyro");
+            field_sender(data);
+            field_time_us(get<uint64_t>(body));
+            field_float("nick", get<float>(body+8));
+            field_float("yaw", get<float>(body+12));
+            field_float("roll", get<float>(body+16));
+            break;
+        case MSG_TYPE_DATA_INT16:
+            begin_record("data_int16");
+            field_hash(get<uint16_t>(body));
+            field_time_ms(get<uint32_t>(body+2));
+            field_int("value", get<int16_t>(body+6));
+            break;
+        case MSG_TYPE_DATA_FLOAT:
+            begin_record("data_float");
+            field_hash(get<uint16_t>(body));
+            field_time_ms(get<uint32_t>(body+2));
+            field_float("value", get<float>(body+6));
+            break;
+        case MSG_TYPE_DATA_DOUBLE:
+            begin_record("data_double");
+            field_hash(get<uint16_t>(body));
+            field_time_ms(get<uint32_t>(body+2));
+            field_double("value", get<double>(body+6));
+            break;
+        case MSG_TYPE_DATA_GPS:
+            begin_record("data_gps");
+            field_hash(get<uint16_t>(body));
+            field_time_ms(get<uint32_t>(body+2));
+            field_double("latitude", get<double>(body+6));
+            field_double("longitude", get<double>(body+14));
+            field_float("altitude", get<float>(body+22));
+            break;
+        default:
+            // unknown types are reported with their data as hex bytes
+            begin_record("unknown");
+            if (view.size() > 2) field_sender(data);
+            field_uint("type_id", view.type());
+            field_hex("data", body, n);
+    };
+    end_record(rssi);
+}
+
+void StreamDecoder::begin_record(const char* type)
+{
+    if (m_format == DECODER_FORMAT_JSON)
+    {
+        m_text += "{\"type\":\"";
+        m_text += type;
+        m_text += '"';
+    }
+    else
+    {
+        m_col_type = type;
+        m_col_sender.clear();
+        m_col_time.clear();
+        m_col_hash.clear();
+        m_col_level.clear();
+        m_col_values.clear();
+        m_col_text.clear();
+    };
+}
+
+void StreamDecoder::end_record(int rssi)
+{
+    if (m_format == DECODER_FORMAT_JSON)
+    {
+        if (rssi >= 0)
+        {
+            m_text += ",\"rssi\":";
+            append_uint(m_text, rssi);
+        };
+        m_text += "}\n";
+    }
+    else
+    {
+        m_text += m_col_type;
+        m_text += ',';
+        m_text += m_col_sender;
+        m_text += ',';
+        m_text += m_col_time;
+        m_text += ',';
+        m_text += m_col_hash;
+        m_text += ',';
+        m_text += m_col_level;
+        m_text += ',';
+        if (rssi >= 0) append_uint(m_text, rssi);
+        m_text += ',';
+        m_text += m_col_values;
+        m_text += ",\"";
+        m_text += m_col_text;
+        m_text += "\"\n";
+    };
+}
+
+std::string& StreamDecoder::begin_field(const char* name, std::string& column)
+{
+    if (m_format == DECODER_FORMAT_JSON)
+    {
+        m_text += ",\"";
+        m_text += name;
+        m_text += "\":";
+        return m_text;
+    };
+    // several values or texts are separated by spaces
+    if (!column.empty()) column += ' ';
+    return column;
+}
+
+void StreamDecoder::field_sender(const uint8_t* data)
+{
+    // the sender ID is padded with spaces
+    size_t n = 8;
+    while ((n > 0) and (data[3+n-1] == ' ')) n--;
+    if (m_format == DECODER_FORMAT_JSON)
+    {
+        m_text += ",\"sender\":\"";
+        append_escaped(m_text, (const char*)data+3, n);
+        m_text += '"';
+    }
+    else
+        append_escaped(m_col_sender, (const char*)data+3, n);
+}
+
+void StreamDecoder::field_time_ms(uint32_t time)
+{
+    std::string& out = (m_format == DECODER_FORMAT_JSON) ? begin_field("time", m_text) : m_col_time;
+    append_fixed(out, time, 3, 1000);
+}
+
+void StreamDecoder::field_time_us(uint64_t time)
+{
+    std::string& out = (m_format == DECODER_FORMAT_JSON) ? begin_field("time", m_text) : m_col_time;
+    append_fixed(out, time, 6, 1000000);
+}
+
+void StreamDecoder::field_hash(uint16_t hash)
+{
+    std::string& out = (m_format == DECODER_FORMAT_JSON) ? begin_field("hash", m_text) : m_col_hash;
+    append_uint(out, hash);
+}
+
+void StreamDecoder::field_level(uint8_t level)
+{
+    std::string& out = (m_format == DECODER_FORMAT_JSON) ? begin_field("level", m_text) : m_col_level;
+    append_uint(out, level);
+}
+
+void StreamDecoder::field_uint(const char* name, uint32_t value)
+{
+    append_uint(begin_field(name, m_col_values), value);
+}
+
+void StreamDecoder::field_int(const char* name, int32_t value)
+{
+    std::string& out = begin_field(name, m_col_values);
+    if (value < 0)
+    {
+        out += '-';
+        append_uint(out, -(int64_t)value);
+    }
+    else
+        append_uint(out, value);
+}
+
+void StreamDecoder::field_float(const char* name, float value)
+{
+    std::string& out = begin_field(name, m_col_values);
+    // JSON has no representation of NaN and infinity
+    if (!std::isfinite(value))
+    {
+        out += (m_format == DECODER_FORMAT_JSON) ? "null" : "nan";
+        return;
+    };
+    // 9 significant digits always reproduce a float value
+    append_real(out, value, "%.9g");
+}
+
+void StreamDecoder::field_double(const char* name, double value)
+{
+    std::string& out = begin_field(name, m_col_values);
+    if (!std::isfinite(value))
+    {
+        out += (m_format == DECODER_FORMAT_JSON) ? "null" : "nan";
+        return;
+    };
+    append_real(out, value, "%.17g");
+}
+
+void StreamDecoder::field_text(const char* name, const char* text, size_t size)
+{
+    std::string& out = begin_field(name, m_col_text);
+    if (m_format == DECODER_FORMAT_JSON) out += '"';
+    append_escaped(out, text, size);
+    if (m_format == DECODER_FORMAT_JSON) out += '"';
+}
+
+void StreamDecoder::field_hex(const char* name, const uint8_t* data, size_t size)
+{
+    std::string& out = begin_field(name, m_col_text);
+    if (m_format == DECODER_FORMAT_JSON) out += '"';
+    for (size_t i=0; i<size; i++)
+    {
+        out += hex_digits[data[i] >> 4];
+        out += hex_digits[data[i] & 0x0F];
+    };
+    if (m_format == DECODER_FORMAT_JSON) out += '"';
+}
+
+void StreamDecoder::append_escaped(std::string& out, const char* text, size_t size)
+{
+    for (size_t i=0; i<size; i++)
+    {
+        uint8_t c = text[i];
+        if (m_format == DECODER_FORMAT_CSV)
+        {
+            // the text column is quoted, quotes are doubled
+            // line breaks would split the row
+            if (c == '"') out += "\"\"";
+            else if ((c == '\n') or (c == '\r')) out += ' ';
+            else out += (char)c;
+            continue;
+        };
+        // the texts may contain arbitrary bytes, everything but
+        // printable ASCII is escaped so the output is always valid UTF-8
+        if ((c == '"') or (c == '\\'))
+        {
+            out += '\\';
+            out += (char)c;
+        }
+        else if ((c < 0x20) or (c >= 0x7F))
+        {
+            out += "\\u00";
+            out += hex_digits[c >> 4];
+            out += hex_digits[c & 0x0F];
+        }
+        else
+            out += (char)c;
+    };
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "framing.h"
+
+/*
+    Decoder for the binary message stream of a TAROS system on the ground.
+
+    The message layouts are taken from the flight software (message.h),
+    the framing and the message views are the same code as on the target.
+
+    The input is pushed in blocks of any size. It is either
+    - the framed link stream as received from the modem (see framing.h),
+      every frame may be followed by trailer bytes (the RSSI byte of the E220)
+    - a plain sequence of messages in the compact binary format
+      (e.g. a binary log file), after invalid data the decoder
+      resynchronizes at the next position holding a valid message
+
+    Every decoded message is kept as raw bytes (for consumers that handle
+    the binary format themselves) and optionally formatted as text,
+    either one JSON object per line (NDJSON) or one CSV row.
+
+    The decoder never allocates memory per message, all buffers grow
+    to the size needed and are re-used after clear().
+*/
+
+enum DecoderFormat {
+    DECODER_FORMAT_NONE = 0,
+    DECODER_FORMAT_JSON = 1,
+    DECODER_FORMAT_CSV = 2
+};
+
+// one decoded message, the data are kept in the raw buffer of the decoder
+struct DecodedMessage {
+    size_t      offset;
+    size_t      size;
+    // the first trailer byte of the frame (the RSSI), -1 if none
+    int         rssi;
+};
+
+class StreamDecoder
+{
+
+public:
+
+    // framed : the input is the framed link stream, otherwise plain messages
+    // trailer_bytes : the number of bytes following every frame (1 for the E220)
+    // keep_raw : keep the raw bytes of all messages (see message())
+    StreamDecoder(DecoderFormat format, bool framed, size_t trailer_bytes, bool keep_raw);
+
+    // decode a block of input data
+    // returns the number of messages completed within this block
+    size_t push(const uint8_t* data, size_t size);
+
+    // the formatted text of all messages decoded since the last clear()
+    const char* text() { return m_text.data(); };
+    size_t text_size() { return m_text.size(); };
+
+    // the raw messages decoded since the last clear()
+    size_t count() { return m_messages.size(); };
+    const uint8_t* message(size_t index, size_t* size, int* rssi);
+
+    // forget the text and raw messages decoded so far
+    // the decoding state is kept, the input can be continued
+    void clear();
+
+    // the CSV header line (empty for other formats)
+    static const char* csv_header();
+
+    // statistics
+    uint64_t    bytes_in() { return m_bytes_in; };
+    uint64_t    messages() { return m_message_count; };
+    // data that could not be decoded as messages (in unframed input)
+    uint64_t    bytes_skipped() { return m_bytes_skipped; };
+    // frames that did not hold valid messages only
+    uint64_t    bad_frames() { return m_bad_frames; };
+    FrameDecoder& frame_decoder() { return m_frames; };
+
+private:
+
+    // split a frame or a block of plain input into messages
+    // returns the number of bytes consumed
+    size_t split(const uint8_t* data, size_t size, int rssi, bool complete);
+
+    // handle one message
+    void decode(const uint8_t* data, size_t size, int rssi);
+
+    // the text formatting
+    void format_message(const uint8_t* data, size_t size, int rssi);
+    void begin_record(const char* type);
+    void end_record(int rssi);
+    void field_sender(const uint8_t* data);
+    void field_time_ms(uint32_t time);
+    void field_time_us(uint64_t time);
+    void field_hash(uint16_t hash);
+    void field_level(uint8_t level);
+    void field_uint(const char* name, uint32_t value);
+    void field_int(const char* name, int32_t value);
+    void field_float(const char* name, float value);
+    void field_double(const char* name, double value);
+    void field_text(const char* name, const char* text, size_t size);
+    void field_hex(const char* name, const uint8_t* data, size_t size);
+
+    // the output target of a field
+    std::string& begin_field(const char* name, std::string& column);
+    // append text escaped for JSON or CSV
+    void append_escaped(std::string& out, const char* text, size_t size);
+
+    DecoderFormat   m_format;
+    bool            m_framed;
+    size_t          m_trailer_bytes;
+    bool            m_keep_raw;
+    FrameDecoder    m_frames;
+
+    // unframed input not yet consumed
+    std::vector<uint8_t> m_pending;
+
+    std::string     m_text;
+    std::vector<uint8_t> m_raw;
+    std::vector<DecodedMessage> m_messages;
+
+    // the columns of a CSV row
+    std::string     m_col_type;
+    std::string     m_col_sender;
+    std::string     m_col_time;
+    std::string     m_col_hash;
+    std::string     m_col_level;
+    std::string     m_col_values;
+    std::string     m_col_text;
+
+    uint64_t        m_bytes_in;
+    uint64_t        m_message_count;
+    uint64_t        m_bytes_skipped;
+    uint64_t        m_bad_frames;
+};
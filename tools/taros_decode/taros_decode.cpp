@@ -0,0 +1,174 @@
+/*
+    Decode a TAROS message stream into NDJSON or CSV.
+
+    usage: taros_decode [options] [input]
+        input               a file, a serial device (e.g. /dev/ttyUSB0) or - for stdin (default)
+        --format json|csv   the output format (default json, one object per line)
+        --raw               the input is a plain sequence of messages (a binary log)
+                            instead of the framed link stream
+        --trailer <n>       bytes following every frame (default 1, the RSSI byte of the E220)
+        --baud <n>          the baud rate of a serial device (default 115200)
+        --output <file>     write to a file instead of stdout
+        --stats             report the statistics and the decoding speed on stderr
+
+    A serial device is read until interrupted, files and stdin until the end.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "stream_decoder.h"
+
+// the size of the blocks read from the input
+#define DECODE_BLOCK_SIZE (1<<20)
+
+static speed_t baud_constant(long baud)
+{
+    switch (baud)
+    {
+        case 9600:      return B9600;
+        case 19200:     return B19200;
+        case 38400:     return B38400;
+        case 57600:     return B57600;
+        case 115200:    return B115200;
+        case 230400:    return B230400;
+        case 460800:    return B460800;
+        case 921600:    return B921600;
+        default:        return 0;
+    }
+}
+
+static int open_serial(const char* device, long baud)
+{
+    int fd = open(device, O_RDONLY | O_NOCTTY);
+    if (fd < 0) return fd;
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0)
+        // not a terminal - read as a file
+        return fd;
+    speed_t speed = baud_constant(baud);
+    if (speed == 0)
+    {
+        fprintf(stderr, "unsupported baud rate %ld\n", baud);
+        exit(1);
+    };
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    // return from read() as soon as anything is available
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+    return fd;
+}
+
+int main(int argc, char *argv[])
+{
+    DecoderFormat format = DECODER_FORMAT_JSON;
+    bool framed = true;
+    int trailer = 1;
+    long baud = 115200;
+    const char* output = NULL;
+    bool stats = false;
+
+    static struct option options[] = {
+        { "format",     required_argument,  0, 'f' },
+        { "raw",        no_argument,        0, 'r' },
+        { "trailer",    required_argument,  0, 't' },
+        { "baud",       required_argument,  0, 'b' },
+        { "output",     required_argument,  0, 'o' },
+        { "stats",      no_argument,        0, 's' },
+        { 0, 0, 0, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+        switch (opt)
+        {
+            case 'f':
+                if (strcmp(optarg, "json") == 0) format = DECODER_FORMAT_JSON;
+                else if (strcmp(optarg, "csv") == 0) format = DECODER_FORMAT_CSV;
+                else
+                {
+                    fprintf(stderr, "unknown format %s\n", optarg);
+                    return 1;
+                };
+                break;
+            case 'r': framed = false; break;
+            case 't': trailer = atoi(optarg); break;
+            case 'b': baud = atol(optarg); break;
+            case 'o': output = optarg; break;
+            case 's': stats = true; break;
+            default:
+                fprintf(stderr, "see the head of taros_decode.cpp for the options\n");
+                return 1;
+        };
+    if ((trailer < 0) or (trailer > 4))
+    {
+        fprintf(stderr, "at most 4 trailer bytes are supported\n");
+        return 1;
+    };
+
+    int fd = STDIN_FILENO;
+    if ((optind < argc) and (strcmp(argv[optind], "-") != 0))
+    {
+        fd = open_serial(argv[optind], baud);
+        if (fd < 0)
+        {
+            perror(argv[optind]);
+            return 1;
+        };
+    };
+    FILE* out = stdout;
+    if (output != NULL)
+    {
+        out = fopen(output, "w");
+        if (out == NULL)
+        {
+            perror(output);
+            return 1;
+        };
+    };
+    // when reading from a serial device every block is written right away
+    bool live = isatty(fd);
+
+    StreamDecoder decoder(format, framed, trailer, false);
+    if (format == DECODER_FORMAT_CSV)
+        fputs(StreamDecoder::csv_header(), out);
+    std::vector<uint8_t> block(DECODE_BLOCK_SIZE);
+    auto start = std::chrono::steady_clock::now();
+    ssize_t n;
+    while ((n = read(fd, block.data(), block.size())) > 0)
+    {
+        decoder.push(block.data(), n);
+        fwrite(decoder.text(), 1, decoder.text_size(), out);
+        decoder.clear();
+        if (live) fflush(out);
+    };
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (out != stdout) fclose(out);
+    else fflush(out);
+
+    if (stats)
+    {
+        FrameDecoder& frames = decoder.frame_decoder();
+        fprintf(stderr, "%llu bytes %llu messages in %.3f s (%.1f MB/s, %.0f messages/s)\n",
+            (unsigned long long)decoder.bytes_in(), (unsigned long long)decoder.messages(),
+            seconds, 1.0e-6*decoder.bytes_in()/seconds, decoder.messages()/seconds);
+        if (framed)
+            fprintf(stderr, "frames ok %u lost %u (crc %u format %u overrun %u) bad content %llu\n",
+                frames.frames_ok(), frames.frames_lost(), frames.crc_errors(),
+                frames.format_errors(), frames.overruns(),
+                (unsigned long long)decoder.bad_frames());
+        else
+            fprintf(stderr, "bytes skipped %llu\n", (unsigned long long)decoder.bytes_skipped());
+    };
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "taros_decoder.h"
+
+#include "stream_decoder.h"
+
+struct taros_decoder {
+    StreamDecoder   decoder;
+    uint8_t         input[TAROS_DECODER_INPUT_SIZE];
+
+    taros_decoder(int format, int framed, int trailer_bytes, int keep_raw) :
+        decoder((DecoderFormat)format, framed != 0, trailer_bytes, keep_raw != 0) {};
+};
+
+taros_decoder* taros_decoder_new(int format, int framed, int trailer_bytes, int keep_raw)
+{
+    if ((format < TAROS_FORMAT_NONE) or (format > TAROS_FORMAT_CSV)) return NULL;
+    if ((trailer_bytes < 0) or (trailer_bytes > 4)) return NULL;
+    return new taros_decoder(format, framed, trailer_bytes, keep_raw);
+}
+
+void taros_decoder_free(taros_decoder* decoder)
+{
+    delete decoder;
+}
+
+size_t taros_decoder_push(taros_decoder* decoder, const uint8_t* data, size_t size)
+{
+    decoder->decoder.clear();
+    return decoder->decoder.push(data, size);
+}
+
+uint8_t* taros_decoder_input(taros_decoder* decoder)
+{
+    return decoder->input;
+}
+
+size_t taros_decoder_push_input(taros_decoder* decoder, size_t size)
+{
+    if (size > TAROS_DECODER_INPUT_SIZE) size = TAROS_DECODER_INPUT_SIZE;
+    return taros_decoder_push(decoder, decoder->input, size);
+}
+
+const char* taros_decoder_text(taros_decoder* decoder, size_t* size)
+{
+    if (size != NULL) *size = decoder->decoder.text_size();
+    return decoder->decoder.text();
+}
+
+size_t taros_decoder_text_size(taros_decoder* decoder)
+{
+    return decoder->decoder.text_size();
+}
+
+const uint8_t* taros_decoder_message_data(taros_decoder* decoder, size_t index)
+{
+    return decoder->decoder.message(index, NULL, NULL);
+}
+
+size_t taros_decoder_message_size(taros_decoder* decoder, size_t index)
+{
+    size_t size = 0;
+    decoder->decoder.message(index, &size, NULL);
+    return size;
+}
+
+int taros_decoder_message_rssi(taros_decoder* decoder, size_t index)
+{
+    int rssi = -1;
+    decoder->decoder.message(index, NULL, &rssi);
+    return rssi;
+}
+
+const char* taros_decoder_csv_header()
+{
+    return StreamDecoder::csv_header();
+}
+
+const uint8_t* taros_decoder_message(taros_decoder* decoder, size_t index, size_t* size, int* rssi)
+{
+    return decoder->decoder.message(index, size, rssi);
+}
+
+uint64_t taros_decoder_bytes_in(taros_decoder* decoder)
+{
+    return decoder->decoder.bytes_in();
+}
+
+uint64_t taros_decoder_messages(taros_decoder* decoder)
+{
+    return decoder->decoder.messages();
+}
+
+uint32_t taros_decoder_frames_ok(taros_decoder* decoder)
+{
+    return decoder->decoder.frame_decoder().frames_ok();
+}
+
+uint32_t taros_decoder_frames_lost(taros_decoder* decoder)
+{
+    return decoder->decoder.frame_decoder().frames_lost();
+}
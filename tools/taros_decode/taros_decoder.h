@@ -0,0 +1,78 @@
+/*
+    C interface of the TAROS stream decoder (see stream_decoder.h)
+    for use from other languages through a foreign function interface,
+    e.g. Python ctypes (GCS/taros_decoder.py) or dart:ffi (ground_control_station).
+
+    All memory is owned by the decoder, no allocation by the caller is needed.
+    Input is copied into the buffer returned by taros_decoder_input()
+    (or passed by pointer with taros_decoder_push()). The results of a push
+    are valid until the next push or taros_decoder_free().
+
+        decoder = taros_decoder_new(TAROS_FORMAT_JSON, 1, 1, 0);
+        n = taros_decoder_push(decoder, data, size);
+        text = taros_decoder_text(decoder, &text_size);
+        ...
+        taros_decoder_free(decoder);
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TAROS_FORMAT_NONE   0
+#define TAROS_FORMAT_JSON   1
+#define TAROS_FORMAT_CSV    2
+
+// the size of the input buffer of every decoder
+#define TAROS_DECODER_INPUT_SIZE 65536
+
+typedef struct taros_decoder taros_decoder;
+
+// format : one of TAROS_FORMAT_...
+// framed : 1 for the framed link stream, 0 for plain messages (binary logs)
+// trailer_bytes : the bytes following every frame (1 for the RSSI byte of the E220)
+// keep_raw : 1 to keep the raw bytes of every message (taros_decoder_message())
+taros_decoder* taros_decoder_new(int format, int framed, int trailer_bytes, int keep_raw);
+
+void taros_decoder_free(taros_decoder* decoder);
+
+// decode a block of data, the results of the previous push are discarded
+// returns the number of messages decoded
+size_t taros_decoder_push(taros_decoder* decoder, const uint8_t* data, size_t size);
+
+// a buffer of TAROS_DECODER_INPUT_SIZE bytes owned by the decoder
+// data copied into it can be decoded with taros_decoder_push_input()
+uint8_t* taros_decoder_input(taros_decoder* decoder);
+size_t taros_decoder_push_input(taros_decoder* decoder, size_t size);
+
+// the text (NDJSON or CSV rows) of all messages of the last push
+// the text is not terminated, its size is returned in size
+const char* taros_decoder_text(taros_decoder* decoder, size_t* size);
+
+// the CSV header line (terminated)
+const char* taros_decoder_csv_header();
+
+// the raw bytes of message index of the last push (compact binary format, see message.h)
+// the RSSI (or -1) is returned in rssi, NULL is returned if there is no such message
+const uint8_t* taros_decoder_message(taros_decoder* decoder, size_t index, size_t* size, int* rssi);
+
+// the same without pointer arguments (for FFI without memory allocation)
+size_t taros_decoder_text_size(taros_decoder* decoder);
+const uint8_t* taros_decoder_message_data(taros_decoder* decoder, size_t index);
+size_t taros_decoder_message_size(taros_decoder* decoder, size_t index);
+int taros_decoder_message_rssi(taros_decoder* decoder, size_t index);
+
+// statistics since the decoder was created
+uint64_t taros_decoder_bytes_in(taros_decoder* decoder);
+uint64_t taros_decoder_messages(taros_decoder* decoder);
+uint32_t taros_decoder_frames_ok(taros_decoder* decoder);
+uint32_t taros_decoder_frames_lost(taros_decoder* decoder);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,286 @@
+#include "log_reader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static size_t field_size(const std::string &type)
+{
+    if ((type == "u8") or (type == "i8")) return 1;
+    if ((type == "u16") or (type == "i16")) return 2;
+    if ((type == "u32") or (type == "i32") or (type == "f32")) return 4;
+    if ((type == "u64") or (type == "i64") or (type == "f64")) return 8;
+    return 0;
+}
+
+LogReader::LogReader()
+{
+    m_fd = -1;
+    m_blocks = 0;
+    memset(&m_info, 0, sizeof(m_info));
+    for (int i=0; i<256; i++) m_lookup[i] = NULL;
+    m_blocks_read = 0;
+    m_search_reads = 0;
+    m_invalid_blocks = 0;
+}
+
+LogReader::~LogReader()
+{
+    if (m_fd >= 0) close(m_fd);
+}
+
+bool LogReader::open(const char* path, std::string &error)
+{
+    m_fd = ::open(path, O_RDONLY);
+    if (m_fd < 0)
+    {
+        error = std::string(path) + " : " + strerror(errno);
+        return false;
+    };
+    struct stat st;
+    fstat(m_fd, &st);
+    m_blocks = (st.st_size + LOG_BLOCK_SIZE - 1) / LOG_BLOCK_SIZE;
+    uint8_t block[LOG_BLOCK_SIZE];
+    if ((m_blocks == 0) or not load_block(0, block))
+    {
+        error = "no valid head block";
+        return false;
+    };
+    const LogBlockHeader* h = (const LogBlockHeader*)block;
+    memcpy(&m_info, block + sizeof(LogBlockHeader), sizeof(m_info));
+    if ((h->type != LOG_BLOCK_HEAD) or (memcmp(m_info.format, "TAROSLOG", 8) != 0))
+    {
+        error = "not a TAROS log file";
+        return false;
+    };
+    if ((m_info.version < 1) or (m_info.version > LOG_FORMAT_VERSION) or (m_info.block_size != LOG_BLOCK_SIZE) or
+        (m_info.index_interval != LOG_INDEX_INTERVAL))
+    {
+        error = "unsupported log format version " + std::to_string(m_info.version);
+        return false;
+    };
+    if (sizeof(LogHeadInfo) + m_info.schema_size > h->size)
+    {
+        error = "truncated schema";
+        return false;
+    };
+    m_schema.assign((const char*)block + sizeof(LogBlockHeader) + sizeof(LogHeadInfo), m_info.schema_size);
+    return parse_schema(error);
+}
+
+bool LogReader::parse_schema(std::string &error)
+{
+    std::istringstream text(m_schema);
+    std::string line;
+    if (not std::getline(text, line) or (line != "taros-schema 1"))
+    {
+        error = "unknown schema version";
+        return false;
+    };
+    while (std::getline(text, line))
+    {
+        std::istringstream words(line);
+        std::string key;
+        words >> key;
+        if (key == "record")
+        {
+            LogRecordType type;
+            std::string signature;
+            words >> signature >> type.name >> type.size;
+            type.signature = std::stoul(signature, NULL, 0);
+            type.message = false;
+            m_types.push_back(type);
+        }
+        else if (key == "message")
+        {
+            // the messages have a fixed layout
+            LogRecordType type;
+            std::string signature;
+            words >> signature >> type.name;
+            type.signature = std::stoul(signature, NULL, 0);
+            type.size = 0;
+            type.message = true;
+            LogField field;
+            field.name = "time";
+            field.type = "u64";
+            field.unit = "us";
+            field.offset = 0;
+            field.size = 8;
+            type.fields.push_back(field);
+            m_types.push_back(type);
+        }
+        else if ((key == "field") and not m_types.empty())
+        {
+            LogField field;
+            words >> field.name >> field.type >> field.offset >> field.unit;
+            field.size = field_size(field.type);
+            if ((field.size == 0) or (field.offset + field.size > m_types.back().size))
+            {
+                error = "illegal schema field : " + line;
+                return false;
+            };
+            m_types.back().fields.push_back(field);
+        }
+        else if (not key.empty())
+        {
+            error = "illegal schema line : " + line;
+            return false;
+        };
+    };
+    for (const LogRecordType &type : m_types)
+    {
+        if (type.fields.empty() or (type.fields[0].name != "time") or (type.fields[0].type != "u64"))
+        {
+            error = "record " + type.name + " does not start with the time";
+            return false;
+        };
+        m_lookup[type.signature] = &type;
+    };
+    return true;
+}
+
+const LogRecordType* LogReader::record_type(uint8_t signature)
+{
+    return m_lookup[signature];
+}
+
+size_t LogReader::record_size(const uint8_t* record, size_t available)
+{
+    const LogRecordType* type = m_lookup[record[0]];
+    if (type == NULL) return 0;
+    size_t size = 1 + type->size;
+    if (type->message)
+    {
+        if (available < LOG_MESSAGE_HEADER) return 0;
+        size = LOG_MESSAGE_HEADER + record[LOG_MESSAGE_HEADER-1];
+    };
+    if (size > available) return 0;
+    return size;
+}
+
+size_t LogReader::block_records(const uint8_t* block, const uint8_t* &records)
+{
+    const LogBlockHeader* h = (const LogBlockHeader*)block;
+    records = block + sizeof(LogBlockHeader);
+    if (h->type == LOG_BLOCK_DATA) return h->size;
+    if (h->type != LOG_BLOCK_PACKED) return 0;
+    size_t n = log_unpack(records, h->size, m_unpacked, LOG_PACK_RAW_SIZE);
+    if (n == 0) m_invalid_blocks++;
+    records = m_unpacked;
+    return n;
+}
+
+bool LogReader::read_block(uint64_t sequence, uint8_t* block)
+{
+    if (sequence < m_blocks) m_blocks_read++;
+    return load_block(sequence, block);
+}
+
+bool LogReader::search_block(uint64_t sequence, uint8_t* block)
+{
+    if (sequence < m_blocks) m_search_reads++;
+    return load_block(sequence, block);
+}
+
+bool LogReader::load_block(uint64_t sequence, uint8_t* block)
+{
+    if (sequence >= m_blocks) return false;
+    ssize_t n = pread(m_fd, block, LOG_BLOCK_SIZE, sequence * LOG_BLOCK_SIZE);
+    if (n < (ssize_t)sizeof(LogBlockHeader)) return false;
+    if (n < LOG_BLOCK_SIZE) memset(block + n, 0, LOG_BLOCK_SIZE - n);
+    if (not log_block_valid(block, m_info.file_id) or (((const LogBlockHeader*)block)->sequence != sequence))
+    {
+        m_invalid_blocks++;
+        return false;
+    };
+    return true;
+}
+
+bool LogReader::group_last_time(uint64_t group, uint64_t &last)
+{
+    uint8_t block[LOG_BLOCK_SIZE];
+    uint64_t index = log_index_sequence(group);
+    if (search_block(index, block) and (((const LogBlockHeader*)block)->type == LOG_BLOCK_INDEX))
+    {
+        last = ((const LogBlockHeader*)block)->last_time;
+        return true;
+    };
+    // search the data blocks from the end of the group
+    for (uint64_t seq = index-1; seq+LOG_INDEX_INTERVAL >= index; seq--)
+        if (search_block(seq, block) and log_data_block(((const LogBlockHeader*)block)->type))
+        {
+            last = ((const LogBlockHeader*)block)->last_time;
+            return true;
+        };
+    return false;
+}
+
+uint64_t LogReader::seek(uint64_t time)
+{
+    uint8_t block[LOG_BLOCK_SIZE];
+    // the number of groups of data blocks completed by an index block
+    uint64_t groups = 0;
+    if (m_blocks > log_index_sequence(0))
+        groups = (m_blocks - log_index_sequence(0) - 1) / (LOG_INDEX_INTERVAL+1) + 1;
+    // binary search for the first group with data at or after the time
+    uint64_t low = 0;
+    uint64_t high = groups;
+    while (low < high)
+    {
+        uint64_t mid = low + (high-low)/2;
+        uint64_t last;
+        if (group_last_time(mid, last) and (last < time))
+            low = mid+1;
+        else
+            high = mid;
+    };
+    uint64_t start = (low == 0) ? 1 : log_index_sequence(low-1)+1;
+    if (low < groups)
+    {
+        // the index tells the first data block of the group
+        uint64_t index = log_index_sequence(low);
+        if (search_block(index, block) and (((const LogBlockHeader*)block)->type == LOG_BLOCK_INDEX))
+        {
+            const LogBlockHeader* h = (const LogBlockHeader*)block;
+            const LogIndexEntry* entries = (const LogIndexEntry*)(block + sizeof(LogBlockHeader));
+            size_t n = h->size / sizeof(LogIndexEntry);
+            for (size_t i=0; i<n; i++)
+                if (entries[i].last_time >= time) return entries[i].sequence;
+        };
+        return start;
+    };
+    // the data after the last index block are searched through the block headers
+    for (uint64_t seq = start; seq < m_blocks; seq++)
+        if (search_block(seq, block))
+        {
+            const LogBlockHeader* h = (const LogBlockHeader*)block;
+            if (log_data_block(h->type) and (h->last_time >= time)) return seq;
+        };
+    return m_blocks;
+}
+
+bool LogReader::time_range(uint64_t &first, uint64_t &last)
+{
+    uint8_t block[LOG_BLOCK_SIZE];
+    const LogBlockHeader* h = (const LogBlockHeader*)block;
+    bool found = false;
+    for (uint64_t seq = 1; seq < m_blocks; seq++)
+        if (search_block(seq, block) and log_data_block(h->type))
+        {
+            first = h->first_time;
+            found = true;
+            break;
+        };
+    if (not found) return false;
+    for (uint64_t seq = m_blocks-1; seq > 0; seq--)
+        if (search_block(seq, block) and (h->type != LOG_BLOCK_HEAD))
+        {
+            last = h->last_time;
+            break;
+        };
+    return true;
+}
@@ -0,0 +1,108 @@
+/*
+    Reader of the binary log files (see src/log_format.h).
+
+    The file is described completely by the schema in its head block,
+    the reader does not depend on the data types compiled into the flight software.
+    Blocks are read by their position, so any time can be found by reading
+    the index blocks (binary search) and a few data blocks only.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "log_format.h"
+
+// one field of a record as given in the schema
+struct LogField {
+    std::string     name;
+    std::string     type;       // u8 i8 u16 i16 u32 i32 u64 i64 f32 f64
+    std::string     unit;
+    size_t          offset;     // from the start of the data (after the signature)
+    size_t          size;
+};
+
+// one record type as given in the schema
+struct LogRecordType {
+    uint8_t                 signature;
+    std::string             name;
+    size_t                  size;       // without the signature (0 for the message records)
+    std::vector<LogField>   fields;
+    bool                    message;    // a message record of variable size (see LOG_MESSAGE_SIGNATURE)
+};
+
+class LogReader
+{
+
+public:
+
+    LogReader();
+    ~LogReader();
+
+    // open a file and read its head block
+    // returns false and an explanation in error if it is not a valid log file
+    bool open(const char* path, std::string &error);
+
+    const LogHeadInfo& info() { return m_info; };
+    const std::string& schema() { return m_schema; };
+    const std::vector<LogRecordType>& record_types() { return m_types; };
+
+    // the record type of a signature, NULL if it is not in the schema
+    const LogRecordType* record_type(uint8_t signature);
+
+    // the size of the record starting at the given position (including the signature)
+    // returns 0 if it is not in the schema or does not fit into the available bytes
+    size_t record_size(const uint8_t* record, size_t available);
+
+    // the number of blocks in the file (including a partially written last block)
+    uint64_t blocks() { return m_blocks; };
+
+    // read a block, returns false if it cannot be read or is invalid
+    bool read_block(uint64_t sequence, uint8_t* block);
+
+    // the records of a data block, packed blocks are decompressed into a buffer of the reader
+    // that is valid until the next call, returns the number of bytes (0 if there are none)
+    size_t block_records(const uint8_t* block, const uint8_t* &records);
+
+    // the first data block that may hold records at or after the given time [us]
+    // returns blocks() if there is none
+    uint64_t seek(uint64_t time);
+
+    // the time range of all data [us], returns false if there are no valid data blocks
+    bool time_range(uint64_t &first, uint64_t &last);
+
+    // statistics
+    // the block reads by read_block() and the ones needed by seek() and time_range()
+    uint64_t blocks_read() { return m_blocks_read; };
+    uint64_t search_reads() { return m_search_reads; };
+    uint64_t invalid_blocks() { return m_invalid_blocks; };
+
+private:
+
+    // parse the schema text, returns false if it is malformed
+    bool parse_schema(std::string &error);
+
+    // read a block without counting it, returns false if it cannot be read or is invalid
+    bool load_block(uint64_t sequence, uint8_t* block);
+
+    // read a block for seek() or time_range()
+    bool search_block(uint64_t sequence, uint8_t* block);
+
+    // the time range of all data blocks of a complete group taken from its index block
+    // falls back to the data block headers if the index block is invalid
+    bool group_last_time(uint64_t group, uint64_t &last);
+
+    int                         m_fd;
+    uint64_t                    m_blocks;
+    LogHeadInfo                 m_info;
+    std::string                 m_schema;
+    std::vector<LogRecordType>  m_types;
+    const LogRecordType*        m_lookup[256];
+    uint64_t                    m_blocks_read;
+    uint64_t                    m_search_reads;
+    uint64_t                    m_invalid_blocks;
+    uint8_t                     m_unpacked[LOG_PACK_RAW_SIZE];
+
+};
@@ -0,0 +1,320 @@
+/*
+    Extract data from a TAROS binary log file (see src/log_format.h).
+
+    usage: taros_log [options] <log file>
+        --info              print the file information, the schema and the time range
+        --from <t>          the start of the time window [s] (acquisition time, default: start of the log)
+        --to <t>            the end of the time window [s] (default: end of the log)
+        --record <name>     only records of this type (e.g. DATA_IMU_GYRO, MESSAGE)
+        --format json|csv|text
+                            the output format (default json, one object per record)
+                            csv needs --record if the schema has more than one record type
+                            text prints one line per record, the messages as the USB debug output
+        --output <file>     write to a file instead of stdout
+        --stats             report the data blocks decoded, the block reads (those of the
+                            search for the start time separately) and the extraction speed on stderr
+
+    Only the index blocks and the data blocks of the time window are read,
+    so extracting a few seconds from a log of many GB is immediate.
+
+    The messages of the system log are stored in the compact binary format,
+    here they are rendered as text the same way the flight software would do it.
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <getopt.h>
+
+#include "log_reader.h"
+#include "message.h"
+
+// the output formats
+#define FORMAT_JSON 0
+#define FORMAT_CSV 1
+#define FORMAT_TEXT 2
+
+// append a field value of a record to the output line
+static void print_field(FILE* out, const LogField &field, const uint8_t* data, bool json)
+{
+    const uint8_t* p = data + field.offset;
+    const std::string &t = field.type;
+    if (t == "u8") { uint8_t v; memcpy(&v, p, 1); fprintf(out, "%u", v); }
+    else if (t == "i8") { int8_t v; memcpy(&v, p, 1); fprintf(out, "%d", v); }
+    else if (t == "u16") { uint16_t v; memcpy(&v, p, 2); fprintf(out, "%u", v); }
+    else if (t == "i16") { int16_t v; memcpy(&v, p, 2); fprintf(out, "%d", v); }
+    else if (t == "u32") { uint32_t v; memcpy(&v, p, 4); fprintf(out, "%u", v); }
+    else if (t == "i32") { int32_t v; memcpy(&v, p, 4); fprintf(out, "%d", v); }
+    else if (t == "u64") { uint64_t v; memcpy(&v, p, 8); fprintf(out, "%llu", (unsigned long long)v); }
+    else if (t == "i64") { int64_t v; memcpy(&v, p, 8); fprintf(out, "%lld", (long long)v); }
+    else
+    {
+        double v;
+        if (t == "f32") { float f; memcpy(&f, p, 4); v = f; }
+        else memcpy(&v, p, 8);
+        if (json and not std::isfinite(v)) fputs("null", out);
+        else fprintf(out, (t == "f32") ? "%.7g" : "%.15g", v);
+    };
+}
+
+// write a text as a quoted JSON string
+static void print_json_string(FILE* out, const std::string &text)
+{
+    fputc('"', out);
+    for (unsigned char c : text)
+    {
+        if ((c == '"') or (c == '\\')) fprintf(out, "\\%c", c);
+        else if (c < 0x20) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    };
+    fputc('"', out);
+}
+
+// write a text as a quoted CSV field
+static void print_csv_string(FILE* out, const std::string &text)
+{
+    fputc('"', out);
+    for (char c : text)
+    {
+        if (c == '"') fputc('"', out);
+        fputc(c, out);
+    };
+    fputc('"', out);
+}
+
+// render a message record (data points after the signature) as text
+static std::string message_text(const uint8_t* data)
+{
+    Message msg((const char*)data + LOG_MESSAGE_HEADER - 1, data[LOG_MESSAGE_HEADER - 2]);
+    return msg.printout();
+}
+
+static void print_record(FILE* out, const LogRecordType* type, const uint8_t* data, int format)
+{
+    if (format == FORMAT_JSON)
+    {
+        fprintf(out, "{\"record\":\"%s\"", type->name.c_str());
+        for (const LogField &field : type->fields)
+        {
+            fprintf(out, ",\"%s\":", field.name.c_str());
+            print_field(out, field, data, true);
+        };
+        if (type->message)
+        {
+            fputs(",\"text\":", out);
+            print_json_string(out, message_text(data));
+        };
+        fputs("}\n", out);
+    }
+    else if (format == FORMAT_CSV)
+    {
+        for (size_t i=0; i<type->fields.size(); i++)
+        {
+            if (i > 0) fputc(',', out);
+            print_field(out, type->fields[i], data, false);
+        };
+        if (type->message)
+        {
+            fputc(',', out);
+            print_csv_string(out, message_text(data));
+        };
+        fputc('\n', out);
+    }
+    else
+    {
+        uint64_t time;
+        memcpy(&time, data, sizeof(time));
+        fprintf(out, "%12.6f ", 1.0e-6*time);
+        if (type->message)
+            fputs(message_text(data).c_str(), out);
+        else
+        {
+            fputs(type->name.c_str(), out);
+            for (size_t i=1; i<type->fields.size(); i++)
+            {
+                fprintf(out, " %s=", type->fields[i].name.c_str());
+                print_field(out, type->fields[i], data, false);
+            };
+        };
+        fputc('\n', out);
+    };
+}
+
+static void print_info(LogReader &reader)
+{
+    const LogHeadInfo &info = reader.info();
+    printf("format version %u, run %u, file id %08x, block size %u, index every %u blocks\n",
+        info.version, info.run, info.file_id, info.block_size, info.index_interval);
+    printf("%llu blocks (%.1f MB)\n", (unsigned long long)reader.blocks(),
+        1.0e-6 * reader.blocks() * LOG_BLOCK_SIZE);
+    for (const LogRecordType &type : reader.record_types())
+    {
+        if (type.message)
+            printf("record 0x%02x %s (variable size)\n", type.signature, type.name.c_str());
+        else
+            printf("record 0x%02x %s (%zu bytes)\n", type.signature, type.name.c_str(), type.size);
+        for (const LogField &field : type.fields)
+            printf("    %-16s %-4s [%s]\n", field.name.c_str(), field.type.c_str(), field.unit.c_str());
+    };
+    uint64_t first, last;
+    if (reader.time_range(first, last))
+        printf("time %.6f ... %.6f s\n", 1.0e-6*first, 1.0e-6*last);
+    else
+        printf("no data\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bool info = false;
+    double from = -1.0;
+    double to = -1.0;
+    const char* record = NULL;
+    int format = FORMAT_JSON;
+    const char* output = NULL;
+    bool stats = false;
+
+    static struct option options[] = {
+        { "info",       no_argument,        0, 'i' },
+        { "from",       required_argument,  0, 'f' },
+        { "to",         required_argument,  0, 't' },
+        { "record",     required_argument,  0, 'r' },
+        { "format",     required_argument,  0, 'F' },
+        { "output",     required_argument,  0, 'o' },
+        { "stats",      no_argument,        0, 's' },
+        { 0, 0, 0, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+        switch (opt)
+        {
+            case 'i': info = true; break;
+            case 'f': from = atof(optarg); break;
+            case 't': to = atof(optarg); break;
+            case 'r': record = optarg; break;
+            case 'F':
+                if (strcmp(optarg, "json") == 0) format = FORMAT_JSON;
+                else if (strcmp(optarg, "csv") == 0) format = FORMAT_CSV;
+                else if (strcmp(optarg, "text") == 0) format = FORMAT_TEXT;
+                else
+                {
+                    fprintf(stderr, "unknown format %s\n", optarg);
+                    return 1;
+                };
+                break;
+            case 'o': output = optarg; break;
+            case 's': stats = true; break;
+            default:
+                fprintf(stderr, "see the head of taros_log.cpp for the options\n");
+                return 1;
+        };
+    if (optind >= argc)
+    {
+        fprintf(stderr, "usage: taros_log [options] <log file>\n");
+        return 1;
+    };
+
+    LogReader reader;
+    std::string error;
+    if (not reader.open(argv[optind], error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    };
+    if (info)
+    {
+        print_info(reader);
+        return 0;
+    };
+
+    // the record type selected
+    const LogRecordType* only = NULL;
+    if (record != NULL)
+    {
+        for (const LogRecordType &type : reader.record_types())
+            if (type.name == record) only = &type;
+        if (only == NULL)
+        {
+            fprintf(stderr, "record %s is not in the schema\n", record);
+            return 1;
+        };
+    }
+    else if (format == FORMAT_CSV)
+    {
+        if (reader.record_types().size() != 1)
+        {
+            fprintf(stderr, "csv output needs --record\n");
+            return 1;
+        };
+        only = &reader.record_types()[0];
+    };
+
+    FILE* out = stdout;
+    if (output != NULL)
+    {
+        out = fopen(output, "w");
+        if (out == NULL)
+        {
+            perror(output);
+            return 1;
+        };
+    };
+    if (format == FORMAT_CSV)
+    {
+        for (size_t i=0; i<only->fields.size(); i++)
+            fprintf(out, "%s%s", (i > 0) ? "," : "", only->fields[i].name.c_str());
+        if (only->message) fputs(",text", out);
+        fputc('\n', out);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t t_from = (from > 0.0) ? (uint64_t)llround(from*1.0e6) : 0;
+    uint64_t t_to = (to >= 0.0) ? (uint64_t)llround(to*1.0e6) : UINT64_MAX;
+    uint64_t records = 0;
+    uint64_t data_blocks = 0;
+    uint8_t block[LOG_BLOCK_SIZE];
+    const LogBlockHeader* h = (const LogBlockHeader*)block;
+    for (uint64_t seq = reader.seek(t_from); seq < reader.blocks(); seq++)
+    {
+        if (not reader.read_block(seq, block))
+        {
+            // never written (the preallocated space after an unclean shutdown)
+            if (h->magic == 0) break;
+            continue;
+        };
+        if (not log_data_block(h->type)) continue;
+        if (h->first_time > t_to) break;
+        data_blocks++;
+        const uint8_t* payload;
+        size_t payload_size = reader.block_records(block, payload);
+        size_t pos = 0;
+        while (pos < payload_size)
+        {
+            size_t size = reader.record_size(payload + pos, payload_size - pos);
+            if (size == 0) break;
+            const LogRecordType* type = reader.record_type(payload[pos]);
+            const uint8_t* data = payload + pos + 1;
+            pos += size;
+            uint64_t time;
+            memcpy(&time, data, sizeof(time));
+            if ((time < t_from) or (time > t_to)) continue;
+            if ((only != NULL) and (type != only)) continue;
+            print_record(out, type, data, format);
+            records++;
+        };
+    };
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (out != stdout) fclose(out);
+    else fflush(out);
+
+    if (stats)
+        fprintf(stderr, "%llu records from %llu data blocks in %.3f s -- "
+            "block reads %llu for the data, %llu for seeking, of %llu blocks in the file (%llu invalid)\n",
+            (unsigned long long)records, (unsigned long long)data_blocks, seconds,
+            (unsigned long long)reader.blocks_read(), (unsigned long long)reader.search_reads(),
+            (unsigned long long)reader.blocks(), (unsigned long long)reader.invalid_blocks());
+    return 0;
+}
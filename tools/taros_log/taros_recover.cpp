@@ -0,0 +1,201 @@
+/*
+    Recover TAROS binary log files (see src/log_format.h) from a raw image of an SD card,
+    e.g. after a power loss when the file system does not know the size of the files.
+
+    usage: taros_recover [options] <image>
+        --list              only list the log files found
+        --output <dir>      the directory where the recovered files are written (default: .)
+        --run <n>           only recover the files of this run
+
+    The image is read from a block device or a file (dd if=/dev/sdX of=card.img).
+    The head blocks of the log files are found by their content, the search
+    proceeds in steps of 512 bytes (one sector). As the log files are preallocated
+    in one contiguous piece, the blocks of a file follow its head block.
+    They are taken as long as they are valid blocks of this file (magic number,
+    sequence number, CRC with the file identifier), the first block not completely
+    written ends the file. The recovered files are named run.<run>.<file id>.tlog
+    and can be read with taros_log.
+
+    A file that was not contiguous on the card (its preallocation failed)
+    can only be recovered up to the end of its first fragment.
+*/
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log_format.h"
+
+// the step in which the head blocks are searched
+#define RECOVER_SECTOR_SIZE 512
+
+// the size of the pieces in which the image is searched
+#define RECOVER_CHUNK_SIZE (16*1024*1024)
+
+// a log file found on the image
+struct RecoveredFile {
+    uint64_t        offset;     // of the head block in the image
+    LogHeadInfo     info;
+    std::string     kinds;      // the record types in the schema
+    uint64_t        blocks;     // the number of valid blocks including the head block
+    uint64_t        first_time;
+    uint64_t        last_time;
+};
+
+// read a block from the image, false if it is not completely inside the image
+static bool read_image(int fd, uint64_t offset, uint8_t* block)
+{
+    return pread(fd, block, LOG_BLOCK_SIZE, offset) == LOG_BLOCK_SIZE;
+}
+
+// check whether a block is a head block, fill in the file information if it is
+static bool head_block(const uint8_t* block, RecoveredFile &file)
+{
+    const LogBlockHeader* h = (const LogBlockHeader*)block;
+    if ((h->type != LOG_BLOCK_HEAD) or (h->sequence != 0) or not log_block_valid(block, 0)) return false;
+    memcpy(&file.info, block + sizeof(LogBlockHeader), sizeof(file.info));
+    if (memcmp(file.info.format, "TAROSLOG", 8) != 0) return false;
+    if ((file.info.block_size != LOG_BLOCK_SIZE) or (file.info.index_interval != LOG_INDEX_INTERVAL)) return false;
+    if (sizeof(LogHeadInfo) + file.info.schema_size > h->size) return false;
+    // the names of the record types from the schema
+    std::istringstream schema(std::string(
+        (const char*)block + sizeof(LogBlockHeader) + sizeof(LogHeadInfo), file.info.schema_size));
+    std::string line;
+    file.kinds.clear();
+    while (std::getline(schema, line))
+    {
+        std::istringstream words(line);
+        std::string key, signature, name;
+        words >> key >> signature >> name;
+        if ((key != "record") and (key != "message")) continue;
+        if (not file.kinds.empty()) file.kinds += ",";
+        file.kinds += name;
+    };
+    file.offset = 0;
+    file.blocks = 1;
+    file.first_time = h->first_time;
+    file.last_time = h->last_time;
+    return true;
+}
+
+// follow the blocks of a file, optionally copying them to the output
+static void follow_file(int fd, RecoveredFile &file, FILE* out)
+{
+    uint8_t block[LOG_BLOCK_SIZE];
+    const LogBlockHeader* h = (const LogBlockHeader*)block;
+    bool data = false;
+    for (uint64_t seq = 0; ; seq++)
+    {
+        if (not read_image(fd, file.offset + seq*LOG_BLOCK_SIZE, block)) break;
+        if ((h->sequence != seq) or not log_block_valid(block, file.info.file_id)) break;
+        if (out != NULL) fwrite(block, 1, LOG_BLOCK_SIZE, out);
+        file.blocks = seq+1;
+        if (log_data_block(h->type))
+        {
+            if (not data) file.first_time = h->first_time;
+            data = true;
+        };
+        if (h->type != LOG_BLOCK_HEAD) file.last_time = h->last_time;
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    bool list = false;
+    std::string output = ".";
+    long only_run = -1;
+
+    static struct option options[] = {
+        { "list",       no_argument,        0, 'l' },
+        { "output",     required_argument,  0, 'o' },
+        { "run",        required_argument,  0, 'r' },
+        { 0, 0, 0, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+        switch (opt)
+        {
+            case 'l': list = true; break;
+            case 'o': output = optarg; break;
+            case 'r': only_run = atol(optarg); break;
+            default:
+                fprintf(stderr, "see the head of taros_recover.cpp for the options\n");
+                return 1;
+        };
+    if (optind >= argc)
+    {
+        fprintf(stderr, "usage: taros_recover [options] <image>\n");
+        return 1;
+    };
+    int fd = open(argv[optind], O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "%s : %s\n", argv[optind], strerror(errno));
+        return 1;
+    };
+
+    // search the image for head blocks
+    std::vector<RecoveredFile> files;
+    std::vector<uint8_t> chunk(RECOVER_CHUNK_SIZE);
+    uint8_t block[LOG_BLOCK_SIZE];
+    uint64_t offset = 0;
+    while (true)
+    {
+        ssize_t n = pread(fd, chunk.data(), RECOVER_CHUNK_SIZE, offset);
+        if (n <= 0) break;
+        for (ssize_t pos = 0; pos + (ssize_t)sizeof(LogBlockHeader) <= n; pos += RECOVER_SECTOR_SIZE)
+        {
+            // most sectors are rejected by the magic number
+            uint32_t magic;
+            memcpy(&magic, chunk.data() + pos, sizeof(magic));
+            if (magic != LOG_BLOCK_MAGIC) continue;
+            RecoveredFile file;
+            if (not read_image(fd, offset + pos, block) or not head_block(block, file)) continue;
+            file.offset = offset + pos;
+            if ((only_run >= 0) and (file.info.run != only_run)) continue;
+            files.push_back(file);
+        };
+        offset += n;
+    };
+    if (files.empty())
+    {
+        fprintf(stderr, "no log files found\n");
+        close(fd);
+        return 1;
+    };
+
+    for (RecoveredFile &file : files)
+    {
+        FILE* out = NULL;
+        char name[64];
+        snprintf(name, sizeof(name), "run.%05u.%08x.tlog", file.info.run, file.info.file_id);
+        std::string path = output + "/" + name;
+        if (not list)
+        {
+            out = fopen(path.c_str(), "wb");
+            if (out == NULL)
+            {
+                perror(path.c_str());
+                close(fd);
+                return 1;
+            };
+        };
+        follow_file(fd, file, out);
+        if (out != NULL) fclose(out);
+        printf("%s : offset %llu, %llu blocks (%.1f MB), time %.3f ... %.3f s, %s\n",
+            name, (unsigned long long)file.offset, (unsigned long long)file.blocks,
+            1.0e-6 * file.blocks * LOG_BLOCK_SIZE, 1.0e-6*file.first_time, 1.0e-6*file.last_time,
+            file.kinds.c_str());
+    };
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+    Decompress a TAROS binary log file (see src/log_format.h).
+
+    usage: taros_unpack <input> <output>
+
+    All packed data blocks (LOG_BLOCK_PACKED) are decompressed and the records
+    are stored in plain data blocks again, in the same order and with the same
+    schema and run number. The output is a complete log file with a new index,
+    so it can be read by tools that do not know the compressed blocks.
+    Invalid blocks of the input (e.g. a file recovered after a power loss) are skipped.
+    taros_log reads the compressed files directly, this is not needed for it.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "log_format.h"
+#include "log_reader.h"
+
+// write all blocks that are ready, returns the number of blocks written
+static uint64_t write_ready(LogBlockWriter &writer, FILE* out)
+{
+    uint64_t n = 0;
+    const uint8_t* block;
+    while ((block = writer.ready()) != NULL)
+    {
+        fwrite(block, 1, LOG_BLOCK_SIZE, out);
+        writer.release();
+        n++;
+    };
+    return n;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: taros_unpack <input> <output>\n");
+        return 1;
+    };
+
+    LogReader reader;
+    std::string error;
+    if (not reader.open(argv[1], error))
+    {
+        fprintf(stderr, "%s : %s\n", argv[1], error.c_str());
+        return 1;
+    };
+    uint8_t block[LOG_BLOCK_SIZE];
+    const LogBlockHeader* h = (const LogBlockHeader*)block;
+    // the creation time is taken from the head block
+    if (not reader.read_block(0, block))
+    {
+        fprintf(stderr, "%s : no valid head block\n", argv[1]);
+        return 1;
+    };
+    FILE* out = fopen(argv[2], "wb");
+    if (out == NULL)
+    {
+        perror(argv[2]);
+        return 1;
+    };
+
+    // the blocks are written as soon as they are complete, so the buffers never run out
+    static LogBlockWriter writer;
+    writer.begin(reader.info().run, reader.schema().c_str(), h->first_time);
+    uint64_t blocks = write_ready(writer, out);
+    uint64_t packed = 0;
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+    for (uint64_t seq = 1; seq < reader.blocks(); seq++)
+    {
+        if (not reader.read_block(seq, block))
+        {
+            // never written (the preallocated space after an unclean shutdown)
+            if (h->magic == 0) break;
+            continue;
+        };
+        if (not log_data_block(h->type)) continue;
+        if (h->type == LOG_BLOCK_PACKED) packed++;
+        const uint8_t* payload;
+        size_t payload_size = reader.block_records(block, payload);
+        size_t pos = 0;
+        while (pos < payload_size)
+        {
+            size_t size = reader.record_size(payload + pos, payload_size - pos);
+            if (size == 0) break;
+            uint64_t time;
+            memcpy(&time, payload + pos + 1, sizeof(time));
+            if (not writer.add(payload + pos, size, time))
+            {
+                blocks += write_ready(writer, out);
+                writer.add(payload + pos, size, time);
+            };
+            pos += size;
+            records++;
+            bytes += size;
+        };
+        blocks += write_ready(writer, out);
+    };
+    writer.finish();
+    blocks += write_ready(writer, out);
+    fclose(out);
+
+    printf("%llu records (%llu bytes) from %llu packed of %llu blocks into %llu blocks, %llu invalid blocks\n",
+        (unsigned long long)records, (unsigned long long)bytes, (unsigned long long)packed,
+        (unsigned long long)reader.blocks(), (unsigned long long)blocks,
+        (unsigned long long)reader.invalid_blocks());
+    return 0;
+}